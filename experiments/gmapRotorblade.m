@@ -11,7 +11,7 @@ gmap.repeats = 2;
 % generic GradientMapper settings
 gmap.params.episodes = 100;
 gmap.params.iterationsCIt = 10;
-gmap.params.useMex = false;
+gmap.params.useMex = true;
 
 % define the environment and the agent
 a1reward = 0.5;
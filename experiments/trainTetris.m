@@ -17,6 +17,7 @@ args.addParamValue( 'conf', 'actor-critic', @ischar );
 
 args.addParamValue( 'logLevel', 'iterations', @ischar );
 args.addParamValue( 'useMex', true, @islogical );
+args.addParamValue( 'useMexTraining', false, @islogical );   % run training iterations natively (see TrainMex)
 
 args.addParamValue( 'iterations', 10, @(x) (isnumeric(x) && isscalar(x)) );
 args.addParamValue( 'trainTestEpisodes', 0, @(x) (isnumeric(x) && isscalar(x)) );
@@ -71,6 +72,9 @@ if ischar(p.theta0)
   if isempty(p.w0); p.w0 = [w0; zeros(size(p.theta0))]; end
 end
 
+% native training needs the critic to be solved natively
+if p.useMexTraining; p.actorArgs = [ {'mexSolve', true}, p.actorArgs ]; end
+
 
 
 
@@ -169,6 +173,7 @@ trainer.training.iterations = p.iterations;
 trainer.training.evaluation.iterations = p.episodesIt;
 trainer.training.evaluation.episodeStoppingConditions = stopConds.train;
 trainer.training.evaluation.useMex = p.useMex;
+trainer.training.useMexTraining = p.useMexTraining;
 
 % configure during-training testing
 trainer.trainingTest.iterations = p.iterations;
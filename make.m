@@ -13,29 +13,40 @@ switch mode
     delete *.mex*
     cd ..
     
-  case {'all', 'debug'}
+  case {'all', 'debug', 'profile'}
+
+    % the Tetris engine, the standalone Tetris environment (see TetrisNative.m), and the generic engine of the native
+    % graph and grid environments. the shared-memory farms of MexTetrisNAC need librt with older glibc versions.
+    if isunix && ~ismac, farmLibraries = { '-lrt' }; else farmLibraries = {}; end
+    targets = { [ { 'MexTetrisNAC.cpp', 'EngineComparison.cpp', 'RolloutEngine.cpp', 'SharedFarm.cpp' }, ...
+                  engineSources(), farmLibraries ], ...
+                [ { 'MexTetris.cpp' }, engineSources() ], ...
+                [ { 'MexGenericNAC.cpp', 'NativeEnvironment.cpp', 'GraphEnvironment.cpp', 'GridEnvironment.cpp', ...
+                    'GenericActorCritic.cpp' }, engineSources() ] };
+    optimFlags = { 'COPTIMFLAGS="\$COPTIMFLAGS -O2"', ...
+                   'CXXOPTIMFLAGS="\$CXXOPTIMFLAGS -O2"', ...
+                   'LDOPTIMFLAGS="\$LDOPTIMFLAGS -O2"', ...
+                   'LDCXXOPTIMFLAGS="\$LDCXXOPTIMFLAGS -O2"' };
 
     cd src/mex/+TetrisNAC
-    try
-      if strcmp(mode, 'debug')
-        fprintf('Compiling with debugging ON.\n');
-        mex -g ...
-          MexTetrisNAC.cpp Tetris.cpp NaturalActorCritic.cpp LSTDLambda.cpp LSPELambda.cpp FullTDLambda.cpp ...
-          ../../../external/SeedFill.cpp
-      else
-        fprintf('Compiling with debugging OFF.\n');
-        % mex -O -lcblas ...
-        %   MexTetrisNAC.cpp Tetris.cpp NaturalActorCritic.cpp LSTDLambda.cpp LSPELambda.cpp FullTDLambda.cpp ...
-        %   ../../../external/SeedFill.cpp
-        mex -O ...
-          COPTIMFLAGS="\$COPTIMFLAGS -O2" ...
-          CXXOPTIMFLAGS="\$CXXOPTIMFLAGS -O2" ...
-          LDOPTIMFLAGS="\$LDOPTIMFLAGS -O2" ...
-          LDCXXOPTIMFLAGS="\$LDCXXOPTIMFLAGS -O2" ...
-          MexTetrisNAC.cpp Tetris.cpp NaturalActorCritic.cpp LSTDLambda.cpp LSPELambda.cpp FullTDLambda.cpp ...
-          ../../../external/SeedFill.cpp
+    for target = targets
+      sources = target{1};
+      try
+        switch mode
+          case 'debug'
+            fprintf('Compiling %s with debugging ON.\n', sources{1});
+            mex( '-g', sources{:} );
+          case 'profile'
+            % collect hot-path call counts and cycle totals (returned in the 'profile' field, see mex/Profiler.hpp)
+            fprintf('Compiling %s with debugging OFF, profiling counters ON.\n', sources{1});
+            mex( '-O', '-DPROFILING=1', optimFlags{:}, sources{:} );
+          otherwise
+            fprintf('Compiling %s with debugging OFF.\n', sources{1});
+            % mex( '-O', '-lcblas', sources{:} );
+            mex( '-O', optimFlags{:}, sources{:} );
+        end
+      catch err
       end
-    catch err
     end
     cd ../../..
 
@@ -48,7 +59,37 @@ switch mode
 
     clear functions
     
+  case 'capi'
+    
+    % the C library (see src/mex/+TetrisNAC/TetrisNACApi.h), linked against the Matrix API of this Matlab installation
+    assert( ~ispc, 'make capi: only supported with gcc or clang' );
+    if ismac, library = 'libtetrisnac.dylib'; else library = 'libtetrisnac.so'; end
+    sources = [ { 'TetrisNACApi.cpp', 'StandaloneMex.cpp' }, engineSources() ];
+    libDir = fullfile( matlabroot, 'bin', computer('arch') );
+    command = sprintf( ['g++ -std=c++11 -O2 -fPIC -shared -fvisibility=hidden -DNDEBUG -DTNAC_BUILD ' ...
+                        '-I"%s" -o %s %s -L"%s" -Wl,-rpath,"%s" -lmx -lpthread'], ...
+                       fullfile( matlabroot, 'extern', 'include' ), library, strjoin( sources, ' ' ), libDir, libDir );
+    
+    cd src/mex/+TetrisNAC
+    fprintf('Compiling the C library %s.\n', library);
+    status = system( command );
+    cd ../../..
+    assert( status == 0, 'make capi: compilation failed' );
+    
 end
 
 
 end
+
+
+
+
+% the engine sources shared by the mex file and the C library
+function sources = engineSources()
+
+sources = { 'Tetris.cpp', 'ActionCache.cpp', 'NaturalActorCritic.cpp', 'Critic.cpp', 'LSTDLambda.cpp', ...
+            'LSPELambda.cpp', 'FullTDLambda.cpp', 'EpisodicNAC.cpp', 'GradientTDLambda.cpp', 'Solver.cpp', ...
+            'CriticPipeline.cpp', 'TetrisBatch.cpp', 'TransitionStore.cpp', 'ObservationLogger.cpp', ...
+            'BatchEvaluation.cpp', 'EpisodeStatistics.cpp', '../../../external/SeedFill.cpp' };
+
+end
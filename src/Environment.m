@@ -78,6 +78,15 @@ classdef Environment < Configurable & Copyable & handle
     % Random number stream
     rstream;
     
+    % Counter-based random streams for mex implementations. If the seed is
+    % set, then each episode run in a mex implementation draws its pieces
+    % and actions from streams keyed by the seed and the episode counter,
+    % instead of rstream, so that any episode can be regenerated on its own
+    % and batched results do not depend on the batch size. The counter is
+    % advanced by RunEpisodeMex, TrainMex and EvaluateBatchMex.
+    mexRngSeed = [];
+    mexRngEpisode = 0;
+    
     % Temporary solution. TODO clean up
     observationLog;
     observationLogLength = 0;
@@ -329,6 +338,10 @@ classdef Environment < Configurable & Copyable & handle
         
         % fill in data
         data.rstream = this.rstream;
+        if ~isempty(this.mexRngSeed)
+          data.rngSeed = this.mexRngSeed;
+          data.rngEpisode = this.mexRngEpisode;
+        end
         
       else
         mexFork( this.rstream ); data = [];
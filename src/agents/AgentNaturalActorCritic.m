@@ -55,6 +55,14 @@ classdef AgentNaturalActorCritic < Agent
     % the critic
     critic;
     
+    % further critics that are stepped on the same transitions as the
+    % critic, for comparing critic settings on a single run (cell array)
+    sweepCritics;
+    
+    % the critic statistics of each learning episode of the mex
+    % implementation, or [] (see the 'mexEpisodeStatistics' option)
+    episodeStatistics = [];
+    
     % The actor parameter column vector. type: column double array, length: aDim
     theta;
     
@@ -70,6 +78,63 @@ classdef AgentNaturalActorCritic < Agent
     % Learning iteration counter. type: int
     actorIteration = 0;
     
+    % Whether to keep the mex implementation alive across episodes in a
+    % persistent session. See mex/+TetrisNAC/MexTetrisNAC.cpp.
+    useMexSession;
+    
+    % Whether to keep the critic statistics in the mex session and solve
+    % the critic there, instead of transferring the statistics to Matlab.
+    useMexSolver;
+    
+    % Whether the mex implementation should run the critic updates in a
+    % separate learner thread, overlapping with the simulation.
+    useMexPipeline;
+    
+    % Truncation level of the importance weights for reusing the
+    % transitions of earlier policies (0 if disabled), and the number of
+    % steps to keep for reuse.
+    mexReuse;
+    mexReuseCapacity;
+    
+    % Policy settings of the mex implementation, or empty for the
+    % compiled-in defaults (see the constructor).
+    mexRejectTerminalActions;
+    mexPetersTrickMode;
+    
+    % Whether the mex implementation records the critic statistics of
+    % each episode, and the file to append them to (see the constructor).
+    mexEpisodeStatistics;
+    mexEpisodeStatisticsFile;
+    
+    % Interval of the actor updates within the episodes of the mex
+    % implementation, in learned transitions (0 if disabled).
+    mexOnlineUpdates;
+    
+  end
+  
+  properties (Access=protected, Transient)
+    
+    % Mex session handle and the mex function owning it, or [] if no
+    % session has been created. Transient, so that clones will create
+    % their own sessions.
+    mexSession = [];
+    mexSessionFunction = [];
+    
+    % Whether the mex session holds critic statistics that have not yet
+    % been added to the critic. These are pulled in only when the critic
+    % is actually used (see pullMexCritic).
+    mexCriticPending = false;
+    
+    % Native solving: whether the critic holds the current solution from
+    % the mex session, and the condition number returned with it.
+    mexSolutionOk = false;
+    mexCond = NaN;
+    
+    % Transition reuse: whether the transitions of earlier policies have
+    % yet to be re-evaluated into the session's critic statistics for the
+    % current policy.
+    mexReusePending = false;
+    
   end
   
   
@@ -91,6 +156,80 @@ classdef AgentNaturalActorCritic < Agent
       %     Level of enforced explorativity in the main policy. Currently
       %     this has the effect of constaining the 2-norm of theta to
       %     thetaC or below: ||theta||_2 <= thetaC
+      %
+      %   'mexSession', (logical) useMexSession
+      %     Keep the mex implementation (environment, agent and critic
+      %     statistics) alive across episodes in a persistent mex session
+      %     instead of constructing it anew for each episode. The critic
+      %     statistics are then transferred only when they are needed.
+      %
+      %   'mexSolve', (logical) useMexSolver
+      %     Implies 'mexSession'. Keep the critic statistics in the mex
+      %     session for good, and solve the critic there using the critic's
+      %     batchMethod. Only the solution and its condition number are
+      %     transferred. Supported by LSTDLambda and LSPELambda with the
+      %     batch methods '\', 'chol', 'qr', 'pinv' and 'regularized', and
+      %     by GradientTDLambda, whose parameters then stay in the session.
+      %     GradientTDLambda requires this option with 'mexSession'.
+      %
+      %   'mexPipeline', (logical) useMexPipeline
+      %     Run the critic updates of the mex implementation in a separate
+      %     learner thread, so that they overlap with the simulation. The
+      %     results are identical.
+      %
+      %   'mexReuse', (double) mexReuse
+      %     Requires 'mexSolve' and LSTDLambda. If positive, then the mex
+      %     session records the transitions of the learning episodes, and
+      %     before solving the critic, the transitions recorded under
+      %     earlier policies are re-evaluated under the current policy
+      %     with per-decision importance weights truncated to at most
+      %     mexReuse (Inf for no truncation) and added to the critic
+      %     statistics. This allows running fewer fresh episodes per
+      %     iteration. As the reused transitions are added anew on every
+      %     iteration, the critic's forgetting factor should be 0.
+      %
+      %   'mexReuseCapacity', (int) mexReuseCapacity
+      %     Maximum number of steps to keep for reuse (default 100000).
+      %     The oldest episodes are dropped first.
+      %
+      %   'mexRejectTerminalActions', (logical) mexRejectTerminalActions
+      %     Whether the mex implementation never selects actions that lead
+      %     to termination. Empty (default) for the compiled-in default.
+      %
+      %   'mexPetersTrickMode', (char) mexPetersTrickMode
+      %     The mode of Peters' variance reduction trick in the mex
+      %     implementation: 'off', 'on' or 'corrected' (LSTDLambda only).
+      %     Empty (default) for the compiled-in default. Fixed for the
+      %     lifetime of a mex session.
+      %
+      %   'sweepCritics', (cell array) sweepCritics
+      %     Further critics (for example, the same critic class with other
+      %     gamma and lambda) that learn from exactly the same transitions
+      %     as the critic, in both implementations, without affecting the
+      %     policy. A parameter sweep thus costs a single run. The critics
+      %     are forgotten with the critic; see getSweepCritics(). Not
+      %     supported with 'mexSolve'.
+      %
+      %   'mexEpisodeStatistics', (logical) mexEpisodeStatistics
+      %     Record the contribution of each learning episode of the mex
+      %     implementation to the critic statistics (A, b and, with
+      %     LSPELambda, B) along with its return and stream index, for
+      %     estimating the variance of the gradient by resampling the
+      %     episodes. See getEpisodeStatistics(). Requires LSTDLambda,
+      %     LSPELambda or EpisodicNAC. Not supported with 'mexSolve'.
+      %
+      %   'mexEpisodeStatisticsFile', (char) mexEpisodeStatisticsFile
+      %     Append the records of 'mexEpisodeStatistics' to this file
+      %     instead of returning them, also with 'mexSolve'. See
+      %     readEpisodeStatistics.
+      %
+      %   'mexOnlineUpdates', (int) mexOnlineUpdates
+      %     Requires 'mexSolve'. If positive, then the mex implementation
+      %     also performs an actor iteration (as iterateActor() does,
+      %     including forgetting) every mexOnlineUpdates learned
+      %     transitions within each episode, so that long episodes improve
+      %     the policy while they run. theta and the critic are taken over
+      %     after the episode. Not supported with 'mexReuse' or TrainMex.
       
       this.critic = critic;
       
@@ -101,6 +240,17 @@ classdef AgentNaturalActorCritic < Agent
       args.addParamValue( 'beta', 1, @(x) (isnumeric(x) && isscalar(x)) );
       args.addParamValue( 'tau', 1, @(x) (isnumeric(x) && isscalar(x)) );
       args.addParamValue( 'QInterpretation', 'gradient', @ischar );
+      args.addParamValue( 'mexSession', false, @(x) (islogical(x) && isscalar(x)) );
+      args.addParamValue( 'mexSolve', false, @(x) (islogical(x) && isscalar(x)) );
+      args.addParamValue( 'mexPipeline', false, @(x) (islogical(x) && isscalar(x)) );
+      args.addParamValue( 'mexReuse', 0, @(x) (isnumeric(x) && isscalar(x) && x >= 0) );
+      args.addParamValue( 'mexReuseCapacity', 100000, @(x) (isnumeric(x) && isscalar(x) && x > 0) );
+      args.addParamValue( 'mexRejectTerminalActions', [], @(x) (isempty(x) || (islogical(x) && isscalar(x))) );
+      args.addParamValue( 'mexPetersTrickMode', '', @(x) any(strcmp( x, {'', 'off', 'on', 'corrected'} )) );
+      args.addParamValue( 'sweepCritics', {}, @iscell );
+      args.addParamValue( 'mexEpisodeStatistics', false, @(x) (islogical(x) && isscalar(x)) );
+      args.addParamValue( 'mexEpisodeStatisticsFile', '', @ischar );
+      args.addParamValue( 'mexOnlineUpdates', 0, @(x) (isnumeric(x) && isscalar(x) && x >= 0) );
       args.parse( varargin{:} );
       
       this.stepsize = args.Results.stepsize;
@@ -109,6 +259,40 @@ classdef AgentNaturalActorCritic < Agent
       this.beta = args.Results.beta;
       this.tau = args.Results.tau;
       this.QInterpretation = args.Results.QInterpretation;
+      this.useMexSolver = args.Results.mexSolve;
+      this.useMexSession = args.Results.mexSession || this.useMexSolver;
+      this.useMexPipeline = args.Results.mexPipeline;
+      this.mexReuse = args.Results.mexReuse;
+      this.mexReuseCapacity = args.Results.mexReuseCapacity;
+      this.mexRejectTerminalActions = args.Results.mexRejectTerminalActions;
+      this.mexPetersTrickMode = args.Results.mexPetersTrickMode;
+      this.sweepCritics = args.Results.sweepCritics(:)';
+      this.mexEpisodeStatisticsFile = args.Results.mexEpisodeStatisticsFile;
+      this.mexEpisodeStatistics = args.Results.mexEpisodeStatistics && isempty(this.mexEpisodeStatisticsFile);
+      this.mexOnlineUpdates = args.Results.mexOnlineUpdates;
+      assert( ~strcmp( this.mexPetersTrickMode, 'corrected' ) || strcmp( class(critic), 'LSTDLambda' ), ...
+        'The corrected Peters'' trick requires LSTDLambda.' );
+      assert( this.mexReuse == 0 || (this.useMexSolver && strcmp( class(critic), 'LSTDLambda' )), ...
+        'Transition reuse requires the ''mexSolve'' option and LSTDLambda.' );
+      assert( isempty(this.sweepCritics) || ~this.useMexSolver, 'Sweep critics are not supported with ''mexSolve''.' );
+      assert( ~any(cellfun( @(c) isa( c, 'GradientTDLambda' ), this.sweepCritics )), ...
+        'GradientTDLambda is not supported as a sweep critic.' );
+      assert( ~isa( critic, 'GradientTDLambda' ) || ~this.useMexSession || this.useMexSolver, ...
+        'GradientTDLambda requires the ''mexSolve'' option with ''mexSession''.' );
+      assert( ~this.mexEpisodeStatistics || ~this.useMexSolver, ...
+        'Episode statistics are returned only without ''mexSolve''; use ''mexEpisodeStatisticsFile''.' );
+      assert( (~this.mexEpisodeStatistics && isempty(this.mexEpisodeStatisticsFile)) || ...
+        any(strcmp( class(critic), {'LSTDLambda', 'LSPELambda', 'EpisodicNAC'} )), ...
+        'Episode statistics require LSTDLambda, LSPELambda or EpisodicNAC.' );
+      assert( this.mexOnlineUpdates == 0 || (this.useMexSolver && this.mexReuse == 0), ...
+        'Online updates require the ''mexSolve'' option and no ''mexReuse''.' );
+      
+    end
+    
+    function delete( this )
+      % Destructor: release the mex session, if any
+      
+      if ~isempty(this.mexSession); this.mexSessionFunction( 'destroy', this.mexSession ); end
       
     end
     
@@ -127,7 +311,8 @@ classdef AgentNaturalActorCritic < Agent
       this.aDim = this.props.actionDim;
       
       % compute critic dimensionality and set it to critic
-      this.critic.dim = this.sDim + this.aDim;
+      this.critic = initCritic( this, this.critic );
+      this.sweepCritics = cellfun( @(c) initCritic( this, c ), this.sweepCritics, 'UniformOutput', false );
       
       % check theta0
       if isempty(this.theta0); this.theta0 = zeros( this.aDim, 1 ); end
@@ -141,8 +326,15 @@ classdef AgentNaturalActorCritic < Agent
       % reset the actor iteration counter
       this.actorIteration = 0;
       
-      % reset the critic
+      % reset the critics
       this.critic = reset( this.critic );
+      this.sweepCritics = cellfun( @reset, this.sweepCritics, 'UniformOutput', false );
+      this.episodeStatistics = [];
+      
+      % discard any critic statistics still held in the mex session
+      if ~isempty(this.mexSession); this.mexSessionFunction( 'reset', this.mexSession ); end
+      this.mexCriticPending = false;
+      this.mexSolutionOk = false;
       
     end
     
@@ -152,6 +344,7 @@ classdef AgentNaturalActorCritic < Agent
       this.prevState = this.state;
       
       this.critic = newEpisode( this.critic );
+      this.sweepCritics = cellfun( @newEpisode, this.sweepCritics, 'UniformOutput', false );
       
     end
     
@@ -224,6 +417,9 @@ classdef AgentNaturalActorCritic < Agent
       % handle args
       if nargin < 2; stepsize = this.stepsize; end
       
+      % make sure that the critic is up to date
+      this = pullMexCritic( this );
+      
       % handle stepsize scheduling
       if length(stepsize) == 2
         stepsize = stepsize(1) / (this.actorIteration + stepsize(2));
@@ -249,6 +445,12 @@ classdef AgentNaturalActorCritic < Agent
       % finalize the critic, then forget critic statistics
       this.critic = finalize( this.critic );
       this.critic = forget( this.critic );
+      this.sweepCritics = cellfun( @(c) forget( finalize( c ) ), this.sweepCritics, 'UniformOutput', false );
+      if this.useMexSolver && ~isempty(this.mexSession)
+        this.mexSessionFunction( 'forget', this.mexSession, this.critic.beta );
+        this.mexSolutionOk = false;
+        this.mexReusePending = this.mexReuse > 0;
+      end
       
       % increment iteration counter
       this.actorIteration = this.actorIteration + 1;
@@ -259,6 +461,7 @@ classdef AgentNaturalActorCritic < Agent
     function V = getV( this )
       
       % update the critic
+      this = pullMexCritic( this );
       this.critic = computeV( this.critic );
       
       % get V and A, return V
@@ -269,6 +472,7 @@ classdef AgentNaturalActorCritic < Agent
     function Q = getQ( this )
       
       % update the critic
+      this = pullMexCritic( this );
       this.critic = computeV( this.critic );
       
       % get V and A, return A
@@ -280,8 +484,27 @@ classdef AgentNaturalActorCritic < Agent
       theta = this.theta;
     end
     
+    % Return the sweep critics (see the constructor), up to date
+    function critics = getSweepCritics( this )
+      this = pullMexCritic( this );
+      critics = this.sweepCritics;
+    end
+    
+    % Return the critic statistics of each learning episode run since
+    % init(), up to date, as a struct with the fields episode (the
+    % counter-based stream index, or NaN), return, steps (n x 1), A
+    % (dim x dim x n), b (dim x n) and, with LSPELambda, B (dim x dim x
+    % n), or [] if none (see the 'mexEpisodeStatistics' option).
+    function episodeStatistics = getEpisodeStatistics( this )
+      this = pullMexCritic( this );
+      episodeStatistics = this.episodeStatistics;
+    end
+    
     % Return the condition number of the gradient estimate.
-    function cnd = getCond( this ); cnd = getCond( this.critic ); end
+    function cnd = getCond( this )
+      this = pullMexCritic( this );
+      if this.useMexSolver && ~isempty(this.mexSession); cnd = this.mexCond; else cnd = getCond( this.critic ); end
+    end
     
     % Assign a new theta0 (enforce into a column array)
     function this = setTheta0( this, theta0 ); this.theta0 = theta0(:); end
@@ -291,8 +514,15 @@ classdef AgentNaturalActorCritic < Agent
       
       if useMex
         
-        data.criticClass = find(strcmp( class(this.critic), {'LSTDLambda', 'LSPELambda', 'FullTDLambda'} )) - 1;
-        assert( ~isempty(data.criticClass) );
+        data.criticClass = mexCriticClass( this, this.critic );
+        if isa( this.critic, 'GradientTDLambda' ); data.criticSettings = getMexSettings( this.critic ); end
+        
+        % the sweep critics, a [criticClass, gamma, lambda] row each
+        data.sweepCritics = zeros( 0, 3 );
+        for i = 1:numel(this.sweepCritics)
+          c = this.sweepCritics{i};
+          data.sweepCritics(i,:) = [ mexCriticClass( this, c ), c.gamma, c.lambda ];
+        end
         
         data.learning = this.learning;
         
@@ -300,17 +530,81 @@ classdef AgentNaturalActorCritic < Agent
         data.gamma = this.critic.gamma;
         data.lambda = this.critic.lambda;
         data.tau = this.tau;
+        data.pipelined = this.useMexPipeline;
+        data.transitionCapacity = (this.mexReuse > 0) * this.mexReuseCapacity;
+        data.rejectTerminalActions = this.mexRejectTerminalActions;
+        data.episodeStatistics = this.mexEpisodeStatistics;
+        data.episodeStatisticsFile = this.mexEpisodeStatisticsFile;
+        if this.mexOnlineUpdates > 0
+          data.onlineUpdates = struct( 'interval', this.mexOnlineUpdates, ...
+                                       'stepsize', this.stepsize, 'actorIteration', this.actorIteration, ...
+                                       'beta', this.beta, 'thetaC', this.thetaC, ...
+                                       'QInterpretation', this.QInterpretation, 'criticBeta', this.critic.beta, ...
+                                       'solver', getSolverOptions( this.critic ) );
+        end
+        if ~isempty(this.mexPetersTrickMode)
+          data.petersTrickMode = find(strcmp( this.mexPetersTrickMode, {'off', 'on', 'corrected'} )) - 1;
+        end
+        
+        % RunEpisodeMex creates the session if the handle is empty
+        if this.useMexSession; data.mexSession = this.mexSession; end
         
       end
       
     end
     
+    function options = getMexTrainingOptions( this, iterations, episodes )
+      % Get the options for running policy improvement iterations natively
+      % with iterations policy improvement iterations and episodes
+      % evaluation episodes per iteration (see TrainMex).
+      
+      assert( this.useMexSolver, 'Native training requires the ''mexSolve'' option.' );
+      
+      options = struct( 'iterations', iterations, 'episodes', episodes, ...
+                        'stepsize', this.stepsize, 'actorIteration', this.actorIteration, ...
+                        'beta', this.beta, 'thetaC', this.thetaC, 'QInterpretation', this.QInterpretation, ...
+                        'criticBeta', this.critic.beta, 'solver', getSolverOptions( this.critic ), ...
+                        'reuseTruncation', this.mexReuse );
+    end
+    
+    function this = mexTrainingJoin( this, trainingLog )
+      % Take over the policy and the critic state after natively run
+      % policy improvement iterations (see TrainMex) or online updates
+      % (see the 'mexOnlineUpdates' option). Equivalent to the state
+      % after the corresponding iterateActor() calls.
+      
+      if isempty(trainingLog.theta); return; end
+      
+      this.theta = trainingLog.theta(:,end);
+      this.actorIteration = trainingLog.actorIteration;
+      
+      % the last solution was finalized (LSPE) and the statistics forgotten in the session
+      this.critic = finalize( setSolution( this.critic, trainingLog.w ) );
+      this.critic = forget( this.critic );
+      this.mexSolutionOk = false;
+      this.mexReusePending = this.mexReuse > 0;
+      
+    end
+    
     function this = mexJoin( this, data )
       this = mexJoin@Agent( this, data );
       
-      if ~isempty(data)
+      if ~isempty(data) && isfield( data, 'mexSession' )
+        % returning from a mex session run: the critic statistics stay in
+        % the session until needed
+        this.mexSession = data.mexSession;
+        this.mexSessionFunction = data.mexSessionFunction;
+        this.mexCriticPending = ~this.useMexSolver;
+        this.mexSolutionOk = false;
+        
+        % take over the actor iterations made during the episode
+        if this.mexOnlineUpdates > 0
+          data = this.mexSessionFunction( 'query', this.mexSession );
+          this = mexTrainingJoin( this, data.onlineUpdates );
+        end
+      elseif ~isempty(data)
         % returning from a mex call
-        this.critic = this.critic.addData( data.critic );
+        this = addMexData( this, data );
       end
       
     end
@@ -327,6 +621,79 @@ classdef AgentNaturalActorCritic < Agent
   
   methods (Access=protected)
     
+    function this = pullMexCritic( this )
+      % Bring the critic up to date with the mex session: add the critic
+      % statistics accumulated in the session to the critic and clear them
+      % in the session, or, when solving natively, solve in the session and
+      % store the solution in the critic.
+      
+      if this.useMexSolver
+        if ~isempty(this.mexSession) && ~this.mexSolutionOk
+          if this.mexReusePending
+            this.mexSessionFunction( 'reevaluate', this.mexSession, this.theta, this.tau, this.mexReuse );
+            this.mexReusePending = false;
+          end
+          solution = this.mexSessionFunction( 'solve', this.mexSession, getSolverOptions( this.critic ) );
+          this.critic = setSolution( this.critic, solution.V );
+          this.mexCond = solution.cond;
+          this.mexSolutionOk = true;
+        end
+      elseif this.mexCriticPending
+        data = this.mexSessionFunction( 'query', this.mexSession );
+        this = addMexData( this, data );
+        this.mexSessionFunction( 'reset', this.mexSession );
+        this.mexCriticPending = false;
+      end
+      
+    end
+    
+    function this = addMexData( this, data )
+      % Add the critic statistics returned by the mex implementation to
+      % the critic and the sweep critics, and append the episode records.
+      
+      this.critic = this.critic.addData( data.critic );
+      for i = 1:numel(this.sweepCritics)
+        this.sweepCritics{i} = this.sweepCritics{i}.addData( data.sweepCritics{i} );
+      end
+      
+      if isfield( data, 'episodeStatistics' ) && ~isempty(data.episodeStatistics.episode)
+        e = data.episodeStatistics;
+        if isempty(this.episodeStatistics)
+          this.episodeStatistics = e;
+        else
+          s = this.episodeStatistics;
+          s.episode = [ s.episode ; e.episode ];
+          s.return = [ s.return ; e.return ];
+          s.steps = [ s.steps ; e.steps ];
+          s.A = cat( 3, s.A, e.A );
+          s.b = [ s.b, e.b ];
+          if isfield( e, 'B' ); s.B = cat( 3, s.B, e.B ); end
+          this.episodeStatistics = s;
+        end
+      end
+      
+    end
+    
+    function criticClass = mexCriticClass( this, critic ) %#ok<INUSL>
+      % Get the criticClass of the mex implementation for the critic.
+      
+      if isa( critic, 'GradientTDLambda' )
+        criticClass = 4 + strcmp( critic.variant, 'TDC' );
+        return;
+      end
+      criticClass = find(strcmp( class(critic), {'LSTDLambda', 'LSPELambda', 'FullTDLambda', 'EpisodicNAC'} )) - 1;
+      assert( ~isempty(criticClass) );
+      
+    end
+    
+    function critic = initCritic( this, critic )
+      % Set the critic dimensions.
+      
+      critic.dim = this.sDim + this.aDim;
+      if isa( critic, 'EpisodicNAC' ); critic.stateDim = this.sDim; end
+      
+    end
+    
     function [pi, a] = decideAction( this, saFeatures )
       % Decide on an action based on this.theta and the features of
       % available actions that are along the rows of saFeatures.
@@ -382,8 +749,10 @@ classdef AgentNaturalActorCritic < Agent
       critic_sa1 = [ phi_s1' ; zeros(this.aDim, 1) ];
       
       
-      % update critic
+      % update critic, and the sweep critics on the same transition
       this.critic = step( this.critic, critic_sa0, critic_sa1, r0 );
+      this.sweepCritics = cellfun( @(c) step( c, critic_sa0, critic_sa1, r0 ), this.sweepCritics, ...
+                                   'UniformOutput', false );
       
     end
     
@@ -24,6 +24,9 @@ classdef Critic < handle
     % mask for selecting active features
     featureMask;
     
+    % Tikhonov regularization strength for the 'regularized' batch method
+    regularization = 1e-6;
+    
     
     % dimensionality. this must be set before using the object.
     dim = NaN;
@@ -51,6 +54,27 @@ classdef Critic < handle
   end
   
   
+  methods
+    
+    function opts = getSolverOptions( this )
+      % Get the solver settings in the form expected by the native solver
+      % (see the 'solve' command in mex/+TetrisNAC/MexTetrisNAC.cpp).
+      
+      opts = struct( 'method', this.batchMethod, 'I', this.Ifactor, 'regularization', this.regularization, ...
+                     'featureMask', this.featureMask );
+    end
+    
+    function this = setSolution( this, V )
+      % Assign an externally computed solution to V. V stays valid until
+      % the statistics are changed.
+      
+      this.V = V;
+      this.Vok = true;
+    end
+    
+  end
+  
+  
   methods (Abstract)
     
     % Reset the critic. This needs to be called before first use. this.dim
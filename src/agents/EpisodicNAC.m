@@ -0,0 +1,162 @@
+classdef EpisodicNAC < LSTDLambda
+  %EPISODICNAC Episodic natural actor-critic (eNAC) critic.
+  %
+  %   Instead of a temporal difference update on every step, each episode
+  %   contributes a single regression sample: the state features of the
+  %   first state of the episode (the baseline) and the discounted sum of
+  %   the compatible features of the episode are regressed on the
+  %   discounted return of the episode. step() only accumulates the sums,
+  %   and the least squares statistics A and b (as in LSTDLambda) are
+  %   updated once per episode, when the next episode starts or the
+  %   statistics are forgotten. The advantage part of V is the natural
+  %   gradient, as with the other critics. lambda is not used.
+  %
+  %   The mex implementation (criticClass 3, see
+  %   mex/+TetrisNAC/EpisodicNAC.hpp) returns the statistics of the episode
+  %   in A and b, so they are joined with addData() as for LSTDLambda.
+  %   stateDim is set by AgentNaturalActorCritic.
+  %
+  %   References
+  %
+  %     Peters & Schaal (2008). Natural actor-critic.
+  
+  
+  properties
+    
+    % number of state features at the beginning of the critic features,
+    % the rest being the compatible features
+    stateDim = 0;
+    
+    % the discounted return of the episode in progress, the discount of
+    % its next step and its step count (z holds its regression features)
+    R = 0;
+    discount = 1;
+    steps = 0;
+    
+  end
+  
+  
+  methods
+    
+    function this = EpisodicNAC( gamma, lambda, varargin )
+      % Constructor
+      %
+      %   this = EpisodicNAC( gamma, lambda, [property/value pairs] )
+      %
+      % The arguments are as for LSTDLambda. Remember to call reset()
+      % before first use!
+      
+      this = this@LSTDLambda( gamma, lambda, varargin{:} );
+      
+    end
+    
+    function this = reset( this )
+      
+      this = reset@LSTDLambda( this );
+      this = clearEpisode( this );
+      
+    end
+    
+    function this = forget( this )
+      % Forget statistics according to this.beta. Forgetting happens
+      % between episodes, so the last episode is complete.
+      
+      this = foldEpisode( this );
+      this = forget@LSTDLambda( this );
+      
+    end
+    
+    function this = newEpisode( this )
+      
+      % complete the previous episode
+      this = foldEpisode( this );
+      
+    end
+    
+    function cnd = getCond( this )
+      % Get condition of the A matrix, with the episode in progress.
+      
+      [A, b] = deal( this.A, this.b );
+      this = includeEpisode( this );
+      cnd = getCond@LSTDLambda( this );
+      [this.A, this.b] = deal( A, b );
+      
+    end
+    
+    function this = step( this, s0, s1, r ) %#ok<INUSL>
+      
+      k = this.stateDim;
+      
+      % the state features of the first state are the baseline features
+      if this.steps == 0; this.z = [ s0(1:k) ; zeros(this.dim - k, 1) ]; end
+      
+      % discounted sums of the compatible features and the rewards
+      this.z(k+1:end) = this.z(k+1:end) + this.discount * s0(k+1:end);
+      this.R = this.R + this.discount * r;
+      
+      this.discount = this.gamma * this.discount;
+      this.steps = this.steps + 1;
+      this.Vok = false;
+      
+    end
+    
+    function this = addData( this, data )
+      
+      this = foldEpisode( this );
+      this = addData@LSTDLambda( this, data );
+      
+    end
+    
+    function this = computeV( this, varargin )
+      % Compute the V-function from the statistics with the episode in
+      % progress, as in LSTDLambda. The episode is not completed by this.
+      
+      [A, b] = deal( this.A, this.b );
+      this = includeEpisode( this );
+      this = computeV@LSTDLambda( this, varargin{:} );
+      [this.A, this.b] = deal( A, b );
+      
+    end
+    
+  end
+  
+  
+  
+  
+  % private methods begin
+  
+  
+  
+  
+  methods (Access=private)
+    
+    function this = includeEpisode( this )
+      % add the episode in progress to A and b
+      
+      if this.steps > 0
+        this.A = this.A + this.z * this.z';
+        this.b = this.b + this.z * this.R;
+      end
+      
+    end
+    
+    function this = foldEpisode( this )
+      % add the episode in progress to A and b, and clear it
+      
+      this = includeEpisode( this );
+      this = clearEpisode( this );
+      
+    end
+    
+    function this = clearEpisode( this )
+      
+      this.z = zeros(this.dim, 1);
+      this.R = 0;
+      this.discount = 1;
+      this.steps = 0;
+      
+    end
+    
+  end
+  
+end
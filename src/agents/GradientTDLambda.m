@@ -0,0 +1,202 @@
+classdef GradientTDLambda < Critic
+  %GRADIENTTDLAMBDA GTD2(lambda) and TDC(lambda) critics.
+  %
+  %   Gradient temporal difference critics, which learn V by stochastic
+  %   gradient descent on the projected Bellman error, with auxiliary
+  %   weights h, instead of accumulating least squares statistics. Each
+  %   step costs O(dim) time and memory:
+  %
+  %     delta = r + gamma w'*s1 - w'*s0
+  %     z     = gamma lambda z + s0
+  %     GTD2:  w = w + alpha (z'*h) (s0 - gamma s1)
+  %     TDC:   w = w + alpha (delta z - gamma (1 - lambda) (z'*h) s1)
+  %     h     = h + alphaH (delta z - (h'*s0) s0)
+  %
+  %   computeV() just copies the parameters w into V, and forget() keeps
+  %   them as the starting point for the next policy. getCond() returns
+  %   NaN.
+  %
+  %   The mex implementation (criticClass 4 for GTD2 and 5 for TDC, see
+  %   mex/+TetrisNAC/GradientTDLambda.hpp) starts from the settings and
+  %   the parameters of getMexSettings() and returns the updated w (as V)
+  %   and h, which addData() takes over. As the result depends on the
+  %   order of the steps, the episodes cannot be run in parallel.
+  %
+  %   References
+  %
+  %     Sutton, Maei, Precup, Bhatnagar, Silver, Szepesvari & Wiewiora
+  %     (2009). Fast gradient-descent methods for temporal-difference
+  %     learning with linear function approximation.
+  %
+  %     Maei (2011). Gradient temporal-difference learning algorithms.
+  
+  
+  properties
+    
+    % 'GTD2' or 'TDC'
+    variant;
+    
+    % step sizes of w and h
+    alpha, alphaH;
+    
+    % parameters and auxiliary weights
+    w, h;
+    
+    % eligibility trace
+    z;
+    
+  end
+  
+  
+  methods
+    
+    function this = GradientTDLambda( gamma, lambda, varargin )
+      % Constructor
+      %
+      %   this = GradientTDLambda( gamma, lambda, [property/value pairs] )
+      %
+      % Remember to call reset() before first use!
+      %
+      % Arguments
+      %
+      %   (double) gamma, lambda
+      %     the discount factor and the eligibility trace strength
+      %
+      %   'variant', 'GTD2'|'TDC'
+      %     The update of w. Default: 'TDC'
+      %
+      %   'alpha', alpha
+      %     Step size of w. Default: 1e-3
+      %
+      %   'alphaH', alphaH
+      %     Step size of the auxiliary weights h. Default: 1e-3
+      %
+      %   (logical array) featureMask
+      %     The elements of V corresponding to the disabled features are
+      %     set to zero (see LSTDLambda). The features still take part in
+      %     the updates of w.
+      %
+      % The arguments 'I', 'beta', 'batchMethod' and 'onlineMethod' are
+      % accepted for compatibility with the other critics, but not used.
+      
+      % parse args
+      
+      args = inputParser;
+      args.addParamValue( 'variant', 'TDC', @(x) any(strcmp( x, {'GTD2', 'TDC'} )) );
+      args.addParamValue( 'alpha', 1e-3, @(x) (isnumeric(x) && isscalar(x)) );
+      args.addParamValue( 'alphaH', 1e-3, @(x) (isnumeric(x) && isscalar(x)) );
+      args.addParamValue( 'featureMask', [], @islogical );
+      
+      % not used but accepted for compatibility
+      args.addParamValue( 'I', 0, @(x) (isnumeric(x) && isscalar(x)) );
+      args.addParamValue( 'beta', 1, @(x) (isnumeric(x) && isscalar(x)) );
+      args.addParamValue( 'batchMethod', '\', @ischar );
+      args.addParamValue( 'onlineMethod', 'none', @ischar );
+      
+      args.parse( varargin{:} );
+      
+      
+      % store args
+      
+      this.gamma = gamma;
+      this.lambda = lambda;
+      this.variant = args.Results.variant;
+      this.alpha = args.Results.alpha;
+      this.alphaH = args.Results.alphaH;
+      this.featureMask = args.Results.featureMask;
+      this.Ifactor = args.Results.I;
+      this.beta = args.Results.beta;
+      
+      this.batchMethod = args.Results.batchMethod;
+      this.onlineMethod = args.Results.onlineMethod;
+      
+    end
+    
+    function this = reset( this )
+      
+      this.w = zeros(this.dim, 1);
+      this.h = zeros(this.dim, 1);
+      this.z = zeros(this.dim, 1);
+      this.V = zeros(this.dim, 1);
+      
+    end
+    
+    function this = forget( this )
+      % Keep w and h as the starting point for the next policy.
+      
+    end
+    
+    function this = newEpisode( this )
+      
+      % reset the eligibility trace
+      this.z = zeros(this.dim, 1);
+      
+    end
+    
+    function cnd = getCond( this ) %#ok<MANU>
+      % There is no main matrix.
+      
+      cnd = NaN;
+      
+    end
+    
+    function this = step( this, s0, s1, r )
+      
+      assert( ~isempty(this.z) );
+      
+      % TD error and trace
+      delta = r + this.gamma * (this.w' * s1) - this.w' * s0;
+      this.z = this.gamma * this.lambda * this.z + s0;
+      zh = this.z' * this.h;
+      
+      % update w and h
+      switch this.variant
+        case 'GTD2'
+          this.w = this.w + this.alpha * zh * (s0 - this.gamma * s1);
+        case 'TDC'
+          this.w = this.w + this.alpha * (delta * this.z - this.gamma * (1 - this.lambda) * zh * s1);
+      end
+      this.h = this.h + this.alphaH * (delta * this.z - (this.h' * s0) * s0);
+      
+      this.Vok = false;
+      
+    end
+    
+    function this = addData( this, data )
+      % Take over the parameters updated by the mex implementation.
+      
+      this.w = data.V;
+      this.h = data.h;
+      
+      this.z = [];
+      this.Vok = false;
+      
+    end
+    
+    function this = finalize( this )
+      % No-op
+      
+    end
+    
+    function this = computeV( this, batchMethod ) %#ok<INUSD>
+      % Copy w into V, with the masked features zeroed.
+      
+      if this.Vok; return; end
+      this.Vok = true;
+      
+      this.V = this.w;
+      if ~isempty(this.featureMask); this.V(~this.featureMask) = 0; end
+      
+    end
+    
+    function settings = getMexSettings( this )
+      % Get the criticSettings of the mex implementation: the step sizes
+      % and the current parameters.
+      
+      settings = struct( 'alpha', this.alpha, 'alphaH', this.alphaH, 'w', this.w, 'h', this.h );
+      
+    end
+    
+  end
+  
+end
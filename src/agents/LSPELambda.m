@@ -214,6 +214,13 @@ classdef LSPELambda < Critic
       
     end
     
+    function opts = getSolverOptions( this )
+      opts = getSolverOptions@Critic( this );
+      opts.w = this.w;
+      opts.iterations = this.iterations;
+      opts.stepsize = this.stepsize;
+    end
+    
     function this = computeV( this, batchMethod )
       % Computes the V-function and stores it into V. Note that this does
       % _not_ perform a critic update: calling this function successively
@@ -199,6 +199,15 @@ classdef LSTDLambda < Critic
       %       results with huge norms).
       %     'pinv': x = pinv(A) * b
       %       Use pinv(). Not for sparse data.
+      %     'qr': [Q,R] = qr(A); x = R \ (Q' * b)
+      %       Use the QR decomposition.
+      %     'chol': x = R \ (R' \ b), where R = chol(A)
+      %       Use the Cholesky decomposition. As A is generally not
+      %       symmetric, the normal equations A'A x = A'b are solved instead
+      %       if it is not.
+      %     'regularized': x = (A'A + rho I) \ (A'b)
+      %       Tikhonov regularized least squares with rho =
+      %       this.regularization, solved with the Cholesky decomposition.
       %     'lsqr': x = lsqr( A, b )
       %       Use the lsqr() function. Supports sparse data (but always
       %       returns full vectors). Possibility for providing an initial
@@ -240,6 +249,19 @@ classdef LSTDLambda < Critic
           [Q,R] = qr( this.A(m,m) );
           V_ = R \ ( Q' * this.b(m) );
           
+        case 'chol'
+          % Cholesky, via the normal equations if A is not symmetric
+          M = this.A(m,m); y = this.b(m);
+          if ~isequal( M, M' ); y = M' * y; M = M' * M; end
+          R = chol( M );
+          V_ = R \ ( R' \ y );
+          
+        case 'regularized'
+          % Tikhonov regularized least squares
+          M = this.A(m,m);
+          R = chol( M' * M + this.regularization * eye(size(M)) );
+          V_ = R \ ( R' \ (M' * this.b(m)) );
+          
         case 'lsqr'
           % MATLAB lsqr
           V_ = lsqr( this.A(m,m), this.b(m) );
@@ -186,6 +186,33 @@ classdef GraphGeneric < Environment & Configurable
         'chain', this.chain ./ repmat( sum(this.chain,2), 1, size(this.chain,2) ) );
     end
     
+    function [this, data] = mexFork( this, useMex )
+      [this, data] = mexFork@Environment( this, useMex );
+      
+      if useMex
+        % see mex/+TetrisNAC/GraphEnvironment.hpp
+        data.type = 'graph';
+        data.P = full( double( this.P ) );
+        data.Q = full( double( this.Q ) );
+        data.x0 = full( double( this.x0 ) );
+        data.term = full( double( this.term ) );
+        data.O = full( double( this.O ) );
+        data.saCounts = double( this.saCounts );
+      end
+      
+    end
+    
+    function this = mexJoin( this, data )
+      this = mexJoin@Environment( this, data );
+      
+      if ~isempty(data) && isfield( data, 'svd' )
+        % returning from a mex call: accumulate the statistics
+        this.svd = this.svd + data.svd;
+        this.chain = this.chain + data.chain;
+      end
+      
+    end
+    
   end
   
   
@@ -161,6 +161,28 @@ classdef GridEpisodicBasic < Environment
       stats.svd = this.svd / sum(this.svd(:));
     end
     
+    function [this, data] = mexFork( this, useMex )
+      [this, data] = mexFork@Environment( this, useMex );
+      
+      if useMex
+        % see mex/+TetrisNAC/GridEnvironment.hpp
+        data.type = 'grid';
+        data.gridSize = double( this.gridSize );
+        data.rewards = double( this.rewards );
+      end
+      
+    end
+    
+    function this = mexJoin( this, data )
+      this = mexJoin@Environment( this, data );
+      
+      if ~isempty(data) && isfield( data, 'svd' )
+        % returning from a mex call: accumulate the statistics
+        this.svd = this.svd + data.svd;
+      end
+      
+    end
+    
   end
   
   
@@ -0,0 +1,176 @@
+classdef TetrisNative < TetrisStandardFeatures
+  %TETRISNATIVE Tetris environment simulated by the native engine.
+  %
+  %   The Tetris environment with the standard features, simulated step by
+  %   step by the native engine of the mex implementation (see
+  %   mex/+TetrisNAC/MexTetris.cpp) instead of Matlab code. This allows
+  %   agents that are implemented only in Matlab, such as AgentRandom or
+  %   prototypes of new algorithms, to use the fast simulator. The board
+  %   size is fixed to 20 x 10.
+  %
+  %   The dynamics and the features are those of the mex implementation,
+  %   so they differ slightly from those of TetrisStandardFeatures (see
+  %   there), and the mex settings of TetrisStandardFeatures apply. With
+  %   the 'useMex' option, AgentNaturalActorCritic runs the episodes
+  %   entirely natively, as with TetrisStandardFeatures.
+  %
+  %   Each native call discards the random numbers left in its buffer (see
+  %   MexCompatibleRandStream), so the pieces of an episode depend on the
+  %   way the episode is stepped. Setting mexRngSeed (see Environment)
+  %   draws the pieces of each episode from a counter-based stream
+  %   instead, which makes them independent of the stepping and is also
+  %   considerably faster with single steps. Use stepBatch() to take
+  %   several steps with a known action sequence in a single call.
+  
+  properties (Transient, Access=private)
+    
+    % handle of the native environment, or empty if not created yet. The
+    % handle is not saved or copied (see Copyable): a copy creates its own
+    % native environment at its first episode.
+    mexHandle = [];
+    
+  end
+  
+  properties (Access=private)
+    
+    % outputs of the last native call: the reward of the last transition,
+    % whether the episode has ended, and the observation, the action
+    % features and the vectorial state of the current state
+    nativeReward = 0;
+    nativeEnded = true;
+    nativeObservation, nativeActions, nativeState;
+    
+  end
+  
+  methods
+    
+    function this = TetrisNative( varargin )
+      % Constructor.
+      %
+      %   this = TetrisNative()
+      
+      this = this@TetrisStandardFeatures( 20, 10, varargin{:} );
+      
+    end
+    
+    function delete( this )
+      % Destroy the native environment.
+      
+      if ~isempty(this.mexHandle); TetrisNAC.MexTetris( 'destroy', this.mexHandle ); end
+      
+    end
+    
+    function [this, rewards, observation, actions] = stepBatch( this, actionSequence )
+      % Take a step with each of the given actions in turn.
+      %
+      %   [this, rewards, observation, actions] = stepBatch( this, actionSequence )
+      %
+      %   (int array) actionSequence
+      %     Action indices. Each action is a row index to the actions
+      %     matrix of the state reached by the previous action, as in
+      %     step().
+      %
+      %   (double column array) rewards
+      %     The immediate rewards of the steps taken. If the episode ends
+      %     before the actions run out, then the remaining actions are
+      %     ignored and rewards is shorter than actionSequence.
+      %
+      %   observation, actions
+      %     As returned by step() for the last state.
+      
+      assert( this.episodeRunning, 'No episode is running.' );
+      
+      [rewards, this.nativeObservation, this.nativeActions, this.nativeState] = ...
+        TetrisNAC.MexTetris( 'stepBatch', this.mexHandle, mexData( this ), actionSequence );
+      if ~isempty(rewards); this.nativeReward = rewards(end); end
+      this.nativeEnded = isempty( this.nativeObservation );
+      
+      % as in Environment.step()
+      this.episodeRunning = ~this.nativeEnded;
+      this.loggerProxy.lastReturn = this.loggerProxy.lastReturn + sum( rewards );
+      this.vectorialState = this.nativeState;
+      this.observation = this.nativeObservation;
+      observation = this.nativeObservation;
+      actions = this.nativeActions;
+      
+    end
+    
+  end
+  
+  
+  
+  
+  % protected methods begin (implementations of abstract methods)
+  
+  
+  
+  
+  methods (Access=protected)
+    
+    function this = resetState( this )
+      
+      data = mexData( this );
+      
+      % create the native environment on first use, or if the mex file has
+      % been cleared since
+      try
+        if isempty(this.mexHandle); error( 'MexTetris:invalidHandle', 'No handle' ); end
+        [this.nativeObservation, this.nativeActions, this.nativeState] = ...
+          TetrisNAC.MexTetris( 'reset', this.mexHandle, data );
+      catch err
+        if ~strcmp( err.identifier, 'MexTetris:invalidHandle' ); rethrow(err); end
+        this.mexHandle = TetrisNAC.MexTetris( 'create', data );
+        [this.nativeObservation, this.nativeActions, this.nativeState] = ...
+          TetrisNAC.MexTetris( 'reset', this.mexHandle, data );
+      end
+      this.nativeReward = 0;
+      this.nativeEnded = false;
+      
+      % each episode has its own counter-based stream, as in RunEpisodeMex
+      this.mexRngEpisode = this.mexRngEpisode + 1;
+      
+    end
+    
+    function this = advanceState( this, action )
+      
+      [this.nativeReward, this.nativeObservation, this.nativeActions, this.nativeState] = ...
+        TetrisNAC.MexTetris( 'step', this.mexHandle, mexData( this ), action );
+      this.nativeEnded = isempty( this.nativeObservation );
+      
+    end
+    
+    function ended = checkEndCondition( this ); ended = this.nativeEnded; end
+    
+    function stateVec = generateVectorialState( this ); stateVec = this.nativeState; end
+    
+    function observation = generateObservation( this ); observation = this.nativeObservation; end
+    
+    function actions = getAvailableActions( this ); actions = this.nativeActions; end
+    
+    function reward = generateReward( this ); reward = this.nativeReward; end
+    
+  end
+  
+  
+  
+  
+  % private methods begin
+  
+  
+  
+  
+  methods (Access=private)
+    
+    function data = mexData( this )
+      % the settings of the native engine, as passed to the mex
+      % implementation (the episode running flag is left untouched)
+      
+      episodeRunning = this.episodeRunning;
+      [~, data] = mexFork( this, true );
+      this.episodeRunning = episodeRunning;
+      
+    end
+    
+  end
+  
+end
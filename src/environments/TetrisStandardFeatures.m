@@ -29,6 +29,31 @@ classdef TetrisStandardFeatures < Tetris
   % NOTE: This Matlab implementation (vs. mex) is not well tested in its
   % current state.
   
+  properties
+    
+    % Number of entries in the action cache of the mex sessions, or 0 to
+    % disable the cache. Each entry takes about 0.6 kB. The plain mex calls
+    % (without a session) do not use the cache. type: int
+    actionCacheSize = 0;
+    
+    % Whether the mex implementation should log the state observations
+    % into observationLog, and optionally the name of a binary file into
+    % which the observations are streamed instead (as rows of doubles;
+    % read with fread( fid, [observationDim, Inf], 'double' )').
+    mexLogObservations = false;
+    mexObservationLogFile = '';
+    
+    % Feature settings of the mex implementation, or empty for the
+    % compiled-in defaults: the hole definition ('coveredBy',
+    % 'underTopline' or 'floodFill'; the latter is not supported by
+    % EvaluateBatchMex) and the values of the bias feature in terminal
+    % states and for terminal actions.
+    mexHoleDefinition = '';
+    mexTerminalBiasValueS = [];
+    mexTerminalBiasValueA = [];
+    
+  end
+  
   properties (Access=private)
     
     IMMREWFEATURE = true;
@@ -40,6 +65,13 @@ classdef TetrisStandardFeatures < Tetris
     % dimension of the standard feature set for the current board size
     stdFeatureDim;
     
+    % action cache statistics accumulated from mex calls
+    actionCacheHits = 0; actionCacheMisses = 0;
+    
+    % profiling counters accumulated from mex calls (available only if the
+    % mex files were compiled with make('profile'))
+    mexProfile = struct();
+    
   end
   
   methods
@@ -68,6 +100,64 @@ classdef TetrisStandardFeatures < Tetris
     % return the environment properties struct
     function props = getProps( this ); props = this.props; end
     
+    function resetStats( this )
+      % reset statistics
+      this.actionCacheHits = 0; this.actionCacheMisses = 0;
+      this.mexProfile = struct();
+    end
+    
+    function stats = getStats( this )
+      % get statistics (action cache statistics are available only when
+      % using the mex implementation with the cache enabled)
+      stats = struct();
+      if this.actionCacheSize > 0
+        stats.actionCacheHits = this.actionCacheHits;
+        stats.actionCacheMisses = this.actionCacheMisses;
+        stats.actionCacheHitRate = this.actionCacheHits / max( 1, this.actionCacheHits + this.actionCacheMisses );
+      end
+      if ~isempty(fieldnames(this.mexProfile)); stats.mexProfile = this.mexProfile; end
+    end
+    
+    function [this, data] = mexFork( this, useMex )
+      [this, data] = mexFork@Tetris( this, useMex );
+      
+      if useMex
+        data.actionCacheSize = this.actionCacheSize;
+        data.logObservations = this.mexLogObservations;
+        data.observationLogFile = this.mexObservationLogFile;
+        if ~isempty(this.mexHoleDefinition)
+          holeDefinitions = { 'coveredBy', 'underTopline', 'floodFill' };
+          assert( any(strcmp( this.mexHoleDefinition, holeDefinitions )), 'Unknown hole definition' );
+          data.holeDefinition = find(strcmp( this.mexHoleDefinition, holeDefinitions )) - 1;
+        end
+        data.terminalBiasValueS = this.mexTerminalBiasValueS;
+        data.terminalBiasValueA = this.mexTerminalBiasValueA;
+      end
+      
+    end
+    
+    function this = mexJoin( this, data )
+      this = mexJoin@Tetris( this, data );
+      
+      if ~isempty(data) && isfield( data, 'actionCache' )
+        % returning from a mex call with the action cache enabled
+        this.actionCacheHits = this.actionCacheHits + data.actionCache.hits;
+        this.actionCacheMisses = this.actionCacheMisses + data.actionCache.misses;
+      end
+      
+      if ~isempty(data) && isfield( data, 'profile' )
+        % returning from a mex call compiled with profiling: accumulate the counters
+        if isempty(fieldnames(this.mexProfile)); this.mexProfile = data.profile; return; end
+        for phase = fieldnames(data.profile)'
+          for counter = fieldnames(data.profile.(phase{1}))'
+            this.mexProfile.(phase{1}).(counter{1}) = ...
+              this.mexProfile.(phase{1}).(counter{1}) + data.profile.(phase{1}).(counter{1});
+          end
+        end
+      end
+      
+    end
+    
   end
   
   
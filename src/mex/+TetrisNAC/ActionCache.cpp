@@ -0,0 +1,185 @@
+/* ActionCache.cpp */
+
+
+#include "ActionCache.hpp"
+#include "Tetris.hpp"
+#include "../Profiler.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <cstring>
+using std::memcpy;
+using std::memcmp;
+using std::memset;
+
+
+// seed for the Zobrist tables
+#define ZOBRISTSEED 0x9E3779B97F4A7C15ULL
+
+#define ABS(x) ((x)<0?-(x):(x))
+
+
+
+
+/* splitmix64 step, used only for generating the Zobrist tables */
+static unsigned long long splitmix64( unsigned long long & state )
+{
+  unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+
+
+
+ActionCache::ActionCache( int capacity ) :
+  hits( 0 ), misses( 0 ), evictions( 0 ),
+  sets( capacity / ACTIONCACHE_WAYS > 0 ? capacity / ACTIONCACHE_WAYS : 1 ),
+  entries( 0 ),
+  useCounter( 0 )
+{
+  // generate the Zobrist tables
+  unsigned long long state = ZOBRISTSEED;
+  for( int row = 0 ; row < ROWS ; row++ )
+    for( int col = 0 ; col < COLUMNS ; col++ )
+      this->zobristBoard[row][col] = splitmix64( state );
+  for( int piece = 0 ; piece < 7 ; piece++ )
+    this->zobristPiece[piece] = splitmix64( state );
+  
+  // allocate and clear the entries
+  this->entries = new Entry[this->sets * ACTIONCACHE_WAYS];
+  PROFILE_ALLOCATION( this->sets * ACTIONCACHE_WAYS * sizeof(Entry) );
+  for( int i = 0 ; i < this->sets * ACTIONCACHE_WAYS ; i++ )
+    this->entries[i].valid = false;
+}
+
+ActionCache::~ActionCache()
+{
+  delete [] this->entries; this->entries = 0;
+}
+
+
+void ActionCache::clear()
+{
+  for( int i = 0 ; i < this->sets * ACTIONCACHE_WAYS ; i++ )
+    this->entries[i].valid = false;
+}
+
+
+void ActionCache::makeKey( const bool (& board)[ROWS][COLUMNS], int boardHeightmapMin, int piece, Key & key ) const
+{
+  unsigned long long hash = this->zobristPiece[piece];
+  
+  // rows above the topmost filled cell are empty
+  for( int row = 0 ; row < boardHeightmapMin ; row++ )
+    key.packedBoard[row] = 0;
+  
+  // hash and pack the active region
+  for( int row = boardHeightmapMin ; row < ROWS ; row++ ) {
+    unsigned short packedRow = 0;
+    for( int col = 0 ; col < COLUMNS ; col++ )
+      if( board[row][col] ) {
+        hash ^= this->zobristBoard[row][col];
+        packedRow |= (unsigned short)(1 << col);
+      }
+    key.packedBoard[row] = packedRow;
+  }
+  
+  key.hash = hash;
+  key.piece = piece;
+}
+
+
+bool ActionCache::lookup( const Key & key, double terminalBiasValueA, Tetris::StepData & stepData )
+{
+  Entry * set = &this->entries[(key.hash % this->sets) * ACTIONCACHE_WAYS];
+  
+  for( int way = 0 ; way < ACTIONCACHE_WAYS ; way++ ) {
+    Entry & entry( set[way] );
+    if( entry.valid && entry.key.hash == key.hash && entry.key.piece == key.piece &&
+        !memcmp( entry.key.packedBoard, key.packedBoard, sizeof(key.packedBoard) ) ) {
+      
+      // hit: rebuild the rows that are in use, as Tetris::computeObservation() and computeActions() write them
+      stepData.actionCount = entry.actionCount;
+      for( int action = 0 ; action < entry.actionCount ; action++ ) {
+        const PackedAction & packed = entry.actions[action];
+        double * row = stepData.actions[action];
+        if( packed.terminal ) {
+          memset( row, 0, STATEDIM * sizeof(double) );
+          row[2 * COLUMNS - 1 + 2] = terminalBiasValueA;
+        } else {
+          int maxHeight = 0;
+          for( int col = 0 ; col < COLUMNS ; col++ ) {
+            row[col] = packed.heights[col];
+            if( col >= 1 ) row[COLUMNS + col - 1] = ABS( row[col] - row[col-1] );
+            if( packed.heights[col] > maxHeight ) maxHeight = packed.heights[col];
+          }
+          row[2 * COLUMNS - 1 + 0] = maxHeight;
+          row[2 * COLUMNS - 1 + 1] = packed.holes;
+          row[2 * COLUMNS - 1 + 2] = 1.0;
+        }
+        row[2 * COLUMNS - 1 + 3] = packed.clearedRows;
+        stepData.isActionTerminal[action] = packed.terminal;
+      }
+      
+      entry.lastUse = ++this->useCounter;
+      this->hits++;
+      return true;
+    }
+  }
+  
+  this->misses++;
+  return false;
+}
+
+
+void ActionCache::store( const Key & key, const Tetris::StepData & stepData )
+{
+  Entry * set = &this->entries[(key.hash % this->sets) * ACTIONCACHE_WAYS];
+  
+  // pick an empty way, or the least recently used one
+  Entry * victim = &set[0];
+  for( int way = 0 ; way < ACTIONCACHE_WAYS ; way++ ) {
+    if( !set[way].valid ) { victim = &set[way]; break; }
+    if( set[way].lastUse < victim->lastUse ) victim = &set[way];
+  }
+  if( victim->valid ) this->evictions++;
+  
+  // fill in
+  victim->valid = true;
+  victim->lastUse = ++this->useCounter;
+  memcpy( &victim->key, &key, sizeof(key) );
+  victim->actionCount = stepData.actionCount;
+  for( int action = 0 ; action < stepData.actionCount ; action++ ) {
+    const double * row = stepData.actions[action];
+    PackedAction & packed = victim->actions[action];
+    for( int col = 0 ; col < COLUMNS ; col++ )
+      packed.heights[col] = (unsigned char)row[col];
+    packed.holes = (unsigned char)row[2 * COLUMNS - 1 + 1];   // at most ROWS * COLUMNS = 200
+    packed.clearedRows = (unsigned char)row[2 * COLUMNS - 1 + 3];
+    packed.terminal = stepData.isActionTerminal[action];
+  }
+}
+
+
+mxArray * ActionCache::createReturnStruct()
+{
+  mxArray * s = mxCreateStructMatrix( 1, 1, 0, 0 );
+  
+  long long lookups = this->hits + this->misses;
+  
+  mxAddField( s, "capacity" );
+  mxSetField( s, 0, "capacity", mxCreateDoubleScalar( capacity() ) );
+  mxAddField( s, "hits" );
+  mxSetField( s, 0, "hits", mxCreateDoubleScalar( (double)this->hits ) );
+  mxAddField( s, "misses" );
+  mxSetField( s, 0, "misses", mxCreateDoubleScalar( (double)this->misses ) );
+  mxAddField( s, "evictions" );
+  mxSetField( s, 0, "evictions", mxCreateDoubleScalar( (double)this->evictions ) );
+  mxAddField( s, "hitRate" );
+  mxSetField( s, 0, "hitRate", mxCreateDoubleScalar( lookups > 0 ? (double)this->hits / (double)lookups : 0.0 ) );
+  
+  return s;
+}
@@ -0,0 +1,106 @@
+/* ActionCache.hpp
+ *
+ * A bounded transposition cache for the action data produced by Tetris::computeActions(). The same (board, piece)
+ * pairs recur often, especially with near-empty boards right after line clears, and a lookup is much cheaper than
+ * dropping and featurizing every available action again.
+ *
+ * Entries are keyed by a Zobrist hash of the board and the falling piece. The board is also stored in packed form
+ * (one bit per cell) and compared on lookup, so a hash collision can never produce a wrong result. The cache is
+ * set-associative with LRU replacement within each set.
+ *
+ * Instead of the feature rows, an entry stores the column heights, the hole count, the cleared rows and the terminal
+ * flag of each action in bytes, from which lookup() rebuilds the rows exactly (the bias of terminal actions is taken
+ * from the caller, so the cache need not be cleared when it changes). An entry thus takes sizeof(Entry), about 0.6 kB,
+ * instead of the 7.4 kB of the rows, and 4096 entries take about 2.5 MB. The cache pays off only when it outlives an
+ * episode, so it is used only by sessions (see MexTetrisNAC.cpp and TetrisNACApi.h).
+ */
+#ifndef ACTIONCACHE_HPP
+#define ACTIONCACHE_HPP
+
+
+#include "Tetris.hpp"
+
+
+// number of entries per set
+#define ACTIONCACHE_WAYS 4
+
+
+
+
+class ActionCache {
+  
+public:
+  
+  /* Lookup key for a (board, piece) pair. Create with makeKey() and pass the same key to both lookup() and
+   * store(). */
+  struct Key {
+    unsigned long long hash;
+    unsigned short packedBoard[ROWS];
+    int piece;
+  };
+  
+  // statistics
+  long long hits, misses, evictions;
+  
+  
+private:
+  
+  // the outcome of an action, from which its feature row is rebuilt
+  struct PackedAction {
+    unsigned char heights[COLUMNS];
+    unsigned char holes;
+    unsigned char clearedRows;
+    bool terminal;
+  };
+  
+  struct Entry {
+    bool valid;
+    unsigned long long lastUse;
+    Key key;
+    int actionCount;
+    PackedAction actions[MAXACTIONS];
+  };
+  
+  // Zobrist tables. These are generated from a fixed seed and do not consume the shared random stream.
+  unsigned long long zobristBoard[ROWS][COLUMNS];
+  unsigned long long zobristPiece[7];
+  
+  // storage: sets x ways
+  int sets;
+  Entry * entries;
+  
+  // use counter for LRU
+  unsigned long long useCounter;
+  
+  
+public:
+  
+  // capacity is rounded down to a multiple of ACTIONCACHE_WAYS (but at least ACTIONCACHE_WAYS entries are used)
+  ActionCache( int capacity );
+  ~ActionCache();
+  
+  // compute the key for a board and a falling piece. rows above boardHeightmapMin must be empty.
+  void makeKey( const bool (& board)[ROWS][COLUMNS], int boardHeightmapMin, int piece, Key & key ) const;
+  
+  /* rebuild the cached action data into stepData and return true, or return false if not found. terminalBiasValueA is
+   * the bias feature of the terminal actions. */
+  bool lookup( const Key & key, double terminalBiasValueA, Tetris::StepData & stepData );
+  
+  // store the action data in stepData, possibly evicting the least recently used entry of the set
+  void store( const Key & key, const Tetris::StepData & stepData );
+  
+  // invalidate all entries (the statistics are kept)
+  void clear();
+  
+  // number of entries
+  int capacity() const { return this->sets * ACTIONCACHE_WAYS; }
+  
+  // creates the return struct
+  mxArray * createReturnStruct();
+  
+};
+
+
+
+
+#endif
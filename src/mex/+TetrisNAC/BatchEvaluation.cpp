@@ -0,0 +1,66 @@
+/* BatchEvaluation.cpp */
+
+
+#include "BatchEvaluation.hpp"
+#include "../PhiloxRandStream.hpp"
+
+
+
+
+void evaluateBatch( TetrisBatch & batch, NaturalActorCritic & agent, int episodes,
+                    bool keyed, unsigned long long seed, unsigned long long firstEpisode,
+                    double maxSteps, double totalRewardMin, double totalRewardMax, double * returns )
+{
+  const int lanes = batch.lanes;
+  PhiloxRandStream actionStreams[BATCHMAXLANES];
+  
+  // per-lane episode bookkeeping
+  int laneEpisode[BATCHMAXLANES], actions[BATCHMAXLANES];
+  double laneSteps[BATCHMAXLANES];
+  bool active[BATCHMAXLANES];
+  int startedEpisodes = 0, activeLanes = 0;
+  for( int lane = 0 ; lane < lanes ; lane++ ) {
+    active[lane] = startedEpisodes < episodes;
+    if( !active[lane] ) continue;
+    if( keyed ) {
+      batch.keyStream( lane, seed, firstEpisode + startedEpisodes );
+      actionStreams[lane].setKey( seed, firstEpisode + startedEpisodes, PhiloxRandStream::RS_ACTIONS );
+    }
+    batch.newEpisode( lane );
+    laneEpisode[lane] = startedEpisodes++; laneSteps[lane] = 0; activeLanes++;
+  }
+  
+  // main loop: act in all lanes, step all lanes, then retire finished episodes and refill their lanes
+  while( activeLanes > 0 ) {
+    
+    for( int lane = 0 ; lane < lanes ; lane++ )
+      if( active[lane] )
+        actions[lane] = keyed ? agent.step( batch.stepData[lane], actionStreams[lane] ) :
+                                agent.step( batch.stepData[lane] );
+    
+    batch.step( actions, active );
+    
+    for( int lane = 0 ; lane < lanes ; lane++ ) {
+      if( !active[lane] ) continue;
+      laneSteps[lane]++;
+      double totalReward = batch.totalClearedRows[lane];
+      if( !batch.terminalState[lane] && totalReward >= totalRewardMin && totalReward <= totalRewardMax &&
+          laneSteps[lane] < maxSteps ) continue;
+      
+      // finish as a single episode does (this consumes the same random numbers), then refill or retire the lane
+      if( keyed ) agent.step( batch.stepData[lane], actionStreams[lane] );
+      else agent.step( batch.stepData[lane] );
+      returns[laneEpisode[lane]] = totalReward;
+      if( startedEpisodes < episodes ) {
+        if( keyed ) {
+          batch.keyStream( lane, seed, firstEpisode + startedEpisodes );
+          actionStreams[lane].setKey( seed, firstEpisode + startedEpisodes, PhiloxRandStream::RS_ACTIONS );
+        }
+        batch.newEpisode( lane );
+        laneEpisode[lane] = startedEpisodes++; laneSteps[lane] = 0;
+      } else {
+        active[lane] = false; activeLanes--;
+      }
+    }
+  }
+}
@@ -0,0 +1,28 @@
+/* BatchEvaluation.hpp
+ *
+ * The lane scheduling of batch policy evaluation, shared by the 'evaluate' command of MexTetrisNAC and the C interface
+ * (see TetrisNACApi.h).
+ */
+#ifndef BATCHEVALUATION_HPP
+#define BATCHEVALUATION_HPP
+
+
+#include "TetrisBatch.hpp"
+#include "NaturalActorCritic.hpp"
+
+
+
+
+/* Run episodes episodes in the lanes of batch, starting a new episode in a lane whenever one ends, and store the
+ * returns in the order in which the episodes were started. An episode ends when it reaches a terminal state, when its
+ * total reward leaves [totalRewardMin, totalRewardMax] or after maxSteps steps. The agent only acts, so it serves all
+ * lanes. If keyed, then episode k draws its pieces and actions from the counter-based streams of (seed,
+ * firstEpisode + k). */
+void evaluateBatch( TetrisBatch & batch, NaturalActorCritic & agent, int episodes,
+                    bool keyed, unsigned long long seed, unsigned long long firstEpisode,
+                    double maxSteps, double totalRewardMin, double totalRewardMax, double * returns );
+                    
+                    
+                    
+                    
+#endif
@@ -1,4 +1,9 @@
-/* Configuration.hpp */
+/* Configuration.hpp
+ *
+ * Default settings. The settings below can be overridden per call in environmentData and agentData (see MexTetrisNAC);
+ * the settings that select code paths are dispatched onto template instantiations, so changing them at runtime does
+ * not slow down the inner loops.
+ */
 #ifndef CONFIGURATION_HPP
 #define CONFIGURATION_HPP
 
@@ -7,22 +12,32 @@
 
 /* Tetris.cpp */
 
-// value of the state part bias feature in a terminal state (type: double)
+// value of the state part bias feature in a terminal state (type: double, override: terminalBiasValueS)
 #define TERMINAL_BIAS_VALUE_S 0.0
 
-// value of the advantage part bias feature in a terminal state (type: double)
+// value of the advantage part bias feature in a terminal state (type: double, override: terminalBiasValueA)
 #define TERMINAL_BIAS_VALUE_A 1.0
 
+// hole definitions: empty cells directly below a filled cell, empty cells below the topmost filled cell of a column,
+// or empty cells not reachable from above
+#define HD_COVEREDBY 0
+#define HD_UNDERTOPLINE 1
+#define HD_FLOODFILL 2
+
+// the hole definition (TetrisBatch does not support HD_FLOODFILL, override: holeDefinition)
+#define HOLEDEFINITION HD_UNDERTOPLINE
+
 
 /* NaturalActorCritic.hpp */
 
-// do not consider actions that are flagged as terminal? (type: bool)
+// do not consider actions that are flagged as terminal? (type: bool, override: rejectTerminalActions)
 #define REJECT_TERMINAL_ACTIONS true
 
 // available modes for using the variance reduction trick introduced in Jan Peters' thesis and in his NAC paper
 enum PetersTrickMode { PTM_OFF, PTM_ON, PTM_CORRECTED };
 
-// the mode for the variance reduction trick by Peters. PTM_CORRECTED is implemented only in LSTDLambda!
+// the mode for the variance reduction trick by Peters. PTM_CORRECTED is implemented only in LSTDLambda! (override:
+// petersTrickMode, fixed when the agent is created)
 const PetersTrickMode PETERS_TRICK_MODE = PTM_ON;
 
 
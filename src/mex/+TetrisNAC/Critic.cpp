@@ -0,0 +1,64 @@
+/* Critic.cpp */
+
+
+#include "Critic.hpp"
+#include "LSTDLambda.hpp"
+#include "LSPELambda.hpp"
+#include "FullTDLambda.hpp"
+#include "EpisodicNAC.hpp"
+#include "GradientTDLambda.hpp"
+#include "../Profiler.hpp"
+
+#include "mex.h"
+
+
+
+
+Critic * Critic::create( int criticClass, int VDim, double gamma, double lambda )
+{
+  if( VDim < 1 || VDim > SOLVER_MAXDIM )
+    mexErrMsgIdAndTxt( "Critic:invalidDimension", "Critic: the feature dimension must be in [1, %d]!", SOLVER_MAXDIM );
+  
+  Critic * critic = 0;
+  switch( (CriticClass)criticClass ) {
+    
+    case CC_LSTD:
+      // use the fixed-size specialization if there is one for this dimension
+      if( VDim == VDIM ) {
+        critic = new LSTDLambda<VDIM>( VDim, gamma, lambda );
+        PROFILE_ALLOCATION( sizeof(LSTDLambda<VDIM>) + (VDim + 4) * VDim * sizeof(double) );
+      } else {
+        critic = new LSTDLambda<0>( VDim, gamma, lambda );
+        PROFILE_ALLOCATION( sizeof(LSTDLambda<0>) + (VDim + 4) * VDim * sizeof(double) );
+      }
+      break;
+    
+    case CC_LSPE:
+      if( VDim != VDIM )
+        mexErrMsgIdAndTxt( "Critic:invalidDimension", "Critic: LSPELambda supports only the dimension %d!", VDIM );
+      critic = new LSPELambda( VDim, gamma, lambda );
+      PROFILE_ALLOCATION( sizeof(LSPELambda) );
+      break;
+    
+    case CC_FULLTD:
+      critic = new FullTDLambda( VDim, gamma, lambda );
+      PROFILE_ALLOCATION( sizeof(FullTDLambda) );
+      break;
+    
+    case CC_ENAC:
+      critic = new EpisodicNAC( VDim, gamma, lambda );
+      PROFILE_ALLOCATION( sizeof(EpisodicNAC) + (VDim + 2) * VDim * sizeof(double) );
+      break;
+    
+    case CC_GTD2:
+    case CC_TDC:
+      critic = new GradientTDLambda( VDim, gamma, lambda, criticClass == CC_TDC );
+      PROFILE_ALLOCATION( sizeof(GradientTDLambda) + 3 * VDim * sizeof(double) );
+      break;
+    
+    default:
+      mexErrMsgIdAndTxt( "Critic:invalidClass", "Critic: invalid critic class id!" );
+  }
+  
+  return critic;
+}
@@ -1,13 +1,97 @@
-/* Critic.hpp */
+/* Critic.hpp
+ *
+ * The critics accept any feature dimension VDim up to SOLVER_MAXDIM. VDIM is the dimension of the Tetris features used
+ * by NaturalActorCritic, for which LSTDLambda has a specialization with a compile-time dimension (see LSTDLambda.hpp).
+ * Critics are created with create(), which picks the specialization for the dimension.
+ */
 #ifndef CRITIC_HPP
 #define CRITIC_HPP
 
 
+#include "Solver.hpp"
+#include "Configuration.hpp"
+#include "../StateBuffer.hpp"
+
+#include "mex.h"
 #include "matrix.h"
 
+#include <cstddef>
+
 
 #define VDIM (22+23)
 
+// compile-time check: the solver must be able to handle the full critic
+typedef char SolverMaxDimCheck[(VDIM <= SOLVER_MAXDIM) ? 1 : -1];
+
+// alignment of the critic statistics and input registers in bytes
+#define CRITIC_ALIGNMENT 64
+
+// maximum number of statistics buffers of a critic (see Critic::getBuffers())
+#define CRITIC_MAXBUFFERS 8
+
+
+
+
+/* A zero-initialized heap array of doubles aligned to CRITIC_ALIGNMENT bytes. */
+class AlignedBuffer {
+  
+  double * raw;
+  double * data;
+  
+  // not copyable
+  AlignedBuffer( const AlignedBuffer & );
+  AlignedBuffer & operator=( const AlignedBuffer & );
+  
+  
+public:
+  
+  AlignedBuffer() : raw( 0 ), data( 0 ) {}
+  ~AlignedBuffer() { delete [] this->raw; }
+  
+  // allocate n doubles, releasing any previous allocation
+  void allocate( size_t n )
+  {
+    const size_t slack = CRITIC_ALIGNMENT / sizeof(double);
+    delete [] this->raw;
+    this->raw = new double[n + slack]();
+    size_t misalignment = ((size_t)this->raw % CRITIC_ALIGNMENT) / sizeof(double);
+    this->data = this->raw + (misalignment ? slack - misalignment : 0);
+  }
+  
+  double * get() const { return this->data; }
+  
+  // n rounded up to a whole number of alignment units
+  static size_t padded( size_t n )
+  {
+    const size_t unit = CRITIC_ALIGNMENT / sizeof(double);
+    return (n + unit - 1) / unit * unit;
+  }
+  
+};
+
+
+
+
+/* A view of a statistics buffer held by a critic, valid until the critic is destroyed. A dense buffer has rows x cols
+ * elements, with element (row, col) at data[row * stride + col]. A packed buffer holds the upper triangle of a
+ * symmetric rows x rows matrix row by row (cols and stride are then rows). */
+struct CriticBuffer {
+  enum Type { BT_DOUBLE = 0, BT_INT64 = 1 };
+  enum Layout { BL_DENSE = 0, BL_PACKEDUPPER = 1 };
+  
+  const char * name;
+  const void * data;
+  Type type;
+  Layout layout;
+  int rows, cols, stride;
+  
+  void set( const char * name, const void * data, Type type, Layout layout, int rows, int cols, int stride )
+  {
+    this->name = name; this->data = data; this->type = type; this->layout = layout;
+    this->rows = rows; this->cols = cols; this->stride = stride;
+  }
+};
+
 
 
 
@@ -21,29 +105,103 @@ protected:
   // learning params
   double gamma, lambda;
   
+  // the mode for Peters' trick (see setPetersTrickMode())
+  PetersTrickMode petersTrickMode;
+  
+  // number of leading state features (see setStateDim())
+  int stateDim;
+  
+  // storage of the input registers
+  AlignedBuffer registers;
+  
   
 public:
   
   // critic classes
-  enum CriticClass { CC_LSTD = 0, CC_LSPE = 1, CC_FULLTD = 2 };
+  enum CriticClass { CC_LSTD = 0, CC_LSPE = 1, CC_FULLTD = 2, CC_ENAC = 3, CC_GTD2 = 4, CC_TDC = 5 };
   
-  // input registers
-  double phi0[VDIM];
-  double phi1[VDIM];
+  // input registers (VDim elements each, zero-initialized)
+  double * phi0;
+  double * phi1;
   
   
   Critic( int VDim, double gamma, double lambda ) :
     VDim( VDim ),
     gamma( gamma ),
-    lambda( lambda )
-  {}
+    lambda( lambda ),
+    petersTrickMode( PETERS_TRICK_MODE ),
+    stateDim( 0 )
+  {
+    this->registers.allocate( 2 * AlignedBuffer::padded( VDim ) );
+    this->phi0 = this->registers.get();
+    this->phi1 = this->phi0 + AlignedBuffer::padded( VDim );
+  }
+  
+  virtual ~Critic() {}
+  
+  // create a critic of the given class (CriticClass) and dimension. raises a Matlab error if the combination is not
+  // supported.
+  static Critic * create( int criticClass, int VDim, double gamma, double lambda );
+  
+  // number of features
+  int getVDim() const { return this->VDim; }
+  
+  // learning params
+  double getGamma() const { return this->gamma; }
+  double getLambda() const { return this->lambda; }
+  
+  // set the mode for Peters' trick before the first step (only LSTDLambda distinguishes PTM_CORRECTED from PTM_ON)
+  void setPetersTrickMode( PetersTrickMode mode ) { this->petersTrickMode = mode; }
+  PetersTrickMode getPetersTrickMode() const { return this->petersTrickMode; }
+  
+  // set the number of state features at the beginning of phi before the first step, the rest being the compatible
+  // features of the policy gradient (only EpisodicNAC and the PTM_CORRECTED update of LSTDLambda distinguish them)
+  void setStateDim( int stateDim ) { this->stateDim = stateDim; }
+  int getStateDim() const { return this->stateDim; }
+  
+  // apply the critic-specific settings of the struct s before the first step (only GradientTDLambda has any)
+  virtual void configure( const mxArray * s ) {}
+  
+  // clear the eligibility trace at the beginning of an episode
+  virtual void newEpisode() {}
+  
+  // clear the accumulated statistics
+  virtual void reset() = 0;
+  
+  // scale the accumulated statistics by beta after an actor update, as forget() in the Matlab critics
+  virtual void forget( double beta ) = 0;
+  
+  /* Solve the critic parameters V (VDim elements) from the accumulated statistics and estimate the condition number of
+   * the main matrix, as computeV() and getCond() in the Matlab critics. */
+  virtual void solve( const SolverOptions & options, double * V, double & cnd )
+  {
+    mexErrMsgIdAndTxt( "Critic:solveNotSupported", "Critic: native solving is not supported by this critic!" );
+  }
+  
+  // move any Matlab-allocated memory into persistent memory, so that the critic can outlive the current mex call
+  virtual void makePersistent() {}
   
   // update statistics based on the data in the input registers
   virtual void step( double r ) = 0;
   
+  /* Update statistics off-policy, with rho the (possibly truncated) importance weight of the action in phi0: the
+   * eligibility trace is carried over the action with weight rho (per-decision importance sampling). */
+  virtual void stepWeighted( double r, double rho )
+  {
+    mexErrMsgIdAndTxt( "Critic:weightedStepNotSupported",
+                       "Critic: off-policy updates are not supported by this critic!" );
+  }
+  
   // copy statistics into the provided return struct
   virtual void fillReturnStruct( mxArray * s ) = 0;
   
+  // describe the statistics buffers in place, without copying them. returns the number of buffers.
+  virtual int getBuffers( CriticBuffer (& buffers)[CRITIC_MAXBUFFERS] ) const { return 0; }
+  
+  // save and restore the accumulated statistics and the eligibility trace
+  virtual void saveState( StateWriter & w ) const = 0;
+  virtual void loadState( StateReader & r ) = 0;
+  
 };
 
 
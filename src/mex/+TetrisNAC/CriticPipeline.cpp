@@ -0,0 +1,106 @@
+/* CriticPipeline.cpp */
+
+
+#include "CriticPipeline.hpp"
+#include "Configuration.hpp"
+#include "../Profiler.hpp"
+
+#include <cstring>
+using std::memcpy;
+
+
+
+
+CriticPipeline::CriticPipeline( Critic * critic, int stateDim ) :
+  critics( 1, critic ),
+  head( 0 ),
+  tail( 0 ),
+  phi0Dim( critic->getVDim() ),
+  phi1Dim( critic->getPetersTrickMode() == PTM_OFF ? critic->getVDim() : stateDim ),
+  running( false )
+{
+  // allocate the feature vectors of the transitions
+  const size_t vectorSize = AlignedBuffer::padded( this->phi0Dim );
+  this->features.allocate( 2 * PIPELINE_CAPACITY * vectorSize );
+  for( int i = 0 ; i < PIPELINE_CAPACITY ; i++ ) {
+    this->buffer[i].phi0 = this->features.get() + 2 * i * vectorSize;
+    this->buffer[i].phi1 = this->buffer[i].phi0 + vectorSize;
+  }
+}
+
+CriticPipeline::~CriticPipeline()
+{
+  sync();
+}
+
+
+void CriticPipeline::addCritic( Critic * critic )
+{
+  mxAssert( critic->getVDim() == this->phi0Dim &&
+            critic->getPetersTrickMode() == this->critics[0]->getPetersTrickMode(),
+            "The critics of a pipeline must have the same dimension and Peters' trick mode!" );
+  sync();
+  this->critics.push_back( critic );
+}
+
+
+CriticPipeline::Transition & CriticPipeline::next()
+{
+  unsigned int h = this->head.load( std::memory_order_relaxed );
+  while( h - this->tail.load( std::memory_order_acquire ) == PIPELINE_CAPACITY ) std::this_thread::yield();
+  return this->buffer[h & (PIPELINE_CAPACITY - 1)];
+}
+
+
+void CriticPipeline::sync()
+{
+  if( !this->running ) return;
+  push( Transition::TK_STOP );
+  this->learner.join();
+  this->running = false;
+}
+
+
+
+
+/* private methods */
+
+
+void CriticPipeline::push( Transition::Kind kind )
+{
+  if( !this->running ) {
+    this->learner = std::thread( &CriticPipeline::learn, this );
+    this->running = true;
+  }
+  
+  next().kind = kind;
+  this->head.store( this->head.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+}
+
+
+/* The learner thread: consume transitions until a stop marker. */
+void CriticPipeline::learn()
+{
+  while( true ) {
+    
+    unsigned int t = this->tail.load( std::memory_order_relaxed );
+    while( this->head.load( std::memory_order_acquire ) == t ) std::this_thread::yield();
+    const Transition & transition = this->buffer[t & (PIPELINE_CAPACITY - 1)];
+    
+    Transition::Kind kind = transition.kind;
+    if( kind == Transition::TK_STEP ) {
+      PROFILE_SCOPE( PP_CRITICSTEP );
+      for( int i = 0 ; i < (int)this->critics.size() ; i++ ) {
+        Critic * critic = this->critics[i];
+        memcpy( critic->phi0, transition.phi0, this->phi0Dim * sizeof(double) );
+        memcpy( critic->phi1, transition.phi1, this->phi1Dim * sizeof(double) );
+        critic->step( transition.reward );
+      }
+    } else if( kind == Transition::TK_NEWEPISODE ) {
+      for( int i = 0 ; i < (int)this->critics.size() ; i++ ) this->critics[i]->newEpisode();
+    }
+    
+    this->tail.store( t + 1, std::memory_order_release );
+    if( kind == Transition::TK_STOP ) break;
+  }
+}
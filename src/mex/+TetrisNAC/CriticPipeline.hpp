@@ -0,0 +1,96 @@
+/* CriticPipeline.hpp
+ *
+ * Pipelined critic updates: the simulation thread (the mex thread, which runs Tetris and act()) pushes transitions into
+ * a single-producer/single-consumer lock-free ring buffer, and a learner thread consumes them into the critic. The
+ * critic therefore sees exactly the same sequence of steps and episode starts as in the sequential path, and produces
+ * identical statistics, while the O(VDIM^2) critic updates overlap with the simulation.
+ *
+ * Further critics of the same dimension and Peters' trick mode (with other gamma and lambda, or of another class) can
+ * be added with addCritic(). The learner thread then steps all of them on each transition, so that they see the same
+ * transitions as the first one.
+ *
+ * The learner thread is started on the first push and stopped by sync(), which returns once all pushed transitions
+ * have been consumed. The critics must not be accessed from the simulation thread between the first push and sync().
+ *
+ * NOTE: The learner thread must not call the Matlab API. The critics do so only through mxAssert, so an assertion
+ * failure in the learner thread (in a debug build) is fatal.
+ */
+#ifndef CRITICPIPELINE_HPP
+#define CRITICPIPELINE_HPP
+
+
+#include "Critic.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+// ring buffer capacity in transitions (must be a power of two)
+#define PIPELINE_CAPACITY 256
+
+
+
+
+class CriticPipeline {
+  
+public:
+  
+  // a transition (the critic input registers and the reward), or a marker. phi0 and phi1 point into the feature storage
+  // of the pipeline and have the dimension of the critic.
+  struct Transition {
+    enum Kind { TK_STEP, TK_NEWEPISODE, TK_STOP } kind;
+    double * phi0;
+    double * phi1;
+    double reward;
+  };
+  
+  
+private:
+  
+  // the critics stepped on each transition
+  std::vector<Critic *> critics;
+  
+  // the ring buffer and the storage of its feature vectors. head is written only by the producer, tail only by the
+  // consumer.
+  Transition buffer[PIPELINE_CAPACITY];
+  AlignedBuffer features;
+  std::atomic<unsigned int> head, tail;
+  
+  // number of phi0 elements, and the number of phi1 elements to pass (the gradient part of phi1 is zero with Peters'
+  // trick)
+  int phi0Dim, phi1Dim;
+  
+  std::thread learner;
+  bool running;
+  
+  void learn();
+  void push( Transition::Kind kind );
+  
+  
+public:
+  
+  // stateDim is the number of state features at the beginning of phi1 (the rest is the gradient part)
+  CriticPipeline( Critic * critic, int stateDim );
+  ~CriticPipeline();
+  
+  // step also the given critic on each transition. it must have the dimension and the Peters' trick mode of the first
+  // critic. the critic is not owned by the pipeline.
+  void addCritic( Critic * critic );
+  
+  // producer: the slot for the next transition. waits while the buffer is full.
+  Transition & next();
+  
+  // producer: publish the transition written into next() as a step, or queue an episode start
+  void pushStep() { push( Transition::TK_STEP ); }
+  void pushNewEpisode() { push( Transition::TK_NEWEPISODE ); }
+  
+  // wait until all transitions have been consumed and stop the learner thread
+  void sync();
+  
+};
+
+
+
+
+#endif
@@ -0,0 +1,303 @@
+/* EngineComparison.cpp */
+
+
+#include "EngineComparison.hpp"
+#include "../StateBuffer.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <cstring>
+using std::memcmp;
+using std::strcmp;
+
+#include <cstdio>
+using std::sprintf;
+
+#include <cmath>
+using std::fabs;
+
+#include <chrono>
+
+
+
+
+/* Adapters that give the candidate environments a common interface. */
+
+class TetrisCandidate {
+  Tetris & environment;
+public:
+  TetrisCandidate( Tetris & environment ) : environment( environment ) {}
+  void keyStream( unsigned long long seed, unsigned long long episode )
+    { this->environment.keyStream( seed, episode ); }
+  void newEpisode() { this->environment.newEpisode(); }
+  void step( int action ) { this->environment.step( action ); }
+  bool terminalState() const { return this->environment.terminalState; }
+  int fallingPiece() const { return this->environment.getFallingPiece(); }
+  const Tetris::StepData & stepData() const { return this->environment.stepData; }
+};
+
+class BatchCandidate {
+  TetrisBatch & batch;
+public:
+  BatchCandidate( TetrisBatch & batch ) : batch( batch ) {}
+  void keyStream( unsigned long long seed, unsigned long long episode ) { this->batch.keyStream( 0, seed, episode ); }
+  void newEpisode() { this->batch.newEpisode( 0 ); }
+  void step( int action ) { bool active = true; this->batch.step( &action, &active ); }
+  bool terminalState() const { return this->batch.terminalState[0]; }
+  int fallingPiece() const { return this->batch.getFallingPiece( 0 ); }
+  const Tetris::StepData & stepData() const { return this->batch.stepData[0]; }
+};
+
+
+
+
+/* private methods */
+
+
+bool EngineComparison::match( double a, double b, double & maxDifference ) const
+{
+  if( this->tolerance == 0.0 ) {
+    if( !memcmp( &a, &b, sizeof(double) ) ) return true;
+  } else {
+    if( a == b || (a != a && b != b) ) return true;
+  }
+  double difference = fabs( a - b );
+  if( !(difference <= maxDifference) ) maxDifference = difference;   // (NaN propagates)
+  return difference <= this->tolerance;
+}
+
+
+void EngineComparison::mismatch( const char * what )
+{
+  if( !this->firstMismatch.empty() ) return;
+  char description[256];
+  sprintf( description, "%s (episode %lld, step %lld)", what, this->episodes, this->steps );
+  this->firstMismatch = description;
+}
+
+
+bool EngineComparison::compareStates( int referencePiece, const Tetris::StepData & reference,
+                                      int candidatePiece, const Tetris::StepData & candidate )
+{
+  // the falling piece is undefined in a terminal state
+  if( reference.actionCount > 0 && referencePiece != candidatePiece ) {
+    this->pieceMismatches++;
+    mismatch( "falling piece" );
+    return false;
+  }
+  
+  bool ok = reference.actionCount == candidate.actionCount;
+  ok = match( reference.transitionReward, candidate.transitionReward, this->maxStepDataDifference ) && ok;
+  for( int i = 0 ; i < STATEDIM ; i++ )
+    ok = match( reference.observation[i], candidate.observation[i], this->maxStepDataDifference ) && ok;
+  for( int action = 0 ; action < reference.actionCount && action < candidate.actionCount ; action++ ) {
+    ok = reference.isActionTerminal[action] == candidate.isActionTerminal[action] && ok;
+    for( int i = 0 ; i < STATEACTIONDIM ; i++ )
+      ok = match( reference.actions[action][i], candidate.actions[action][i], this->maxStepDataDifference ) && ok;
+  }
+  if( !ok ) {
+    this->stepDataMismatches++;
+    mismatch( "step data" );
+  }
+  return true;
+}
+
+
+void EngineComparison::compareCritics( NaturalActorCritic & reference, NaturalActorCritic & candidate )
+{
+  reference.sync();
+  candidate.sync();
+  bool ok = true;
+  
+  if( this->tolerance == 0.0 ) {
+    
+    // bit-for-bit: compare the saved states (the statistics and the eligibility trace)
+    StateWriter rw, cw;
+    reference.critic->saveState( rw );
+    candidate.critic->saveState( cw );
+    mxArray * r = rw.createArray(), * c = cw.createArray();
+    ok = mxGetNumberOfElements( r ) == mxGetNumberOfElements( c ) &&
+         !memcmp( mxGetData( r ), mxGetData( c ), mxGetNumberOfElements( r ) );
+    mxDestroyArray( r );
+    mxDestroyArray( c );
+    
+  } else {
+    
+    // within the tolerance: compare the numeric fields of the return structs
+    mxArray * r = mxCreateStructMatrix( 1, 1, 0, 0 );
+    mxArray * c = mxCreateStructMatrix( 1, 1, 0, 0 );
+    reference.critic->fillReturnStruct( r );
+    candidate.critic->fillReturnStruct( c );
+    ok = mxGetNumberOfFields( r ) == mxGetNumberOfFields( c );
+    for( int field = 0 ; ok && field < mxGetNumberOfFields( r ) ; field++ ) {
+      const mxArray * a = mxGetFieldByNumber( r, 0, field );
+      const mxArray * b = mxGetField( c, 0, mxGetFieldNameByNumber( r, field ) );
+      if( !b || mxGetNumberOfElements( a ) != mxGetNumberOfElements( b ) ) { ok = false; break; }
+      if( !mxIsDouble( a ) || !mxIsDouble( b ) ) continue;
+      const double * pa = mxGetPr( a ), * pb = mxGetPr( b );
+      for( size_t i = 0 ; i < mxGetNumberOfElements( a ) ; i++ )
+        ok = match( pa[i], pb[i], this->maxCriticDifference ) && ok;
+    }
+    mxDestroyArray( r );
+    mxDestroyArray( c );
+    
+  }
+  
+  if( !ok ) {
+    this->criticMismatches++;
+    mismatch( "critic statistics" );
+  }
+}
+
+
+template<class Candidate>
+void EngineComparison::runEpisode( Tetris & referenceEnvironment, NaturalActorCritic & referenceAgent,
+                                   Candidate & candidateEnvironment, NaturalActorCritic & candidateAgent,
+                                   double maxSteps )
+{
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point t0, t1, t2;
+  
+  // start the episode
+  t0 = Clock::now();
+  referenceEnvironment.newEpisode();
+  referenceAgent.newEpisode();
+  t1 = Clock::now();
+  candidateEnvironment.newEpisode();
+  candidateAgent.newEpisode();
+  t2 = Clock::now();
+  this->referenceSeconds += std::chrono::duration<double>( t1 - t0 ).count();
+  this->candidateSeconds += std::chrono::duration<double>( t2 - t1 ).count();
+  
+  bool diverged = !compareStates( referenceEnvironment.getFallingPiece(), referenceEnvironment.stepData,
+                                  candidateEnvironment.fallingPiece(), candidateEnvironment.stepData() );
+  
+  // step in lockstep
+  double stepCounter = 0;
+  while( !diverged && !referenceEnvironment.terminalState && stepCounter < maxSteps ) {
+    
+    t0 = Clock::now();
+    int referenceAction = referenceAgent.step( referenceEnvironment.stepData );
+    t1 = Clock::now();
+    int candidateAction = candidateAgent.step( candidateEnvironment.stepData() );
+    t2 = Clock::now();
+    this->referenceSeconds += std::chrono::duration<double>( t1 - t0 ).count();
+    this->candidateSeconds += std::chrono::duration<double>( t2 - t1 ).count();
+    
+    if( referenceAction != candidateAction ) {
+      this->actionMismatches++;
+      mismatch( "action" );
+      diverged = true;
+      break;
+    }
+    
+    t0 = Clock::now();
+    referenceEnvironment.step( referenceAction );
+    t1 = Clock::now();
+    candidateEnvironment.step( candidateAction );
+    t2 = Clock::now();
+    this->referenceSeconds += std::chrono::duration<double>( t1 - t0 ).count();
+    this->candidateSeconds += std::chrono::duration<double>( t2 - t1 ).count();
+    
+    this->steps++; stepCounter++;
+    diverged = !compareStates( referenceEnvironment.getFallingPiece(), referenceEnvironment.stepData,
+                               candidateEnvironment.fallingPiece(), candidateEnvironment.stepData() );
+    if( !diverged && referenceEnvironment.terminalState != candidateEnvironment.terminalState() ) {
+      this->stepDataMismatches++;
+      mismatch( "terminal state" );
+      diverged = true;
+    }
+  }
+  
+  // step in the terminal state for learning purposes, and compare the statistics of a complete episode
+  if( !diverged ) {
+    t0 = Clock::now();
+    referenceAgent.step( referenceEnvironment.stepData );
+    referenceAgent.sync();
+    t1 = Clock::now();
+    candidateAgent.step( candidateEnvironment.stepData() );
+    candidateAgent.sync();
+    t2 = Clock::now();
+    this->referenceSeconds += std::chrono::duration<double>( t1 - t0 ).count();
+    this->candidateSeconds += std::chrono::duration<double>( t2 - t1 ).count();
+    compareCritics( referenceAgent, candidateAgent );
+  }
+}
+
+
+
+
+/* public methods */
+
+
+EngineComparison::EngineComparison( double tolerance ) :
+  tolerance( tolerance ),
+  episodes( 0 ),
+  steps( 0 ),
+  pieceMismatches( 0 ),
+  actionMismatches( 0 ),
+  stepDataMismatches( 0 ),
+  criticMismatches( 0 ),
+  maxStepDataDifference( 0.0 ),
+  maxCriticDifference( 0.0 ),
+  referenceSeconds( 0.0 ),
+  candidateSeconds( 0.0 )
+{
+}
+
+
+void EngineComparison::run( Tetris & referenceEnvironment, NaturalActorCritic & referenceAgent,
+                            Tetris * candidateEnvironment, TetrisBatch * candidateBatch,
+                            NaturalActorCritic & candidateAgent,
+                            int episodes, unsigned long long seed, unsigned long long firstEpisode, double maxSteps )
+{
+  mxAssert( candidateEnvironment || candidateBatch, "No candidate environment!" );
+  
+  for( int episode = 0 ; episode < episodes ; episode++ ) {
+    
+    // key both engines to the same streams, and start from empty critic statistics
+    referenceEnvironment.keyStream( seed, firstEpisode + episode );
+    referenceAgent.keyStream( seed, firstEpisode + episode );
+    candidateAgent.keyStream( seed, firstEpisode + episode );
+    referenceAgent.sync();
+    candidateAgent.sync();
+    referenceAgent.critic->reset();
+    candidateAgent.critic->reset();
+    
+    if( candidateEnvironment ) {
+      TetrisCandidate candidate( *candidateEnvironment );
+      candidate.keyStream( seed, firstEpisode + episode );
+      runEpisode( referenceEnvironment, referenceAgent, candidate, candidateAgent, maxSteps );
+    } else {
+      BatchCandidate candidate( *candidateBatch );
+      candidate.keyStream( seed, firstEpisode + episode );
+      runEpisode( referenceEnvironment, referenceAgent, candidate, candidateAgent, maxSteps );
+    }
+    
+    this->episodes++;
+  }
+}
+
+
+mxArray * EngineComparison::createReturnStruct() const
+{
+  const char * fieldnames[] = { "episodes", "steps", "pieceMismatches", "actionMismatches", "stepDataMismatches",
+                                "criticMismatches", "maxStepDataDifference", "maxCriticDifference", "firstMismatch",
+                                "referenceStepsPerSecond", "candidateStepsPerSecond" };
+  mxArray * s = mxCreateStructMatrix( 1, 1, sizeof(fieldnames) / sizeof(fieldnames[0]), fieldnames );
+  mxSetField( s, 0, "episodes", mxCreateDoubleScalar( (double)this->episodes ) );
+  mxSetField( s, 0, "steps", mxCreateDoubleScalar( (double)this->steps ) );
+  mxSetField( s, 0, "pieceMismatches", mxCreateDoubleScalar( (double)this->pieceMismatches ) );
+  mxSetField( s, 0, "actionMismatches", mxCreateDoubleScalar( (double)this->actionMismatches ) );
+  mxSetField( s, 0, "stepDataMismatches", mxCreateDoubleScalar( (double)this->stepDataMismatches ) );
+  mxSetField( s, 0, "criticMismatches", mxCreateDoubleScalar( (double)this->criticMismatches ) );
+  mxSetField( s, 0, "maxStepDataDifference", mxCreateDoubleScalar( this->maxStepDataDifference ) );
+  mxSetField( s, 0, "maxCriticDifference", mxCreateDoubleScalar( this->maxCriticDifference ) );
+  mxSetField( s, 0, "firstMismatch", mxCreateString( this->firstMismatch.c_str() ) );
+  mxSetField( s, 0, "referenceStepsPerSecond",
+              mxCreateDoubleScalar( this->referenceSeconds > 0.0 ? this->steps / this->referenceSeconds : 0.0 ) );
+  mxSetField( s, 0, "candidateStepsPerSecond",
+              mxCreateDoubleScalar( this->candidateSeconds > 0.0 ? this->steps / this->candidateSeconds : 0.0 ) );
+  return s;
+}
@@ -0,0 +1,83 @@
+/* EngineComparison.hpp
+ *
+ * Reference-equivalence harness for the optimized engines (see the 'compare' command in MexTetrisNAC). The reference
+ * engine (Tetris without the action cache, and NaturalActorCritic with sequential critic updates) and a candidate
+ * engine are run side by side on the same counter-based random streams, so that both see the same random numbers no
+ * matter how they consume them. After each step, the falling pieces, the step data and the selected actions are
+ * compared, and after each episode the critic statistics of the episode. A piece or action mismatch ends the episode,
+ * as the trajectories diverge after it. Values are compared bit-for-bit if the tolerance is zero (the critics through
+ * their saved states), otherwise within the absolute tolerance (the critics through their return structs, which for
+ * FullTDLambda copies all sample buffers). The time spent in each engine is measured separately, excluding the
+ * comparisons.
+ */
+#ifndef ENGINECOMPARISON_HPP
+#define ENGINECOMPARISON_HPP
+
+
+#include "Tetris.hpp"
+#include "TetrisBatch.hpp"
+#include "NaturalActorCritic.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <string>
+
+
+
+
+class EngineComparison {
+  
+  // absolute tolerance, or 0 for bit-for-bit comparison
+  double tolerance;
+  
+  // totals
+  long long episodes, steps;
+  long long pieceMismatches, actionMismatches, stepDataMismatches, criticMismatches;
+  double maxStepDataDifference, maxCriticDifference;
+  double referenceSeconds, candidateSeconds;
+  
+  // description of the first mismatch, or empty
+  std::string firstMismatch;
+  
+  
+  // compare two values, maintaining maxDifference. returns true if they match.
+  bool match( double a, double b, double & maxDifference ) const;
+  
+  // compare the pieces and the step data of the current states. returns false on a piece mismatch.
+  bool compareStates( int referencePiece, const Tetris::StepData & reference,
+                      int candidatePiece, const Tetris::StepData & candidate );
+  
+  // compare the critic statistics
+  void compareCritics( NaturalActorCritic & reference, NaturalActorCritic & candidate );
+  
+  // record a mismatch
+  void mismatch( const char * what );
+  
+  // run an episode in both engines. Candidate is one of the adapters in EngineComparison.cpp.
+  template<class Candidate>
+  void runEpisode( Tetris & referenceEnvironment, NaturalActorCritic & referenceAgent,
+                   Candidate & candidateEnvironment, NaturalActorCritic & candidateAgent, double maxSteps );
+  
+  
+public:
+  
+  EngineComparison( double tolerance );
+  
+  /* Run episodes episodes in both engines, with the streams of episode k keyed by (seed, firstEpisode + k). The
+   * candidate environment is candidateEnvironment, or lane 0 of candidateBatch if candidateEnvironment is null. The
+   * critics are reset at the start of each episode. With a nonzero tolerance, the agents must be persistent (see
+   * NaturalActorCritic::makePersistent()), so that their statistics can be copied. */
+  void run( Tetris & referenceEnvironment, NaturalActorCritic & referenceAgent,
+            Tetris * candidateEnvironment, TetrisBatch * candidateBatch, NaturalActorCritic & candidateAgent,
+            int episodes, unsigned long long seed, unsigned long long firstEpisode, double maxSteps );
+  
+  // creates the report struct
+  mxArray * createReturnStruct() const;
+  
+};
+
+
+
+
+#endif
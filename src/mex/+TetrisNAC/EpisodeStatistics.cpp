@@ -0,0 +1,114 @@
+/* EpisodeStatistics.cpp */
+
+
+#include "EpisodeStatistics.hpp"
+
+#include <cstring>
+using std::memcpy;
+
+
+
+
+EpisodeStatistics::EpisodeStatistics( int criticClass, int VDim, const char * path ) :
+  VDim( VDim ),
+  hasB( criticClass == Critic::CC_LSPE ),
+  path( path ? path : "" ),
+  file( 0 )
+{
+  if( criticClass != Critic::CC_LSTD && criticClass != Critic::CC_LSPE && criticClass != Critic::CC_ENAC )
+    mexErrMsgIdAndTxt( "EpisodeStatistics:invalidCriticClass",
+                       "EpisodeStatistics: the critic statistics must be additive!" );
+  if( this->path.empty() ) return;
+  
+  this->file = fopen( this->path.c_str(), "a+b" );
+  if( !this->file )
+    mexErrMsgIdAndTxt( "EpisodeStatistics:openFailed", "EpisodeStatistics: cannot open '%s' for writing!",
+                       this->path.c_str() );
+  
+  // write the header into a new file, or check the header of an existing one
+  const double header[4] = { (double)recordLength(), (double)VDim, (double)this->hasB, EPISODESTATISTICS_VERSION };
+  double existing[4];
+  fseek( this->file, 0, SEEK_END );
+  bool ok = ftell( this->file ) == 0 ? fwrite( header, sizeof(header), 1, this->file ) == 1 && !fflush( this->file ) :
+            !fseek( this->file, 0, SEEK_SET ) && fread( existing, sizeof(existing), 1, this->file ) == 1 &&
+            !memcmp( header, existing, sizeof(header) );
+  if( !ok ) {
+    fclose( this->file ); this->file = 0;
+    mexErrMsgIdAndTxt( "EpisodeStatistics:invalidFile",
+                       "EpisodeStatistics: '%s' is not an episode statistics file of this critic!",
+                       this->path.c_str() );
+  }
+
+  // an update stream must be repositioned between reading the header and writing the records
+  fseek( this->file, 0, SEEK_END );
+}
+
+EpisodeStatistics::~EpisodeStatistics()
+{
+  if( this->file ) fclose( this->file );
+}
+
+
+void EpisodeStatistics::record( double episode, double episodeReturn, double steps, Critic & critic )
+{
+  const int n = this->VDim;
+  
+  // the statistics in Matlab layout
+  mxArray * s = mxCreateStructMatrix( 1, 1, 0, 0 );
+  critic.fillReturnStruct( s );
+  const mxArray * A = mxGetField(s, 0, "A");
+  const mxArray * b = mxGetField(s, 0, "b");
+  const mxArray * B = mxGetField(s, 0, "B");
+  mxAssert( A && b && (B || !this->hasB), "Unexpected critic statistics!" );
+  
+  std::vector<double> r( recordLength() );
+  r[0] = episode; r[1] = episodeReturn; r[2] = steps;
+  memcpy( &r[3], mxGetPr( A ), n * n * sizeof(double) );
+  memcpy( &r[3 + n * n], mxGetPr( b ), n * sizeof(double) );
+  if( this->hasB ) memcpy( &r[3 + n * n + n], mxGetPr( B ), n * n * sizeof(double) );
+  mxDestroyArray( s );
+  
+  // append a complete record, so that the file can be read while it grows
+  if( this->file ) {
+    if( fwrite( &r[0], r.size() * sizeof(double), 1, this->file ) != 1 || fflush( this->file ) )
+      mexErrMsgIdAndTxt( "EpisodeStatistics:writeFailed", "EpisodeStatistics: writing to '%s' failed!",
+                         this->path.c_str() );
+  } else {
+    this->records.insert( this->records.end(), r.begin(), r.end() );
+  }
+}
+
+
+mxArray * EpisodeStatistics::createReturnStruct() const
+{
+  const int n = this->VDim, length = recordLength();
+  const int count = (int)this->records.size() / length;
+  
+  const char * fieldnames[] = { "episode", "return", "steps", "A", "b", "B" };
+  mxArray * s = mxCreateStructMatrix( 1, 1, this->hasB ? 6 : 5, fieldnames );
+  
+  mxArray * episode = mxCreateDoubleMatrix( count, 1, mxREAL );
+  mxArray * episodeReturn = mxCreateDoubleMatrix( count, 1, mxREAL );
+  mxArray * steps = mxCreateDoubleMatrix( count, 1, mxREAL );
+  mwSize dims[3] = { (mwSize)n, (mwSize)n, (mwSize)count };
+  mxArray * A = mxCreateNumericArray( 3, dims, mxDOUBLE_CLASS, mxREAL );
+  mxArray * b = mxCreateDoubleMatrix( n, count, mxREAL );
+  mxArray * B = this->hasB ? mxCreateNumericArray( 3, dims, mxDOUBLE_CLASS, mxREAL ) : 0;
+  for( int i = 0 ; i < count ; i++ ) {
+    const double * r = &this->records[i * length];
+    mxGetPr( episode )[i] = r[0];
+    mxGetPr( episodeReturn )[i] = r[1];
+    mxGetPr( steps )[i] = r[2];
+    memcpy( mxGetPr( A ) + i * n * n, &r[3], n * n * sizeof(double) );
+    memcpy( mxGetPr( b ) + i * n, &r[3 + n * n], n * sizeof(double) );
+    if( B ) memcpy( mxGetPr( B ) + i * n * n, &r[3 + n * n + n], n * n * sizeof(double) );
+  }
+  
+  mxSetField( s, 0, "episode", episode );
+  mxSetField( s, 0, "return", episodeReturn );
+  mxSetField( s, 0, "steps", steps );
+  mxSetField( s, 0, "A", A );
+  mxSetField( s, 0, "b", b );
+  if( B ) mxSetField( s, 0, "B", B );
+  return s;
+}
@@ -0,0 +1,74 @@
+/* EpisodeStatistics.hpp
+ *
+ * A record of the contribution of each episode to the critic statistics, for estimating the variance of the natural
+ * gradient offline (by bootstrapping over episodes, say) and for recombining subsets of the episodes without
+ * repeating the simulation. Each record holds the episode index (the index of the counter-based streams, or NaN if
+ * the episode was not keyed), the return, the number of steps, and the statistics A and b (and B for LSPELambda)
+ * that the episode alone produced, in Matlab layout. The critics with other statistics are not supported.
+ *
+ * The records are either kept in memory, or appended to a file as they are made, so that the file grows over any
+ * number of mex calls and sessions. The file starts with a header of four doubles [recordLength, VDim, hasB,
+ * version], followed by the records as recordLength doubles each, in native byte order: [episode, return, steps,
+ * A(:), b, B(:)]. An existing file is appended to only if its header matches. See readEpisodeStatistics.m.
+ */
+#ifndef EPISODESTATISTICS_HPP
+#define EPISODESTATISTICS_HPP
+
+
+#include "Critic.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+// file format version
+#define EPISODESTATISTICS_VERSION 1
+
+
+
+
+class EpisodeStatistics {
+  
+  int VDim;
+  bool hasB;
+  
+  // the records held in memory
+  std::vector<double> records;
+  
+  // the file name and the file, if appending to a file
+  std::string path;
+  FILE * file;
+  
+  
+public:
+  
+  // keep the records of critics of the given class and dimension in memory if path is null or empty, otherwise append
+  // them to the file
+  EpisodeStatistics( int criticClass, int VDim, const char * path );
+  ~EpisodeStatistics();
+  
+  const std::string & getPath() const { return this->path; }
+  
+  // the number of doubles in a record
+  int recordLength() const { return 3 + this->VDim * this->VDim * (this->hasB ? 2 : 1) + this->VDim; }
+  
+  // record an episode, given the critic that accumulated the statistics of the episode alone
+  void record( double episode, double episodeReturn, double steps, Critic & critic );
+  
+  // drop the records held in memory
+  void clear() { this->records.clear(); }
+  
+  /* the records held in memory as a struct with the fields episode, return and steps (n x 1), A (VDim x VDim x n), b
+   * (VDim x n) and, for LSPE, B (VDim x VDim x n) */
+  mxArray * createReturnStruct() const;
+  
+};
+
+
+
+
+#endif
@@ -0,0 +1,196 @@
+/* EpisodicNAC.cpp */
+
+
+#include "EpisodicNAC.hpp"
+#include "Solver.hpp"
+
+#include "mex.h"
+
+#include <cstring>
+using std::memcpy;
+using std::memset;
+
+#include <vector>
+
+
+
+
+/* private methods */
+
+
+void EpisodicNAC::foldEpisode()
+{
+  const int n = this->VDim;
+  if( this->steps > 0 ) {
+    for( int i = 0 ; i < n ; i++ ) {
+      double * Ai = &this->A[i * n];
+      const double zi = this->z[i];
+      for( int j = 0 ; j < n ; j++ )
+        Ai[j] += zi * this->z[j];
+      this->b[i] += zi * this->R;
+    }
+  }
+  
+  memset( this->z, 0, n * sizeof(double) );
+  this->R = 0.0;
+  this->discount = 1.0;
+  this->steps = 0;
+}
+
+
+void EpisodicNAC::getStatistics( double * A, double * b ) const
+{
+  const int n = this->VDim;
+  memcpy( A, this->A, n * n * sizeof(double) );
+  memcpy( b, this->b, n * sizeof(double) );
+  if( this->steps > 0 ) {
+    for( int i = 0 ; i < n ; i++ ) {
+      for( int j = 0 ; j < n ; j++ )
+        A[i * n + j] += this->z[i] * this->z[j];
+      b[i] += this->z[i] * this->R;
+    }
+  }
+}
+
+
+
+
+/* public methods */
+
+
+EpisodicNAC::EpisodicNAC( int VDim, double gamma, double lambda ) :
+  Critic( VDim, gamma, lambda ),
+  R( 0.0 ),
+  discount( 1.0 ),
+  steps( 0 )
+{
+  // allocate and clear the params
+  const int n = VDim;
+  const size_t vectorSize = AlignedBuffer::padded( n );
+  this->storage.allocate( AlignedBuffer::padded( n * n ) + 2 * vectorSize );
+  this->A = this->storage.get();
+  this->b = this->A + AlignedBuffer::padded( n * n );
+  this->z = this->b + vectorSize;
+}
+
+
+void EpisodicNAC::newEpisode()
+{
+  foldEpisode();
+}
+
+
+void EpisodicNAC::reset()
+{
+  memset( this->A, 0, this->VDim * this->VDim * sizeof(double) );
+  memset( this->b, 0, this->VDim * sizeof(double) );
+  memset( this->z, 0, this->VDim * sizeof(double) );
+  this->R = 0.0;
+  this->discount = 1.0;
+  this->steps = 0;
+}
+
+
+void EpisodicNAC::forget( double beta )
+{
+  // forgetting happens between episodes, so the last episode is complete
+  foldEpisode();
+  
+  const int n = this->VDim;
+  for( int i = 0 ; i < n ; i++ ) {
+    for( int j = 0 ; j < n ; j++ )
+      this->A[i * n + j] *= beta;
+    this->b[i] *= beta;
+  }
+}
+
+
+void EpisodicNAC::solve( const SolverOptions & options, double * V, double & cnd )
+{
+  const int n = this->VDim;
+  
+  // the statistics, with the episode in progress
+  std::vector<double> A( n * n ), b( n );
+  getStatistics( &A[0], &b[0] );
+  
+  // extract the masked system
+  std::vector<double> Am( n * n ), bm( n ), Vm( n );
+  int nm = Solver::extract( n, &A[0], options.featureMask, options.Ifactor, &Am[0] );
+  for( int i = 0, k = 0 ; i < n ; i++ )
+    if( options.featureMask[i] ) bm[k++] = b[i];
+  
+  // solve A V = b
+  Solver::solve( options.method, nm, &Am[0], &bm[0], &Vm[0], options.regularization );
+  cnd = Solver::cond( nm, &Am[0] );
+  
+  // undo the mask
+  for( int i = 0, k = 0 ; i < n ; i++ )
+    V[i] = options.featureMask[i] ? Vm[k++] : 0.0;
+}
+
+
+void EpisodicNAC::step( double r )
+{
+  const int n = this->VDim;
+  const int stateDim = this->stateDim;
+  
+  // the state features of the first state are the baseline features of the episode
+  if( this->steps == 0 ) memcpy( this->z, this->phi0, stateDim * sizeof(double) );
+  
+  // discounted sums of the compatible features and the rewards
+  for( int i = stateDim ; i < n ; i++ )
+    this->z[i] += this->discount * this->phi0[i];
+  this->R += this->discount * r;
+  
+  this->discount *= this->gamma;
+  this->steps++;
+}
+
+
+void EpisodicNAC::fillReturnStruct( mxArray * s )
+{
+  const int n = this->VDim;
+  
+  // A and b with the episode in progress (A is symmetric, so it needs no transposing)
+  mxArray * A = mxCreateDoubleMatrix( n, n, mxREAL );
+  mxArray * b = mxCreateDoubleMatrix( n, 1, mxREAL );
+  getStatistics( mxGetPr(A), mxGetPr(b) );
+  mxAddField( s, "A" );
+  mxSetField( s, 0, "A", A );
+  mxAddField( s, "b" );
+  mxSetField( s, 0, "b", b );
+}
+
+
+int EpisodicNAC::getBuffers( CriticBuffer (& buffers)[CRITIC_MAXBUFFERS] ) const
+{
+  const int n = this->VDim;
+  buffers[0].set( "A", this->A, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, n, n, n );
+  buffers[1].set( "b", this->b, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, n, 1, 1 );
+  buffers[2].set( "z", this->z, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, n, 1, 1 );
+  buffers[3].set( "R", &this->R, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, 1, 1, 1 );
+  return 4;
+}
+
+
+void EpisodicNAC::saveState( StateWriter & w ) const
+{
+  const int n = this->VDim;
+  w.write( this->A, n * n * sizeof(double) );
+  w.write( this->b, n * sizeof(double) );
+  w.write( this->z, n * sizeof(double) );
+  w.write( this->R );
+  w.write( this->discount );
+  w.write( this->steps );
+}
+
+void EpisodicNAC::loadState( StateReader & r )
+{
+  const int n = this->VDim;
+  r.read( this->A, n * n * sizeof(double) );
+  r.read( this->b, n * sizeof(double) );
+  r.read( this->z, n * sizeof(double) );
+  r.read( this->R );
+  r.read( this->discount );
+  r.read( this->steps );
+}
@@ -0,0 +1,88 @@
+/* EpisodicNAC.hpp
+ *
+ * The critic of the episodic natural actor-critic (eNAC; Peters & Schaal, 2008). Instead of a temporal difference
+ * update on every step, each episode contributes a single regression sample
+ *
+ *   [ phi(s_0) ; sum_t gamma^t grad log pi(a_t|s_t) ]' V  ~  sum_t gamma^t r_t
+ *
+ * where phi(s_0) are the state features of the first state of the episode (the baseline), and the sums run over the
+ * steps of the episode. step() only accumulates the sums, in O(VDim), and the least squares statistics A = sum z z'
+ * and b = sum z R are updated once per episode, when the next episode starts or the statistics are forgotten. The
+ * statistics read in between (fillReturnStruct(), solve()) include the episode in progress without folding it in, so
+ * that a chunked episode is still a single sample. The advantage part of the solution is the natural gradient, as
+ * with the other critics.
+ *
+ * The first getStateDim() features of phi0 are the state features and the rest the compatible features; phi1 and
+ * lambda are not used.
+ *
+ *   References
+ *
+ *     Peters & Schaal (2008). Natural actor-critic.
+ */
+#ifndef EPISODICNAC_HPP
+#define EPISODICNAC_HPP
+
+
+#include "Critic.hpp"
+
+
+
+
+class EpisodicNAC :
+  public Critic
+{
+  
+  // params: A (row-major, symmetric) and b of the completed episodes, and the regression features z of the episode in
+  // progress, in a single aligned allocation
+  AlignedBuffer storage;
+  double * A;
+  double * b;
+  double * z;
+  
+  // the discounted return and the discount of the next step of the episode in progress, and its step count
+  double R;
+  double discount;
+  int steps;
+  
+  // add the episode in progress to A and b, and clear it
+  void foldEpisode();
+  
+  // A and b with the episode in progress added (n * n and n elements)
+  void getStatistics( double * A, double * b ) const;
+  
+  
+public:
+  
+  EpisodicNAC( int VDim, double gamma, double lambda );
+  
+  // complete the previous episode
+  virtual void newEpisode();
+  
+  // clear the accumulated statistics and the episode in progress
+  virtual void reset();
+  
+  // complete the previous episode and scale the statistics
+  virtual void forget( double beta );
+  
+  // solve V
+  virtual void solve( const SolverOptions & options, double * V, double & cnd );
+  
+  // accumulate the sums of the episode in progress
+  virtual void step( double r );
+  
+  // copy statistics into the provided return struct
+  virtual void fillReturnStruct( mxArray * s );
+  
+  // describe A and b of the completed episodes, and z and R of the episode in progress (without copying)
+  virtual int getBuffers( CriticBuffer (& buffers)[CRITIC_MAXBUFFERS] ) const;
+  
+  // save and restore the accumulated statistics and the episode in progress
+  virtual void saveState( StateWriter & w ) const;
+  virtual void loadState( StateReader & r );
+  
+};
+
+
+
+
+#endif
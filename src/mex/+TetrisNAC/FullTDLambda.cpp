@@ -2,6 +2,7 @@
 
 
 #include "FullTDLambda.hpp"
+#include "../Profiler.hpp"
 
 #include "mex.h"
 
@@ -14,17 +15,42 @@ using std::memset;
 FullTDLambda::FullTDLambda( int VDim, double gamma, double lambda ) :
   Critic( VDim, gamma, lambda )
 {
-  // check board size
-  mxAssert( VDim == VDIM, "VDim must match the hard-coded value VDIM!" );
-  
   // init params
-  this->s0 = mxCreateDoubleMatrix( MAXSAMPLES, VDIM, mxREAL );
-  this->s1 = mxCreateDoubleMatrix( MAXSAMPLES, VDIM, mxREAL );
+  this->s0 = mxCreateDoubleMatrix( MAXSAMPLES, VDim, mxREAL );
+  this->s1 = mxCreateDoubleMatrix( MAXSAMPLES, VDim, mxREAL );
   this->r = mxCreateDoubleMatrix( MAXSAMPLES, 1, mxREAL );
   mxAssert( this->s0 && this->s1 && this->r, "Out of memory!" );   // redundant when run as mex
+  PROFILE_ALLOCATION( (2 * VDim + 1) * MAXSAMPLES * sizeof(double) );
   
   // init sample counter
   this->n = 0;
+  
+  // the arrays are handed over to Matlab in fillReturnStruct() unless made persistent
+  this->persistent = false;
+}
+
+FullTDLambda::~FullTDLambda()
+{
+  // non-persistent arrays are freed by Matlab
+  if( this->persistent ) {
+    mxDestroyArray( this->s0 ); mxDestroyArray( this->s1 ); mxDestroyArray( this->r );
+  }
+}
+
+
+void FullTDLambda::reset()
+{
+  // samples beyond n are never read, so resetting the counter is enough
+  this->n = 0;
+}
+
+
+void FullTDLambda::makePersistent()
+{
+  mexMakeArrayPersistent( this->s0 );
+  mexMakeArrayPersistent( this->s1 );
+  mexMakeArrayPersistent( this->r );
+  this->persistent = true;
 }
 
 
@@ -52,15 +78,50 @@ void FullTDLambda::step( double reward )
 
 void FullTDLambda::fillReturnStruct( mxArray * s )
 {
-  // add s0, s1, r
+  // add s0, s1, r (hand over the arrays, or copy them if they are persistent)
   mxAddField( s, "s0" );
-  mxSetField( s, 0, "s0", this->s0 );
+  mxSetField( s, 0, "s0", this->persistent ? mxDuplicateArray( this->s0 ) : this->s0 );
   mxAddField( s, "s1" );
-  mxSetField( s, 0, "s1", this->s1 );
+  mxSetField( s, 0, "s1", this->persistent ? mxDuplicateArray( this->s1 ) : this->s1 );
   mxAddField( s, "r" );
-  mxSetField( s, 0, "r", this->r );
+  mxSetField( s, 0, "r", this->persistent ? mxDuplicateArray( this->r ) : this->r );
   
   // add sample counter
   mxAddField( s, "n" );
   mxSetField( s, 0, "n", mxCreateDoubleScalar( this->n ) );
 }
+
+
+int FullTDLambda::getBuffers( CriticBuffer (& buffers)[CRITIC_MAXBUFFERS] ) const
+{
+  // the sample arrays are column-major (sample index innermost), so each feature is a row here
+  buffers[0].set( "s0", mxGetPr( this->s0 ), CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, this->VDim, this->n,
+                  MAXSAMPLES );
+  buffers[1].set( "s1", mxGetPr( this->s1 ), CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, this->VDim, this->n,
+                  MAXSAMPLES );
+  buffers[2].set( "r", mxGetPr( this->r ), CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, 1, this->n, MAXSAMPLES );
+  return 3;
+}
+
+
+void FullTDLambda::saveState( StateWriter & w ) const
+{
+  // store only the samples in use
+  w.write( this->n );
+  for( int i = 0; i < this->VDim ; i++ ) {
+    w.write( &mxGetPr( this->s0 )[i * MAXSAMPLES], this->n * sizeof(double) );
+    w.write( &mxGetPr( this->s1 )[i * MAXSAMPLES], this->n * sizeof(double) );
+  }
+  w.write( mxGetPr( this->r ), this->n * sizeof(double) );
+}
+
+void FullTDLambda::loadState( StateReader & r )
+{
+  r.read( this->n );
+  mxAssert( this->n >= 0 && this->n <= MAXSAMPLES, "Invalid sample count in the state blob!" );
+  for( int i = 0; i < this->VDim ; i++ ) {
+    r.read( &mxGetPr( this->s0 )[i * MAXSAMPLES], this->n * sizeof(double) );
+    r.read( &mxGetPr( this->s1 )[i * MAXSAMPLES], this->n * sizeof(double) );
+  }
+  r.read( mxGetPr( this->r ), this->n * sizeof(double) );
+}
@@ -24,10 +24,23 @@ class FullTDLambda :
   // sample counter
   int n;
   
+  // whether the sample arrays are persistent and thus still owned by this object after fillReturnStruct()
+  bool persistent;
+  
   
 public:
   
   FullTDLambda( int VDim, double gamma, double lambda );
+  ~FullTDLambda();
+  
+  // clear the samples
+  virtual void reset();
+  
+  // clear the samples (as in the Matlab implementation, regardless of beta)
+  virtual void forget( double beta ) { reset(); }
+  
+  // make the sample arrays persistent
+  virtual void makePersistent();
   
   // update statistics based on the data in the input registers
   virtual void step( double reward );
@@ -35,6 +48,13 @@ public:
   // copy statistics into the provided return struct
   virtual void fillReturnStruct( mxArray * s );
   
+  // describe the samples s0, s1 (features x samples) and r (without copying)
+  virtual int getBuffers( CriticBuffer (& buffers)[CRITIC_MAXBUFFERS] ) const;
+  
+  // save and restore the accumulated statistics and the eligibility trace
+  virtual void saveState( StateWriter & w ) const;
+  virtual void loadState( StateReader & r );
+  
 };
 
 
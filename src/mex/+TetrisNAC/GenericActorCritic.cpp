@@ -0,0 +1,198 @@
+/* GenericActorCritic.cpp */
+
+
+#include "GenericActorCritic.hpp"
+#include "SoftmaxPolicy.hpp"
+#include "Critic.hpp"
+#include "CriticPipeline.hpp"
+#include "Configuration.hpp"
+#include "../Profiler.hpp"
+
+#include "matrix.h"
+
+#include <cstring>
+using std::memcpy;
+using std::memset;
+
+
+
+
+GenericActorCritic::GenericActorCritic( mxArray * rstream, int criticClass, int petersTrickMode, bool learning,
+                                        int observationDim, int actionDim, int thetaDim, const double * theta,
+                                        double gamma, double lambda, double tau ) :
+  rstream( rstream ),
+  keyed( false ),
+  learning( learning ),
+  observationDim( observationDim ),
+  actionDim( actionDim ),
+  theta( theta ),
+  tau( tau ),
+  rejectTerminalActions( false ),
+  petersTrickMode( (PetersTrickMode)petersTrickMode ),
+  firstStep( true ),
+  action( -1 ),
+  prevAction( -1 ),
+  pipeline( 0 ),
+  critic( 0 )
+{
+  if( thetaDim != actionDim )
+    mexErrMsgIdAndTxt( "GenericActorCritic:invalidTheta",
+                       "GenericActorCritic: theta must have one element per action feature (%d)!", actionDim );
+  if( petersTrickMode != PTM_OFF && petersTrickMode != PTM_ON && petersTrickMode != PTM_CORRECTED )
+    mexErrMsgIdAndTxt( "GenericActorCritic:invalidPetersTrickMode", "GenericActorCritic: Unknown Peters' trick mode!" );
+  if( petersTrickMode == PTM_CORRECTED && criticClass != Critic::CC_LSTD )
+    mexErrMsgIdAndTxt( "GenericActorCritic:invalidPetersTrickMode",
+                       "GenericActorCritic: The corrected Peters' trick is implemented only in LSTDLambda!" );
+  if( criticClass == Critic::CC_LSPE )
+    mexErrMsgIdAndTxt( "GenericActorCritic:invalidCriticClass",
+                       "GenericActorCritic: LSPELambda relies on the Tetris features and is not supported!" );
+  
+  // create the critic
+  this->critic = Critic::create( criticClass, observationDim + actionDim, gamma, lambda );
+  
+  this->critic->setPetersTrickMode( this->petersTrickMode );
+  this->critic->setStateDim( observationDim );
+  
+  // the policy gradient part of phi1 in the critic is always zero with Peters' trick. set the entire phi1 to zero here
+  // and do not touch the gradient part after this.
+  memset( critic->phi1, 0, this->critic->getVDim() * sizeof(double) );
+  
+  this->prevStepData.actionDim = actionDim;
+  this->prevStepData.actionCount = 0;
+}
+
+GenericActorCritic::~GenericActorCritic()
+{
+  // stop the learner thread and delete the critic
+  delete this->pipeline; this->pipeline = 0;
+  delete this->critic; this->critic = 0;
+}
+
+
+void GenericActorCritic::setPipelined( bool pipelined )
+{
+  if( pipelined && !this->pipeline ) {
+    this->pipeline = new CriticPipeline( this->critic, this->observationDim );
+    PROFILE_ALLOCATION( sizeof(CriticPipeline) );
+  } else if( !pipelined && this->pipeline ) {
+    delete this->pipeline; this->pipeline = 0;
+  }
+}
+
+
+void GenericActorCritic::sync()
+{
+  if( this->pipeline ) this->pipeline->sync();
+}
+
+
+void GenericActorCritic::keyStream( unsigned long long seed, unsigned long long episode )
+{
+  this->keyedStream.setKey( seed, episode, PhiloxRandStream::RS_ACTIONS );
+  this->keyed = true;
+}
+
+
+void GenericActorCritic::newEpisode()
+{
+  this->firstStep = true;
+  if( this->pipeline ) this->pipeline->pushNewEpisode();
+  else this->critic->newEpisode();
+}
+
+
+int GenericActorCritic::step( const NativeEnvironment::StepData & stepData )
+{
+  // decide an action for the current step (none in a terminal state)
+  this->action = stepData.actionCount > 0 ? act( stepData ) : -1;
+  
+  // learn?
+  if( this->learning ) {
+    
+    // learn from the previous transition if not the first step
+    if( !this->firstStep ) learn( this->prevStepData, this->prevActionProbabilities, this->prevAction,
+                                  stepData, this->actionProbabilities, this->action );
+    
+    // shift the current state to appear as the previous state
+    this->prevStepData = stepData;
+    this->prevActionProbabilities = this->actionProbabilities;
+    this->prevAction = this->action;
+    
+    // make sure that the episode start flag is down
+    this->firstStep = false;
+    
+  }
+  
+  // return the action
+  return this->action;
+}
+
+
+mxArray * GenericActorCritic::createReturnStruct()
+{
+  sync();
+  
+  mxArray * s = mxCreateStructMatrix( 1, 1, 0, 0 );
+  mxArray * sc = mxCreateStructMatrix( 1, 1, 0, 0 );
+  
+  mxAddField( s, "critic" );
+  mxSetField( s, 0, "critic", sc );
+  
+  critic->fillReturnStruct( sc );
+  
+  return s;
+}
+
+
+
+
+/* private methods */
+
+
+/* Learn. This is not the first step (checked in step()), but it might be the last step. */
+void GenericActorCritic::learn( const NativeEnvironment::StepData & s0, const std::vector<double> & pr0, int a0,
+                                const NativeEnvironment::StepData & s1, const std::vector<double> & pr1, int a1 )
+{
+  PROFILE_SCOPE( PP_LEARN );
+  
+  // fill in the critic input registers, or the next transition in the pipeline
+  CriticPipeline::Transition * transition = this->pipeline ? &this->pipeline->next() : 0;
+  double * phi0 = transition ? transition->phi0 : this->critic->phi0;
+  double * phi1 = transition ? transition->phi1 : this->critic->phi1;
+  
+  // load the state feature parts of phi0 and phi1 (the observation of a terminal state is zero)
+  memcpy( phi0, &s0.observation[0], this->observationDim * sizeof(double) );
+  memcpy( phi1, &s1.observation[0], this->observationDim * sizeof(double) );
+  
+  // load the gradient vector part of phi0
+  SoftmaxPolicy::computeGradient( s0, &pr0[0], a0, &phi0[this->observationDim] );
+  
+  // without Peters' trick, load also the gradient vector part of phi1 (zero in a terminal state)
+  if( this->petersTrickMode == PTM_OFF ) {
+    if( a1 >= 0 ) SoftmaxPolicy::computeGradient( s1, &pr1[0], a1, &phi1[this->observationDim] );
+    else memset( &phi1[this->observationDim], 0, this->actionDim * sizeof(double) );
+  }
+  
+  // step the critic, or hand the transition over to the learner thread
+  if( transition ) {
+    transition->reward = s1.transitionReward;
+    this->pipeline->pushStep();
+  } else {
+    PROFILE_SCOPE( PP_CRITICSTEP );
+    critic->step( s1.transitionReward );
+  }
+}
+
+
+int GenericActorCritic::act( const NativeEnvironment::StepData & s )
+{
+  PROFILE_SCOPE( PP_ACT );
+  
+  RandStream & rng = this->keyed ? (RandStream &)this->keyedStream : (RandStream &)this->rstream;
+  this->actionProbabilities.resize( s.actionCount );
+  if( this->rejectTerminalActions )
+    SoftmaxPolicy::computeActionProbabilities<true>( s, this->theta, this->tau, &this->actionProbabilities[0] );
+  else
+    SoftmaxPolicy::computeActionProbabilities<false>( s, this->theta, this->tau, &this->actionProbabilities[0] );
+  return SoftmaxPolicy::drawAction( &this->actionProbabilities[0], s.actionCount, rng );
+}
@@ -0,0 +1,120 @@
+/* GenericActorCritic.hpp
+ *
+ * The natural actor-critic agent of AgentNaturalActorCritic.m for the native environments of NativeEnvironment.hpp,
+ * whose dimensions are given at runtime. It follows NaturalActorCritic, with the same policy computations (see
+ * SoftmaxPolicy.hpp), critics and pipelined mode, but is not coupled to Tetris: the critic has observationDim +
+ * actionDim features, and theta has actionDim elements.
+ *
+ * As in the Matlab implementation, no action is drawn in a terminal state, so the random numbers are consumed exactly
+ * as by AgentNaturalActorCritic.m. Terminal actions are not rejected by default, as the Matlab implementation does not
+ * know about them (see setRejectTerminalActions()).
+ *
+ * Not supported (unlike in NaturalActorCritic): saving the episode state, transition recording for off-policy
+ * re-evaluation and persistent sessions.
+ */
+#ifndef GENERICACTORCRITIC_HPP
+#define GENERICACTORCRITIC_HPP
+
+
+#include "NativeEnvironment.hpp"
+#include "Critic.hpp"
+#include "CriticPipeline.hpp"
+#include "Configuration.hpp"
+#include "../MatlabRandStream.hpp"
+#include "../PhiloxRandStream.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <vector>
+
+
+
+
+class GenericActorCritic {
+  
+  // random number generators: the Matlab stream, or the counter-based action stream if keyed (see keyStream())
+  MatlabRandStream rstream;
+  PhiloxRandStream keyedStream;
+  bool keyed;
+  
+  // whether learning is enabled
+  bool learning;
+  
+  // dimensions of the observations and of the action features (and theta)
+  int observationDim, actionDim;
+  
+  // params
+  const double * theta;
+  
+  // policy temperature
+  double tau;
+  
+  // whether actions flagged as terminal are never selected
+  bool rejectTerminalActions;
+  
+  // the mode for Peters' trick, fixed at construction
+  PetersTrickMode petersTrickMode;
+  
+  
+  // whether a new episode has just begun
+  bool firstStep;
+  
+  // copy of the StepData for the previous step
+  NativeEnvironment::StepData prevStepData;
+  
+  // action index of the current and the previous step (-1 in a terminal state)
+  int action, prevAction;
+  
+  // normalized action probabilities of the current and the previous step
+  std::vector<double> actionProbabilities, prevActionProbabilities;
+  
+  // the learner thread pipeline in pipelined mode, or null (see CriticPipeline.hpp)
+  CriticPipeline * pipeline;
+  
+  
+  void learn( const NativeEnvironment::StepData & s0, const std::vector<double> & pr0, int a0,
+              const NativeEnvironment::StepData & s1, const std::vector<double> & pr1, int a1 );
+  int act( const NativeEnvironment::StepData & s );
+  
+  
+public:
+  
+  // critic
+  Critic * critic;
+  
+  
+  // petersTrickMode is a PetersTrickMode (PTM_CORRECTED requires CC_LSTD). theta must have actionDim elements.
+  GenericActorCritic( mxArray * rstream, int criticClass, int petersTrickMode, bool learning, int observationDim,
+                      int actionDim, int thetaDim, const double * theta, double gamma, double lambda, double tau );
+  
+  ~GenericActorCritic();
+  
+  // set whether actions flagged as terminal are never selected (false by default)
+  void setRejectTerminalActions( bool reject ) { this->rejectTerminalActions = reject; }
+  
+  // enable or disable pipelined critic updates in a learner thread. the results are identical in both modes.
+  void setPipelined( bool pipelined );
+  
+  // wait for pending critic updates. in pipelined mode, this must be called before accessing the critic directly.
+  void sync();
+  
+  // draw the actions from the counter-based stream of the given experiment seed and episode index, instead of the
+  // Matlab stream
+  void keyStream( unsigned long long seed, unsigned long long episode );
+  
+  // begin a new episode
+  void newEpisode();
+  
+  // take a step and return the index of the selected action, or -1 in a terminal state
+  int step( const NativeEnvironment::StepData & stepData );
+  
+  // creates the return struct
+  mxArray * createReturnStruct();
+  
+};
+
+
+
+
+#endif
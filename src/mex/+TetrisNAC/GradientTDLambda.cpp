@@ -0,0 +1,150 @@
+/* GradientTDLambda.cpp */
+
+
+#include "GradientTDLambda.hpp"
+
+#include "mex.h"
+
+#include <cstring>
+using std::memcpy;
+using std::memset;
+
+
+
+
+GradientTDLambda::GradientTDLambda( int VDim, double gamma, double lambda, bool tdc ) :
+  Critic( VDim, gamma, lambda ),
+  tdc( tdc ),
+  alpha( GRADIENTTD_ALPHA ),
+  alphaH( GRADIENTTD_ALPHAH )
+{
+  // allocate and clear the params
+  const size_t vectorSize = AlignedBuffer::padded( VDim );
+  this->storage.allocate( 3 * vectorSize );
+  this->w = this->storage.get();
+  this->h = this->w + vectorSize;
+  this->e = this->h + vectorSize;
+}
+
+
+void GradientTDLambda::configure( const mxArray * s )
+{
+  const int n = this->VDim;
+  const mxArray * alpha = mxGetField(s, 0, "alpha");
+  const mxArray * alphaH = mxGetField(s, 0, "alphaH");
+  const mxArray * w = mxGetField(s, 0, "w");
+  const mxArray * h = mxGetField(s, 0, "h");
+  if( (w && !mxIsEmpty( w ) && (int)mxGetNumberOfElements( w ) != n) ||
+      (h && !mxIsEmpty( h ) && (int)mxGetNumberOfElements( h ) != n) )
+    mexErrMsgIdAndTxt( "GradientTDLambda:invalidDimension",
+                       "GradientTDLambda: w and h must have %d elements!", n );
+  
+  if( alpha && !mxIsEmpty( alpha ) ) this->alpha = mxGetScalar( alpha );
+  if( alphaH && !mxIsEmpty( alphaH ) ) this->alphaH = mxGetScalar( alphaH );
+  if( w && !mxIsEmpty( w ) ) memcpy( this->w, mxGetPr( w ), n * sizeof(double) );
+  if( h && !mxIsEmpty( h ) ) memcpy( this->h, mxGetPr( h ), n * sizeof(double) );
+}
+
+
+void GradientTDLambda::newEpisode()
+{
+  memset( this->e, 0, this->VDim * sizeof(double) );
+}
+
+
+void GradientTDLambda::reset()
+{
+  memset( this->w, 0, this->VDim * sizeof(double) );
+  memset( this->h, 0, this->VDim * sizeof(double) );
+  memset( this->e, 0, this->VDim * sizeof(double) );
+}
+
+
+void GradientTDLambda::solve( const SolverOptions & options, double * V, double & cnd )
+{
+  for( int i = 0 ; i < this->VDim ; i++ )
+    V[i] = options.featureMask[i] ? this->w[i] : 0.0;
+  cnd = mxGetNaN();
+}
+
+
+void GradientTDLambda::step( double r )
+{
+  const int n = this->VDim;
+  const double gamma = this->gamma;
+  const double * phi0 = this->phi0;
+  const double * phi1 = this->phi1;
+  double * w = this->w;
+  double * h = this->h;
+  double * e = this->e;
+  
+  // the TD error with the current w, and the trace
+  double v0 = 0.0, v1 = 0.0;
+  for( int i = 0 ; i < n ; i++ ) {
+    v0 += w[i] * phi0[i];
+    v1 += w[i] * phi1[i];
+    e[i] = gamma * this->lambda * e[i] + phi0[i];
+  }
+  const double delta = r + gamma * v1 - v0;
+  
+  // the projections of the trace and phi0 on the current h
+  double eh = 0.0, ph = 0.0;
+  for( int i = 0 ; i < n ; i++ ) {
+    eh += e[i] * h[i];
+    ph += phi0[i] * h[i];
+  }
+  
+  // update w and h
+  const double a = this->alpha, aH = this->alphaH;
+  if( this->tdc ) {
+    const double c = gamma * (1.0 - this->lambda) * eh;
+    for( int i = 0 ; i < n ; i++ )
+      w[i] += a * (delta * e[i] - c * phi1[i]);
+  } else {
+    for( int i = 0 ; i < n ; i++ )
+      w[i] += a * eh * (phi0[i] - gamma * phi1[i]);
+  }
+  for( int i = 0 ; i < n ; i++ )
+    h[i] += aH * (delta * e[i] - ph * phi0[i]);
+}
+
+
+void GradientTDLambda::fillReturnStruct( mxArray * s )
+{
+  const int n = this->VDim;
+  mxArray * V = mxCreateDoubleMatrix( n, 1, mxREAL );
+  mxArray * h = mxCreateDoubleMatrix( n, 1, mxREAL );
+  memcpy( mxGetPr(V), this->w, n * sizeof(double) );
+  memcpy( mxGetPr(h), this->h, n * sizeof(double) );
+  mxAddField( s, "V" );
+  mxSetField( s, 0, "V", V );
+  mxAddField( s, "h" );
+  mxSetField( s, 0, "h", h );
+}
+
+
+int GradientTDLambda::getBuffers( CriticBuffer (& buffers)[CRITIC_MAXBUFFERS] ) const
+{
+  const int n = this->VDim;
+  buffers[0].set( "w", this->w, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, n, 1, 1 );
+  buffers[1].set( "h", this->h, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, n, 1, 1 );
+  buffers[2].set( "e", this->e, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, n, 1, 1 );
+  return 3;
+}
+
+
+void GradientTDLambda::saveState( StateWriter & w ) const
+{
+  const int n = this->VDim;
+  w.write( this->w, n * sizeof(double) );
+  w.write( this->h, n * sizeof(double) );
+  w.write( this->e, n * sizeof(double) );
+}
+
+void GradientTDLambda::loadState( StateReader & r )
+{
+  const int n = this->VDim;
+  r.read( this->w, n * sizeof(double) );
+  r.read( this->h, n * sizeof(double) );
+  r.read( this->e, n * sizeof(double) );
+}
@@ -0,0 +1,95 @@
+/* GradientTDLambda.hpp
+ *
+ * The gradient temporal difference critics GTD2(lambda) and TDC(lambda) (Sutton et al., 2009; Maei, 2011), which
+ * learn the critic parameters by stochastic gradient descent on the projected Bellman error instead of accumulating
+ * least squares statistics. Each step costs O(VDim) time and the critic holds O(VDim) memory:
+ *
+ *   delta = r + gamma w'phi1 - w'phi0
+ *   e     = gamma lambda e + phi0
+ *   GTD2:  w += alpha (e'h) (phi0 - gamma phi1)
+ *   TDC:   w += alpha (delta e - gamma (1 - lambda) (e'h) phi1)
+ *   h     += alphaH (delta e - (h'phi0) phi0)
+ *
+ * where w are the critic parameters (whose advantage part is the natural gradient, as with the other critics) and h
+ * the auxiliary weights. The parameters are the state of the critic rather than statistics: solve() just returns w,
+ * and forget() leaves them as they are, as the estimate of the previous policy is a good starting point for the next
+ * one. The step sizes and the initial w and h are set with configure(); the defaults are GRADIENTTD_ALPHA,
+ * GRADIENTTD_ALPHAH and zeros. The estimate depends on the order of the steps, so the critic cannot be split over
+ * episodes run in parallel and joined.
+ *
+ *   References
+ *
+ *     Sutton, Maei, Precup, Bhatnagar, Silver, Szepesvari & Wiewiora (2009). Fast gradient-descent methods for
+ *     temporal-difference learning with linear function approximation.
+ *
+ *     Maei (2011). Gradient temporal-difference learning algorithms. PhD thesis.
+ */
+#ifndef GRADIENTTDLAMBDA_HPP
+#define GRADIENTTDLAMBDA_HPP
+
+
+#include "Critic.hpp"
+
+
+// default step sizes of w and h
+#define GRADIENTTD_ALPHA 1e-3
+#define GRADIENTTD_ALPHAH 1e-3
+
+
+
+
+class GradientTDLambda :
+  public Critic
+{
+  
+  // TDC instead of GTD2
+  bool tdc;
+  
+  // step sizes of w and h
+  double alpha, alphaH;
+  
+  // params: w, h and the eligibility trace e, in a single aligned allocation
+  AlignedBuffer storage;
+  double * w;
+  double * h;
+  double * e;
+  
+  
+public:
+  
+  GradientTDLambda( int VDim, double gamma, double lambda, bool tdc );
+  
+  // set the step sizes and the initial parameters from the optional fields alpha, alphaH, w and h of s
+  virtual void configure( const mxArray * s );
+  
+  // clear the eligibility trace
+  virtual void newEpisode();
+  
+  // clear w, h and the eligibility trace
+  virtual void reset();
+  
+  // keep the parameters (see above)
+  virtual void forget( double beta ) {}
+  
+  // return w with the masked features zeroed. the condition number is NaN.
+  virtual void solve( const SolverOptions & options, double * V, double & cnd );
+  
+  // update w, h and the eligibility trace
+  virtual void step( double r );
+  
+  // return w as V, and h
+  virtual void fillReturnStruct( mxArray * s );
+  
+  // describe w, h and e (without copying)
+  virtual int getBuffers( CriticBuffer (& buffers)[CRITIC_MAXBUFFERS] ) const;
+  
+  // save and restore the parameters and the eligibility trace
+  virtual void saveState( StateWriter & w ) const;
+  virtual void loadState( StateReader & r );
+  
+};
+
+
+
+
+#endif
@@ -0,0 +1,139 @@
+/* GraphEnvironment.cpp */
+
+
+#include "GraphEnvironment.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+
+
+
+// the number of observations (columns of O) and of actions (elements of Q per state), checked before construction
+static int observationCount( const mxArray * environmentData )
+{
+  const mxArray * O = mxGetField(environmentData, 0, "O");
+  if( !O || !mxIsDouble( O ) || mxIsEmpty( O ) )
+    mexErrMsgIdAndTxt( "GraphEnvironment:invalidData", "GraphEnvironment: O must be a nonempty double matrix!" );
+  return (int)mxGetN( O );
+}
+
+static int actionCount( const mxArray * environmentData )
+{
+  const mxArray * O = mxGetField(environmentData, 0, "O");
+  const mxArray * Q = mxGetField(environmentData, 0, "Q");
+  if( !O || !Q || !mxIsDouble( Q ) || mxIsEmpty( Q ) || mxGetNumberOfElements( Q ) % mxGetM( O ) )
+    mexErrMsgIdAndTxt( "GraphEnvironment:invalidData", "GraphEnvironment: Q must have sCount x aCount elements!" );
+  return (int)(mxGetNumberOfElements( Q ) / mxGetM( O ));
+}
+
+
+
+
+GraphEnvironment::GraphEnvironment( const mxArray * environmentData ) :
+  NativeEnvironment( mxGetField(environmentData, 0, "rstream"), observationCount( environmentData ),
+                     observationCount( environmentData ) * actionCount( environmentData ),
+                     actionCount( environmentData ) ),
+  state( 0 ),
+  ended( false )
+{
+  this->sCount = (int)mxGetM( mxGetField(environmentData, 0, "O") );
+  this->aCount = actionCount( environmentData );
+  this->oCount = observationCount( environmentData );
+  const int S = this->sCount, A = this->aCount;
+  
+  const double * P = getArray( environmentData, "P", (size_t)S * A * S );
+  const double * Q = getArray( environmentData, "Q", (size_t)S * A );
+  const double * x0 = getArray( environmentData, "x0", S );
+  const double * term = getArray( environmentData, "term", S );
+  const double * O = getArray( environmentData, "O", (size_t)S * this->oCount );
+  const double * saCounts = getArray( environmentData, "saCounts", S );
+  
+  // transpose the Matlab arrays into row-major form, so that each drawn distribution is contiguous
+  this->transitions.resize( (size_t)S * A * S );
+  this->rewards.resize( (size_t)S * A );
+  this->terminalActions.assign( (size_t)S * A, 0 );
+  for( int s = 0 ; s < S ; s++ ) {
+    for( int a = 0 ; a < A ; a++ ) {
+      bool terminal = true;
+      for( int s1 = 0 ; s1 < S ; s1++ ) {
+        double p = P[s + a * S + (size_t)s1 * S * A];
+        this->transitions[((size_t)s * A + a) * S + s1] = p;
+        if( p > 0.0 && term[s1] < 1.0 ) terminal = false;
+      }
+      this->rewards[s * A + a] = Q[s + a * S];
+      this->terminalActions[s * A + a] = terminal;
+    }
+  }
+  this->x0.assign( x0, x0 + S );
+  this->term.assign( term, term + S );
+  this->observations.resize( (size_t)S * this->oCount );
+  for( int s = 0 ; s < S ; s++ )
+    for( int o = 0 ; o < this->oCount ; o++ )
+      this->observations[(size_t)s * this->oCount + o] = O[s + (size_t)o * S];
+  this->actionCounts.resize( S );
+  for( int s = 0 ; s < S ; s++ ) {
+    this->actionCounts[s] = (int)saCounts[s];
+    if( this->actionCounts[s] < 1 || this->actionCounts[s] > A )
+      mexErrMsgIdAndTxt( "GraphEnvironment:invalidData", "GraphEnvironment: saCounts must be in [1, aCount]!" );
+  }
+  
+  this->svd.assign( S, 0.0 );
+  this->chain.assign( (size_t)S * S, 0.0 );
+}
+
+
+void GraphEnvironment::fillReturnStruct( mxArray * s )
+{
+  const int S = this->sCount;
+  
+  mxArray * svd = mxCreateDoubleMatrix( 1, S, mxREAL );
+  for( int i = 0 ; i < S ; i++ ) mxGetPr( svd )[i] = this->svd[i];
+  mxAddField( s, "svd" );
+  mxSetField( s, 0, "svd", svd );
+  
+  mxArray * chain = mxCreateDoubleMatrix( S, S, mxREAL );
+  for( size_t i = 0 ; i < (size_t)S * S ; i++ ) mxGetPr( chain )[i] = this->chain[i];
+  mxAddField( s, "chain" );
+  mxSetField( s, 0, "chain", chain );
+}
+
+
+
+
+/* private methods */
+
+
+void GraphEnvironment::resetState()
+{
+  this->state = randDiscretePdf( &this->x0[0], this->sCount );
+  this->ended = false;
+}
+
+
+double GraphEnvironment::advanceState( int action )
+{
+  const int S = this->sCount, A = this->aCount;
+  int state0 = this->state;
+  
+  // add the old state to svd
+  this->svd[state0] += 1.0;
+  
+  // generate reward, advance state, check if ended
+  double reward = this->rewards[state0 * A + action];
+  this->state = randDiscretePdf( &this->transitions[((size_t)state0 * A + action) * S], S );
+  this->ended = rand() < this->term[this->state];
+  
+  // add the transition to chain
+  this->chain[state0 + (size_t)this->state * S] += 1.0;
+  
+  return reward;
+}
+
+
+void GraphEnvironment::generateStepData()
+{
+  int observation = randDiscretePdf( &this->observations[(size_t)this->state * this->oCount], this->oCount );
+  generateTabularStepData( observation, this->actionCounts[this->state],
+                           &this->terminalActions[(size_t)this->state * this->aCount] );
+}
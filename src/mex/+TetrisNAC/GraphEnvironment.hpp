@@ -0,0 +1,73 @@
+/* GraphEnvironment.hpp
+ *
+ * The generic discrete graph environment of GraphGeneric.m (and of its subclasses, which only fill in the graph). The
+ * observation is a one-hot vector of oCount elements, and the actions are tabular (see
+ * NativeEnvironment::generateTabularStepData()). The random numbers are drawn in the same order as in the Matlab
+ * implementation (the start state and the first observation, then for each step the next state, the terminal
+ * condition and, unless terminal, the observation), so the episodes are identical to those of GraphGeneric.m for the
+ * same stream.
+ *
+ * environmentData contains the fields of GraphGeneric.mexFork(): P (sCount x aCount x sCount), Q (sCount x aCount),
+ * x0 and term (sCount elements), O (sCount x oCount) and saCounts (sCount elements). An action is flagged as terminal
+ * if all of its possible next states are certainly terminal. The state visitation counts and the transition counts are
+ * returned in the fields svd (1 x sCount) and chain (sCount x sCount).
+ */
+#ifndef GRAPHENVIRONMENT_HPP
+#define GRAPHENVIRONMENT_HPP
+
+
+#include "NativeEnvironment.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <vector>
+
+
+
+
+class GraphEnvironment :
+  public NativeEnvironment
+{
+  
+  // state, action and observation counts
+  int sCount, aCount, oCount;
+  
+  // the graph, row-major: transition probabilities (s, a) -> s1, rewards (s, a), start and terminal state
+  // probabilities, observation probabilities (s, o), the numbers of actions of the states and the terminal actions
+  std::vector<double> transitions;
+  std::vector<double> rewards;
+  std::vector<double> x0;
+  std::vector<double> term;
+  std::vector<double> observations;
+  std::vector<int> actionCounts;
+  std::vector<char> terminalActions;
+  
+  // current state (0-based) and whether the episode has ended
+  int state;
+  bool ended;
+  
+  // state visitation counts and transition counts (column-major, as returned)
+  std::vector<double> svd;
+  std::vector<double> chain;
+  
+  // implementations of NativeEnvironment
+  virtual void resetState();
+  virtual double advanceState( int action );
+  virtual bool checkEndCondition() { return this->ended; }
+  virtual void generateStepData();
+  
+  
+public:
+  
+  GraphEnvironment( const mxArray * environmentData );
+  
+  // add svd and chain to the return struct
+  virtual void fillReturnStruct( mxArray * s );
+  
+};
+
+
+
+
+#endif
@@ -0,0 +1,106 @@
+/* GridEnvironment.cpp */
+
+
+#include "GridEnvironment.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <cmath>
+using std::erfc;
+using std::sqrt;
+
+#include <algorithm>
+using std::max;
+using std::min;
+
+
+
+
+// the number of cells, checked before construction
+static int cellCount( const mxArray * environmentData )
+{
+  const mxArray * gridSize = mxGetField(environmentData, 0, "gridSize");
+  if( !gridSize || !mxIsDouble( gridSize ) || mxGetNumberOfElements( gridSize ) != 2 ||
+      mxGetPr( gridSize )[0] < 2 || mxGetPr( gridSize )[1] < 1 )
+    mexErrMsgIdAndTxt( "GridEnvironment:invalidData",
+                       "GridEnvironment: gridSize must be [sizeX, sizeY] with sizeX >= 2 and sizeY >= 1!" );
+  return (int)mxGetPr( gridSize )[0] * (int)mxGetPr( gridSize )[1];
+}
+
+// the standard normal cumulative distribution function
+static double normcdf( double z )
+{
+  return 0.5 * erfc( -z / sqrt( 2.0 ) );
+}
+
+
+
+
+GridEnvironment::GridEnvironment( const mxArray * environmentData ) :
+  NativeEnvironment( mxGetField(environmentData, 0, "rstream"), cellCount( environmentData ),
+                     3 * cellCount( environmentData ), 3 ),
+  x( 0 ),
+  y( 0 )
+{
+  this->sizeX = (int)mxGetPr( mxGetField(environmentData, 0, "gridSize") )[0];
+  this->sizeY = (int)mxGetPr( mxGetField(environmentData, 0, "gridSize") )[1];
+  const int cells = this->sizeX * this->sizeY;
+  
+  const double * rewards = getArray( environmentData, "rewards", cells );
+  this->rewards.assign( rewards, rewards + cells );
+  
+  // start row y with probability p( y <= sizeY/2 + sizeY/4 * z < y + 1 ), z ~ N(0,1) (normalized when drawn)
+  const double mean = this->sizeY / 2.0, stddev = this->sizeY / 4.0;
+  this->startRows.resize( this->sizeY );
+  for( int row = 0 ; row < this->sizeY ; row++ )
+    this->startRows[row] = normcdf( (row + 1 - mean) / stddev ) - normcdf( (row - mean) / stddev );
+  
+  this->svd.assign( cells, 0.0 );
+}
+
+
+void GridEnvironment::fillReturnStruct( mxArray * s )
+{
+  mxArray * svd = mxCreateDoubleMatrix( this->sizeX, this->sizeY, mxREAL );
+  for( int i = 0 ; i < this->sizeX * this->sizeY ; i++ ) mxGetPr( svd )[i] = this->svd[i];
+  mxAddField( s, "svd" );
+  mxSetField( s, 0, "svd", svd );
+}
+
+
+
+
+/* private methods */
+
+
+void GridEnvironment::resetState()
+{
+  this->x = 0;
+  this->y = randDiscretePdf( &this->startRows[0], this->sizeY );
+}
+
+
+double GridEnvironment::advanceState( int action )
+{
+  // add the old state to svd
+  this->svd[this->x + this->y * this->sizeX] += 1.0;
+  
+  // the reward of the cell
+  double reward = this->rewards[this->x + this->y * this->sizeX];
+  
+  // move right, and possibly up or down, preventing top or bottom edge overruns
+  this->x++;
+  this->y = max( 0, min( this->sizeY - 1, this->y + action - 1 ) );
+  
+  return reward;
+}
+
+
+void GridEnvironment::generateStepData()
+{
+  // all actions from the rightmost column end the episode
+  const char terminal = this->x == this->sizeX - 1;
+  const char terminalActions[3] = { terminal, terminal, terminal };
+  generateTabularStepData( this->y * this->sizeX + this->x, 3, terminalActions );
+}
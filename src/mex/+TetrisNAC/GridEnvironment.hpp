@@ -0,0 +1,69 @@
+/* GridEnvironment.hpp
+ *
+ * The basic episodic grid world of GridEpisodicBasic.m: the agent starts from the leftmost column, moves one column to
+ * the right on each step and optionally one row down (action 0) or up (action 2), and the episode ends after the
+ * rightmost column. The reward of a step is that of the cell the step starts from. The observation is a one-hot vector
+ * of sizeX * sizeY elements, and the actions are tabular (see NativeEnvironment::generateTabularStepData()); in the
+ * rightmost column, all actions are flagged as terminal.
+ *
+ * environmentData contains the fields of GridEpisodicBasic.mexFork(): gridSize ([sizeX, sizeY]) and rewards (sizeX x
+ * sizeY). The state visitation counts are returned in the field svd (sizeX x sizeY).
+ *
+ * NOTE: The start row is drawn with a single uniform random number from the distribution of the Matlab
+ * implementation (the normal distribution with mean sizeY/2 and standard deviation sizeY/4, rounded down and truncated
+ * to the grid), which draws it from randn() instead. The episodes thus follow the same distribution, but are not
+ * identical to those of GridEpisodicBasic.m for the same stream.
+ */
+#ifndef GRIDENVIRONMENT_HPP
+#define GRIDENVIRONMENT_HPP
+
+
+#include "NativeEnvironment.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <vector>
+
+
+
+
+class GridEnvironment :
+  public NativeEnvironment
+{
+  
+  // grid size
+  int sizeX, sizeY;
+  
+  // immediate rewards of the cells: rewards[x + y * sizeX]
+  std::vector<double> rewards;
+  
+  // distribution of the start row
+  std::vector<double> startRows;
+  
+  // current position
+  int x, y;
+  
+  // state visitation counts: svd[x + y * sizeX]
+  std::vector<double> svd;
+  
+  // implementations of NativeEnvironment
+  virtual void resetState();
+  virtual double advanceState( int action );
+  virtual bool checkEndCondition() { return this->x >= this->sizeX; }
+  virtual void generateStepData();
+  
+  
+public:
+  
+  GridEnvironment( const mxArray * environmentData );
+  
+  // add svd to the return struct
+  virtual void fillReturnStruct( mxArray * s );
+  
+};
+
+
+
+
+#endif
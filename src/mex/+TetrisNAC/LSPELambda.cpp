@@ -2,6 +2,7 @@
 
 
 #include "LSPELambda.hpp"
+#include "Solver.hpp"
 
 #include "mex.h"
 
@@ -18,19 +19,82 @@ LSPELambda::LSPELambda( int VDim, double gamma, double lambda ) :
   mxAssert( VDim == VDIM, "VDim must match the hard-coded value VDIM!" );
   
   // init params
-  memset( this->B, 0, sizeof(this->B) );
+  memset( this->Bss, 0, sizeof(this->Bss) );
+  memset( this->Bsa, 0, sizeof(this->Bsa) );
+  memset( this->Baa, 0, sizeof(this->Baa) );
   memset( this->A, 0, sizeof(this->A) );
   memset( this->b, 0, sizeof(this->b) );
   memset( this->z, 0, sizeof(this->z) );
+  this->carry = false;
+  this->nonIntegral = false;
 }
 
 
-void LSPELambda::step( double r )
+void LSPELambda::newEpisode()
 {
-  // update B
-  for( int i = 0 ; i < this->VDim ; i++ )
+  memset( this->z, 0, sizeof(this->z) );
+}
+
+
+void LSPELambda::reset()
+{
+  memset( this->Bss, 0, sizeof(this->Bss) );
+  memset( this->Bsa, 0, sizeof(this->Bsa) );
+  memset( this->Baa, 0, sizeof(this->Baa) );
+  memset( this->A, 0, sizeof(this->A) );
+  memset( this->b, 0, sizeof(this->b) );
+  this->carry = false;
+  this->nonIntegral = false;
+}
+
+
+void LSPELambda::forget( double beta )
+{
+  // scaling would break the exact integer accumulation of B, so move B into the carry matrix
+  if( beta != 0.0 ) {
+    double B[VDIM][VDIM];   // includes the previous carry
+    expandB( B );
+    for( int i = 0 ; i < this->VDim ; i++ )
+      for( int j = 0 ; j < this->VDim ; j++ )
+        this->Bcarry[i][j] = beta * B[i][j];
+  }
+  this->carry = beta != 0.0;
+  memset( this->Bss, 0, sizeof(this->Bss) );
+  memset( this->Bsa, 0, sizeof(this->Bsa) );
+  memset( this->Baa, 0, sizeof(this->Baa) );
+  
+  for( int i = 0 ; i < this->VDim ; i++ ) {
     for( int j = 0 ; j < this->VDim ; j++ )
-      this->B[i][j] += this->phi0[i] * this->phi0[j];
+      this->A[i][j] *= beta;
+    this->b[i] *= beta;
+  }
+}
+
+
+void LSPELambda::step( double r )
+{
+  // update B: state x state block (upper triangle, exact)
+  long long phi0s[STATEDIM];
+  for( int i = 0 ; i < STATEDIM ; i++ ) {
+    phi0s[i] = (long long)this->phi0[i];
+    if( phi0s[i] != this->phi0[i] ) this->nonIntegral = true;
+  }
+  long long * Bss = this->Bss;
+  for( int i = 0 ; i < STATEDIM ; i++ )
+    for( int j = i ; j < STATEDIM ; j++ )
+      *Bss++ += phi0s[i] * phi0s[j];
+  
+  // update B: state x advantage block
+  const double * phi0a = &this->phi0[STATEDIM];
+  for( int i = 0 ; i < STATEDIM ; i++ )
+    for( int j = 0 ; j < ADIM ; j++ )
+      this->Bsa[i][j] += this->phi0[i] * phi0a[j];
+  
+  // update B: advantage x advantage block (upper triangle)
+  double * Baa = this->Baa;
+  for( int i = 0 ; i < ADIM ; i++ )
+    for( int j = i ; j < ADIM ; j++ )
+      *Baa++ += phi0a[i] * phi0a[j];
   
   // update z
   for( int i = 0 ; i < this->VDim ; i++ )
@@ -50,14 +114,76 @@ void LSPELambda::step( double r )
 }
 
 
+void LSPELambda::expandB( double (& B)[VDIM][VDIM] ) const
+{
+  const long long * Bss = this->Bss;
+  for( int row = 0 ; row < STATEDIM ; row++ )
+    for( int col = row ; col < STATEDIM ; col++, Bss++ )
+      B[row][col] = B[col][row] = (double)*Bss;
+  for( int row = 0 ; row < STATEDIM ; row++ )
+    for( int col = 0 ; col < ADIM ; col++ )
+      B[row][STATEDIM + col] = B[STATEDIM + col][row] = this->Bsa[row][col];
+  const double * Baa = this->Baa;
+  for( int row = 0 ; row < ADIM ; row++ )
+    for( int col = row ; col < ADIM ; col++, Baa++ )
+      B[STATEDIM + row][STATEDIM + col] = B[STATEDIM + col][STATEDIM + row] = *Baa;
+  
+  if( this->carry )
+    for( int row = 0 ; row < VDIM ; row++ )
+      for( int col = 0 ; col < VDIM ; col++ )
+        B[row][col] += this->Bcarry[row][col];
+}
+
+
+void LSPELambda::checkIntegral() const
+{
+  if( this->nonIntegral )
+    mexErrMsgIdAndTxt( "LSPELambda:nonIntegralFeatures", "LSPELambda: the state features must be integral!" );
+}
+
+
+void LSPELambda::solve( const SolverOptions & options, double * V, double & cnd )
+{
+  checkIntegral();
+  
+  // extract the masked system
+  double B[VDIM][VDIM];
+  expandB( B );
+  double Bm[VDIM * VDIM], Am[VDIM * VDIM], bm[VDIM], Vm[VDIM], rm[VDIM], delta[VDIM];
+  int nm = Solver::extract( VDIM, &B[0][0], options.featureMask, options.Ifactor, Bm );
+  Solver::extract( VDIM, &this->A[0][0], options.featureMask, 0.0, Am );
+  for( int i = 0, k = 0 ; i < VDIM ; i++ )
+    if( options.featureMask[i] ) { bm[k] = this->b[i]; Vm[k] = options.w[i]; k++; }
+  
+  // iterate V = V + stepsize * B^-1 (A V + b), starting from w
+  for( int iteration = 0 ; iteration < options.iterations ; iteration++ ) {
+    for( int i = 0 ; i < nm ; i++ ) {
+      rm[i] = bm[i];
+      for( int j = 0 ; j < nm ; j++ ) rm[i] += Am[i * nm + j] * Vm[j];
+    }
+    Solver::solve( options.method, nm, Bm, rm, delta, options.regularization );
+    for( int i = 0 ; i < nm ; i++ ) Vm[i] += options.stepsize * delta[i];
+  }
+  cnd = Solver::cond( nm, Bm );
+  
+  // undo the mask (features outside the mask keep their value in w)
+  for( int i = 0, k = 0 ; i < VDIM ; i++ )
+    V[i] = options.featureMask[i] ? Vm[k++] : options.w[i];
+}
+
+
 void LSPELambda::fillReturnStruct( mxArray * s )
 {
-  // add B
+  checkIntegral();
+  
+  // add B (expand the blocks into a full symmetric matrix)
+  double Bfull[VDIM][VDIM];
+  expandB( Bfull );
   mxArray * B = mxCreateDoubleMatrix( VDIM, VDIM, mxREAL );
   double * BData = mxGetPr(B);
   for( int row = 0 ; row < VDIM ; row++ )
     for( int col = 0 ; col < VDIM ; col++ )
-      BData[col * VDIM + row] = this->B[row][col];   // shuffle from row-major (C) to column-major (Matlab)
+      BData[col * VDIM + row] = Bfull[row][col];   // shuffle from row-major (C) to column-major (Matlab)
   mxAddField( s, "B" );
   mxSetField( s, 0, "B", B );
   
@@ -77,3 +203,46 @@ void LSPELambda::fillReturnStruct( mxArray * s )
   mxAddField( s, "b" );
   mxSetField( s, 0, "b", b );
 }
+
+
+int LSPELambda::getBuffers( CriticBuffer (& buffers)[CRITIC_MAXBUFFERS] ) const
+{
+  checkIntegral();
+  
+  buffers[0].set( "A", this->A, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, VDIM, VDIM, VDIM );
+  buffers[1].set( "b", this->b, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, VDIM, 1, 1 );
+  buffers[2].set( "Bss", this->Bss, CriticBuffer::BT_INT64, CriticBuffer::BL_PACKEDUPPER,
+                  STATEDIM, STATEDIM, STATEDIM );
+  buffers[3].set( "Bsa", this->Bsa, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, STATEDIM, ADIM, ADIM );
+  buffers[4].set( "Baa", this->Baa, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_PACKEDUPPER, ADIM, ADIM, ADIM );
+  if( !this->carry ) return 5;
+  buffers[5].set( "Bcarry", this->Bcarry, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, VDIM, VDIM, VDIM );
+  return 6;
+}
+
+
+void LSPELambda::saveState( StateWriter & w ) const
+{
+  w.write( this->Bss );
+  w.write( this->Bsa );
+  w.write( this->Baa );
+  w.write( this->carry );
+  if( this->carry ) w.write( this->Bcarry );
+  w.write( this->nonIntegral );
+  w.write( this->A );
+  w.write( this->b );
+  w.write( this->z );
+}
+
+void LSPELambda::loadState( StateReader & r )
+{
+  r.read( this->Bss );
+  r.read( this->Bsa );
+  r.read( this->Baa );
+  r.read( this->carry );
+  if( this->carry ) r.read( this->Bcarry );
+  r.read( this->nonIntegral );
+  r.read( this->A );
+  r.read( this->b );
+  r.read( this->z );
+}
@@ -1,9 +1,22 @@
-/* LSPELambda.hpp */
+/* LSPELambda.hpp
+ *
+ * B is symmetric, so only its upper triangle is accumulated, in packed row-major form. The state part of phi0 consists
+ * of small integers (column heights, height differences, holes and the bias), so the state x state block of B is
+ * accumulated exactly in 64-bit integers. The blocks involving the advantage part are accumulated in doubles. B is
+ * expanded into a full matrix only in fillReturnStruct().
+ *
+ * The block structure relies on the Tetris state features, so this critic supports only the dimension VDIM.
+ */
 #ifndef LSPELAMBDA_HPP
 #define LSPELAMBDA_HPP
 
 
 #include "Critic.hpp"
+#include "Tetris.hpp"
+
+
+// dimension of the advantage part of the critic features
+#define ADIM (VDIM - STATEDIM)
 
 
 
@@ -12,23 +25,60 @@ class LSPELambda :
   public Critic
 {
   
-  // params
-  double B[VDIM][VDIM];
+  // params. B is split into blocks: state x state (packed upper triangle, exact), state x advantage (full) and
+  // advantage x advantage (packed upper triangle).
+  long long Bss[STATEDIM * (STATEDIM + 1) / 2];
+  double Bsa[STATEDIM][ADIM];
+  double Baa[ADIM * (ADIM + 1) / 2];
+  
+  // forgotten (scaled) statistics of B from previous actor iterations, used only if carry is set (see forget())
+  double Bcarry[VDIM][VDIM];
+  bool carry;
   double A[VDIM][VDIM];
   double b[VDIM];
   double z[VDIM];
   
   
+  // set by step() if a state feature was not integral, which breaks the exact accumulation of Bss. step() may run in
+  // the learner thread of CriticPipeline and cannot raise the error, so the statistics are rejected by checkIntegral().
+  bool nonIntegral;
+  
+  // expand B into a full matrix
+  void expandB( double (& B)[VDIM][VDIM] ) const;
+  
+  // raise an error if nonIntegral is set
+  void checkIntegral() const;
+  
+  
 public:
   
   LSPELambda( int VDim, double gamma, double lambda );
   
+  // clear the eligibility trace
+  virtual void newEpisode();
+  
+  // clear the accumulated statistics
+  virtual void reset();
+  
+  // scale the accumulated statistics
+  virtual void forget( double beta );
+  
+  // solve V
+  virtual void solve( const SolverOptions & options, double * V, double & cnd );
+  
   // update statistics based on the data in the input registers
   virtual void step( double r );
   
   // copy statistics into the provided return struct
   virtual void fillReturnStruct( mxArray * s );
   
+  // describe A and b, and the blocks of B (without copying; B = Bss + Bsa + Baa + Bcarry)
+  virtual int getBuffers( CriticBuffer (& buffers)[CRITIC_MAXBUFFERS] ) const;
+  
+  // save and restore the accumulated statistics and the eligibility trace
+  virtual void saveState( StateWriter & w ) const;
+  virtual void loadState( StateReader & r );
+  
 };
 
 
@@ -4,74 +4,197 @@
 #include "LSTDLambda.hpp"
 #include "Tetris.hpp"
 #include "Configuration.hpp"
+#include "Solver.hpp"
 
 #include "mex.h"
 
 #include <cstring>
+using std::memcpy;
 using std::memset;
 
+#include <vector>
 
 
 
-LSTDLambda::LSTDLambda( int VDim, double gamma, double lambda ) :
+
+template<int Dim>
+LSTDLambda<Dim>::LSTDLambda( int VDim, double gamma, double lambda ) :
   Critic( VDim, gamma, lambda )
 {
-  // check board size
-  mxAssert( VDim == VDIM, "VDim must match the hard-coded value VDIM!" );
+  // check the dimension
+  mxAssert( Dim == 0 || VDim == Dim, "VDim must match the dimension of the specialization!" );
   
-  // init params
-  memset( this->A, 0, sizeof(this->A) );
-  memset( this->b, 0, sizeof(this->b) );
-  memset( this->z, 0, sizeof(this->z) );
+  // allocate and clear the params
+  const int n = dim();
+  const size_t vectorSize = AlignedBuffer::padded( n );
+  this->storage.allocate( AlignedBuffer::padded( n * n ) + 4 * vectorSize );
+  this->A = this->storage.get();
+  this->b = this->A + AlignedBuffer::padded( n * n );
+  this->z = this->b + vectorSize;
+  this->z0 = this->z + vectorSize;
+  this->tmp = this->z0 + vectorSize;
+}
+
+
+template<int Dim>
+void LSTDLambda<Dim>::newEpisode()
+{
+  memset( this->z, 0, dim() * sizeof(double) );
+}
+
+
+template<int Dim>
+void LSTDLambda<Dim>::reset()
+{
+  memset( this->A, 0, dim() * dim() * sizeof(double) );
+  memset( this->b, 0, dim() * sizeof(double) );
+}
+
+
+template<int Dim>
+void LSTDLambda<Dim>::forget( double beta )
+{
+  // the Ifactor * I term is not included in A here, so plain scaling is enough
+  const int n = dim();
+  for( int i = 0 ; i < n ; i++ ) {
+    for( int j = 0 ; j < n ; j++ )
+      this->A[i * n + j] *= beta;
+    this->b[i] *= beta;
+  }
+}
+
+
+template<int Dim>
+void LSTDLambda<Dim>::step( double r )
+{
+  // the on-policy update is the special case rho = 1 (the results are identical, as multiplying by 1 is exact)
+  stepWeighted( r, 1.0 );
 }
 
 
-void LSTDLambda::step( double r )
+template<int Dim>
+void LSTDLambda<Dim>::stepWeighted( double r, double rho )
 {
+  if( this->petersTrickMode == PTM_CORRECTED ) update<true>( r, rho );
+  else update<false>( r, rho );
+}
+
+
+template<int Dim>
+template<bool PetersTrickCorrected>
+void LSTDLambda<Dim>::update( double r, double rho )
+{
+  const int n = dim();
+  
   // store old z if needed
-  double z0[VDIM];
-  if( PETERS_TRICK_MODE == PTM_CORRECTED ) memcpy( &z0, &this->z, sizeof(z0) );
+  if( PetersTrickCorrected ) memcpy( this->z0, this->z, n * sizeof(double) );
   
   // update z
-  for( int i = 0 ; i < this->VDim ; i++ )
-    this->z[i] = this->gamma * this->lambda * this->z[i] + phi0[i];
-  
-  // update A
-  double tmp[VDIM];
-  for( int i = 0 ; i < this->VDim ; i++ )
-    tmp[i] = phi0[i] - this->gamma * phi1[i];
-  for( int i = 0 ; i < this->VDim ; i++ )
-    for( int j = 0 ; j < this->VDim ; j++ )
-      this->A[i][j] += this->z[i] * tmp[j];
+  for( int i = 0 ; i < n ; i++ )
+    this->z[i] = this->gamma * this->lambda * rho * this->z[i] + phi0[i];
   
-  // if the corrected version of Peters' trick is in use, then substract the correction term from A
-  if( PETERS_TRICK_MODE == PTM_CORRECTED ) {
-    for( int i = 0 ; i < this->VDim ; i++ )   // loop over z
-      for( int j = STATEDIM ; j < this->VDim ; j++ )   // loop over advantage part of phi
-        this->A[i][j] -= this->gamma * this->lambda * z0[i] * phi0[j];
+  // update A: add z * (phi0 - gamma phi1)', and if the corrected version of Peters' trick is in use, then substract
+  // the correction term over the advantage part of phi. Each element is updated in the same order as in two separate
+  // passes, so blocking does not change the results.
+  for( int i = 0 ; i < n ; i++ )
+    this->tmp[i] = phi0[i] - this->gamma * phi1[i];
+  const int blockSize = Dim > 0 ? Dim : LSTD_BLOCKSIZE;
+  for( int j0 = 0 ; j0 < n ; j0 += blockSize ) {
+    const int j1 = j0 + blockSize < n ? j0 + blockSize : n;
+    const int jc = j0 > this->stateDim ? j0 : this->stateDim;   // first advantage column of the block
+    for( int i = 0 ; i < n ; i++ ) {
+      double * Ai = &this->A[i * n];
+      const double zi = this->z[i];
+      for( int j = j0 ; j < j1 ; j++ )
+        Ai[j] += zi * this->tmp[j];
+      if( PetersTrickCorrected ) {
+        const double c = this->gamma * this->lambda * rho * this->z0[i];
+        for( int j = jc ; j < j1 ; j++ )
+          Ai[j] -= c * phi0[j];
+      }
+    }
   }
   
   // update b
-  for( int i = 0 ; i < this->VDim ; i++ )
+  for( int i = 0 ; i < n ; i++ )
     this->b[i] += this->z[i] * r;
 }
 
 
-void LSTDLambda::fillReturnStruct( mxArray * s )
+template<int Dim>
+void LSTDLambda<Dim>::fillReturnStruct( mxArray * s )
 {
+  const int n = dim();
+  
   // add A
-  mxArray * A = mxCreateDoubleMatrix( VDIM, VDIM, mxREAL );
+  mxArray * A = mxCreateDoubleMatrix( n, n, mxREAL );
   double * AData = mxGetPr(A);
-  for( int row = 0 ; row < VDIM ; row++ )
-    for( int col = 0 ; col < VDIM ; col++ )
-      AData[col * VDIM + row] = this->A[row][col];   // shuffle from row-major (C) to column-major (Matlab)
+  for( int row = 0 ; row < n ; row++ )
+    for( int col = 0 ; col < n ; col++ )
+      AData[col * n + row] = this->A[row * n + col];   // shuffle from row-major (C) to column-major (Matlab)
   mxAddField( s, "A" );
   mxSetField( s, 0, "A", A );
   
   // add b
-  mxArray * b = mxCreateDoubleMatrix( VDIM, 1, mxREAL );
-  double * bData = mxGetPr(b);
-  memcpy( mxGetPr(b), this->b, sizeof(this->b) );
+  mxArray * b = mxCreateDoubleMatrix( n, 1, mxREAL );
+  memcpy( mxGetPr(b), this->b, n * sizeof(double) );
   mxAddField( s, "b" );
   mxSetField( s, 0, "b", b );
 }
+
+
+template<int Dim>
+int LSTDLambda<Dim>::getBuffers( CriticBuffer (& buffers)[CRITIC_MAXBUFFERS] ) const
+{
+  const int n = dim();
+  buffers[0].set( "A", this->A, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, n, n, n );
+  buffers[1].set( "b", this->b, CriticBuffer::BT_DOUBLE, CriticBuffer::BL_DENSE, n, 1, 1 );
+  return 2;
+}
+
+
+template<int Dim>
+void LSTDLambda<Dim>::solve( const SolverOptions & options, double * V, double & cnd )
+{
+  const int n = dim();
+  
+  // extract the masked system
+  std::vector<double> Am( n * n ), bm( n ), Vm( n );
+  int nm = Solver::extract( n, this->A, options.featureMask, options.Ifactor, &Am[0] );
+  for( int i = 0, k = 0 ; i < n ; i++ )
+    if( options.featureMask[i] ) bm[k++] = this->b[i];
+  
+  // solve A V = b
+  Solver::solve( options.method, nm, &Am[0], &bm[0], &Vm[0], options.regularization );
+  cnd = Solver::cond( nm, &Am[0] );
+  
+  // undo the mask
+  for( int i = 0, k = 0 ; i < n ; i++ )
+    V[i] = options.featureMask[i] ? Vm[k++] : 0.0;
+}
+
+
+template<int Dim>
+void LSTDLambda<Dim>::saveState( StateWriter & w ) const
+{
+  const int n = dim();
+  w.write( this->A, n * n * sizeof(double) );
+  w.write( this->b, n * sizeof(double) );
+  w.write( this->z, n * sizeof(double) );
+}
+
+template<int Dim>
+void LSTDLambda<Dim>::loadState( StateReader & r )
+{
+  const int n = dim();
+  r.read( this->A, n * n * sizeof(double) );
+  r.read( this->b, n * sizeof(double) );
+  r.read( this->z, n * sizeof(double) );
+}
+
+
+
+
+// the instantiations: the Tetris features, and the dynamic-size fallback
+template class LSTDLambda<VDIM>;
+template class LSTDLambda<0>;
@@ -1,4 +1,12 @@
-/* LSTDLambda.hpp */
+/* LSTDLambda.hpp
+ *
+ * The critic is a template on the feature dimension. LSTDLambda<Dim> with Dim > 0 has the dimension as a compile-time
+ * constant, so that the loops have constant trip counts and are unrolled and vectorized by the compiler; the common
+ * sizes are instantiated in LSTDLambda.cpp and selected by Critic::create(). LSTDLambda<0> is the fallback for any
+ * other dimension (given at runtime, up to SOLVER_MAXDIM). Its rank-one updates of A are blocked by columns, so
+ * that the touched part of the feature vectors stays in the L1 cache while the rows of A stream through. Both variants
+ * keep the statistics in aligned heap storage and produce identical results.
+ */
 #ifndef LSTDLAMBDA_HPP
 #define LSTDLAMBDA_HPP
 
@@ -6,28 +14,64 @@
 #include "Critic.hpp"
 
 
+// column block size of the rank-one updates in the dynamic-size critic (in doubles)
+#define LSTD_BLOCKSIZE 256
 
 
+
+
+template<int Dim>
 class LSTDLambda :
   public Critic
 {
   
-  // params
-  double A[VDIM][VDIM];
-  double b[VDIM];
-  double z[VDIM];
+  // params: A (row-major), b and z, and the work vectors of update(), in a single aligned allocation
+  AlignedBuffer storage;
+  double * A;
+  double * b;
+  double * z;
+  double * z0;
+  double * tmp;
+  
+  // the dimension, as a compile-time constant if possible
+  int dim() const { return Dim > 0 ? Dim : this->VDim; }
+  
+  // the update, compiled separately for the corrected version of Peters' trick
+  template<bool PetersTrickCorrected> void update( double r, double rho );
   
   
 public:
   
   LSTDLambda( int VDim, double gamma, double lambda );
   
+  // clear the eligibility trace
+  virtual void newEpisode();
+  
+  // clear the accumulated statistics
+  virtual void reset();
+  
+  // scale the accumulated statistics
+  virtual void forget( double beta );
+  
+  // solve V
+  virtual void solve( const SolverOptions & options, double * V, double & cnd );
+  
   // update statistics based on the data in the input registers
   virtual void step( double r );
   
+  // off-policy update
+  virtual void stepWeighted( double r, double rho );
+  
   // copy statistics into the provided return struct
   virtual void fillReturnStruct( mxArray * s );
   
+  // describe A and b (row-major, without copying)
+  virtual int getBuffers( CriticBuffer (& buffers)[CRITIC_MAXBUFFERS] ) const;
+  
+  // save and restore the accumulated statistics and the eligibility trace
+  virtual void saveState( StateWriter & w ) const;
+  virtual void loadState( StateReader & r );
+  
 };
 
 
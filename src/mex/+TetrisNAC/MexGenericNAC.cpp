@@ -0,0 +1,133 @@
+/* MexGenericNAC.cpp
+ *
+ *   [environmentDataOut, agentDataOut] = MexGenericNAC( environmentDataIn, agentDataIn, stopConds )
+ *
+ * Runs a single episode of the natural actor-critic agent (AgentNaturalActorCritic) in one of the native environments
+ * of NativeEnvironment.hpp, selected by environmentDataIn.type: 'graph' (GraphGeneric and its subclasses) or 'grid'
+ * (GridEpisodicBasic). This is the counterpart of the plain call of MexTetrisNAC for environments whose feature and
+ * action counts are known only at runtime; see RunEpisodeMex for the dispatch.
+ *
+ * agentDataIn has the fields of AgentNaturalActorCritic.mexFork(): criticClass, learning, theta (actionDim x 1), gamma,
+ * lambda and tau, and optionally petersTrickMode, rejectTerminalActions (default false, unlike in MexTetrisNAC),
+ * pipelined and criticSettings (for the gradient-TD critics, as in MexTetrisNAC). The critic has observationDim +
+ * actionDim features, so the LSPE critic, whose statistics rely on the Tetris features, is rejected with an error.
+ * environmentDataOut has the fields return, observationLog (always empty) and the statistics of the environment (see
+ * GraphEnvironment.hpp and GridEnvironment.hpp), and agentDataOut.critic holds the critic statistics, as in
+ * MexTetrisNAC.
+ *
+ * Counter-based random streams: If environmentDataIn contains the field 'rngSeed', then the episode draws from its own
+ * counter-based streams of rngSeed and rngEpisode, as in MexTetrisNAC.
+ *
+ * The graph episodes are identical to those of the Matlab implementation for the same streams (up to rounding in the
+ * critic statistics). In the grid, the start row is drawn differently (see GridEnvironment.hpp). Chunked episodes,
+ * sessions, observation logging and transition reuse are not supported.
+ */
+
+
+#include "NativeEnvironment.hpp"
+#include "GenericActorCritic.hpp"
+#include "Configuration.hpp"
+#include "../Profiler.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <memory>
+
+
+
+
+// read an optional scalar field, or return defaultValue if the field is missing or empty
+static double getOptionalScalar( const mxArray * s, const char * name, double defaultValue )
+{
+  const mxArray * field = mxGetField(s, 0, name);
+  return field && !mxIsEmpty( field ) ? mxGetScalar( field ) : defaultValue;
+}
+
+
+static std::unique_ptr<GenericActorCritic> newAgent( const mxArray * agentData, const NativeEnvironment & environment )
+{
+  // create and init the agent
+  std::unique_ptr<GenericActorCritic> agent(
+    new GenericActorCritic( mxGetField(agentData, 0, "rstream"),
+                            (int)(mxGetScalar( mxGetField(agentData, 0, "criticClass") )),
+                            (int)getOptionalScalar( agentData, "petersTrickMode", PETERS_TRICK_MODE ),
+                            mxGetScalar( mxGetField(agentData, 0, "learning") ),
+                            environment.getObservationDim(), environment.getActionDim(),
+                            mxGetNumberOfElements( mxGetField(agentData, 0, "theta") ),
+                            mxGetPr( mxGetField(agentData, 0, "theta") ),
+                            mxGetScalar( mxGetField(agentData, 0, "gamma") ),
+                            mxGetScalar( mxGetField(agentData, 0, "lambda") ),
+                            mxGetScalar( mxGetField(agentData, 0, "tau") ) ) );
+  const mxArray * criticSettings = mxGetField(agentData, 0, "criticSettings");
+  if( criticSettings && !mxIsEmpty( criticSettings ) ) agent->critic->configure( criticSettings );
+  agent->setRejectTerminalActions( getOptionalScalar( agentData, "rejectTerminalActions", false ) );
+  agent->setPipelined( getOptionalScalar( agentData, "pipelined", false ) );
+  return agent;
+}
+
+
+static void runEpisode( NativeEnvironment & environment, GenericActorCritic & agent, const mxArray * stopConds )
+{
+  // parse stopConds
+  double scMaxSteps = mxGetScalar( mxGetField(stopConds, 0, "maxSteps") );
+  double scTotalRewardMin = mxGetPr( mxGetField(stopConds, 0, "totalRewardRange") )[0];
+  double scTotalRewardMax = mxGetPr( mxGetField(stopConds, 0, "totalRewardRange") )[1];
+  
+  environment.newEpisode();
+  agent.newEpisode();
+  
+  // main loop
+  double totalReward = 0.0, stepCounter = 0;
+  while( !environment.terminalState &&
+         totalReward >= scTotalRewardMin && totalReward <= scTotalRewardMax &&
+         stepCounter < scMaxSteps ) {
+    totalReward += environment.step( agent.step( environment.stepData ) );
+    stepCounter++;
+  }
+  agent.step( environment.stepData );   // step in terminal state for learning purposes
+  
+  // the critic is accessed directly after this
+  agent.sync();
+}
+
+
+
+
+void mexFunction(
+    int nlhs, mxArray * plhs[],
+    int nrhs, const mxArray * prhs[])
+{
+  // clear profiling counters from previous calls
+  PROFILE_RESET();
+  
+  if( nrhs != 3 || mxIsChar( prhs[0] ) )
+    mexErrMsgIdAndTxt( "MexGenericNAC:notSupported",
+                       "MexGenericNAC: only single unchunked episodes are supported (no sessions or chunks)!" );
+  mxAssert( nlhs == 2, "Wrong number of arguments!" );
+  const mxArray * environmentData = prhs[0];
+  const mxArray * agentData = prhs[1];
+  const mxArray * stopConds = prhs[2];
+  if( getOptionalScalar( agentData, "transitionCapacity", 0 ) > 0 )
+    mexErrMsgIdAndTxt( "MexGenericNAC:notSupported", "MexGenericNAC: transition reuse is not supported!" );
+  
+  // create and init the environment and the agent
+  std::unique_ptr<NativeEnvironment> environment( NativeEnvironment::create( environmentData ) );
+  std::unique_ptr<GenericActorCritic> agent = newAgent( agentData, *environment );
+  
+  // counter-based streams
+  const mxArray * rngSeed = mxGetField(environmentData, 0, "rngSeed");
+  if( rngSeed && !mxIsEmpty( rngSeed ) ) {
+    unsigned long long seed = (unsigned long long)mxGetScalar( rngSeed );
+    unsigned long long episode = (unsigned long long)getOptionalScalar( environmentData, "rngEpisode", 0 );
+    environment->keyStream( seed, episode );
+    agent->keyStream( seed, episode );
+  }
+  
+  // run
+  runEpisode( *environment, *agent, stopConds );
+  
+  // create and assign return structs, then return
+  plhs[0] = environment->createReturnStruct();
+  plhs[1] = agent->createReturnStruct();
+}
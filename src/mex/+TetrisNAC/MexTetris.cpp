@@ -0,0 +1,235 @@
+/* MexTetris.cpp
+ *
+ *   handle = MexTetris( 'create', environmentDataIn )
+ *   [observation, actions, state] = MexTetris( 'reset', handle, environmentDataIn )
+ *   [reward, observation, actions, state] = MexTetris( 'step', handle, environmentDataIn, action )
+ *   [rewards, observation, actions, state] = MexTetris( 'stepBatch', handle, environmentDataIn, actions )
+ *   MexTetris( 'destroy', handle )
+ *
+ * The native Tetris engine as a standalone environment, for agents that are not implemented natively (see
+ * TetrisNative.m). The environment is kept alive across calls in persistent memory, and is referred to by the handle
+ * returned by 'create'. All environments are destroyed when the mex file is cleared, which invalidates any remaining
+ * handles ('destroy' ignores invalid handles). environmentDataIn has the fields of TetrisStandardFeatures.mexFork();
+ * the action cache size is fixed by 'create', while the random stream and the feature settings are taken from the
+ * arguments on each call.
+ *
+ * 'reset' starts a new episode and 'step' takes a step with the given action, which is a (1-based) row index to the
+ * actions matrix of the previous call, as in Environment.step(). observation is the 1 x STATEDIM feature vector of the
+ * new state, or empty if the episode ended, actions is the actionCount x STATEACTIONDIM matrix of the action features
+ * (empty if the episode ended) and state is the vectorial state (see Tetris::getVectorialState()). The features are
+ * those of MexTetrisNAC, and thus differ slightly from those of TetrisStandardFeatures.m.
+ *
+ * 'stepBatch' takes a step with each of the given actions in turn, each indexing the actions matrix of the state
+ * reached by the previous one, and returns the rewards of the steps taken as a column vector, along with the outputs
+ * of 'step' for the last state. If the episode ends before the actions run out, then the remaining actions are
+ * ignored and rewards is shorter than actions. This saves the call overhead when the action sequence is known in
+ * advance.
+ *
+ * Random streams: Each call draws from the Matlab stream of environmentDataIn.rstream, discarding any numbers left
+ * in the buffer at the end of the call (see MatlabRandStream.hpp). If environmentDataIn contains the field 'rngSeed',
+ * then 'reset' keys the pieces of the episode to the counter-based stream of rngSeed and rngEpisode instead, as in
+ * MexTetrisNAC, and the stream is kept until the next 'reset'. This is considerably faster when taking single steps.
+ */
+
+
+#include "Tetris.hpp"
+#include "Configuration.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <cstring>
+using std::memcpy;
+using std::strcmp;
+
+
+// maximum number of concurrent environments
+#define MAXENVIRONMENTS 64
+
+
+
+
+// environment slots (a handle is the slot index plus one)
+static Tetris * environments[MAXENVIRONMENTS];
+
+// whether the current episode of an environment slot draws from the counter-based stream
+static bool keyedEpisodes[MAXENVIRONMENTS];
+
+
+// mexAtExit() callback
+static void destroyAllEnvironments()
+{
+  for( int slot = 0 ; slot < MAXENVIRONMENTS ; slot++ ) {
+    delete environments[slot]; environments[slot] = 0;
+  }
+}
+
+// return the slot of a handle, or -1 if the handle is not valid
+static int findSlot( const mxArray * handle )
+{
+  if( !mxIsDouble( handle ) || mxGetNumberOfElements( handle ) != 1 ) return -1;
+  double h = mxGetScalar( handle );
+  if( h < 1 || h > MAXENVIRONMENTS || h != (int)h || !environments[(int)h - 1] ) return -1;
+  return (int)h - 1;
+}
+
+static int getSlot( const mxArray * handle )
+{
+  int slot = findSlot( handle );
+  if( slot < 0 ) mexErrMsgIdAndTxt( "MexTetris:invalidHandle", "MexTetris: invalid environment handle!" );
+  return slot;
+}
+
+
+// read an optional scalar field, or return defaultValue if the field is missing or empty
+static double getOptionalScalar( const mxArray * s, const char * name, double defaultValue )
+{
+  const mxArray * field = mxGetField(s, 0, name);
+  return field && !mxIsEmpty( field ) ? mxGetScalar( field ) : defaultValue;
+}
+
+// attach to the random stream of the call and apply the feature settings, which may change between calls
+static void attach( int slot, const mxArray * environmentData )
+{
+  Tetris & environment = *environments[slot];
+  if( !keyedEpisodes[slot] ) environment.attach( mxGetField(environmentData, 0, "rstream") );
+  environment.configure( (int)getOptionalScalar( environmentData, "holeDefinition", HOLEDEFINITION ),
+                         getOptionalScalar( environmentData, "terminalBiasValueS", TERMINAL_BIAS_VALUE_S ),
+                         getOptionalScalar( environmentData, "terminalBiasValueA", TERMINAL_BIAS_VALUE_A ) );
+}
+
+
+// create the observation, actions and state outputs of the current state into plhs[0..nlhs)
+static void createStateOutputs( const Tetris & environment, int nlhs, mxArray * plhs[] )
+{
+  const Tetris::StepData & s = environment.stepData;
+  bool ended = environment.terminalState;
+  
+  if( nlhs >= 1 ) {
+    plhs[0] = mxCreateDoubleMatrix( ended ? 0 : 1, ended ? 0 : STATEDIM, mxREAL );
+    if( !ended ) memcpy( mxGetPr( plhs[0] ), s.observation, STATEDIM * sizeof(double) );
+  }
+  
+  if( nlhs >= 2 ) {
+    // transpose into a column-major matrix with a row for each action
+    plhs[1] = mxCreateDoubleMatrix( s.actionCount, ended ? 0 : STATEACTIONDIM, mxREAL );
+    double * actions = mxGetPr( plhs[1] );
+    for( int a = 0 ; a < s.actionCount ; a++ )
+      for( int i = 0 ; i < STATEACTIONDIM ; i++ )
+        actions[a + i * s.actionCount] = s.actions[a][i];
+  }
+  
+  if( nlhs >= 3 ) {
+    plhs[2] = mxCreateDoubleMatrix( ended ? 0 : 1, ended ? 0 : ROWS * COLUMNS + 1, mxREAL );
+    if( !ended ) environment.getVectorialState( mxGetPr( plhs[2] ) );
+  }
+}
+
+
+// take a step with a 1-based action index and return the reward
+static double step( Tetris & environment, double action )
+{
+  if( environment.terminalState )
+    mexErrMsgIdAndTxt( "MexTetris:noEpisode", "MexTetris: no episode is running!" );
+  if( action < 1 || action > environment.stepData.actionCount || action != (int)action )
+    mexErrMsgIdAndTxt( "MexTetris:invalidAction", "MexTetris: the action must be an index in [1, %d]!",
+                       environment.stepData.actionCount );
+  return environment.step( (int)action - 1 );
+}
+
+
+
+
+void mexFunction(
+    int nlhs, mxArray * plhs[],
+    int nrhs, const mxArray * prhs[])
+{
+  char command[16];
+  if( nrhs < 2 || !mxIsChar( prhs[0] ) || mxGetString( prhs[0], command, sizeof(command) ) )
+    mexErrMsgIdAndTxt( "MexTetris:invalidCommand", "MexTetris: the first argument must be a command!" );
+  
+  if( !strcmp( command, "create" ) ) {
+    
+    mxAssert( nlhs <= 1 && nrhs == 2, "Wrong number of arguments!" );
+    
+    // find a free slot
+    int slot = 0;
+    while( slot < MAXENVIRONMENTS && environments[slot] ) slot++;
+    if( slot == MAXENVIRONMENTS )
+      mexErrMsgIdAndTxt( "MexTetris:tooManyEnvironments", "MexTetris: too many environments!" );
+    
+    // create the environment. it ends up in the terminal state until the first reset.
+    Tetris * environment = new Tetris( 20, 10, mxGetField(prhs[1], 0, "rstream"),
+                                       (int)getOptionalScalar( prhs[1], "actionCacheSize", 0 ) );
+    environment->setLogging( false, "" );
+    environment->terminalState = true;
+    environments[slot] = environment;
+    keyedEpisodes[slot] = false;
+    mexAtExit( destroyAllEnvironments );
+    
+    plhs[0] = mxCreateDoubleScalar( slot + 1 );
+    
+  } else if( !strcmp( command, "reset" ) ) {
+    
+    mxAssert( nlhs <= 3 && nrhs == 3, "Wrong number of arguments!" );
+    int slot = getSlot( prhs[1] );
+    Tetris & environment = *environments[slot];
+    
+    // the previous episode might have been keyed: attach to the Matlab stream in any case, then key the new episode
+    keyedEpisodes[slot] = false;
+    attach( slot, prhs[2] );
+    const mxArray * rngSeed = mxGetField(prhs[2], 0, "rngSeed");
+    if( rngSeed && !mxIsEmpty( rngSeed ) ) {
+      environment.keyStream( (unsigned long long)mxGetScalar( rngSeed ),
+                             (unsigned long long)getOptionalScalar( prhs[2], "rngEpisode", 0 ) );
+      keyedEpisodes[slot] = true;
+    }
+    
+    environment.newEpisode();
+    createStateOutputs( environment, nlhs, plhs );
+    
+  } else if( !strcmp( command, "step" ) ) {
+    
+    mxAssert( nlhs <= 4 && nrhs == 4, "Wrong number of arguments!" );
+    int slot = getSlot( prhs[1] );
+    attach( slot, prhs[2] );
+    
+    double reward = step( *environments[slot], mxGetScalar( prhs[3] ) );
+    
+    plhs[0] = mxCreateDoubleScalar( reward );
+    createStateOutputs( *environments[slot], nlhs - 1, plhs + 1 );
+    
+  } else if( !strcmp( command, "stepBatch" ) ) {
+    
+    mxAssert( nlhs <= 4 && nrhs == 4, "Wrong number of arguments!" );
+    int slot = getSlot( prhs[1] );
+    attach( slot, prhs[2] );
+    Tetris & environment = *environments[slot];
+    
+    if( !mxIsDouble( prhs[3] ) )
+      mexErrMsgIdAndTxt( "MexTetris:invalidAction", "MexTetris: the actions must be a double array!" );
+    const double * actions = mxGetPr( prhs[3] );
+    int actionCount = (int)mxGetNumberOfElements( prhs[3] );
+    
+    // step until the actions run out or the episode ends
+    mxArray * rewards = mxCreateDoubleMatrix( actionCount, 1, mxREAL );
+    int steps = 0;
+    while( steps < actionCount && (steps == 0 || !environment.terminalState) ) {
+      mxGetPr( rewards )[steps] = step( environment, actions[steps] );
+      steps++;
+    }
+    mxSetM( rewards, steps );
+    
+    plhs[0] = rewards;
+    createStateOutputs( environment, nlhs - 1, plhs + 1 );
+    
+  } else if( !strcmp( command, "destroy" ) ) {
+    
+    mxAssert( nlhs == 0 && nrhs == 2, "Wrong number of arguments!" );
+    int slot = findSlot( prhs[1] );
+    if( slot >= 0 ) { delete environments[slot]; environments[slot] = 0; }
+    
+  } else {
+    mexErrMsgIdAndTxt( "MexTetris:invalidCommand", "MexTetris: unknown command '%s'!", command );
+  }
+}
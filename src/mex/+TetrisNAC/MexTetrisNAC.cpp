@@ -1,11 +1,196 @@
 /* MexTetrisNAC.cpp
  *
  *   [environmentDataOut, agentDataOut] = MexTetrisNAC( environmentDataIn, agentDataIn, stopConds )
+ *   [environmentDataOut, agentDataOut, episodeStateOut] = MexTetrisNAC( environmentDataIn, agentDataIn, stopConds,
+ *                                                                      episodeStateIn )
  *
  * This implementation runs only for a single episode, which is assumed in the Matlab implementation
  * AgentNaturalActorCritic (in mexJoin). We could, in principle, run several episodes, as long as we do not cross the
  * time instant when the actor or the critic is to be updated.
  *
+ * Chunked episodes: If stopConds contains the field 'chunkSteps', then at most that many steps are taken during this
+ * call. If the episode is still running after that, then the complete episode state (board, falling piece, previous
+ * step data, action probabilities, critic statistics and traces, random stream positions and the stopping condition
+ * counters) is returned in episodeStateOut as an opaque uint8 array, which can be passed back in as episodeStateIn to
+ * continue the episode. episodeStateOut is empty once the episode has ended. The other stopping conditions apply to
+ * the whole episode, not to the chunk. The critic statistics in agentDataOut are cumulative over the whole episode,
+ * so they should be joined only after the final chunk (see RunEpisodeMex). A chunked episode produces exactly the
+ * same results as an unchunked one, as long as the same rstream objects are passed in on each call. The state blob is
+ * valid only for the same build of this mex file. episodeStateOut must be requested whenever chunkSteps is set (also by
+ * 'run'), and 'train' and 'farmWork' do not support chunked episodes.
+ *
+ * Sessions: The environment, the agent and the critic can be kept alive across calls in persistent memory, which
+ * avoids constructing them (and allocating and zeroing the critic statistics) on every episode:
+ *
+ *   session = MexTetrisNAC( 'create', environmentDataIn, agentDataIn )
+ *   [environmentDataOut, episodeStateOut] = MexTetrisNAC( 'run', session, environmentDataIn, agentDataIn, stopConds,
+ *                                                         episodeStateIn )
+ *   agentDataOut = MexTetrisNAC( 'query', session )
+ *   MexTetrisNAC( 'reset', session )
+ *   solution = MexTetrisNAC( 'solve', session, solverOptions )
+ *   MexTetrisNAC( 'forget', session, beta )
+ *   result = MexTetrisNAC( 'reevaluate', session, theta, tau, truncation )
+ *   [trainingLog, environmentDataOut] = MexTetrisNAC( 'train', session, environmentDataIn, agentDataIn, stopConds,
+ *                                                     trainingOptions )
+ *   MexTetrisNAC( 'destroy', session )
+ *
+ * 'run' runs an episode (or a chunk of it) like the plain call above, but accumulates the critic statistics in the
+ * session instead of returning them. The random streams, theta, learning and tau are taken from the arguments on each
+ * run; the critic class, gamma, lambda and actionCacheSize are fixed when the session is created. The action cache
+ * (actionCacheSize entries of about 0.6 kB each; see ActionCache.hpp) is used only by sessions, which keep it across
+ * episodes; the plain call and 'farmWork' ignore actionCacheSize. 'query' returns the statistics accumulated since
+ * creation or the previous 'reset', and 'reset' clears them. 'destroy' ignores unknown handles. All sessions are
+ * destroyed when the mex file is cleared, which invalidates any remaining handles.
+ *
+ * 'solve' solves the critic parameters from the statistics held in the session (see Solver.hpp) and returns a struct
+ * with the fields V (the critic parameters; the advantage part is the natural gradient) and cond (the condition number
+ * of the main matrix). solverOptions has the fields method (a batchMethod name), I, regularization, featureMask (or
+ * []) and, for LSPE, w, iterations and stepsize; see Critic.getSolverOptions(). A singular system raises an error
+ * rather than returning NaN values, except with 'pinv'. 'forget' scales the statistics held in the session by beta
+ * after an actor update. Together these allow keeping the critic statistics entirely in the session.
+ *
+ * Transition reuse: If agentDataIn contains a positive field 'transitionCapacity', then the session records the
+ * transitions of its learning episodes (at most that many steps; see TransitionStore.hpp). 'reevaluate' adds the
+ * transitions recorded before the latest 'forget' (that is, by earlier policies) to the critic statistics, re-evaluated
+ * under the policy (theta, tau) with per-decision importance weights truncated to at most truncation (Inf for none),
+ * and returns a struct with the fields transitions and meanWeight. The transitions are re-evaluated into the
+ * statistics on every call, so forgetting should then be complete (beta = 0). Requires the LSTD critic.
+ *
+ * 'train' runs the whole policy improvement loop natively, as ImprovePolicy with EvaluatePolicy and the 'mexSolve' mode
+ * of AgentNaturalActorCritic would: for each iteration, run the evaluation episodes, solve the critic, update theta
+ * (starting from agentDataIn.theta) and forget critic statistics. Each episode starts with fresh random stream buffers,
+ * just as separate mex calls would. trainingOptions has the fields iterations, episodes, stepsize (scalar or [c, d] for
+ * the schedule c / (t + d)), actorIteration (t of the first iteration), beta, thetaC, QInterpretation ('gradient' or
+ * 'target'), criticBeta, solver (solverOptions as above) and optionally reuseTruncation (if positive, the recorded
+ * transitions of earlier iterations are re-evaluated with this truncation before each solve, as 'reevaluate' does). The
+ * returned log has the fields theta (thetaDim x iterations, after each update), returns (episodes x iterations),
+ * gradientNorm and cond (1 x iterations), w (the last critic solution, which is also the next LSPE iterate) and
+ * actorIteration (after the last iteration). environmentDataOut is returned for the last episode.
+ *
+ * Batch evaluation: The policy can be evaluated without learning in a batch of boards that are stepped in lockstep
+ * (see TetrisBatch.hpp):
+ *
+ *   returns = MexTetrisNAC( 'evaluate', environmentDataIn, agentDataIn, stopConds, episodes, lanes )
+ *
+ * runs episodes episodes in lanes (at most 64) lanes, starting a new episode in a lane whenever one ends, and returns
+ * the returns as an episodes x 1 array in the order in which the episodes were started. stopConds apply to each
+ * episode. The results depend on the number of lanes (but not otherwise on scheduling), as the pieces of all lanes
+ * are drawn from the environment's random stream in lane order, unless the streams are keyed (see below).
+ *
+ * Reference equivalence: An optimized engine can be checked against the reference engine (Tetris without the action
+ * cache and sequential critic updates) with
+ *
+ *   report = MexTetrisNAC( 'compare', environmentDataIn, agentDataIn, stopConds, episodes, engine, tolerance )
+ *
+ * which runs both engines side by side on the same counter-based streams (keyed as for the plain call, or by seed 0 if
+ * rngSeed is not set) and compares the pieces, the step data, the selected actions and the critic statistics of each
+ * episode, bit-for-bit if tolerance is 0 (see EngineComparison.hpp). engine is 'actionCache' (the action cache, of
+ * size actionCacheSize or 4096), 'pipeline' (the learner thread) or 'batch' (lane 0 of TetrisBatch, learning
+ * disabled). The report has the fields episodes, steps, pieceMismatches, actionMismatches, stepDataMismatches,
+ * criticMismatches, maxStepDataDifference, maxCriticDifference, firstMismatch (a description, or empty), and
+ * referenceStepsPerSecond and candidateStepsPerSecond. Only the native engines are compared; the Matlab
+ * implementation is not.
+ *
+ * Rollouts: The targets of rollout-based approximate policy iteration (such as CBMPI) are computed with
+ *
+ *   result = MexTetrisNAC( 'rollouts', environmentDataIn, agentDataIn, stopConds, rolloutOptions )
+ *
+ * which samples states from trajectories of the policy (theta, tau) and estimates the value of each sampled state and
+ * of each action available in it with truncated rollouts of the policy in worker threads (see RolloutEngine.hpp).
+ * rolloutOptions has the fields states (the number of states to sample), rolloutLength, rollouts (per state and
+ * action) and optionally gamma (default 1), samplingRate (the probability of sampling each visited state, default 1),
+ * valueWeights (STATEDIM x 1 weights of the value function in the last state of a rollout, or [] for none) and
+ * threads (default: the number of hardware threads). stopConds.maxSteps limits the sampling trajectories. result has
+ * the fields states (states x STATEDIM observations), actionCounts (states x 1), actions (states x MAXACTIONS x
+ * STATEACTIONDIM action features, zero for the unavailable actions), Q (states x MAXACTIONS, NaN for the unavailable
+ * actions), V (states x 1) and episodes (the number of sampling trajectories). All streams are counter-based, keyed
+ * as for 'evaluate' (by seed 0 from episode 0 if rngSeed is not set), and the results do not depend on the number of
+ * threads. The classifier and the regression are left to the caller (see RolloutsMex).
+ *
+ * Shared-memory farms: The episodes of a policy evaluation can be run by several Matlab processes on the same host,
+ * which share a work queue and the critic statistics in named shared memory (see SharedFarm.hpp):
+ *
+ *   MexTetrisNAC( 'farmCreate', name, capacity )
+ *   MexTetrisNAC( 'farmSubmit', name, environmentDataIn, agentDataIn, jobs )
+ *   jobsRun = MexTetrisNAC( 'farmWork', name, environmentDataIn, agentDataIn, stopConds )
+ *   status = MexTetrisNAC( 'farmQuery', name )
+ *   MexTetrisNAC( 'farmDestroy', name )
+ *
+ * The coordinating process creates the farm (replacing any farm of the same name) with room for batches of at most
+ * capacity jobs, and submits batches of jobs episodes that evaluate the policy (theta, tau) of agentDataIn with its
+ * critic class, gamma, lambda, petersTrickMode and rejectTerminalActions, and with the feature settings
+ * (holeDefinition, terminalBiasValueS and terminalBiasValueA) of environmentDataIn. A batch can be submitted once the
+ * previous one has been completed. Worker processes (and the coordinator itself) call 'farmWork', which runs jobs of
+ * the current batch until none are open, each as a learning episode with a fresh agent, and merges the critic
+ * statistics of each job into the farm; only the rstream of their agentDataIn is used, so the workers need not know the
+ * policy, and their environmentDataIn gives only the rstream and the observation logging. If the environmentDataIn of
+ * 'farmSubmit' sets rngSeed, then job j draws from the counter-based streams of episode rngEpisode + j, regardless of
+ * the process that runs it. status has the fields jobs, claimed, completed, failed, returns (the cleared rows of each
+ * job, NaN until completed) and critic (the merged statistics, which can be joined like agentDataOut.critic once
+ * completed equals jobs). 'farmSubmit' checks the batch settings, and 'farmWork' checks its inputs before claiming any
+ * job; a job that still raises an error in a worker counts as completed and failed, with a NaN return and no
+ * statistics, and the error is raised in that worker. Only the critics with additive statistics are supported (LSTD,
+ * LSPE and eNAC). Not supported on Windows.
+ *
+ * Counter-based random streams: If environmentDataIn contains the field 'rngSeed', then each episode draws its pieces
+ * and actions from its own counter-based streams (see PhiloxRandStream.hpp), keyed by rngSeed, the episode index and
+ * the purpose, instead of the rstream objects. The episode index is environmentDataIn.rngEpisode (default 0) for
+ * the plain call and 'run', rngEpisode + (iteration - 1) * episodes + (episode - 1) for 'train', and rngEpisode plus
+ * the episode's position in the returns for 'evaluate'. Any episode can then be regenerated independently, and the
+ * results of 'evaluate' do not depend on the number of lanes. The caller is responsible for advancing rngEpisode
+ * between calls (see Environment.mexRngEpisode).
+ *
+ * Observation logging: If environmentDataIn contains a nonzero field 'logObservations', then the state observations of
+ * each step are returned in environmentDataOut.observationLog (nothing is allocated otherwise). If it also contains a
+ * nonempty field 'observationLogFile', then the observations are instead streamed into that file by a background
+ * writer (see ObservationLogger.hpp) and observationLog is empty. In a session, the file stays open across calls
+ * until the settings change or the session is destroyed.
+ *
+ * Feature and policy settings: The defaults in Configuration.hpp can be overridden per call by the optional fields
+ * holeDefinition (HD_COVEREDBY = 0, HD_UNDERTOPLINE = 1 or HD_FLOODFILL = 2; the latter is not supported by
+ * 'evaluate'), terminalBiasValueS and terminalBiasValueA of environmentDataIn, and rejectTerminalActions of
+ * agentDataIn. The field petersTrickMode of agentDataIn (PTM_OFF = 0, PTM_ON = 1 or PTM_CORRECTED = 2, the latter only
+ * with the LSTD critic; other critics raise an error) is read when the agent is created, so in a session it is fixed
+ * by 'create'. Each setting that selects a code path is dispatched once per step onto a specialized instantiation of
+ * the inner loops, so the overrides cost nothing per feature or per action.
+ *
+ * Parameter sweeps: If agentDataIn contains a nonempty field 'sweepCritics', an n x 3 matrix with a row [criticClass,
+ * gamma, lambda] for each critic, then n further critics are stepped on exactly the same transitions as the main
+ * critic (see NaturalActorCritic.hpp), so that critics with several settings are compared on a single run. Their
+ * statistics are returned in agentDataOut.sweepCritics, a 1 x n cell array of structs like agentDataOut.critic. The
+ * sweep critics do not affect the policy. In a session, they are fixed by 'create'; 'query', 'reset', 'forget' and
+ * 'train' cover them as well, while 'solve' and 'reevaluate' concern only the main critic.
+ *
+ * Episode statistics: If agentDataIn contains a nonzero field 'episodeStatistics', then the contribution of each
+ * learning episode to the critic statistics is recorded separately (see EpisodeStatistics.hpp), for estimating the
+ * variance of the natural gradient by resampling the episodes offline. The records are returned in
+ * agentDataOut.episodeStatistics, a struct with the fields episode (the counter-based stream index, or NaN), return,
+ * steps (n x 1), A (VDim x VDim x n), b (VDim x n) and, with LSPE, B. If agentDataIn contains a nonempty field
+ * 'episodeStatisticsFile', then the records are instead appended to that file as each episode ends (see
+ * readEpisodeStatistics.m), and the file keeps growing over calls and sessions. Without forgetting or re-evaluation,
+ * the records sum up to the statistics of the main critic. In a session, the records in memory are dropped by 'reset'.
+ * Only the critics with additive statistics are supported (LSTD, LSPE and eNAC).
+ *
+ * Online actor updates: If agentDataIn contains a nonempty field 'onlineUpdates', a struct with a positive field
+ * interval and the actor update fields of trainingOptions (stepsize, actorIteration, beta, thetaC, QInterpretation,
+ * criticBeta and solver), then the actor is also updated within each learning episode, every interval learned
+ * transitions, from the main critic solved at that point (see NaturalActorCritic.hpp). The agent acts on its own copy
+ * of theta, starting from agentDataIn.theta, and each update forgets the critic statistics as 'train' does.
+ * agentDataOut.onlineUpdates (or the 'query' result in a session) holds the log of the episode, with the same fields
+ * as the log of 'train': theta, gradientNorm, cond, w and actorIteration. The state of the updates is part of the
+ * chunked episode state. Not supported by 'train'.
+ *
+ * Gradient-TD critics: The critic classes 4 (GTD2) and 5 (TDC) learn the critic parameters by stochastic gradient
+ * descent in O(VDim) per step instead of accumulating least squares statistics (see GradientTDLambda.hpp). The optional
+ * field 'criticSettings' of agentDataIn, a struct with the fields alpha and alphaH (the step sizes) and w and h (the
+ * initial parameters and auxiliary weights, VDim x 1), is applied when the agent is created, so in a session it is
+ * fixed by 'create'. agentDataOut.critic holds V (the parameters w) and h, which are passed back in as the initial
+ * parameters of the next call. 'solve' returns w (cond is NaN), 'forget' keeps the parameters and 'reset' clears
+ * them. As sweep critics they use the default settings. Not supported by episode statistics, farms or 'reevaluate'.
+ *
+ * Pipelining: If agentDataIn contains a nonzero field 'pipelined', then the critic updates run in a learner thread
+ * that overlaps with the simulation (see CriticPipeline.hpp). The results are identical to the sequential mode.
+ *
  * This implementation produces exactly identical results with the Matlab implementation for the case of gamma=1
  * and lambda=0. In most cases however there will be slight rounding error differences in the critic statistics,
  * leading to very slightly differing results (tested with r108 trunk). (starting from around r383, the mex and
@@ -14,72 +199,898 @@
 
 
 #include "Tetris.hpp"
+#include "TetrisBatch.hpp"
+#include "BatchEvaluation.hpp"
 #include "NaturalActorCritic.hpp"
 #include "LSTDLambda.hpp"
 #include "LSPELambda.hpp"
+#include "Configuration.hpp"
 #include "../MatlabRandStream.hpp"
+#include "../PhiloxRandStream.hpp"
+#include "../Profiler.hpp"
+#include "Solver.hpp"
+#include "EngineComparison.hpp"
+#include "RolloutEngine.hpp"
+#include "SharedFarm.hpp"
+#include "../StateBuffer.hpp"
 
 #include "mex.h"
 #include "matrix.h"
 
 #include <cstring>
 using std::memcpy;
+using std::strcmp;
+using std::strncmp;
 
+#include <memory>
+#include <thread>
 
 
+// episode state blob header
+#define EPISODESTATE_MAGIC 0x5354504554525452ULL   // "RTRTEPTS"
+#define EPISODESTATE_VERSION 2
 
-void mexFunction(
-    int nlhs, mxArray * plhs[],
-    int nrhs, const mxArray * prhs[])
+// maximum number of concurrent sessions
+#define MAXSESSIONS 64
+
+
+
+
+static void saveEpisodeState( StateWriter & w, const Tetris & environment, NaturalActorCritic & agent,
+                              double totalReward, double stepCounter )
 {
-  const mxArray * environmentData;
-  const mxArray * agentData;
-  const mxArray * stopConds;
-  
-  // check and get args
-  mxAssert( nlhs == 2 && nrhs == 3, "Wrong number of arguments!" );
-  environmentData = prhs[0];
-  agentData = prhs[1];
-  stopConds = prhs[2];
+  w.write( (unsigned long long)EPISODESTATE_MAGIC );
+  w.write( (int)EPISODESTATE_VERSION );
+  w.write( (int)VDIM );
+  w.write( totalReward );
+  w.write( stepCounter );
+  environment.saveState( w );
+  agent.saveState( w );
+}
+
+static void loadEpisodeState( StateReader & r, Tetris & environment, NaturalActorCritic & agent,
+                              double & totalReward, double & stepCounter )
+{
+  unsigned long long magic; int version, vdim;
+  r.read( magic ); r.read( version ); r.read( vdim );
+  if( magic != EPISODESTATE_MAGIC || version != EPISODESTATE_VERSION || vdim != VDIM )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidEpisodeState", "MexTetrisNAC: invalid or incompatible episode state!" );
+  r.read( totalReward );
+  r.read( stepCounter );
+  environment.loadState( r );
+  agent.loadState( r );
+  if( !r.atEnd() )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidEpisodeState",
+                       "MexTetrisNAC: episode state does not match the critic class!" );
+}
+
+
+
+
+// read an optional scalar field, or return defaultValue if the field is missing or empty
+static double getOptionalScalar( const mxArray * s, const char * name, double defaultValue )
+{
+  const mxArray * field = mxGetField(s, 0, name);
+  return field && !mxIsEmpty( field ) ? mxGetScalar( field ) : defaultValue;
+}
+
+// read the optional feature settings (see the header comment), defaulting to Configuration.hpp
+static void getFeatureSettings( const mxArray * environmentData, int & holeDefinition,
+                                double & terminalBiasValueS, double & terminalBiasValueA )
+{
+  holeDefinition = (int)getOptionalScalar( environmentData, "holeDefinition", HOLEDEFINITION );
+  terminalBiasValueS = getOptionalScalar( environmentData, "terminalBiasValueS", TERMINAL_BIAS_VALUE_S );
+  terminalBiasValueA = getOptionalScalar( environmentData, "terminalBiasValueA", TERMINAL_BIAS_VALUE_A );
+}
+
+// apply the optional environment settings, which may change between calls
+static void configureEnvironment( Tetris & environment, const mxArray * environmentData )
+{
+  int holeDefinition;
+  double terminalBiasValueS, terminalBiasValueA;
+  getFeatureSettings( environmentData, holeDefinition, terminalBiasValueS, terminalBiasValueA );
+  environment.configure( holeDefinition, terminalBiasValueS, terminalBiasValueA );
   
-  // parse stopConds
-  double scMaxSteps = mxGetScalar( mxGetField(stopConds, 0, "maxSteps") );
-  double scTotalRewardMin = mxGetPr( mxGetField(stopConds, 0, "totalRewardRange") )[0];
-  double scTotalRewardMax = mxGetPr( mxGetField(stopConds, 0, "totalRewardRange") )[1];
+  const mxArray * logObservations = mxGetField(environmentData, 0, "logObservations");
+  const mxArray * observationLogFile = mxGetField(environmentData, 0, "observationLogFile");
+  char path[1024] = "";
+  if( observationLogFile && !mxIsEmpty( observationLogFile ) &&
+      mxGetString( observationLogFile, path, sizeof(path) ) )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidObservationLogFile", "MexTetrisNAC: invalid observationLogFile!" );
+  environment.setLogging( logObservations && mxGetScalar( logObservations ), path );
+}
+
+/* The returned objects are freed also if a Matlab error is raised (by this function or later). The action cache is
+ * created only for sessions, as it pays off only across episodes (see ActionCache.hpp). */
+static std::unique_ptr<Tetris> newEnvironment( const mxArray * environmentData, bool session )
+{
+  // parse optional environment settings
+  const mxArray * actionCacheSize = mxGetField(environmentData, 0, "actionCacheSize");
+  int cacheSize = session && actionCacheSize ? (int)mxGetScalar( actionCacheSize ) : 0;
   
   // create and init the environment
-  Tetris environment( 20, 10, mxGetField(environmentData, 0, "rstream") );
+  std::unique_ptr<Tetris> environment( new Tetris( 20, 10, mxGetField(environmentData, 0, "rstream"), cacheSize ) );
+  configureEnvironment( *environment, environmentData );
+  return environment;
+}
+
+// parse solverOptions (see the header comment)
+static void parseSolverOptions( const mxArray * s, SolverOptions & options )
+{
+  char method[16];
+  const mxArray * field = mxGetField(s, 0, "method");
+  if( !field || mxGetString( field, method, sizeof(method) ) || !Solver::parseMethod( method, options.method ) )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidSolverMethod", "MexTetrisNAC: invalid or unsupported solver method!" );
+  
+  field = mxGetField(s, 0, "I");
+  options.Ifactor = field ? mxGetScalar( field ) : 0.0;
+  field = mxGetField(s, 0, "regularization");
+  options.regularization = field ? mxGetScalar( field ) : 0.0;
   
+  // an empty mask selects all features
+  field = mxGetField(s, 0, "featureMask");
+  if( field && !mxIsEmpty( field ) ) {
+    if( !mxIsLogical( field ) || mxGetNumberOfElements( field ) != VDIM )
+      mexErrMsgIdAndTxt( "MexTetrisNAC:invalidFeatureMask",
+                         "MexTetrisNAC: featureMask must be a logical array of %d elements!", VDIM );
+    memcpy( options.featureMask, mxGetLogicals( field ), VDIM * sizeof(bool) );
+  } else {
+    for( int i = 0 ; i < VDIM ; i++ ) options.featureMask[i] = true;
+  }
+  
+  // LSPE
+  field = mxGetField(s, 0, "w");
+  if( field && !mxIsEmpty( field ) ) {
+    if( !mxIsDouble( field ) || mxGetNumberOfElements( field ) != VDIM )
+      mexErrMsgIdAndTxt( "MexTetrisNAC:invalidW", "MexTetrisNAC: w must be a double array of %d elements!", VDIM );
+    memcpy( options.w, mxGetPr( field ), VDIM * sizeof(double) );
+  } else {
+    for( int i = 0 ; i < VDIM ; i++ ) options.w[i] = 0.0;
+  }
+  field = mxGetField(s, 0, "iterations");
+  options.iterations = field ? (int)mxGetScalar( field ) : 1;
+  field = mxGetField(s, 0, "stepsize");
+  options.stepsize = field ? mxGetScalar( field ) : 1.0;
+}
+
+// parse the actor update fields of trainingOptions or onlineUpdates (see the header comment)
+static void parseActorUpdateOptions( const mxArray * s, ActorUpdateOptions & options )
+{
+  const mxArray * stepsize = mxGetField(s, 0, "stepsize");
+  options.stepsizeSchedule = mxGetNumberOfElements( stepsize ) == 2;
+  options.stepsize[0] = mxGetPr( stepsize )[0];
+  options.stepsize[1] = options.stepsizeSchedule ? mxGetPr( stepsize )[1] : 0.0;
+  options.actorIteration = (int)mxGetScalar( mxGetField(s, 0, "actorIteration") );
+  
+  options.beta = mxGetScalar( mxGetField(s, 0, "beta") );
+  options.thetaC = mxGetScalar( mxGetField(s, 0, "thetaC") );
+  
+  char QInterpretation[16];
+  mxGetString( mxGetField(s, 0, "QInterpretation"), QInterpretation, sizeof(QInterpretation) );
+  if( !strcmp( QInterpretation, "gradient" ) ) options.QTarget = false;
+  else if( !strcmp( QInterpretation, "target" ) ) options.QTarget = true;
+  else mexErrMsgIdAndTxt( "MexTetrisNAC:invalidQInterpretation", "MexTetrisNAC: invalid QInterpretation value!" );
+  
+  options.criticBeta = mxGetScalar( mxGetField(s, 0, "criticBeta") );
+  parseSolverOptions( mxGetField(s, 0, "solver"), options.solver );
+}
+
+// apply the optional agent settings, which may change between calls
+static void configureAgent( NaturalActorCritic & agent, const mxArray * agentData )
+{
+  const mxArray * pipelined = mxGetField(agentData, 0, "pipelined");
+  agent.setPipelined( pipelined && mxGetScalar( pipelined ) );
+  const mxArray * transitionCapacity = mxGetField(agentData, 0, "transitionCapacity");
+  agent.setTransitionCapacity( transitionCapacity ? (int)mxGetScalar( transitionCapacity ) : 0 );
+  agent.setRejectTerminalActions( getOptionalScalar( agentData, "rejectTerminalActions", REJECT_TERMINAL_ACTIONS ) );
+  
+  const mxArray * episodeStatistics = mxGetField(agentData, 0, "episodeStatistics");
+  const mxArray * episodeStatisticsFile = mxGetField(agentData, 0, "episodeStatisticsFile");
+  char path[1024] = "";
+  if( episodeStatisticsFile && !mxIsEmpty( episodeStatisticsFile ) &&
+      mxGetString( episodeStatisticsFile, path, sizeof(path) ) )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidEpisodeStatisticsFile", "MexTetrisNAC: invalid episodeStatisticsFile!" );
+  agent.setEpisodeStatistics( (episodeStatistics && mxGetScalar( episodeStatistics )) || path[0], path );
+  
+  const mxArray * onlineUpdates = mxGetField(agentData, 0, "onlineUpdates");
+  ActorUpdateOptions options = ActorUpdateOptions();
+  const int interval = onlineUpdates && !mxIsEmpty( onlineUpdates ) ?
+    (int)mxGetScalar( mxGetField(onlineUpdates, 0, "interval") ) : 0;
+  if( interval > 0 ) parseActorUpdateOptions( onlineUpdates, options );
+  agent.setOnlineUpdates( interval, options );
+}
+
+// read the optional counter-based stream key (see the header comment). returns false if the streams are not keyed.
+static bool getStreamKey( const mxArray * environmentData, unsigned long long & seed, unsigned long long & episode )
+{
+  const mxArray * rngSeed = mxGetField(environmentData, 0, "rngSeed");
+  if( !rngSeed || mxIsEmpty( rngSeed ) ) return false;
+  const mxArray * rngEpisode = mxGetField(environmentData, 0, "rngEpisode");
+  seed = (unsigned long long)mxGetScalar( rngSeed );
+  episode = rngEpisode ? (unsigned long long)mxGetScalar( rngEpisode ) : 0;
+  return true;
+}
+
+// key the streams of a new episode, if requested. offset is added to the episode index.
+static void keyEpisode( Tetris & environment, NaturalActorCritic & agent, const mxArray * environmentData,
+                        unsigned long long offset )
+{
+  unsigned long long seed, episode;
+  if( !getStreamKey( environmentData, seed, episode ) ) return;
+  environment.keyStream( seed, episode + offset );
+  agent.keyStream( seed, episode + offset );
+}
+
+static std::unique_ptr<NaturalActorCritic> newAgent( const mxArray * agentData )
+{
   // create and init the agent
-  NaturalActorCritic agent( mxGetField(agentData, 0, "rstream"),
+  std::unique_ptr<NaturalActorCritic> agent(
+    new NaturalActorCritic( mxGetField(agentData, 0, "rstream"),
                             (int)(mxGetScalar( mxGetField(agentData, 0, "criticClass") )),
+                            (int)getOptionalScalar( agentData, "petersTrickMode", PETERS_TRICK_MODE ),
                             mxGetScalar( mxGetField(agentData, 0, "learning") ),
                             mxGetM( mxGetField(agentData, 0, "theta") ),
                             mxGetPr( mxGetField(agentData, 0, "theta") ),
                             mxGetScalar( mxGetField(agentData, 0, "gamma") ),
                             mxGetScalar( mxGetField(agentData, 0, "lambda") ),
-                            mxGetScalar( mxGetField(agentData, 0, "tau") ) );
+                            mxGetScalar( mxGetField(agentData, 0, "tau") ) ) );
+  
+  // the settings and initial parameters of the critic, if any
+  const mxArray * criticSettings = mxGetField(agentData, 0, "criticSettings");
+  if( criticSettings && !mxIsEmpty( criticSettings ) ) agent->critic->configure( criticSettings );
   
+  // the critics of a parameter sweep, one [criticClass, gamma, lambda] row each
+  const mxArray * sweepCritics = mxGetField(agentData, 0, "sweepCritics");
+  if( sweepCritics && !mxIsEmpty( sweepCritics ) ) {
+    if( mxGetN( sweepCritics ) != 3 )
+      mexErrMsgIdAndTxt( "MexTetrisNAC:invalidSweepCritics",
+                         "MexTetrisNAC: sweepCritics must have a [criticClass, gamma, lambda] row per critic!" );
+    const int count = (int)mxGetM( sweepCritics );
+    const double * config = mxGetPr( sweepCritics );
+    for( int i = 0 ; i < count ; i++ )
+      agent->addSweepCritic( (int)config[i], config[i + count], config[i + 2 * count] );
+  }
+  
+  configureAgent( *agent, agentData );
+  return agent;
+}
+
+
+// whether stopConds asks for a chunked episode (see the header comment)
+static bool isChunked( const mxArray * stopConds )
+{
+  return mxGetField(stopConds, 0, "chunkSteps") != 0;
+}
+
+// raise an error if stopConds lacks a scalar maxSteps or a two-element totalRewardRange
+static void checkStopConds( const mxArray * stopConds )
+{
+  const mxArray * maxSteps = mxIsStruct( stopConds ) ? mxGetField(stopConds, 0, "maxSteps") : 0;
+  const mxArray * totalRewardRange = mxIsStruct( stopConds ) ? mxGetField(stopConds, 0, "totalRewardRange") : 0;
+  if( !maxSteps || mxGetNumberOfElements( maxSteps ) != 1 || !totalRewardRange || !mxIsDouble( totalRewardRange ) ||
+      mxGetNumberOfElements( totalRewardRange ) != 2 )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidStopConds",
+                       "MexTetrisNAC: stopConds must have the fields maxSteps and totalRewardRange!" );
+}
+
+/* Runs an episode, or a chunk of it if stopConds.chunkSteps is set, in which case episodeStateOut must be non-null. If
+ * the episode is interrupted only by the chunk length, then the episode state is returned in *episodeStateOut.
+ * Otherwise the agent takes the terminal step and *episodeStateOut is set to an empty array, if non-null. */
+static void runEpisode( Tetris & environment, NaturalActorCritic & agent, const mxArray * stopConds,
+                        const mxArray * episodeStateIn, mxArray ** episodeStateOut )
+{
+  // parse stopConds
+  double scMaxSteps = mxGetScalar( mxGetField(stopConds, 0, "maxSteps") );
+  double scTotalRewardMin = mxGetPr( mxGetField(stopConds, 0, "totalRewardRange") )[0];
+  double scTotalRewardMax = mxGetPr( mxGetField(stopConds, 0, "totalRewardRange") )[1];
+  const mxArray * chunkStepsField = mxGetField(stopConds, 0, "chunkSteps");
+  double scChunkSteps = chunkStepsField ? mxGetScalar( chunkStepsField ) : mxGetInf();
+  if( chunkStepsField && !episodeStateOut )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:chunkedEpisode",
+                       "MexTetrisNAC: the episode state must be returned when stopConds.chunkSteps is set!" );
+  
+  // start a new episode or resume a chunked one
+  double totalReward = 0.0, reward, stepCounter = 0;
+  if( episodeStateIn ) {
+    StateReader r( episodeStateIn );
+    loadEpisodeState( r, environment, agent, totalReward, stepCounter );
+  } else {
+    environment.newEpisode();
+    agent.newEpisode();
+  }
   
   // main loop
   int action;
-  environment.newEpisode();
-  agent.newEpisode();
-  double totalReward = 0.0, reward, stepCounter = 0;
+  double chunkStepCounter = 0;
   while( !environment.terminalState &&
          totalReward >= scTotalRewardMin && totalReward <= scTotalRewardMax &&
-         stepCounter < scMaxSteps ) {
+         stepCounter < scMaxSteps && chunkStepCounter < scChunkSteps ) {
     
     action = agent.step( environment.stepData );
     reward = environment.step( action );
     
-    totalReward += reward; stepCounter++;
+    totalReward += reward; stepCounter++; chunkStepCounter++;
+  }
+  
+  // was the episode interrupted only by the chunk length?
+  bool episodeContinues = !environment.terminalState &&
+                          totalReward >= scTotalRewardMin && totalReward <= scTotalRewardMax &&
+                          stepCounter < scMaxSteps;
+  
+  if( episodeContinues ) {
+    // export the episode state for the next chunk (episodeStateOut is non-null, as chunkSteps is set)
+    StateWriter w;
+    saveEpisodeState( w, environment, agent, totalReward, stepCounter );
+    *episodeStateOut = w.createArray();
+  } else {
+    agent.step( environment.stepData );   // step in terminal state for learning purposes
+    agent.recordEpisode( totalReward, stepCounter );
+    if( episodeStateOut ) *episodeStateOut = mxCreateNumericMatrix( 0, 0, mxUINT8_CLASS, mxREAL );
   }
-  agent.step( environment.stepData );   // step in terminal state for learning purposes
   
+  // the critic is accessed directly after this
+  agent.sync();
+}
+
+
+
+/* Evaluates the policy (theta and tau from agentData, learning disabled) in a batch environment. See 'evaluate' in the
+ * header comment. */
+static mxArray * evaluate( const mxArray * environmentData, const mxArray * agentData, const mxArray * stopConds,
+                           int episodes, int lanes )
+{
+  // parse stopConds
+  double scMaxSteps = mxGetScalar( mxGetField(stopConds, 0, "maxSteps") );
+  double scTotalRewardMin = mxGetPr( mxGetField(stopConds, 0, "totalRewardRange") )[0];
+  double scTotalRewardMax = mxGetPr( mxGetField(stopConds, 0, "totalRewardRange") )[1];
+  
+  if( lanes < 1 || lanes > BATCHMAXLANES )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidLanes", "MexTetrisNAC: the number of lanes must be in [1, %d]!",
+                       BATCHMAXLANES );
+  if( lanes > episodes ) lanes = episodes > 0 ? episodes : 1;
+  
+  // create the batch and the agent. the agent only acts, so it serves all lanes.
+  TetrisBatch batch( lanes, mxGetField(environmentData, 0, "rstream") );
+  int holeDefinition;
+  double terminalBiasValueS, terminalBiasValueA;
+  getFeatureSettings( environmentData, holeDefinition, terminalBiasValueS, terminalBiasValueA );
+  batch.configure( holeDefinition, terminalBiasValueS, terminalBiasValueA );
+  NaturalActorCritic agent( mxGetField(agentData, 0, "rstream"), Critic::CC_LSTD, PTM_ON, false,
+                            mxGetM( mxGetField(agentData, 0, "theta") ),
+                            mxGetPr( mxGetField(agentData, 0, "theta") ),
+                            0.0, 0.0, mxGetScalar( mxGetField(agentData, 0, "tau") ) );
+  agent.setRejectTerminalActions( getOptionalScalar( agentData, "rejectTerminalActions", REJECT_TERMINAL_ACTIONS ) );
+  
+  mxArray * returns = mxCreateDoubleMatrix( episodes, 1, mxREAL );
+  
+  // counter-based streams: the pieces and the actions of each episode are drawn from its own streams
+  unsigned long long seed = 0, firstEpisode = 0;
+  bool keyed = getStreamKey( environmentData, seed, firstEpisode );
+  evaluateBatch( batch, agent, episodes, keyed, seed, firstEpisode, scMaxSteps, scTotalRewardMin, scTotalRewardMax,
+                 mxGetPr( returns ) );
+  
+  return returns;
+}
+
+
+/* Runs the reference engine and the given candidate engine side by side and returns the report of EngineComparison.
+ * See 'compare' in the header comment. */
+static mxArray * compare( const mxArray * environmentData, const mxArray * agentData, const mxArray * stopConds,
+                          int episodes, const char * engine, double tolerance )
+{
+  double scMaxSteps = mxGetScalar( mxGetField(stopConds, 0, "maxSteps") );
+  mxArray * rstream = mxGetField(environmentData, 0, "rstream");
+  
+  bool actionCache = !strcmp( engine, "actionCache" );
+  bool pipeline = !strcmp( engine, "pipeline" );
+  bool batch = !strcmp( engine, "batch" );
+  if( !actionCache && !pipeline && !batch )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidEngine", "MexTetrisNAC: unknown engine '%s'!", engine );
+  if( tolerance < 0.0 )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidTolerance", "MexTetrisNAC: the tolerance must be nonnegative!" );
+  
+  // the reference engine: no action cache, sequential critic updates, no logging or transition recording
+  Tetris referenceEnvironment( 20, 10, rstream, 0 );
+  configureEnvironment( referenceEnvironment, environmentData );
+  referenceEnvironment.setLogging( false, "" );
+  
+  // the candidate environment. the action cache size is taken from environmentData if set.
+  const mxArray * actionCacheSize = mxGetField(environmentData, 0, "actionCacheSize");
+  int cacheSize = actionCacheSize && mxGetScalar( actionCacheSize ) > 0 ? (int)mxGetScalar( actionCacheSize ) : 4096;
+  std::unique_ptr<Tetris> candidateEnvironment;
+  std::unique_ptr<TetrisBatch> candidateBatch;
+  if( batch ) {
+    int holeDefinition;
+    double terminalBiasValueS, terminalBiasValueA;
+    getFeatureSettings( environmentData, holeDefinition, terminalBiasValueS, terminalBiasValueA );
+    candidateBatch.reset( new TetrisBatch( 1, rstream ) );
+    candidateBatch->configure( holeDefinition, terminalBiasValueS, terminalBiasValueA );
+  } else {
+    candidateEnvironment.reset( new Tetris( 20, 10, rstream, actionCache ? cacheSize : 0 ) );
+    configureEnvironment( *candidateEnvironment, environmentData );
+    candidateEnvironment->setLogging( false, "" );
+  }
+  
+  // the agents. the batch engine only acts, so learning is disabled in both agents for it.
+  std::unique_ptr<NaturalActorCritic> referenceAgent = newAgent( agentData );
+  std::unique_ptr<NaturalActorCritic> candidateAgent = newAgent( agentData );
+  referenceAgent->setPipelined( false );
+  candidateAgent->setPipelined( pipeline );
+  referenceAgent->setTransitionCapacity( 0 );
+  candidateAgent->setTransitionCapacity( 0 );
+  if( batch ) {
+    mxArray * theta = mxGetField(agentData, 0, "theta");
+    double tau = mxGetScalar( mxGetField(agentData, 0, "tau") );
+    referenceAgent->attach( mxGetField(agentData, 0, "rstream"), false, mxGetM( theta ), mxGetPr( theta ), tau );
+    candidateAgent->attach( mxGetField(agentData, 0, "rstream"), false, mxGetM( theta ), mxGetPr( theta ), tau );
+  }
+  referenceAgent->makePersistent();
+  candidateAgent->makePersistent();
+  
+  // run on the counter-based streams of the environment's key, or of seed 0 from episode 0
+  unsigned long long seed = 0, firstEpisode = 0;
+  getStreamKey( environmentData, seed, firstEpisode );
+  EngineComparison comparison( tolerance );
+  comparison.run( referenceEnvironment, *referenceAgent, candidateEnvironment.get(), candidateBatch.get(),
+                  *candidateAgent, episodes, seed, firstEpisode, scMaxSteps );
+  
+  return comparison.createReturnStruct();
+}
+
+
+
+/* Samples states and runs the rollouts of RolloutEngine. See 'rollouts' in the header comment. */
+static mxArray * rollouts( const mxArray * environmentData, const mxArray * agentData, const mxArray * stopConds,
+                           const mxArray * rolloutOptions )
+{
+  const mxArray * theta = mxGetField(agentData, 0, "theta");
+  if( mxGetNumberOfElements( theta ) != STATEACTIONDIM )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidTheta", "MexTetrisNAC: theta must have %d elements!", STATEACTIONDIM );
+  const mxArray * valueWeights = mxGetField(rolloutOptions, 0, "valueWeights");
+  if( valueWeights && !mxIsEmpty( valueWeights ) && mxGetNumberOfElements( valueWeights ) != STATEDIM )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidValueWeights", "MexTetrisNAC: valueWeights must have %d elements!",
+                       STATEDIM );
+  
+  RolloutOptions options;
+  options.states = (int)mxGetScalar( mxGetField(rolloutOptions, 0, "states") );
+  options.rolloutLength = (int)mxGetScalar( mxGetField(rolloutOptions, 0, "rolloutLength") );
+  options.rollouts = (int)mxGetScalar( mxGetField(rolloutOptions, 0, "rollouts") );
+  options.gamma = getOptionalScalar( rolloutOptions, "gamma", 1.0 );
+  options.samplingRate = getOptionalScalar( rolloutOptions, "samplingRate", 1.0 );
+  options.maxSteps = mxGetScalar( mxGetField(stopConds, 0, "maxSteps") );
+  options.valueWeights = valueWeights && !mxIsEmpty( valueWeights ) ? mxGetPr( valueWeights ) : 0;
+  options.threads = (int)getOptionalScalar( rolloutOptions, "threads", std::thread::hardware_concurrency() );
+  
+  int holeDefinition;
+  double terminalBiasValueS, terminalBiasValueA;
+  getFeatureSettings( environmentData, holeDefinition, terminalBiasValueS, terminalBiasValueA );
+  RolloutEngine engine( mxGetPr( theta ), mxGetScalar( mxGetField(agentData, 0, "tau") ),
+                        getOptionalScalar( agentData, "rejectTerminalActions", REJECT_TERMINAL_ACTIONS ), options,
+                        holeDefinition, terminalBiasValueS, terminalBiasValueA );
+  
+  // run on the counter-based streams of the environment's key, or of seed 0 from episode 0
+  unsigned long long seed = 0, firstEpisode = 0;
+  getStreamKey( environmentData, seed, firstEpisode );
+  engine.run( seed, firstEpisode );
+  
+  return engine.createReturnStruct();
+}
+
+
+
+
+/* Publishes a batch of jobs evaluating the agent's policy in a farm. See 'farmSubmit' in the header comment. */
+static void farmSubmit( const char * name, const mxArray * environmentData, const mxArray * agentData, int jobs )
+{
+  const mxArray * theta = mxGetField(agentData, 0, "theta");
+  if( mxGetNumberOfElements( theta ) != STATEACTIONDIM )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidTheta", "MexTetrisNAC: theta must have %d elements!", STATEACTIONDIM );
+  
+  FarmBatch batch;
+  batch.jobs = jobs;
+  batch.criticClass = (int)mxGetScalar( mxGetField(agentData, 0, "criticClass") );
+  batch.petersTrickMode = (int)getOptionalScalar( agentData, "petersTrickMode", PETERS_TRICK_MODE );
+  batch.gamma = mxGetScalar( mxGetField(agentData, 0, "gamma") );
+  batch.lambda = mxGetScalar( mxGetField(agentData, 0, "lambda") );
+  memcpy( batch.theta, mxGetPr( theta ), sizeof(batch.theta) );
+  batch.tau = mxGetScalar( mxGetField(agentData, 0, "tau") );
+  batch.rejectTerminalActions = getOptionalScalar( agentData, "rejectTerminalActions", REJECT_TERMINAL_ACTIONS );
+  getFeatureSettings( environmentData, batch.holeDefinition, batch.terminalBiasValueS, batch.terminalBiasValueA );
+  batch.seed = batch.firstEpisode = 0;
+  batch.keyed = getStreamKey( environmentData, batch.seed, batch.firstEpisode );
+  
+  // create the agent and the environment of a job once here, so that invalid settings raise an error in the submitter
+  // instead of failing every job in the workers
+  NaturalActorCritic agent( mxGetField(agentData, 0, "rstream"), batch.criticClass, batch.petersTrickMode, true,
+                            STATEACTIONDIM, batch.theta, batch.gamma, batch.lambda, batch.tau );
+  std::unique_ptr<Tetris> environment = newEnvironment( environmentData, false );
+  
+  SharedFarm farm( name );
+  farm.submit( batch );
+}
+
+
+/* Runs jobs of a farm until none are open, and returns the number of jobs run. See 'farmWork' in the header comment.
+ * Each job runs a learning episode with a fresh agent, whose critic statistics are then merged in the farm. The inputs
+ * are checked before any job is claimed; if a claimed job still raises an error, then it is marked failed before the
+ * error propagates, so that the batch completes. */
+static int farmWork( const char * name, const mxArray * environmentData, const mxArray * agentData,
+                     const mxArray * stopConds )
+{
+  if( isChunked( stopConds ) )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:chunkedEpisode", "MexTetrisNAC: chunked episodes are not supported by farms!" );
+  checkStopConds( stopConds );
+  if( !mxIsStruct( agentData ) || !mxGetField(agentData, 0, "rstream") )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidAgentData", "MexTetrisNAC: agentDataIn must have the field rstream!" );
+  
+  SharedFarm farm( name );
+  std::unique_ptr<Tetris> environment = newEnvironment( environmentData, false );
+  
+  FarmBatch batch;
+  int job, jobsRun = 0;
+  while( farm.claim( job, batch ) ) {
+    try {
+      NaturalActorCritic agent( mxGetField(agentData, 0, "rstream"), batch.criticClass, batch.petersTrickMode, true,
+                                STATEACTIONDIM, batch.theta, batch.gamma, batch.lambda, batch.tau );
+      agent.setRejectTerminalActions( batch.rejectTerminalActions );
+      environment->configure( batch.holeDefinition, batch.terminalBiasValueS, batch.terminalBiasValueA );
+      if( batch.keyed ) {
+        environment->keyStream( batch.seed, batch.firstEpisode + job );
+        agent.keyStream( batch.seed, batch.firstEpisode + job );
+      }
+      
+      runEpisode( *environment, agent, stopConds, 0, 0 );
+      
+      mxArray * agentDataOut = agent.createReturnStruct();
+      farm.complete( job, environment->totalClearedRows, mxGetField(agentDataOut, 0, "critic") );
+      mxDestroyArray( agentDataOut );
+    } catch( ... ) {
+      farm.fail();
+      throw;
+    }
+    jobsRun++;
+  }
+  
+  return jobsRun;
+}
+
+
+
+
+/* sessions */
+
+
+struct Session {
+  std::unique_ptr<Tetris> environment;
+  std::unique_ptr<NaturalActorCritic> agent;
+};
+
+// session slots (a handle is the slot index plus one)
+static Session * sessions[MAXSESSIONS];
+
+
+static void destroySession( int slot )
+{
+  delete sessions[slot]; sessions[slot] = 0;
+}
+
+// mexAtExit() callback
+static void destroyAllSessions()
+{
+  for( int slot = 0 ; slot < MAXSESSIONS ; slot++ )
+    if( sessions[slot] ) destroySession( slot );
+}
+
+// return the slot of a session handle, or -1 if the handle is not valid
+static int findSession( const mxArray * handle )
+{
+  if( !mxIsDouble( handle ) || mxGetNumberOfElements( handle ) != 1 ) return -1;
+  double h = mxGetScalar( handle );
+  if( h < 1 || h > MAXSESSIONS || h != (int)h || !sessions[(int)h - 1] ) return -1;
+  return (int)h - 1;
+}
+
+static Session & getSession( const mxArray * handle )
+{
+  int slot = findSession( handle );
+  if( slot < 0 ) mexErrMsgIdAndTxt( "MexTetrisNAC:invalidSession", "MexTetrisNAC: invalid session handle!" );
+  return *sessions[slot];
+}
+
+
+struct TrainingOptions {
+  int iterations, episodes;
+  ActorUpdateOptions actor;
+  double reuseTruncation;
+};
+
+static void parseTrainingOptions( const mxArray * s, TrainingOptions & options )
+{
+  options.iterations = (int)mxGetScalar( mxGetField(s, 0, "iterations") );
+  options.episodes = (int)mxGetScalar( mxGetField(s, 0, "episodes") );
+  parseActorUpdateOptions( s, options.actor );
+  
+  const mxArray * reuseTruncation = mxGetField(s, 0, "reuseTruncation");
+  options.reuseTruncation = reuseTruncation && !mxIsEmpty( reuseTruncation ) ? mxGetScalar( reuseTruncation ) : 0.0;
+}
+
+
+/* Runs the policy improvement loop in a session. See 'train' in the header comment. */
+static mxArray * train( Session & session, const mxArray * environmentData, const mxArray * agentData,
+                        const mxArray * stopConds, TrainingOptions & options )
+{
+  if( isChunked( stopConds ) )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:chunkedEpisode", "MexTetrisNAC: chunked episodes are not supported by 'train'!" );
+  configureEnvironment( *session.environment, environmentData );
+  configureAgent( *session.agent, agentData );
+  if( session.agent->getOnlineInterval() > 0 )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:onlineUpdates", "MexTetrisNAC: online updates are not supported by 'train'!" );
+  
+  // theta is owned here during training
+  const mxArray * theta0 = mxGetField(agentData, 0, "theta");
+  if( !theta0 || !mxIsDouble( theta0 ) || mxGetNumberOfElements( theta0 ) != STATEACTIONDIM )
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidTheta", "MexTetrisNAC: theta must have %d elements!", STATEACTIONDIM );
+  const int thetaDim = STATEACTIONDIM;
+  double theta[STATEACTIONDIM];
+  memcpy( theta, mxGetPr( theta0 ), sizeof(theta) );
+  double tau = mxGetScalar( mxGetField(agentData, 0, "tau") );
+  
+  // create the log
+  mxArray * logTheta = mxCreateDoubleMatrix( thetaDim, options.iterations, mxREAL );
+  mxArray * logReturns = mxCreateDoubleMatrix( options.episodes, options.iterations, mxREAL );
+  mxArray * logGradientNorm = mxCreateDoubleMatrix( 1, options.iterations, mxREAL );
+  mxArray * logCond = mxCreateDoubleMatrix( 1, options.iterations, mxREAL );
+  
+  for( int iteration = 0 ; iteration < options.iterations ; iteration++ ) {
+    
+    // evaluation episodes. re-attach for each episode, so that the random streams stay in sync with per-episode calls.
+    for( int episode = 0 ; episode < options.episodes ; episode++ ) {
+      session.environment->attach( mxGetField(environmentData, 0, "rstream") );
+      session.agent->attach( mxGetField(agentData, 0, "rstream"), true, thetaDim, theta, tau );
+      keyEpisode( *session.environment, *session.agent, environmentData,
+                  (unsigned long long)iteration * options.episodes + episode );
+      runEpisode( *session.environment, *session.agent, stopConds, 0, 0 );
+      mxGetPr( logReturns )[iteration * options.episodes + episode] = session.environment->totalClearedRows;
+    }
+    
+    // add the transitions of earlier iterations, re-evaluated under the current policy
+    if( options.reuseTruncation > 0.0 ) {
+      double meanWeight;
+      session.agent->reevaluate( theta, tau, options.reuseTruncation, meanWeight );
+    }
+    
+    // solve the critic, update theta and forget
+    double gradientNorm, cnd;
+    session.agent->updateActor( options.actor, theta, gradientNorm, cnd );
+    
+    // log
+    memcpy( &mxGetPr( logTheta )[iteration * thetaDim], theta, sizeof(theta) );
+    mxGetPr( logGradientNorm )[iteration] = gradientNorm;
+    mxGetPr( logCond )[iteration] = cnd;
+  }
+  
+  // the theta pointer must not outlive this call
+  session.agent->attach( mxGetField(agentData, 0, "rstream"), true, thetaDim, mxGetPr( theta0 ), tau );
+  
+  mxArray * w = mxCreateDoubleMatrix( VDIM, 1, mxREAL );
+  memcpy( mxGetPr(w), options.actor.solver.w, VDIM * sizeof(double) );
+  
+  mxArray * s = mxCreateStructMatrix( 1, 1, 0, 0 );
+  mxAddField( s, "theta" );
+  mxSetField( s, 0, "theta", logTheta );
+  mxAddField( s, "returns" );
+  mxSetField( s, 0, "returns", logReturns );
+  mxAddField( s, "gradientNorm" );
+  mxSetField( s, 0, "gradientNorm", logGradientNorm );
+  mxAddField( s, "cond" );
+  mxSetField( s, 0, "cond", logCond );
+  mxAddField( s, "w" );
+  mxSetField( s, 0, "w", w );
+  mxAddField( s, "actorIteration" );
+  mxSetField( s, 0, "actorIteration", mxCreateDoubleScalar( options.actor.actorIteration ) );
+  return s;
+}
+
+
+static void sessionFunction(
+    const char * command,
+    int nlhs, mxArray * plhs[],
+    int nrhs, const mxArray * prhs[])
+{
+  if( !strcmp( command, "create" ) ) {
+    
+    mxAssert( nlhs <= 1 && nrhs == 3, "Wrong number of arguments!" );
+    
+    // find a free slot
+    int slot = 0;
+    while( slot < MAXSESSIONS && sessions[slot] ) slot++;
+    if( slot == MAXSESSIONS )
+      mexErrMsgIdAndTxt( "MexTetrisNAC:tooManySessions", "MexTetrisNAC: too many sessions!" );
+    
+    // create the objects and move them into persistent memory (the session takes ownership only once all succeed)
+    std::unique_ptr<Tetris> environment = newEnvironment( prhs[1], true );
+    std::unique_ptr<NaturalActorCritic> agent = newAgent( prhs[2] );
+    agent->makePersistent();
+    Session * session = new Session;
+    session->environment = std::move( environment );
+    session->agent = std::move( agent );
+    sessions[slot] = session;
+    mexAtExit( destroyAllSessions );
+    
+    plhs[0] = mxCreateDoubleScalar( slot + 1 );
+    
+  } else if( !strcmp( command, "run" ) ) {
+    
+    mxAssert( nlhs <= 2 && (nrhs == 5 || nrhs == 6), "Wrong number of arguments!" );
+    Session & session = getSession( prhs[1] );
+    const mxArray * environmentData = prhs[2];
+    const mxArray * agentData = prhs[3];
+    const mxArray * episodeStateIn = (nrhs == 6 && !mxIsEmpty( prhs[5] )) ? prhs[5] : 0;
+    
+    // attach to the arguments of this call
+    session.environment->attach( mxGetField(environmentData, 0, "rstream") );
+    configureEnvironment( *session.environment, environmentData );
+    session.agent->attach( mxGetField(agentData, 0, "rstream"),
+                           mxGetScalar( mxGetField(agentData, 0, "learning") ),
+                           mxGetM( mxGetField(agentData, 0, "theta") ),
+                           mxGetPr( mxGetField(agentData, 0, "theta") ),
+                           mxGetScalar( mxGetField(agentData, 0, "tau") ) );
+    configureAgent( *session.agent, agentData );
+    if( !episodeStateIn ) keyEpisode( *session.environment, *session.agent, environmentData, 0 );
+    
+    runEpisode( *session.environment, *session.agent, prhs[4], episodeStateIn, nlhs == 2 ? &plhs[1] : 0 );
+    
+    plhs[0] = session.environment->createReturnStruct();
+    
+  } else if( !strcmp( command, "query" ) ) {
+    
+    mxAssert( nlhs <= 1 && nrhs == 2, "Wrong number of arguments!" );
+    plhs[0] = getSession( prhs[1] ).agent->createReturnStruct();
+    
+  } else if( !strcmp( command, "reset" ) ) {
+    
+    mxAssert( nlhs == 0 && nrhs == 2, "Wrong number of arguments!" );
+    getSession( prhs[1] ).agent->resetCritics();
+    
+  } else if( !strcmp( command, "solve" ) ) {
+    
+    mxAssert( nlhs <= 1 && nrhs == 3, "Wrong number of arguments!" );
+    Session & session = getSession( prhs[1] );
+    
+    SolverOptions options;
+    parseSolverOptions( prhs[2], options );
+    double V[VDIM], cnd;
+    session.agent->critic->solve( options, V, cnd );
+    
+    mxArray * Vout = mxCreateDoubleMatrix( VDIM, 1, mxREAL );
+    memcpy( mxGetPr(Vout), V, sizeof(V) );
+    plhs[0] = mxCreateStructMatrix( 1, 1, 0, 0 );
+    mxAddField( plhs[0], "V" );
+    mxSetField( plhs[0], 0, "V", Vout );
+    mxAddField( plhs[0], "cond" );
+    mxSetField( plhs[0], 0, "cond", mxCreateDoubleScalar( cnd ) );
+    
+  } else if( !strcmp( command, "forget" ) ) {
+    
+    mxAssert( nlhs == 0 && nrhs == 3, "Wrong number of arguments!" );
+    Session & session = getSession( prhs[1] );
+    session.agent->forgetCritics( mxGetScalar( prhs[2] ) );
+    session.agent->policyUpdated();
+    
+  } else if( !strcmp( command, "reevaluate" ) ) {
+    
+    mxAssert( nlhs <= 1 && nrhs == 5, "Wrong number of arguments!" );
+    Session & session = getSession( prhs[1] );
+    if( !mxIsDouble( prhs[2] ) || mxGetNumberOfElements( prhs[2] ) != STATEACTIONDIM )
+      mexErrMsgIdAndTxt( "MexTetrisNAC:invalidTheta", "MexTetrisNAC: theta must have %d elements!", STATEACTIONDIM );
+    
+    double meanWeight;
+    int transitions = session.agent->reevaluate( mxGetPr( prhs[2] ), mxGetScalar( prhs[3] ), mxGetScalar( prhs[4] ),
+                                                 meanWeight );
+    
+    plhs[0] = mxCreateStructMatrix( 1, 1, 0, 0 );
+    mxAddField( plhs[0], "transitions" );
+    mxSetField( plhs[0], 0, "transitions", mxCreateDoubleScalar( transitions ) );
+    mxAddField( plhs[0], "meanWeight" );
+    mxSetField( plhs[0], 0, "meanWeight", mxCreateDoubleScalar( meanWeight ) );
+    
+  } else if( !strcmp( command, "train" ) ) {
+    
+    mxAssert( nlhs <= 2 && nrhs == 6, "Wrong number of arguments!" );
+    Session & session = getSession( prhs[1] );
+    
+    TrainingOptions options;
+    parseTrainingOptions( prhs[5], options );
+    plhs[0] = train( session, prhs[2], prhs[3], prhs[4], options );
+    if( nlhs == 2 ) plhs[1] = session.environment->createReturnStruct();
+    
+  } else if( !strcmp( command, "destroy" ) ) {
+    
+    mxAssert( nlhs == 0 && nrhs == 2, "Wrong number of arguments!" );
+    int slot = findSession( prhs[1] );
+    if( slot >= 0 ) destroySession( slot );
+    
+  } else {
+    mexErrMsgIdAndTxt( "MexTetrisNAC:invalidCommand", "MexTetrisNAC: unknown command '%s'!", command );
+  }
+}
+
+
+
+
+void mexFunction(
+    int nlhs, mxArray * plhs[],
+    int nrhs, const mxArray * prhs[])
+{
+  const mxArray * environmentData;
+  const mxArray * agentData;
+  const mxArray * stopConds;
+  const mxArray * episodeStateIn = 0;
+  
+  // clear profiling counters from previous calls
+  PROFILE_RESET();
+  
+  // session commands
+  if( nrhs >= 1 && mxIsChar( prhs[0] ) ) {
+    char command[16];
+    mxGetString( prhs[0], command, sizeof(command) );
+    if( !strcmp( command, "evaluate" ) ) {
+      mxAssert( nlhs <= 1 && nrhs == 6, "Wrong number of arguments!" );
+      plhs[0] = evaluate( prhs[1], prhs[2], prhs[3], (int)mxGetScalar( prhs[4] ), (int)mxGetScalar( prhs[5] ) );
+    } else if( !strcmp( command, "compare" ) ) {
+      mxAssert( nlhs <= 1 && nrhs == 7, "Wrong number of arguments!" );
+      char engine[16];
+      if( mxGetString( prhs[5], engine, sizeof(engine) ) )
+        mexErrMsgIdAndTxt( "MexTetrisNAC:invalidEngine", "MexTetrisNAC: invalid engine name!" );
+      plhs[0] = compare( prhs[1], prhs[2], prhs[3], (int)mxGetScalar( prhs[4] ), engine, mxGetScalar( prhs[6] ) );
+    } else if( !strcmp( command, "rollouts" ) ) {
+      mxAssert( nlhs <= 1 && nrhs == 5, "Wrong number of arguments!" );
+      plhs[0] = rollouts( prhs[1], prhs[2], prhs[3], prhs[4] );
+    } else if( !strncmp( command, "farm", 4 ) ) {
+      char name[256];
+      if( nrhs < 2 || mxGetString( prhs[1], name, sizeof(name) ) )
+        mexErrMsgIdAndTxt( "MexTetrisNAC:invalidFarm", "MexTetrisNAC: invalid farm name!" );
+      if( !strcmp( command, "farmCreate" ) ) {
+        mxAssert( nlhs == 0 && nrhs == 3, "Wrong number of arguments!" );
+        SharedFarm::create( name, (int)mxGetScalar( prhs[2] ) );
+      } else if( !strcmp( command, "farmSubmit" ) ) {
+        mxAssert( nlhs == 0 && nrhs == 5, "Wrong number of arguments!" );
+        farmSubmit( name, prhs[2], prhs[3], (int)mxGetScalar( prhs[4] ) );
+      } else if( !strcmp( command, "farmWork" ) ) {
+        mxAssert( nlhs <= 1 && nrhs == 5, "Wrong number of arguments!" );
+        plhs[0] = mxCreateDoubleScalar( farmWork( name, prhs[2], prhs[3], prhs[4] ) );
+      } else if( !strcmp( command, "farmQuery" ) ) {
+        mxAssert( nlhs <= 1 && nrhs == 2, "Wrong number of arguments!" );
+        plhs[0] = SharedFarm( name ).createReturnStruct();
+      } else if( !strcmp( command, "farmDestroy" ) ) {
+        mxAssert( nlhs == 0 && nrhs == 2, "Wrong number of arguments!" );
+        SharedFarm::destroy( name );
+      } else {
+        mexErrMsgIdAndTxt( "MexTetrisNAC:invalidCommand", "MexTetrisNAC: unknown command '%s'!", command );
+      }
+    } else {
+      sessionFunction( command, nlhs, plhs, nrhs, prhs );
+    }
+    return;
+  }
+  
+  // check and get args
+  mxAssert( (nlhs == 2 || nlhs == 3) && (nrhs == 3 || nrhs == 4), "Wrong number of arguments!" );
+  environmentData = prhs[0];
+  agentData = prhs[1];
+  stopConds = prhs[2];
+  if( nrhs == 4 && !mxIsEmpty( prhs[3] ) ) episodeStateIn = prhs[3];
+  
+  // create and init the environment and the agent
+  std::unique_ptr<Tetris> environment = newEnvironment( environmentData, false );
+  std::unique_ptr<NaturalActorCritic> agent = newAgent( agentData );
+  if( !episodeStateIn ) keyEpisode( *environment, *agent, environmentData, 0 );
+  
+  // run
+  runEpisode( *environment, *agent, stopConds, episodeStateIn, nlhs == 3 ? &plhs[2] : 0 );
   
   // create and assign return structs, then return
-  plhs[0] = environment.createReturnStruct();
-  plhs[1] = agent.createReturnStruct();
+  plhs[0] = environment->createReturnStruct();
+  plhs[1] = agent->createReturnStruct();
   return;
 }
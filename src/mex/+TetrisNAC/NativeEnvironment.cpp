@@ -0,0 +1,159 @@
+/* NativeEnvironment.cpp */
+
+
+#include "NativeEnvironment.hpp"
+#include "GraphEnvironment.hpp"
+#include "GridEnvironment.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <cstring>
+using std::strcmp;
+
+#include <algorithm>
+using std::fill;
+
+
+
+
+NativeEnvironment::NativeEnvironment( mxArray * rstream, int observationDim, int actionDim, int maxActions ) :
+  terminalState( true ),
+  observationDim( observationDim ),
+  actionDim( actionDim ),
+  maxActions( maxActions ),
+  totalReward( 0.0 ),
+  rstream( rstream ),
+  keyed( false )
+{
+  this->stepData.transitionReward = 0.0;
+  this->stepData.observation.assign( observationDim, 0.0 );
+  this->stepData.actions.assign( maxActions * actionDim, 0.0 );
+  this->stepData.isActionTerminal.assign( maxActions, 0 );
+  this->stepData.actionDim = actionDim;
+  this->stepData.actionCount = 0;
+}
+
+
+NativeEnvironment * NativeEnvironment::create( const mxArray * environmentData )
+{
+  const mxArray * typeField = mxGetField(environmentData, 0, "type");
+  char type[16] = "";
+  if( !typeField || mxGetString( typeField, type, sizeof(type) ) )
+    mexErrMsgIdAndTxt( "NativeEnvironment:invalidType", "NativeEnvironment: the environment type must be given!" );
+  
+  if( !strcmp( type, "graph" ) ) return new GraphEnvironment( environmentData );
+  if( !strcmp( type, "grid" ) ) return new GridEnvironment( environmentData );
+  
+  mexErrMsgIdAndTxt( "NativeEnvironment:invalidType", "NativeEnvironment: unknown environment type '%s'!", type );
+  return 0;
+}
+
+
+void NativeEnvironment::keyStream( unsigned long long seed, unsigned long long episode )
+{
+  // the environment stream has the purpose of the Tetris piece stream
+  this->keyedStream.setKey( seed, episode, PhiloxRandStream::RS_PIECES );
+  this->keyed = true;
+}
+
+
+void NativeEnvironment::newEpisode()
+{
+  resetState();
+  this->terminalState = false;
+  this->totalReward = 0.0;
+  generateStepData();
+  this->stepData.transitionReward = 0.0;
+}
+
+
+double NativeEnvironment::step( int action )
+{
+  mxAssert( !this->terminalState && action >= 0 && action < this->stepData.actionCount, "Invalid action!" );
+  
+  double reward = advanceState( action );
+  this->terminalState = checkEndCondition();
+  if( this->terminalState ) generateTerminalStepData();
+  else generateStepData();
+  
+  this->stepData.transitionReward = reward;
+  this->totalReward += reward;
+  return reward;
+}
+
+
+mxArray * NativeEnvironment::createReturnStruct()
+{
+  mxArray * s = mxCreateStructMatrix( 1, 1, 0, 0 );
+  
+  // add return
+  mxAddField( s, "return" );
+  mxSetField( s, 0, "return", mxCreateDoubleScalar( this->totalReward ) );
+  
+  // add observation log (not supported, always empty)
+  mxAddField( s, "observationLog" );
+  mxSetField( s, 0, "observationLog", mxCreateDoubleMatrix( 0, this->observationDim, mxREAL ) );
+  
+  fillReturnStruct( s );
+  return s;
+}
+
+
+
+
+/* protected methods */
+
+
+const double * NativeEnvironment::getArray( const mxArray * environmentData, const char * name, size_t elements )
+{
+  const mxArray * field = mxGetField(environmentData, 0, name);
+  if( !field || !mxIsDouble( field ) || mxGetNumberOfElements( field ) != elements )
+    mexErrMsgIdAndTxt( "NativeEnvironment:invalidData", "NativeEnvironment: %s must be a double array of %d elements!",
+                       name, (int)elements );
+  return mxGetPr( field );
+}
+
+
+int NativeEnvironment::randDiscretePdf( const double * p, int n )
+{
+  // cs = cumsum(p); cs = cs ./ cs(end); i = find( rand < cs )
+  double total = 0.0;
+  for( int i = 0 ; i < n ; i++ ) total += p[i];
+  
+  double r = rand();
+  double sum = 0.0;
+  for( int i = 0 ; i < n ; i++ ) {
+    sum += p[i];
+    if( r < sum / total ) return i;
+  }
+  return n - 1;   // in case of numerical errors
+}
+
+
+void NativeEnvironment::generateTabularStepData( int observation, int actionCount, const char * terminalActions )
+{
+  mxAssert( observation >= 0 && observation < this->observationDim && actionCount <= this->maxActions &&
+            actionCount * this->observationDim <= this->actionDim, "Invalid tabular state!" );
+  StepData & s = this->stepData;
+  
+  fill( s.observation.begin(), s.observation.end(), 0.0 );
+  s.observation[observation] = 1.0;
+  
+  // clear only the rows of the previous step
+  fill( s.actions.begin(), s.actions.begin() + s.actionCount * this->actionDim, 0.0 );
+  for( int a = 0 ; a < actionCount ; a++ ) {
+    s.actions[a * this->actionDim + a * this->observationDim + observation] = 1.0;
+    s.isActionTerminal[a] = terminalActions ? terminalActions[a] : 0;
+  }
+  s.actionCount = actionCount;
+}
+
+
+void NativeEnvironment::generateTerminalStepData()
+{
+  StepData & s = this->stepData;
+  fill( s.observation.begin(), s.observation.end(), 0.0 );
+  fill( s.actions.begin(), s.actions.begin() + s.actionCount * this->actionDim, 0.0 );
+  s.actionCount = 0;
+}
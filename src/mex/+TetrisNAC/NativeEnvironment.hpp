@@ -0,0 +1,138 @@
+/* NativeEnvironment.hpp
+ *
+ * Interface of the native environments other than Tetris, for the generic natural actor-critic agent
+ * (GenericActorCritic, run by MexGenericNAC). Unlike Tetris, whose dimensions are compile-time constants, the
+ * observation and action feature dimensions and the number of actions of a state are given at runtime, and the step
+ * data is sized when the environment is created.
+ *
+ * As in Environment.m, newEpisode() and step() are implemented here on top of the abstract methods resetState(),
+ * advanceState(), checkEndCondition() and generateStepData() of the environment classes. As in Tetris, terminal states
+ * are signaled by terminalState, with a zero observation and no actions in the step data. Environments are created with
+ * create(), which selects the class by the field 'type' of environmentData:
+ *
+ *   'graph'  GraphEnvironment (GraphGeneric.m and its subclasses)
+ *   'grid'   GridEnvironment (GridEpisodicBasic.m)
+ *
+ * The random numbers are drawn from the Matlab stream environmentData.rstream, or from the counter-based stream of an
+ * experiment seed and an episode index if keyed (see keyStream()).
+ */
+#ifndef NATIVEENVIRONMENT_HPP
+#define NATIVEENVIRONMENT_HPP
+
+
+#include "../MatlabRandStream.hpp"
+#include "../PhiloxRandStream.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <vector>
+
+
+
+
+class NativeEnvironment {
+  
+public:
+  
+  /* Data structure for passing information from the environment to the agent, as Tetris::StepData but with dynamic
+   * dimensions. actions holds the features of the available actions row by row (actionCount x actionDim). */
+  struct StepData {
+    double transitionReward;
+    std::vector<double> observation;
+    std::vector<double> actions;
+    std::vector<char> isActionTerminal;
+    int actionDim;
+    int actionCount;
+    
+    // the action features, as accessed by SoftmaxPolicy
+    int getActionDim() const { return this->actionDim; }
+    const double * getAction( int a ) const { return &this->actions[a * this->actionDim]; }
+  };
+  
+  // outbound data for the current state
+  StepData stepData;
+  
+  // whether in terminal state
+  bool terminalState;
+  
+  
+protected:
+  
+  // dimensions: observation features, action features and the maximum number of actions of a state
+  int observationDim, actionDim, maxActions;
+  
+  // sum of the rewards during the episode
+  double totalReward;
+  
+  // random number generators: the Matlab stream, or the counter-based stream if keyed (see keyStream())
+  MatlabRandStream rstream;
+  PhiloxRandStream keyedStream;
+  bool keyed;
+  
+  // draw a random number from the current stream
+  double rand() { return this->keyed ? this->keyedStream.rand() : this->rstream.rand(); }
+  
+  // draw an index from the unnormalized discrete distribution p (n elements) with a single random number, exactly as
+  // util/randDiscretePdf.m
+  int randDiscretePdf( const double * p, int n );
+  
+  // the data of a double array field of environmentData with the given number of elements. raises a Matlab error if
+  // the field is missing or has a different size.
+  static const double * getArray( const mxArray * environmentData, const char * name, size_t elements );
+  
+  /* Generate the step data of a tabular state: observation is the index of a one-hot observation vector, and action a
+   * (of actionCount) has the observation vector in block a of its features, as in GraphGeneric.getAvailableActions().
+   * Actions flagged in terminalActions (actionCount elements, or null for none) end the episode. */
+  void generateTabularStepData( int observation, int actionCount, const char * terminalActions );
+  
+  // generate the step data of a terminal state
+  void generateTerminalStepData();
+  
+  // reset the state at the beginning of an episode
+  virtual void resetState() = 0;
+  
+  // advance the state with the action index action (0-based). returns the reward of the transition.
+  virtual double advanceState( int action ) = 0;
+  
+  // whether the state is terminal
+  virtual bool checkEndCondition() = 0;
+  
+  // generate the step data of a nonterminal state (except for the reward)
+  virtual void generateStepData() = 0;
+  
+  
+public:
+  
+  // the dimensions are fixed at construction
+  NativeEnvironment( mxArray * rstream, int observationDim, int actionDim, int maxActions );
+  virtual ~NativeEnvironment() {}
+  
+  // create an environment of the class given in environmentData.type. raises a Matlab error if the type is unknown.
+  static NativeEnvironment * create( const mxArray * environmentData );
+  
+  int getObservationDim() const { return this->observationDim; }
+  int getActionDim() const { return this->actionDim; }
+  
+  // draw the random numbers from the counter-based stream of the given experiment seed and episode index, instead of
+  // the Matlab stream. call before newEpisode().
+  void keyStream( unsigned long long seed, unsigned long long episode );
+  
+  // start a new episode
+  void newEpisode();
+  
+  // take a step with the action index action (0-based). returns the immediate reward.
+  double step( int action );
+  
+  // creates the return struct (return and observationLog, plus the fields of fillReturnStruct())
+  mxArray * createReturnStruct();
+  
+  // add the environment-specific statistics to the return struct
+  virtual void fillReturnStruct( mxArray * s ) {}
+  
+};
+
+
+
+
+#endif
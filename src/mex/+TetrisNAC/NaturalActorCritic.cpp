@@ -1,17 +1,19 @@
 /* NaturalActorCritic.cpp
  *
  * NOTE: learning and acting are in reverse order in step() when compared to the Matlab implementation. This makes no
- * difference as long as policy updates are performed only in terminal states.
+ * difference as long as policy updates are performed only in terminal states. The online actor updates are therefore
+ * made at the beginning of step(), before acting, so that the compatible features of each learned transition are
+ * those of the policy that selected its action.
  */
 
 
 #include "NaturalActorCritic.hpp"
+#include "SoftmaxPolicy.hpp"
 #include "Critic.hpp"
-#include "LSTDLambda.hpp"
-#include "LSPELambda.hpp"
-#include "FullTDLambda.hpp"
+#include "CriticPipeline.hpp"
 #include "Configuration.hpp"
 #include "../MatlabRandStream.hpp"
+#include "../Profiler.hpp"
 
 #include "matrix.h"
 
@@ -24,63 +26,288 @@ using std::memset;
 
 #include <cmath>
 using std::exp;
+using std::sqrt;
 
 
 
 
-NaturalActorCritic::NaturalActorCritic( mxArray * rstream, int criticClass, bool learning,
+NaturalActorCritic::NaturalActorCritic( mxArray * rstream, int criticClass, int petersTrickMode, bool learning,
                                         int thetaDim, const double * theta, double gamma, double lambda, double tau ) :
-  critic( 0 ),
   rstream( rstream ),
+  keyed( false ),
   learning( learning ),
   thetaDim( thetaDim ),
   theta( theta ),
-  tau( tau )
+  tau( tau ),
+  rejectTerminalActions( REJECT_TERMINAL_ACTIONS ),
+  petersTrickMode( (PetersTrickMode)petersTrickMode ),
+  criticClass( criticClass ),
+  pipeline( 0 ),
+  store( 0 ),
+  generation( 0 ),
+  episodeCritic( 0 ),
+  episodeStatistics( 0 ),
+  onlineInterval( 0 ),
+  onlineSteps( 0 ),
+  critic( 0 )
 {
+  if( petersTrickMode != PTM_OFF && petersTrickMode != PTM_ON && petersTrickMode != PTM_CORRECTED )
+    mexErrMsgIdAndTxt( "NaturalActorCritic:invalidPetersTrickMode", "NaturalActorCritic: Unknown Peters' trick mode!" );
+  if( petersTrickMode == PTM_CORRECTED && criticClass != Critic::CC_LSTD )
+    mexErrMsgIdAndTxt( "NaturalActorCritic:invalidPetersTrickMode",
+                       "NaturalActorCritic: The corrected Peters' trick is implemented only in LSTDLambda!" );
+  
   // create the critic
-  switch( (Critic::CriticClass)criticClass ) {
-    case Critic::CC_LSTD:
-      this->critic = new LSTDLambda( STATEDIM + STATEACTIONDIM, gamma, lambda );
-      break;
-    case Critic::CC_LSPE:
-      this->critic = new LSPELambda( STATEDIM + STATEACTIONDIM, gamma, lambda );
-      break;
-    case Critic::CC_FULLTD:
-      this->critic = new FullTDLambda( STATEDIM + STATEACTIONDIM, gamma, lambda );
-      break;
-    default:
-      mxAssert( false, "Invalid critic class id!" );
-  };
+  this->critic = Critic::create( criticClass, STATEDIM + STATEACTIONDIM, gamma, lambda );
+  
+  this->critic->setPetersTrickMode( this->petersTrickMode );
+  this->critic->setStateDim( STATEDIM );
   
   // the policy gradient part of phi1 in the critic is always zero. set the entire phi1 to zero here and do not touch
   // the gradient part after this.
-  memset( critic->phi1, 0, sizeof(critic->phi1) );
+  memset( critic->phi1, 0, this->critic->getVDim() * sizeof(double) );
 }
 
 NaturalActorCritic::~NaturalActorCritic()
 {
-  // delete the critic
+  // stop the learner thread and delete the critics
+  delete this->pipeline; this->pipeline = 0;
+  delete this->store; this->store = 0;
   delete this->critic; this->critic = 0;
+  for( int i = 0 ; i < (int)this->sweepCritics.size() ; i++ ) delete this->sweepCritics[i];
+  this->sweepCritics.clear();
+  delete this->episodeCritic; this->episodeCritic = 0;
+  delete this->episodeStatistics; this->episodeStatistics = 0;
+}
+
+
+void NaturalActorCritic::makePersistent()
+{
+  sync();
+  this->critic->makePersistent();
+  for( int i = 0 ; i < (int)this->sweepCritics.size() ; i++ ) this->sweepCritics[i]->makePersistent();
+  if( this->episodeCritic ) this->episodeCritic->makePersistent();
+}
+
+
+void NaturalActorCritic::addSweepCritic( int criticClass, double gamma, double lambda )
+{
+  if( this->petersTrickMode == PTM_CORRECTED && criticClass != Critic::CC_LSTD )
+    mexErrMsgIdAndTxt( "NaturalActorCritic:invalidPetersTrickMode",
+                       "NaturalActorCritic: The corrected Peters' trick is implemented only in LSTDLambda!" );
+  
+  Critic * critic = Critic::create( criticClass, STATEDIM + STATEACTIONDIM, gamma, lambda );
+  critic->setPetersTrickMode( this->petersTrickMode );
+  critic->setStateDim( STATEDIM );
+  memset( critic->phi1, 0, critic->getVDim() * sizeof(double) );
+  
+  this->sweepCritics.push_back( critic );
+  if( this->pipeline ) this->pipeline->addCritic( critic );
+}
+
+
+void NaturalActorCritic::resetCritics()
+{
+  sync();
+  this->critic->reset();
+  for( int i = 0 ; i < (int)this->sweepCritics.size() ; i++ ) this->sweepCritics[i]->reset();
+  if( this->episodeCritic ) this->episodeCritic->reset();
+  if( this->episodeStatistics ) this->episodeStatistics->clear();
+}
+
+void NaturalActorCritic::forgetCritics( double beta )
+{
+  sync();
+  this->critic->forget( beta );
+  for( int i = 0 ; i < (int)this->sweepCritics.size() ; i++ ) this->sweepCritics[i]->forget( beta );
+}
+
+
+void NaturalActorCritic::attach( mxArray * rstream, bool learning, int thetaDim, const double * theta, double tau )
+{
+  this->rstream.setStream( rstream );
+  this->keyed = false;
+  this->learning = learning;
+  this->thetaDim = thetaDim;
+  this->theta = theta;
+  this->tau = tau;
+}
+
+
+void NaturalActorCritic::setPipelined( bool pipelined )
+{
+  if( pipelined && !this->pipeline ) {
+    this->pipeline = new CriticPipeline( this->critic, STATEDIM );
+    PROFILE_ALLOCATION( sizeof(CriticPipeline) );
+    for( int i = 0 ; i < (int)this->sweepCritics.size() ; i++ ) this->pipeline->addCritic( this->sweepCritics[i] );
+    if( this->episodeCritic ) this->pipeline->addCritic( this->episodeCritic );
+  } else if( !pipelined && this->pipeline ) {
+    delete this->pipeline; this->pipeline = 0;
+  }
+}
+
+
+void NaturalActorCritic::sync()
+{
+  if( this->pipeline ) this->pipeline->sync();
+}
+
+
+void NaturalActorCritic::keyStream( unsigned long long seed, unsigned long long episode )
+{
+  this->keyedStream.setKey( seed, episode, PhiloxRandStream::RS_ACTIONS );
+  this->keyed = true;
+}
+
+
+void NaturalActorCritic::setTransitionCapacity( int capacity )
+{
+  if( capacity > 0 && !this->store ) {
+    this->store = new TransitionStore( capacity );
+    PROFILE_ALLOCATION( sizeof(TransitionStore) );
+  } else if( capacity > 0 ) {
+    this->store->setCapacity( capacity );
+  } else {
+    delete this->store; this->store = 0;
+  }
+}
+
+
+void NaturalActorCritic::setEpisodeStatistics( bool enabled, const char * path )
+{
+  // keep the current record if the settings are unchanged
+  if( !enabled || !this->episodeStatistics || this->episodeStatistics->getPath() != (path ? path : "") ) {
+    delete this->episodeStatistics; this->episodeStatistics = 0;
+  }
+  if( enabled && !this->episodeStatistics ) {
+    this->episodeStatistics = new EpisodeStatistics( this->criticClass, VDIM, path );
+    PROFILE_ALLOCATION( sizeof(EpisodeStatistics) );
+  }
+  if( enabled == (this->episodeCritic != 0) ) return;
+  
+  // the pipeline cannot drop a critic, so restart it with the new set of critics
+  const bool pipelined = this->pipeline != 0;
+  setPipelined( false );
+  if( enabled ) {
+    this->episodeCritic = Critic::create( this->criticClass, STATEDIM + STATEACTIONDIM, this->critic->getGamma(),
+                                          this->critic->getLambda() );
+    this->episodeCritic->setPetersTrickMode( this->petersTrickMode );
+    this->episodeCritic->setStateDim( STATEDIM );
+    memset( this->episodeCritic->phi1, 0, this->episodeCritic->getVDim() * sizeof(double) );
+  } else {
+    delete this->episodeCritic; this->episodeCritic = 0;
+  }
+  setPipelined( pipelined );
+}
+
+
+void NaturalActorCritic::recordEpisode( double episodeReturn, double steps )
+{
+  if( !this->episodeStatistics || !this->learning ) return;
+  sync();
+  this->episodeStatistics->record( this->keyed ? (double)this->keyedStream.getEpisode() : mxGetNaN(),
+                                   episodeReturn, steps, *this->episodeCritic );
+}
+
+
+void NaturalActorCritic::updateActor( ActorUpdateOptions & options, double * theta, double & gradientNorm,
+                                      double & cnd )
+{
+  // solve the critic: the advantage part of V is the natural gradient
+  sync();
+  double V[VDIM];
+  this->critic->solve( options.solver, V, cnd );
+  const double * Q = &V[STATEDIM];
+  
+  // stepsize
+  double stepsize = options.stepsizeSchedule ?
+    options.stepsize[0] / (options.actorIteration + options.stepsize[1]) : options.stepsize[0];
+  
+  // actor iteration, as in AgentNaturalActorCritic.iterateActor()
+  double Qnorm = 0.0, thetaNorm = 0.0;
+  for( int i = 0 ; i < STATEACTIONDIM ; i++ ) {
+    theta[i] = options.beta * theta[i] + stepsize * (options.QTarget ? Q[i] - theta[i] : Q[i]);
+    Qnorm += Q[i] * Q[i];
+    thetaNorm += theta[i] * theta[i];
+  }
+  thetaNorm = sqrt( thetaNorm );
+  if( thetaNorm > options.thetaC )
+    for( int i = 0 ; i < STATEACTIONDIM ; i++ ) theta[i] *= options.thetaC / thetaNorm;
+  
+  // finalize (LSPE: the next iteration starts from the current solution) and forget
+  memcpy( options.solver.w, V, sizeof(V) );
+  forgetCritics( options.criticBeta );
+  policyUpdated();
+  options.actorIteration++;
+  
+  gradientNorm = sqrt( Qnorm );
+}
+
+
+void NaturalActorCritic::setOnlineUpdates( int interval, const ActorUpdateOptions & options )
+{
+  mxAssert( interval <= 0 || this->thetaDim == STATEACTIONDIM, "Unexpected theta dimension!" );
+  this->onlineInterval = interval > 0 ? interval : 0;
+  this->onlineOptions = options;
+  
+  // act on a copy of the attached theta
+  if( this->onlineInterval > 0 ) {
+    memcpy( this->onlineTheta, this->theta, sizeof(this->onlineTheta) );
+    this->theta = this->onlineTheta;
+  }
 }
 
 
 void NaturalActorCritic::newEpisode()
 {
   this->firstStep = true;
+  this->onlineSteps = 0;
+  this->onlineLog.clear();
+  if( this->store && this->learning ) this->store->newEpisode( this->generation );
+  
+  // the episode critic starts afresh on each episode
+  if( this->episodeCritic ) {
+    sync();
+    this->episodeCritic->reset();
+  }
+  
+  if( this->pipeline ) this->pipeline->pushNewEpisode();
+  else {
+    this->critic->newEpisode();
+    for( int i = 0 ; i < (int)this->sweepCritics.size() ; i++ ) this->sweepCritics[i]->newEpisode();
+    if( this->episodeCritic ) this->episodeCritic->newEpisode();
+  }
 }
 
 
 int NaturalActorCritic::step( const Tetris::StepData & stepData )
 {
+  if( this->keyed ) return step( stepData, this->keyedStream );
+  else return step( stepData, this->rstream );
+}
+
+int NaturalActorCritic::step( const Tetris::StepData & stepData, RandStream & rng )
+{
+  // update the actor before acting, once enough transitions have been learned
+  if( this->learning && this->onlineInterval > 0 && this->onlineSteps >= this->onlineInterval ) onlineUpdate();
+  
   // decide an action for the current step
-  this->action = act( stepData );
+  this->action = act( stepData, rng );
   
   // learn?
   if( this->learning ) {
     
+    // record the step for off-policy re-evaluation
+    if( this->store )
+      this->store->record( stepData, this->action,
+                           this->action >= 0 ? this->actionProbabilities[this->action] : 1.0 );
+    
     // learn from the previous transition if not the first step
-    if( !this->firstStep ) learn( this->prevStepData, this->prevActionProbabilities, this->prevAction,
-            stepData, this->actionProbabilities, this->action );
+    if( !this->firstStep ) {
+      learn( this->prevStepData, this->prevActionProbabilities, this->prevAction,
+             stepData, this->actionProbabilities, this->action );
+      this->onlineSteps++;
+    }
 
     // shift the current state to appear as the previous state
     memcpy( &this->prevStepData, &stepData, sizeof(this->prevStepData) );
@@ -97,8 +324,70 @@ int NaturalActorCritic::step( const Tetris::StepData & stepData )
 }
 
 
+int NaturalActorCritic::reevaluate( const double * theta, double tau, double truncation, double & meanWeight )
+{
+  sync();
+  
+  int transitions = 0;
+  double weightSum = 0.0;
+  
+  // the step data and action probabilities of the current (k) and next (1 - k) step
+  Tetris::StepData s[2];
+  double pr[2][MAXACTIONS];
+  
+  for( int i = 0 ; this->store && i < this->store->episodeCount() ; i++ ) {
+    const TransitionStore::Episode & e = this->store->episode( i );
+    if( e.generation >= this->generation || e.steps.size() < 2 ) continue;
+    
+    this->critic->newEpisode();
+    int k = 0;
+    TransitionStore::load( e, 0, s[k] );
+    computeActionProbabilities( s[k], theta, tau, this->rejectTerminalActions, pr[k] );
+    
+    for( int t = 0 ; t + 1 < (int)e.steps.size() ; t++, k = 1 - k ) {
+      const TransitionStore::Step & step0 = e.steps[t];
+      const TransitionStore::Step & step1 = e.steps[t+1];
+      TransitionStore::load( e, t + 1, s[1-k] );
+      computeActionProbabilities( s[1-k], theta, tau, this->rejectTerminalActions, pr[1-k] );
+      
+      // per-decision importance weight of the action in phi0
+      double rho = step0.behaviorProbability > 0.0 ? pr[k][step0.action] / step0.behaviorProbability : 0.0;
+      if( rho > truncation ) rho = truncation;
+      
+      // fill in the input registers as learn() does, with the compatible features of the new policy
+      double * phi0 = this->critic->phi0;
+      double * phi1 = this->critic->phi1;
+      memcpy( phi0, s[k].observation, sizeof(s[k].observation) );
+      memcpy( phi1, s[1-k].observation, sizeof(s[1-k].observation) );
+      SoftmaxPolicy::computeGradient( s[k], pr[k], step0.action, &phi0[STATEDIM] );
+      
+      // without Peters' trick, the gradient part of phi1 depends on the next action, so weight it as well (its
+      // expectation under the new policy is zero, which is what the weighted sample estimates)
+      if( this->petersTrickMode == PTM_OFF ) {
+        if( step1.action >= 0 && step1.behaviorProbability > 0.0 ) {
+          double rho1 = pr[1-k][step1.action] / step1.behaviorProbability;
+          if( rho1 > truncation ) rho1 = truncation;
+          SoftmaxPolicy::computeGradient( s[1-k], pr[1-k], step1.action, &phi1[STATEDIM] );
+          for( int j = STATEDIM ; j < VDIM ; j++ ) phi1[j] *= rho1;
+        } else {
+          memset( &phi1[STATEDIM], 0, STATEACTIONDIM * sizeof(double) );
+        }
+      }
+      
+      this->critic->stepWeighted( s[1-k].transitionReward, rho );
+      weightSum += rho; transitions++;
+    }
+  }
+  
+  meanWeight = transitions > 0 ? weightSum / transitions : mxGetNaN();
+  return transitions;
+}
+
+
 mxArray * NaturalActorCritic::createReturnStruct()
 {
+  sync();
+  
   mxArray * s = mxCreateStructMatrix( 1, 1, 0, 0 );
   mxArray * sc = mxCreateStructMatrix( 1, 1, 0, 0 );
   
@@ -107,12 +396,114 @@ mxArray * NaturalActorCritic::createReturnStruct()
   
   critic->fillReturnStruct( sc );
   
+  // the sweep critics, in the order in which they were added
+  const int sweepCount = (int)this->sweepCritics.size();
+  if( sweepCount > 0 ) {
+    mxArray * sweep = mxCreateCellMatrix( 1, sweepCount );
+    for( int i = 0 ; i < sweepCount ; i++ ) {
+      mxArray * sci = mxCreateStructMatrix( 1, 1, 0, 0 );
+      this->sweepCritics[i]->fillReturnStruct( sci );
+      mxSetCell( sweep, i, sci );
+    }
+    mxAddField( s, "sweepCritics" );
+    mxSetField( s, 0, "sweepCritics", sweep );
+  }
+  
+  // the episode records, unless they went into a file
+  if( this->episodeStatistics && this->episodeStatistics->getPath().empty() ) {
+    mxAddField( s, "episodeStatistics" );
+    mxSetField( s, 0, "episodeStatistics", this->episodeStatistics->createReturnStruct() );
+  }
+  
+  // the log of the online updates, as the log of the native training loop
+  if( this->onlineInterval > 0 ) {
+    const int updates = (int)this->onlineLog.size() / (STATEACTIONDIM + 2);
+    mxArray * theta = mxCreateDoubleMatrix( STATEACTIONDIM, updates, mxREAL );
+    mxArray * gradientNorm = mxCreateDoubleMatrix( 1, updates, mxREAL );
+    mxArray * cond = mxCreateDoubleMatrix( 1, updates, mxREAL );
+    for( int i = 0 ; i < updates ; i++ ) {
+      const double * record = &this->onlineLog[i * (STATEACTIONDIM + 2)];
+      memcpy( &mxGetPr( theta )[i * STATEACTIONDIM], record, STATEACTIONDIM * sizeof(double) );
+      mxGetPr( gradientNorm )[i] = record[STATEACTIONDIM];
+      mxGetPr( cond )[i] = record[STATEACTIONDIM + 1];
+    }
+    mxArray * w = mxCreateDoubleMatrix( VDIM, 1, mxREAL );
+    memcpy( mxGetPr( w ), this->onlineOptions.solver.w, VDIM * sizeof(double) );
+    
+    const char * fieldnames[] = { "theta", "gradientNorm", "cond", "w", "actorIteration" };
+    mxArray * log = mxCreateStructMatrix( 1, 1, 5, fieldnames );
+    mxSetField( log, 0, "theta", theta );
+    mxSetField( log, 0, "gradientNorm", gradientNorm );
+    mxSetField( log, 0, "cond", cond );
+    mxSetField( log, 0, "w", w );
+    mxSetField( log, 0, "actorIteration", mxCreateDoubleScalar( this->onlineOptions.actorIteration ) );
+    mxAddField( s, "onlineUpdates" );
+    mxSetField( s, 0, "onlineUpdates", log );
+  }
+  
   return s;
 }
 
 
 
 
+void NaturalActorCritic::saveState( StateWriter & w )
+{
+  sync();
+  
+  w.write( this->firstStep );
+  w.write( this->prevStepData );
+  w.write( this->action );
+  w.write( this->prevAction );
+  w.write( this->actionProbabilities );
+  w.write( this->prevActionProbabilities );
+  w.write( this->keyed );
+  if( this->keyed ) this->keyedStream.saveState( w );
+  else this->rstream.saveState( w );
+  this->critic->saveState( w );
+  for( int i = 0 ; i < (int)this->sweepCritics.size() ; i++ ) this->sweepCritics[i]->saveState( w );
+  if( this->episodeCritic ) this->episodeCritic->saveState( w );
+  if( this->onlineInterval > 0 ) {
+    w.write( this->onlineTheta );
+    w.write( this->onlineSteps );
+    w.write( this->onlineOptions.actorIteration );
+    w.write( this->onlineOptions.solver.w, VDIM * sizeof(double) );
+    w.write( this->onlineLog.size() );
+    if( !this->onlineLog.empty() ) w.write( &this->onlineLog[0], this->onlineLog.size() * sizeof(double) );
+  }
+}
+
+void NaturalActorCritic::loadState( StateReader & r )
+{
+  sync();
+  
+  r.read( this->firstStep );
+  r.read( this->prevStepData );
+  r.read( this->action );
+  r.read( this->prevAction );
+  r.read( this->actionProbabilities );
+  r.read( this->prevActionProbabilities );
+  r.read( this->keyed );
+  if( this->keyed ) this->keyedStream.loadState( r );
+  else this->rstream.loadState( r );
+  this->critic->loadState( r );
+  for( int i = 0 ; i < (int)this->sweepCritics.size() ; i++ ) this->sweepCritics[i]->loadState( r );
+  if( this->episodeCritic ) this->episodeCritic->loadState( r );
+  if( this->onlineInterval > 0 ) {
+    r.read( this->onlineTheta );
+    r.read( this->onlineSteps );
+    r.read( this->onlineOptions.actorIteration );
+    r.read( this->onlineOptions.solver.w, VDIM * sizeof(double) );
+    size_t logSize;
+    r.read( logSize );
+    this->onlineLog.resize( logSize );
+    if( logSize > 0 ) r.read( &this->onlineLog[0], logSize * sizeof(double) );
+  }
+}
+
+
+
+
 /* private methods */
 
 
@@ -120,89 +511,79 @@ mxArray * NaturalActorCritic::createReturnStruct()
 void NaturalActorCritic::learn( const Tetris::StepData & s0, const double (& pr0)[MAXACTIONS], int a0,
                                 const Tetris::StepData & s1, const double (& pr1)[MAXACTIONS], int a1 )
 {
-  // load the state feature parts of phi0 and phi1 into the critic
-  memcpy( this->critic->phi0, s0.observation, sizeof(s0.observation) );
-  memcpy( this->critic->phi1, s1.observation, sizeof(s1.observation) );
+  PROFILE_SCOPE( PP_LEARN );
+  
+  // fill in the critic input registers, or the next transition in the pipeline
+  CriticPipeline::Transition * transition = this->pipeline ? &this->pipeline->next() : 0;
+  double * phi0 = transition ? transition->phi0 : this->critic->phi0;
+  double * phi1 = transition ? transition->phi1 : this->critic->phi1;
+  
+  // load the state feature parts of phi0 and phi1
+  memcpy( phi0, s0.observation, sizeof(s0.observation) );
+  memcpy( phi1, s1.observation, sizeof(s1.observation) );
   
-  // load the gradient vector part of phi0:
-  //   grad( log( pi(a0|s0) ) ) = phi(s,a) - sum_b( pi(b|s) phi(s,b) )
-  memcpy( &this->critic->phi0[STATEDIM], s0.actions[a0], sizeof(s0.actions[a0]) );
-  for( int action = 0 ; action < s0.actionCount ; action++ )
-    for( int i = 0 ; i < STATEACTIONDIM ; i++ )
-      this->critic->phi0[STATEDIM+i] -= pr0[action] * s0.actions[action][i];
+  // load the gradient vector part of phi0
+  SoftmaxPolicy::computeGradient( s0, pr0, a0, &phi0[STATEDIM] );
   
-  // if Peters' variance reduction trick is not enabled, then load also the gradient vector part of phi1, otherwise do
-  // nothing (the gradient part of phi1 has been zeroed in the constructor)
-  if( PETERS_TRICK_MODE == PTM_OFF ) {
-    memcpy( &this->critic->phi1[STATEDIM], s1.actions[a1], sizeof(s1.actions[a1]) );
-    for( int action = 0 ; action < s1.actionCount ; action++ )
-      for( int i = 0 ; i < STATEACTIONDIM ; i++ )
-        this->critic->phi1[STATEDIM+i] -= pr1[action] * s1.actions[action][i];
+  // if Peters' variance reduction trick is not enabled, then load also the gradient vector part of phi1 (zero in a
+  // terminal state), otherwise do nothing (the gradient part of phi1 has been zeroed in the constructor, and is not
+  // passed through the pipeline)
+  if( this->petersTrickMode == PTM_OFF ) {
+    if( a1 >= 0 ) SoftmaxPolicy::computeGradient( s1, pr1, a1, &phi1[STATEDIM] );
+    else memset( &phi1[STATEDIM], 0, STATEACTIONDIM * sizeof(double) );
   }
   
-  // step the critic
-  critic->step( s1.transitionReward );
+  // step the critic, or hand the transition over to the learner thread
+  if( transition ) {
+    transition->reward = s1.transitionReward;
+    this->pipeline->pushStep();
+  } else {
+    PROFILE_SCOPE( PP_CRITICSTEP );
+    
+    // the sweep critics and the episode critic take the same input (copied before the main critic step, which may use
+    // the registers)
+    const int phi1Dim = this->petersTrickMode == PTM_OFF ? VDIM : STATEDIM;
+    for( int i = 0 ; i < (int)this->sweepCritics.size() ; i++ ) {
+      memcpy( this->sweepCritics[i]->phi0, phi0, VDIM * sizeof(double) );
+      memcpy( this->sweepCritics[i]->phi1, phi1, phi1Dim * sizeof(double) );
+    }
+    if( this->episodeCritic ) {
+      memcpy( this->episodeCritic->phi0, phi0, VDIM * sizeof(double) );
+      memcpy( this->episodeCritic->phi1, phi1, phi1Dim * sizeof(double) );
+    }
+    
+    critic->step( s1.transitionReward );
+    for( int i = 0 ; i < (int)this->sweepCritics.size() ; i++ ) this->sweepCritics[i]->step( s1.transitionReward );
+    if( this->episodeCritic ) this->episodeCritic->step( s1.transitionReward );
+  }
 }
 
 
-int NaturalActorCritic::act( const Tetris::StepData & s )
+void NaturalActorCritic::onlineUpdate()
 {
-  computeActionProbabilities( s );
-  return drawAction( s );
+  double gradientNorm, cnd;
+  updateActor( this->onlineOptions, this->onlineTheta, gradientNorm, cnd );
+  this->onlineLog.insert( this->onlineLog.end(), this->onlineTheta, this->onlineTheta + STATEACTIONDIM );
+  this->onlineLog.push_back( gradientNorm );
+  this->onlineLog.push_back( cnd );
+  this->onlineSteps = 0;
 }
 
 
-void NaturalActorCritic::computeActionProbabilities( const Tetris::StepData & s )
+int NaturalActorCritic::act( const Tetris::StepData & s, RandStream & rng )
 {
-  // set to zero
-  memset( this->actionProbabilities, 0, sizeof(this->actionProbabilities) );
-  
-  // (col)actionProbabilities = ((matrix)actions * (col)theta) / tau   (find maximum value for later use)
-  double maxPr = -Inf;
-  for( int action = 0 ; action < s.actionCount ; action++ ) {
-    if( REJECT_TERMINAL_ACTIONS && s.isActionTerminal[action] ) {
-      // disable
-      this->actionProbabilities[action] = -Inf;
-    } else {
-      // add
-      for( int i = 0 ; i < STATEACTIONDIM ; i++ )
-        this->actionProbabilities[action] += (s.actions[action][i] * this->theta[i]) / this->tau;
-    }
-    // maintain max value
-    if( this->actionProbabilities[action] > maxPr ) maxPr = this->actionProbabilities[action];
-  }
+  PROFILE_SCOPE( PP_ACT );
   
-  // (col)actionProbabilities = exp( (col)actionProbabilities - maxPr ) (avoid overflow, get sum for later use)
-  double sumPr = 0.0;
-  for( int action = 0 ; action < s.actionCount ; action++ ) {
-    this->actionProbabilities[action] = exp( this->actionProbabilities[action] - maxPr );
-    sumPr += this->actionProbabilities[action];
-  }
-  
-  // (col)actionProbabilities = (col)actionProbabilities / sum( (col)actionProbabilities )
-  for( int action = 0 ; action < s.actionCount ; action++ ) {
-    this->actionProbabilities[action] /= sumPr;
-  }
-  
-  // set to the uniform distribution if all actions had -Inf unnormalized probability
-  if( maxPr == -Inf ) {
-    for( int action = 0 ; action < s.actionCount ; action++ )
-      this->actionProbabilities[action] = 1.0 / (double)s.actionCount;
-  }
+  computeActionProbabilities( s, this->theta, this->tau, this->rejectTerminalActions, this->actionProbabilities );
+  return SoftmaxPolicy::drawAction( this->actionProbabilities, s.actionCount, rng );
 }
 
 
-int NaturalActorCritic::drawAction( const Tetris::StepData & s )
+void NaturalActorCritic::computeActionProbabilities( const Tetris::StepData & s, const double * theta, double tau,
+                                                     bool rejectTerminalActions, double (& pr)[MAXACTIONS] )
 {
-  double r = this->rstream.rand();
-  double sum = 0.0;
-  int action;
-  
-  for( action = 0 ; action < s.actionCount ; action++ ) {
-    sum += this->actionProbabilities[action];
-    if( r < sum ) break;
-  }
-  if( action == s.actionCount ) action--;   // in case of numerical errors
-  
-  return action;
+  // the probabilities of the unavailable actions are kept at zero
+  memset( pr, 0, sizeof(pr) );
+  if( rejectTerminalActions ) SoftmaxPolicy::computeActionProbabilities<true>( s, theta, tau, pr );
+  else SoftmaxPolicy::computeActionProbabilities<false>( s, theta, tau, pr );
 }
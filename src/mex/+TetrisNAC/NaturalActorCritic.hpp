@@ -3,6 +3,20 @@
  * NOTE: The implementation uses new and delete calls, which might leak memory if Matlab terminates the mex while
  * fetching more random numbers.
  *
+ * Parameter sweeps: further critics (of any class, with their own gamma and lambda) can be added with addSweepCritic().
+ * They are stepped on exactly the same transitions as the main critic, so the simulation, the action selection and the
+ * compatible features are computed once for all of them, and a sweep over the critic parameters costs a single run.
+ * The sweep critics are not used for the actor; their statistics are returned along with those of the main critic.
+ *
+ * Online actor updates: with setOnlineUpdates(), the actor is updated every K learned transitions within the episode,
+ * from the solution of the main critic at that point, instead of only between episodes. The agent then acts on its
+ * own copy of theta, which starts from the attached theta, and logs theta after each update. Each update forgets the
+ * critic statistics as an update between episodes does (with eNAC, this completes the episode sample so far).
+ *
+ * Episode statistics: with setEpisodeStatistics(), a further critic of the same class and settings as the main critic
+ * accumulates the statistics of the current learning episode alone, and recordEpisode() hands them over to an
+ * EpisodeStatistics record at the end of each episode (see EpisodeStatistics.hpp).
+ *
  * NOTE: Actions leading to termination are handled differently here than in the Matlab implementation. TODO: add an
  * explicit "will terminate" feature to action features and use it in action selection, instead of disabling terminating
  * actions in a hard-coded manner.
@@ -13,17 +27,43 @@
 
 #include "Tetris.hpp"
 #include "Critic.hpp"
+#include "Solver.hpp"
 #include "LSTDLambda.hpp"
 #include "LSPELambda.hpp"
+#include "CriticPipeline.hpp"
+#include "TransitionStore.hpp"
+#include "EpisodeStatistics.hpp"
 #include "../MatlabRandStream.hpp"
+#include "../PhiloxRandStream.hpp"
+
+#include <vector>
+
+
+
+
+/* The settings of an actor update, as in AgentNaturalActorCritic.iterateActor(): the stepsize (with the schedule
+ * stepsize[0] / (actorIteration + stepsize[1]) if stepsizeSchedule), the iteration count, the forgetting factor beta
+ * of theta, the bound thetaC of its norm, whether Q is a target rather than a gradient, the forgetting factor of the
+ * critic statistics and the critic solver options. solver.w is updated to the last solution (the next LSPE iterate). */
+struct ActorUpdateOptions {
+  double stepsize[2];
+  bool stepsizeSchedule;
+  int actorIteration;
+  double beta, thetaC;
+  bool QTarget;
+  double criticBeta;
+  SolverOptions solver;
+};
 
 
 
 
 class NaturalActorCritic {
   
-  // random number generator
+  // random number generators: the Matlab stream, or the counter-based action stream if keyed (see keyStream())
   MatlabRandStream rstream;
+  PhiloxRandStream keyedStream;
+  bool keyed;
   
   // whether learning is enabled
   bool learning;
@@ -37,6 +77,13 @@ class NaturalActorCritic {
   // policy temperature
   double tau;
   
+  // whether actions flagged as terminal are never selected (see setRejectTerminalActions())
+  bool rejectTerminalActions;
+  
+  // the mode for Peters' trick and the class of the main critic, fixed at construction
+  PetersTrickMode petersTrickMode;
+  int criticClass;
+  
   
   // whether a new episode has just begun
   bool firstStep;
@@ -52,13 +99,36 @@ class NaturalActorCritic {
   // next step as the action probabilities of the then-previous step.
   double actionProbabilities[MAXACTIONS], prevActionProbabilities[MAXACTIONS];
   
+  // the learner thread pipeline in pipelined mode, or null (see CriticPipeline.hpp)
+  CriticPipeline * pipeline;
+  
+  // the transitions recorded for off-policy re-evaluation, or null if not recording (see reevaluate())
+  TransitionStore * store;
+  
+  // policy generation, incremented by policyUpdated()
+  int generation;
+  
+  // the critic of the current episode alone and the record of the episodes, or null (see setEpisodeStatistics())
+  Critic * episodeCritic;
+  EpisodeStatistics * episodeStatistics;
+  
+  // online actor updates: the interval (0 if disabled), the update settings, the agent's own theta, the transitions
+  // learned since the previous update and the log of the episode, a (theta, gradientNorm, cond) record per update
+  int onlineInterval;
+  ActorUpdateOptions onlineOptions;
+  double onlineTheta[STATEACTIONDIM];
+  int onlineSteps;
+  std::vector<double> onlineLog;
+  
   
   void learn( const Tetris::StepData & s0, const double (& pr0)[MAXACTIONS], int a0,
               const Tetris::StepData & s1, const double (& pr1)[MAXACTIONS], int a1 );
-  int act( const Tetris::StepData & s );
+  int act( const Tetris::StepData & s, RandStream & rng );
+  void onlineUpdate();
   
-  void computeActionProbabilities( const Tetris::StepData & s );
-  int drawAction( const Tetris::StepData & s );
+  // the policy computations of SoftmaxPolicy.hpp, on the Tetris step data
+  static void computeActionProbabilities( const Tetris::StepData & s, const double * theta, double tau,
+                                          bool rejectTerminalActions, double (& pr)[MAXACTIONS] );
   
   
 public:
@@ -66,21 +136,99 @@ public:
   // critic
   Critic * critic;
   
+  // the critics of a parameter sweep (see addSweepCritic())
+  std::vector<Critic *> sweepCritics;
+  
   
-  NaturalActorCritic( mxArray * rstream, int criticClass, bool learning,
+  /* petersTrickMode is a PetersTrickMode. PTM_CORRECTED requires CC_LSTD: the correction term is implemented only in
+   * the update of A in LSTDLambda. The other critics (LSPE, FullTD, eNAC and the gradient-TD critics) would each need
+   * a correction of their own, and raise NaturalActorCritic:invalidPetersTrickMode instead of silently running as
+   * PTM_ON; use PTM_ON with them. */
+  NaturalActorCritic( mxArray * rstream, int criticClass, int petersTrickMode, bool learning,
                       int thetaDim, const double * theta, double gamma, double lambda, double tau );
   
   ~NaturalActorCritic();
+  
+  // move the Matlab-allocated memory of the critic into persistent memory, so that the object can outlive the current
+  // mex call
+  void makePersistent();
+  
+  // prepare for a new mex call when the object outlives a call: attach to the call's random stream and theta, and
+  // update the settings that may change between calls. The critic statistics are left intact.
+  void attach( mxArray * rstream, bool learning, int thetaDim, const double * theta, double tau );
+  
+  // add a critic of the given class, gamma and lambda that is stepped on the same transitions as the main critic. the
+  // Peters' trick mode of the agent applies (PTM_CORRECTED requires CC_LSTD).
+  void addSweepCritic( int criticClass, double gamma, double lambda );
+  
+  // clear the statistics of all critics, or scale them by beta. resetting also drops the episode records held in
+  // memory, while forgetting leaves them intact.
+  void resetCritics();
+  void forgetCritics( double beta );
+  
+  // set whether actions flagged as terminal are never selected (REJECT_TERMINAL_ACTIONS by default)
+  void setRejectTerminalActions( bool reject ) { this->rejectTerminalActions = reject; }
+  
+  // enable or disable pipelined critic updates in a learner thread. the results are identical in both modes.
+  void setPipelined( bool pipelined );
+  
+  // wait for pending critic updates. in pipelined mode, this must be called before accessing the critic directly.
+  void sync();
 
+  // draw the actions from the counter-based stream of the given experiment seed and episode index, instead of the
+  // Matlab stream, until the next attach()
+  void keyStream( unsigned long long seed, unsigned long long episode );
+  
   // begin a new episode
   void newEpisode();
   
   // take a step and return the index of the selected action
   int step( const Tetris::StepData & stepData );
   
-  // creates the return struct
+  // take a step, drawing the action from the given stream (used to act in several episodes at once)
+  int step( const Tetris::StepData & stepData, RandStream & rng );
+  
+  // record the transitions of learning episodes for off-policy re-evaluation, keeping at most capacity steps. a
+  // capacity of 0 disables recording and drops the recorded transitions.
+  void setTransitionCapacity( int capacity );
+  
+  // record the statistics of each learning episode in memory (if path is null or empty) or append them to the file
+  // (see EpisodeStatistics.hpp). the record is kept if the settings are unchanged. requires a critic class with
+  // additive statistics (LSTD, LSPE or eNAC).
+  void setEpisodeStatistics( bool enabled, const char * path );
+  
+  // record the statistics of a learning episode that has just taken its terminal step, if enabled
+  void recordEpisode( double episodeReturn, double steps );
+  
+  /* Update the actor from the solution of the main critic, as the native training loop does between iterations: solve
+   * the critic, update theta (STATEACTIONDIM elements) in place, forget the statistics of all critics and mark the
+   * policy updated. Returns the norm of the gradient and the condition number. */
+  void updateActor( ActorUpdateOptions & options, double * theta, double & gradientNorm, double & cnd );
+  
+  // update the actor every interval learned transitions within the episodes, starting from the attached theta (call
+  // after attach()). an interval of 0 disables the online updates. requires a critic that supports solve().
+  void setOnlineUpdates( int interval, const ActorUpdateOptions & options );
+  int getOnlineInterval() const { return this->onlineInterval; }
+  
+  // mark the transitions recorded so far as produced by an earlier policy (call after each actor update)
+  void policyUpdated() { this->generation++; }
+  
+  /* Re-evaluate the recorded transitions of earlier policies under the policy (theta, tau): recompute the action
+   * probabilities and the compatible features, and add the transitions to the critic statistics with per-decision
+   * importance weights pi(a|s) / mu(a|s), truncated to at most truncation (Inf for no truncation). Returns the
+   * number of transitions and their mean weight. Requires a critic that supports off-policy updates (LSTDLambda). */
+  int reevaluate( const double * theta, double tau, double truncation, double & meanWeight );
+  
+  // creates the return struct (the statistics of the main critic in the field critic, those of the sweep critics, if
+  // any, in a cell array in the field sweepCritics, the episode records held in memory, if any, in the field
+  // episodeStatistics, and the log of the online updates of the episode, if enabled, in the field onlineUpdates)
   mxArray * createReturnStruct();
   
+  // save and restore the episode state (previous step, action probabilities, critic statistics of all critics,
+  // including the episode critic, the state of the online updates and the random stream position)
+  void saveState( StateWriter & w );
+  void loadState( StateReader & r );
+  
 };
 
 
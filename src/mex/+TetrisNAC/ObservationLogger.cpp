@@ -0,0 +1,142 @@
+/* ObservationLogger.cpp */
+
+
+#include "ObservationLogger.hpp"
+#include "../Profiler.hpp"
+
+#include <cstring>
+using std::memcpy;
+
+
+
+
+ObservationLogger::ObservationLogger( const char * path ) :
+  path( path ? path : "" ),
+  file( 0 ),
+  writing( false ),
+  stopping( false ),
+  failed( false )
+{
+  if( this->path.empty() ) return;
+  
+  this->file = fopen( this->path.c_str(), "wb" );
+  if( !this->file )
+    mexErrMsgIdAndTxt( "ObservationLogger:openFailed", "ObservationLogger: cannot open '%s' for writing!",
+                       this->path.c_str() );
+  this->writer = std::thread( &ObservationLogger::write, this );
+}
+
+ObservationLogger::~ObservationLogger()
+{
+  // write any remaining observations and stop the writer
+  if( this->file ) {
+    if( !this->chunks.empty() ) { hand( this->chunks.back() ); this->chunks.clear(); }
+    {
+      std::lock_guard<std::mutex> lock( this->mutex );
+      this->stopping = true;
+    }
+    this->changed.notify_all();
+    this->writer.join();
+    fclose( this->file ); this->file = 0;
+  }
+  
+  for( size_t i = 0 ; i < this->chunks.size() ; i++ ) delete[] this->chunks[i].data;
+}
+
+
+void ObservationLogger::newChunk()
+{
+  // in streaming mode, the full chunk goes to the writer
+  if( this->file && !this->chunks.empty() ) { hand( this->chunks.back() ); this->chunks.clear(); }
+  
+  Chunk c = { new double[OBSERVATIONLOGCHUNK * STATEDIM], 0 };
+  PROFILE_ALLOCATION( OBSERVATIONLOGCHUNK * STATEDIM * sizeof(double) );
+  this->chunks.push_back( c );
+}
+
+
+void ObservationLogger::flush()
+{
+  if( !this->file ) return;
+  
+  if( !this->chunks.empty() ) { hand( this->chunks.back() ); this->chunks.clear(); }
+  
+  std::unique_lock<std::mutex> lock( this->mutex );
+  while( !this->queue.empty() || this->writing ) this->changed.wait( lock );
+  bool failed = this->failed;
+  lock.unlock();
+  
+  if( failed )
+    mexErrMsgIdAndTxt( "ObservationLogger:writeFailed", "ObservationLogger: writing to '%s' failed!",
+                       this->path.c_str() );
+}
+
+
+void ObservationLogger::clear()
+{
+  for( size_t i = 0 ; i < this->chunks.size() ; i++ ) delete[] this->chunks[i].data;
+  this->chunks.clear();
+}
+
+
+mxArray * ObservationLogger::createArray()
+{
+  flush();
+  
+  int n = 0;
+  for( size_t i = 0 ; i < this->chunks.size() ; i++ ) n += this->chunks[i].rows;
+  
+  mxArray * a = mxCreateDoubleMatrix( n, STATEDIM, mxREAL );
+  double * data = mxGetPr(a);
+  for( int col = 0 ; col < STATEDIM ; col++ )
+    for( size_t i = 0, row = 0 ; i < this->chunks.size() ; row += this->chunks[i].rows, i++ )
+      memcpy( &data[col * n + row], &this->chunks[i].data[col * OBSERVATIONLOGCHUNK],
+              this->chunks[i].rows * sizeof(double) );
+  return a;
+}
+
+
+
+
+/* private methods */
+
+
+void ObservationLogger::hand( const Chunk & chunk )
+{
+  {
+    std::lock_guard<std::mutex> lock( this->mutex );
+    this->queue.push_back( chunk );
+  }
+  this->changed.notify_all();
+}
+
+
+/* The writer thread: write chunks as rows until stopped. */
+void ObservationLogger::write()
+{
+  std::vector<double> rows( OBSERVATIONLOGCHUNK * STATEDIM );
+  
+  std::unique_lock<std::mutex> lock( this->mutex );
+  while( true ) {
+    while( this->queue.empty() && !this->stopping ) this->changed.wait( lock );
+    if( this->queue.empty() ) break;
+    
+    Chunk c = this->queue.front();
+    this->queue.pop_front();
+    this->writing = true;
+    lock.unlock();
+    
+    // transpose into rows and append
+    for( int row = 0 ; row < c.rows ; row++ )
+      for( int col = 0 ; col < STATEDIM ; col++ )
+        rows[row * STATEDIM + col] = c.data[col * OBSERVATIONLOGCHUNK + row];
+    bool ok = fwrite( &rows[0], sizeof(double) * STATEDIM, c.rows, this->file ) == (size_t)c.rows &&
+              fflush( this->file ) == 0;
+    delete[] c.data;
+    
+    lock.lock();
+    this->writing = false;
+    if( !ok ) this->failed = true;
+    this->changed.notify_all();
+  }
+}
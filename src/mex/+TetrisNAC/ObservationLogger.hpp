@@ -0,0 +1,98 @@
+/* ObservationLogger.hpp
+ *
+ * Runtime observation logging for Tetris. The log grows in chunks of OBSERVATIONLOGCHUNK observations, so nothing is
+ * allocated while logging is disabled (no logger exists) and episodes of any length can be logged. The chunks are
+ * stored column-major, so that the log is copied into a Matlab matrix with one memcpy per column and chunk.
+ *
+ * Streaming: If a file name is given, then full chunks are handed over to a background writer thread, which appends
+ * them to the file as rows of STATEDIM doubles in native byte order, and only the chunk being filled is kept in memory.
+ * flush() writes the partial chunk and waits for the writer. The file is truncated when the logger is created, and can
+ * be read in Matlab with
+ *
+ *   observationLog = fread( fid, [STATEDIM, Inf], 'double' )';
+ *
+ * NOTE: The writer thread must not call the Matlab API. Write errors are reported by flush().
+ */
+#ifndef OBSERVATIONLOGGER_HPP
+#define OBSERVATIONLOGGER_HPP
+
+
+#include "Tetris.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+// number of observations per chunk
+#define OBSERVATIONLOGCHUNK 4096
+
+
+
+
+class ObservationLogger {
+  
+  // a chunk (column-major, OBSERVATIONLOGCHUNK x STATEDIM) and the number of observations in it
+  struct Chunk {
+    double * data;
+    int rows;
+  };
+  
+  // in-memory chunks; the last one is being filled. in streaming mode, only the chunk being filled is kept.
+  std::vector<Chunk> chunks;
+  
+  // streaming: the file name, the file, and the chunks waiting to be written
+  std::string path;
+  FILE * file;
+  std::deque<Chunk> queue;
+  bool writing, stopping, failed;
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::thread writer;
+  
+  void write();
+  void hand( const Chunk & chunk );
+  
+  
+public:
+  
+  // log into memory if path is null or empty, otherwise stream into the file
+  ObservationLogger( const char * path );
+  ~ObservationLogger();
+  
+  const std::string & getPath() const { return this->path; }
+  
+  // append an observation
+  void log( const double (& observation)[STATEDIM] )
+  {
+    if( this->chunks.empty() || this->chunks.back().rows == OBSERVATIONLOGCHUNK ) newChunk();
+    Chunk & c = this->chunks.back();
+    for( int col = 0 ; col < STATEDIM ; col++ ) c.data[col * OBSERVATIONLOGCHUNK + c.rows] = observation[col];
+    c.rows++;
+  }
+  
+  // start a new chunk (in streaming mode, hand the full one over to the writer)
+  void newChunk();
+  
+  // streaming: write everything logged so far and wait for the writer
+  void flush();
+  
+  // drop the observations held in memory
+  void clear();
+  
+  // the observations held in memory as an n x STATEDIM matrix (empty in streaming mode, after flushing)
+  mxArray * createArray();
+  
+};
+
+
+
+
+#endif
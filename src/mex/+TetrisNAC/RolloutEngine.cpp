@@ -0,0 +1,226 @@
+/* RolloutEngine.cpp */
+
+
+#include "RolloutEngine.hpp"
+#include "SoftmaxPolicy.hpp"
+#include "../PhiloxRandStream.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <cstring>
+using std::memcpy;
+
+#include <thread>
+#include <functional>
+
+
+
+
+/* private methods */
+
+
+int RolloutEngine::drawAction( const Tetris::StepData & s, RandStream & rng ) const
+{
+  double pr[MAXACTIONS];
+  if( this->rejectTerminalActions )
+    SoftmaxPolicy::computeActionProbabilities<true>( s, this->theta, this->tau, pr );
+  else
+    SoftmaxPolicy::computeActionProbabilities<false>( s, this->theta, this->tau, pr );
+  return SoftmaxPolicy::drawAction( pr, s.actionCount, rng );
+}
+
+
+void RolloutEngine::sampleStates( Tetris & environment )
+{
+  const int states = this->options.states;
+  this->snapshots.resize( states );
+  this->observations.assign( states * STATEDIM, 0.0 );
+  this->actionCounts.assign( states, 0 );
+  this->actions.assign( states * MAXACTIONS * STATEACTIONDIM, 0.0 );
+  
+  // run trajectories until enough states are sampled
+  int sampled = 0;
+  this->episodes = 0;
+  while( sampled < states ) {
+    unsigned long long episode = this->firstEpisode + this->episodes++;
+    PhiloxRandStream actionStream, sampleStream;
+    environment.keyStream( this->seed, episode );
+    actionStream.setKey( this->seed, episode, PhiloxRandStream::RS_ACTIONS );
+    sampleStream.setKey( this->seed, episode, PhiloxRandStream::RS_SAMPLES );
+    environment.newEpisode();
+    
+    double steps = 0;
+    while( !environment.terminalState && steps < this->options.maxSteps && sampled < states ) {
+      
+      // sample the current state?
+      if( sampleStream.rand() < this->options.samplingRate ) {
+        const Tetris::StepData & s = environment.stepData;
+        environment.takeSnapshot( this->snapshots[sampled] );
+        memcpy( &this->observations[sampled * STATEDIM], s.observation, sizeof(s.observation) );
+        this->actionCounts[sampled] = s.actionCount;
+        memcpy( &this->actions[sampled * MAXACTIONS * STATEACTIONDIM], s.actions,
+                s.actionCount * STATEACTIONDIM * sizeof(double) );
+        sampled++;
+      }
+      
+      environment.step( drawAction( environment.stepData, actionStream ) );
+      steps++;
+    }
+  }
+}
+
+
+void RolloutEngine::rollOut( Tetris & environment, int i )
+{
+  const Tetris::Snapshot & start = this->snapshots[i];
+  const int rollouts = this->options.rollouts;
+  
+  // the rollouts j of all actions share their streams
+  unsigned long long firstRollout = (this->firstEpisode << 32) + (unsigned long long)i * rollouts;
+  
+  for( int a = 0 ; a < this->actionCounts[i] ; a++ ) {
+    double sum = 0.0;
+    for( int j = 0 ; j < rollouts ; j++ ) sum += rollout( environment, start, a, firstRollout + j );
+    this->Q[i * MAXACTIONS + a] = sum / rollouts;
+  }
+  
+  double sum = 0.0;
+  for( int j = 0 ; j < rollouts ; j++ ) sum += rollout( environment, start, -1, firstRollout + j );
+  this->V[i] = sum / rollouts;
+}
+
+
+double RolloutEngine::rollout( Tetris & environment, const Tetris::Snapshot & start, int firstAction,
+                               unsigned long long episode )
+{
+  PhiloxRandStream actionStream;
+  environment.keyStream( this->seed, episode, PhiloxRandStream::RS_ROLLOUTPIECES );
+  actionStream.setKey( this->seed, episode, PhiloxRandStream::RS_ROLLOUTACTIONS );
+  environment.restoreSnapshot( start );
+  
+  // discounted rewards of the truncated rollout
+  double ret = 0.0, discount = 1.0;
+  for( int t = 0 ; t < this->options.rolloutLength && !environment.terminalState ; t++ ) {
+    int action = t == 0 && firstAction >= 0 ? firstAction : drawAction( environment.stepData, actionStream );
+    ret += discount * environment.step( action );
+    discount *= this->options.gamma;
+  }
+  
+  // bootstrap from the value function in the last state
+  if( !environment.terminalState && this->options.valueWeights ) {
+    double value = 0.0;
+    for( int k = 0 ; k < STATEDIM ; k++ )
+      value += this->options.valueWeights[k] * environment.stepData.observation[k];
+    ret += discount * value;
+  }
+  
+  return ret;
+}
+
+
+void RolloutEngine::work( Tetris & environment )
+{
+  for( int i = this->nextState++ ; i < this->options.states ; i = this->nextState++ )
+    rollOut( environment, i );
+}
+
+
+
+
+/* public methods */
+
+
+RolloutEngine::RolloutEngine( const double * theta, double tau, bool rejectTerminalActions,
+                              const RolloutOptions & options, int holeDefinition, double terminalBiasValueS,
+                              double terminalBiasValueA ) :
+  theta( theta ),
+  tau( tau ),
+  rejectTerminalActions( rejectTerminalActions ),
+  options( options ),
+  seed( 0 ),
+  firstEpisode( 0 ),
+  episodes( 0 )
+{
+  if( options.states < 1 || options.rolloutLength < 1 || options.rollouts < 1 )
+    mexErrMsgIdAndTxt( "RolloutEngine:invalidOptions",
+                       "RolloutEngine: states, rolloutLength and rollouts must be positive!" );
+  if( !(options.samplingRate > 0.0 && options.samplingRate <= 1.0) || !(options.maxSteps >= 1) )
+    mexErrMsgIdAndTxt( "RolloutEngine:invalidOptions",
+                       "RolloutEngine: samplingRate must be in (0, 1] and maxSteps at least 1!" );
+  if( (unsigned long long)options.states * options.rollouts > 0xFFFFFFFFull )
+    mexErrMsgIdAndTxt( "RolloutEngine:invalidOptions", "RolloutEngine: too many states times rollouts!" );
+  
+  // no more workers than states. the environments must be created here, as their constructor calls the Matlab API.
+  if( this->options.threads < 1 ) this->options.threads = 1;
+  if( this->options.threads > options.states ) this->options.threads = options.states;
+  for( int w = 0 ; w < this->options.threads ; w++ ) {
+    Tetris * environment = new Tetris( 20, 10, 0, 0 );
+    environment->configure( holeDefinition, terminalBiasValueS, terminalBiasValueA );
+    environment->setLogging( false, "" );
+    this->environments.push_back( environment );
+  }
+}
+
+RolloutEngine::~RolloutEngine()
+{
+  for( int w = 0 ; w < (int)this->environments.size() ; w++ ) delete this->environments[w];
+}
+
+
+void RolloutEngine::run( unsigned long long seed, unsigned long long firstEpisode )
+{
+  this->seed = seed;
+  this->firstEpisode = firstEpisode;
+  
+  sampleStates( *this->environments[0] );
+  
+  // unavailable actions are marked with NaN
+  this->Q.assign( this->options.states * MAXACTIONS, mxGetNaN() );
+  this->V.assign( this->options.states, 0.0 );
+  
+  // roll out in the workers, the calling thread being the first one
+  this->nextState = 0;
+  std::vector<std::thread> workers;
+  for( int w = 1 ; w < (int)this->environments.size() ; w++ )
+    workers.push_back( std::thread( &RolloutEngine::work, this, std::ref( *this->environments[w] ) ) );
+  work( *this->environments[0] );
+  for( int w = 0 ; w < (int)workers.size() ; w++ ) workers[w].join();
+}
+
+
+mxArray * RolloutEngine::createReturnStruct() const
+{
+  const int states = this->options.states;
+  
+  const char * fieldnames[] = { "states", "actionCounts", "actions", "Q", "V", "episodes" };
+  mxArray * s = mxCreateStructMatrix( 1, 1, sizeof(fieldnames) / sizeof(fieldnames[0]), fieldnames );
+  
+  // transpose into column-major arrays with a row for each sampled state
+  mxArray * observations = mxCreateDoubleMatrix( states, STATEDIM, mxREAL );
+  mxArray * actionCounts = mxCreateDoubleMatrix( states, 1, mxREAL );
+  mwSize dims[3] = { (mwSize)states, MAXACTIONS, STATEACTIONDIM };
+  mxArray * actions = mxCreateNumericArray( 3, dims, mxDOUBLE_CLASS, mxREAL );
+  mxArray * Q = mxCreateDoubleMatrix( states, MAXACTIONS, mxREAL );
+  mxArray * V = mxCreateDoubleMatrix( states, 1, mxREAL );
+  for( int i = 0 ; i < states ; i++ ) {
+    for( int k = 0 ; k < STATEDIM ; k++ )
+      mxGetPr( observations )[i + k * states] = this->observations[i * STATEDIM + k];
+    mxGetPr( actionCounts )[i] = this->actionCounts[i];
+    for( int a = 0 ; a < MAXACTIONS ; a++ ) {
+      for( int k = 0 ; k < STATEACTIONDIM ; k++ )
+        mxGetPr( actions )[i + (a + k * MAXACTIONS) * states] =
+          this->actions[(i * MAXACTIONS + a) * STATEACTIONDIM + k];
+      mxGetPr( Q )[i + a * states] = this->Q[i * MAXACTIONS + a];
+    }
+    mxGetPr( V )[i] = this->V[i];
+  }
+  
+  mxSetField( s, 0, "states", observations );
+  mxSetField( s, 0, "actionCounts", actionCounts );
+  mxSetField( s, 0, "actions", actions );
+  mxSetField( s, 0, "Q", Q );
+  mxSetField( s, 0, "V", V );
+  mxSetField( s, 0, "episodes", mxCreateDoubleScalar( this->episodes ) );
+  return s;
+}
@@ -0,0 +1,129 @@
+/* RolloutEngine.hpp
+ *
+ * Truncated rollouts for rollout-based approximate policy iteration, as in classification-based modified policy
+ * iteration (CBMPI; Scherrer, Ghavamzadeh, Gabillon & Geist, 2012). A set of start states is sampled from trajectories
+ * of the current policy, and the value of each sampled state and of each action available in it are estimated by
+ * averaging truncated rollouts that follow the policy:
+ *
+ *   Q(s,a) ~ mean( r_0 + gamma r_1 + ... + gamma^(m-1) r_(m-1) + gamma^m w' phi(s_m) )
+ *
+ * where the first action is a in the rollouts of Q(s,a) and drawn from the policy in the rollouts of V(s), m is the
+ * rollout length, phi(s_m) is the observation of the last state and w the given value function weights (the last term
+ * is left out if the rollout reaches a terminal state, or if no weights are given). V is the regression target of the
+ * value function and Q gives the classification targets of the policy.
+ *
+ * The policy is the softmax policy of NaturalActorCritic (theta, tau, and optionally rejecting terminal actions). All
+ * random numbers are drawn from counter-based streams (see PhiloxRandStream.hpp). Trajectory k of the state sampling
+ * draws its pieces, actions and sampling decisions from the streams of episode firstEpisode + k. Rollout j of sampled
+ * state i draws from the rollout streams of episode firstEpisode * 2^32 + i * rollouts + j, which the rollouts j of all
+ * actions of the state share: the actions are compared on common random numbers, which reduces the variance of the
+ * differences between their values. The rollouts are distributed over worker threads, and the results do not depend
+ * on the number of threads.
+ *
+ * NOTE: The workers must not call the Matlab API, which is why the environments are created before the workers start
+ * and the Matlab streams are not supported. In a profiling build (see Profiler.hpp), each worker records into
+ * counters of its own, which are totaled once the workers have been joined.
+ *
+ *   References
+ *
+ *     Scherrer, Ghavamzadeh, Gabillon & Geist (2012). Approximate modified policy iteration.
+ *     Gabillon, Ghavamzadeh & Scherrer (2013). Approximate dynamic programming finally performs well in the game of
+ *       Tetris.
+ */
+#ifndef ROLLOUTENGINE_HPP
+#define ROLLOUTENGINE_HPP
+
+
+#include "Tetris.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <vector>
+#include <atomic>
+
+
+
+
+struct RolloutOptions {
+  int states;                    // number of start states to sample
+  int rolloutLength;             // m
+  int rollouts;                  // rollouts per state and action (and for the state value)
+  double gamma;
+  double samplingRate;           // probability of sampling each visited non-terminal state, in (0, 1]
+  double maxSteps;               // length limit of the sampling trajectories
+  const double * valueWeights;   // STATEDIM value function weights, or null
+  int threads;                   // number of worker threads
+};
+
+
+
+
+class RolloutEngine {
+  
+  // policy
+  const double * theta;
+  double tau;
+  bool rejectTerminalActions;
+  
+  RolloutOptions options;
+  
+  // stream key
+  unsigned long long seed, firstEpisode;
+  
+  // one environment per worker
+  std::vector<Tetris *> environments;
+  
+  // the sampled states
+  std::vector<Tetris::Snapshot> snapshots;
+  
+  // results: per sampled state, the observation, the number of actions and the action features, and the value
+  // estimates (state-major)
+  std::vector<double> observations;
+  std::vector<int> actionCounts;
+  std::vector<double> actions;
+  std::vector<double> Q, V;
+  
+  // trajectories used for sampling
+  int episodes;
+  
+  // index of the next sampled state to roll out, shared by the workers
+  std::atomic<int> nextState;
+  
+  
+  // draw an action of the softmax policy
+  int drawAction( const Tetris::StepData & s, RandStream & rng ) const;
+  
+  // sample the start states from trajectories of the policy (main thread)
+  void sampleStates( Tetris & environment );
+  
+  // run all rollouts of sampled state i in the given environment
+  void rollOut( Tetris & environment, int i );
+  
+  // run a single rollout from a snapshot and return its return. firstAction is -1 to follow the policy from the start.
+  double rollout( Tetris & environment, const Tetris::Snapshot & start, int firstAction, unsigned long long episode );
+  
+  // worker: roll out the states claimed from nextState until none are left
+  void work( Tetris & environment );
+  
+  
+public:
+  
+  /* The environments are configured with the given feature settings. theta (STATEACTIONDIM elements) and
+   * options.valueWeights must stay valid for the lifetime of the object. */
+  RolloutEngine( const double * theta, double tau, bool rejectTerminalActions, const RolloutOptions & options,
+                 int holeDefinition, double terminalBiasValueS, double terminalBiasValueA );
+  ~RolloutEngine();
+  
+  // sample the states and run the rollouts, keying the streams by seed and firstEpisode
+  void run( unsigned long long seed, unsigned long long firstEpisode );
+  
+  // creates the result struct (see 'rollouts' in MexTetrisNAC.cpp)
+  mxArray * createReturnStruct() const;
+  
+};
+
+
+
+
+#endif
@@ -0,0 +1,295 @@
+/* SharedFarm.cpp */
+
+
+#include "SharedFarm.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <cstring>
+using std::memcpy;
+using std::memset;
+using std::strlen;
+
+#include <cstdio>
+#include <new>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+// segment header
+#define FARM_MAGIC 0x4D52414643414E54ULL   // "TNACFARM"
+#define FARM_VERSION 3
+#define FARM_CLOSED 0xFFFFFFFFULL   // the job index of the claim counter while a batch is submitted
+
+
+static_assert( ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+               "SharedFarm requires lock-free atomics to share them across processes" );
+
+
+
+
+/* private methods */
+
+
+void SharedFarm::lock()
+{
+  int expected = 0;
+  while( !this->header->lock.compare_exchange_weak( expected, 1, std::memory_order_acquire ) ) {
+    expected = 0;
+    std::this_thread::yield();
+  }
+}
+
+void SharedFarm::unlock()
+{
+  this->header->lock.store( 0, std::memory_order_release );
+}
+
+
+size_t SharedFarm::segmentSize( int capacity )
+{
+  // the header is padded to a whole number of doubles
+  size_t headerSize = (sizeof(Header) + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+  return headerSize + (capacity + 2 * VDIM * VDIM + VDIM) * sizeof(double);
+}
+
+
+void SharedFarm::objectName( const char * name, char (& object)[256] )
+{
+  if( !name[0] || strlen( name ) > 200 )
+    mexErrMsgIdAndTxt( "SharedFarm:invalidName", "SharedFarm: the name must have 1 to 200 characters!" );
+  snprintf( object, sizeof(object), name[0] == '/' ? "%s" : "/%s", name );
+}
+
+
+
+
+/* public methods */
+
+
+void SharedFarm::create( const char * name, int capacity )
+{
+#ifdef _WIN32
+  mexErrMsgIdAndTxt( "SharedFarm:notSupported", "SharedFarm: shared memory is not supported on this platform!" );
+#else
+  if( capacity < 1 )
+    mexErrMsgIdAndTxt( "SharedFarm:invalidCapacity", "SharedFarm: the capacity must be positive!" );
+  char object[256];
+  objectName( name, object );
+  
+  // replace any earlier segment, so that the processes still mapping it cannot interfere
+  shm_unlink( object );
+  int fd = shm_open( object, O_CREAT | O_EXCL | O_RDWR, 0600 );
+  if( fd < 0 )
+    mexErrMsgIdAndTxt( "SharedFarm:createFailed", "SharedFarm: cannot create the shared memory object '%s'!", object );
+  const size_t size = segmentSize( capacity );
+  void * p = ftruncate( fd, size ) == 0 ? mmap( 0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) : MAP_FAILED;
+  close( fd );
+  if( p == MAP_FAILED ) {
+    shm_unlink( object );
+    mexErrMsgIdAndTxt( "SharedFarm:createFailed", "SharedFarm: cannot map the shared memory object '%s'!", object );
+  }
+  
+  // the segment is zero-filled: no batch, no open jobs
+  Header * header = new (p) Header;
+  header->version = FARM_VERSION;
+  header->VDim = VDIM;
+  header->capacity = capacity;
+  header->claim.store( 0 );
+  header->jobs.store( 0 );
+  header->completed.store( 0 );
+  header->failed.store( 0 );
+  header->lock.store( 0 );
+  header->mergeB = false;
+  header->magic = FARM_MAGIC;
+  munmap( p, size );
+#endif
+}
+
+
+void SharedFarm::destroy( const char * name )
+{
+#ifndef _WIN32
+  char object[256];
+  objectName( name, object );
+  shm_unlink( object );
+#endif
+}
+
+
+SharedFarm::SharedFarm( const char * name ) :
+  header( 0 ),
+  size( 0 )
+{
+#ifdef _WIN32
+  mexErrMsgIdAndTxt( "SharedFarm:notSupported", "SharedFarm: shared memory is not supported on this platform!" );
+#else
+  char object[256];
+  objectName( name, object );
+  int fd = shm_open( object, O_RDWR, 0600 );
+  struct stat st;
+  if( fd < 0 || fstat( fd, &st ) != 0 || (size_t)st.st_size < sizeof(Header) ) {
+    if( fd >= 0 ) close( fd );
+    mexErrMsgIdAndTxt( "SharedFarm:notFound", "SharedFarm: no farm '%s'!", name );
+  }
+  
+  this->size = st.st_size;
+  void * p = mmap( 0, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+  close( fd );
+  if( p == MAP_FAILED )
+    mexErrMsgIdAndTxt( "SharedFarm:mapFailed", "SharedFarm: cannot map the farm '%s'!", name );
+  
+  this->header = (Header *)p;
+  if( this->header->magic != FARM_MAGIC || this->header->version != FARM_VERSION || this->header->VDim != VDIM ||
+      this->size != segmentSize( this->header->capacity ) ) {
+    munmap( p, this->size ); this->header = 0;
+    mexErrMsgIdAndTxt( "SharedFarm:incompatible", "SharedFarm: the farm '%s' is incompatible with this build!", name );
+  }
+  
+  this->returns = (double *)((char *)p + this->size) - (this->header->capacity + 2 * VDIM * VDIM + VDIM);
+  this->A = this->returns + this->header->capacity;
+  this->b = this->A + VDIM * VDIM;
+  this->B = this->b + VDIM;
+#endif
+}
+
+SharedFarm::~SharedFarm()
+{
+#ifndef _WIN32
+  if( this->header ) munmap( this->header, this->size );
+#endif
+}
+
+
+void SharedFarm::submit( const FarmBatch & batch )
+{
+  Header & h = *this->header;
+  if( batch.jobs < 1 || batch.jobs > h.capacity )
+    mexErrMsgIdAndTxt( "SharedFarm:invalidJobs", "SharedFarm: the number of jobs must be in [1, %d]!", h.capacity );
+  if( batch.criticClass != Critic::CC_LSTD && batch.criticClass != Critic::CC_LSPE &&
+      batch.criticClass != Critic::CC_ENAC )
+    mexErrMsgIdAndTxt( "SharedFarm:invalidCriticClass", "SharedFarm: the critic statistics must be additive!" );
+  
+  // all jobs claimed and completed?
+  unsigned long long claim = h.claim.load( std::memory_order_acquire );
+  if( (int)(claim & 0xFFFFFFFFull) < h.jobs.load() || h.completed.load( std::memory_order_acquire ) < h.jobs.load() )
+    mexErrMsgIdAndTxt( "SharedFarm:batchRunning", "SharedFarm: the jobs of the previous batch are still running!" );
+  
+  // close the claim counter under the next batch number first: the workers compare the job index against the new
+  // job count as soon as it is stored, and could otherwise claim the jobs of the new batch with its old settings
+  const unsigned long long next = ((claim >> 32) + 1) << 32;
+  h.claim.store( next | FARM_CLOSED, std::memory_order_release );
+  
+  const double NaN = mxGetNaN();
+  lock();
+  h.batch = batch;
+  h.mergeB = batch.criticClass == Critic::CC_LSPE;
+  for( int j = 0 ; j < h.capacity ; j++ ) this->returns[j] = NaN;
+  memset( this->A, 0, (2 * VDIM * VDIM + VDIM) * sizeof(double) );
+  h.completed.store( 0 );
+  h.failed.store( 0 );
+  h.jobs.store( batch.jobs );
+  unlock();
+  
+  // open the jobs of the next batch
+  h.claim.store( next, std::memory_order_release );
+}
+
+
+bool SharedFarm::claim( int & job, FarmBatch & batch )
+{
+  Header & h = *this->header;
+  unsigned long long claim = h.claim.load( std::memory_order_acquire );
+  while( true ) {
+    const unsigned long long index = claim & FARM_CLOSED;
+    if( index >= (unsigned long long)h.jobs.load( std::memory_order_acquire ) ) return false;
+    job = (int)index;
+    if( h.claim.compare_exchange_weak( claim, claim + 1, std::memory_order_acq_rel ) ) break;
+  }
+  
+  // the batch cannot change before the claimed job has been completed
+  batch = h.batch;
+  return true;
+}
+
+
+void SharedFarm::complete( int job, double jobReturn, const mxArray * critic )
+{
+  Header & h = *this->header;
+  const mxArray * A = mxGetField(critic, 0, "A");
+  const mxArray * b = mxGetField(critic, 0, "b");
+  const mxArray * B = mxGetField(critic, 0, "B");
+  if( !A || !b || (h.mergeB && !B) || mxGetNumberOfElements( A ) != VDIM * VDIM ||
+      mxGetNumberOfElements( b ) != VDIM )
+    mexErrMsgIdAndTxt( "SharedFarm:invalidStatistics", "SharedFarm: unexpected critic statistics!" );
+  
+  lock();
+  for( int i = 0 ; i < VDIM * VDIM ; i++ ) this->A[i] += mxGetPr( A )[i];
+  for( int i = 0 ; i < VDIM ; i++ ) this->b[i] += mxGetPr( b )[i];
+  if( h.mergeB ) for( int i = 0 ; i < VDIM * VDIM ; i++ ) this->B[i] += mxGetPr( B )[i];
+  this->returns[job] = jobReturn;
+  unlock();
+  
+  h.completed.fetch_add( 1, std::memory_order_release );
+}
+
+
+void SharedFarm::fail()
+{
+  // the return of the job stays NaN. count the failure before the completion, so that it is visible once the batch is.
+  Header & h = *this->header;
+  h.failed.fetch_add( 1, std::memory_order_relaxed );
+  h.completed.fetch_add( 1, std::memory_order_release );
+}
+
+
+mxArray * SharedFarm::createReturnStruct()
+{
+  Header & h = *this->header;
+  
+  const char * fieldnames[] = { "jobs", "claimed", "completed", "failed", "returns", "critic" };
+  mxArray * s = mxCreateStructMatrix( 1, 1, sizeof(fieldnames) / sizeof(fieldnames[0]), fieldnames );
+  
+  // allocate first, so that no Matlab call can interrupt the process while it holds the lock
+  const int jobs = h.jobs.load( std::memory_order_acquire );
+  mxArray * returns = mxCreateDoubleMatrix( jobs, 1, mxREAL );
+  mxArray * critic = mxCreateStructMatrix( 1, 1, 0, 0 );
+  mxArray * A = mxCreateDoubleMatrix( VDIM, VDIM, mxREAL );
+  mxArray * b = mxCreateDoubleMatrix( VDIM, 1, mxREAL );
+  mxArray * B = h.mergeB ? mxCreateDoubleMatrix( VDIM, VDIM, mxREAL ) : 0;
+  
+  // a consistent snapshot of the merged statistics
+  lock();
+  const unsigned long long claimed = h.claim.load() & FARM_CLOSED;
+  const int completed = h.completed.load();
+  const int failed = h.failed.load();
+  memcpy( mxGetPr( returns ), this->returns, jobs * sizeof(double) );
+  memcpy( mxGetPr( A ), this->A, VDIM * VDIM * sizeof(double) );
+  memcpy( mxGetPr( b ), this->b, VDIM * sizeof(double) );
+  if( B ) memcpy( mxGetPr( B ), this->B, VDIM * VDIM * sizeof(double) );
+  unlock();
+  
+  if( B ) {
+    mxAddField( critic, "B" );
+    mxSetField( critic, 0, "B", B );
+  }
+  mxAddField( critic, "A" );
+  mxSetField( critic, 0, "A", A );
+  mxAddField( critic, "b" );
+  mxSetField( critic, 0, "b", b );
+  
+  mxSetField( s, 0, "jobs", mxCreateDoubleScalar( jobs ) );
+  mxSetField( s, 0, "claimed", mxCreateDoubleScalar( claimed < (unsigned long long)jobs ? claimed : jobs ) );
+  mxSetField( s, 0, "completed", mxCreateDoubleScalar( completed ) );
+  mxSetField( s, 0, "failed", mxCreateDoubleScalar( failed ) );
+  mxSetField( s, 0, "returns", returns );
+  mxSetField( s, 0, "critic", critic );
+  return s;
+}
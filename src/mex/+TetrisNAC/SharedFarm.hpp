@@ -0,0 +1,138 @@
+/* SharedFarm.hpp
+ *
+ * A work queue of episode jobs and a critic statistics segment in named shared memory, for running the episodes of a
+ * policy evaluation in several Matlab processes on one host. The coordinating process creates the segment and submits
+ * batches of jobs (the policy to evaluate, the critic and feature settings and the stream key); any number of worker
+ * processes claim jobs from the current batch, run them, and add their critic statistics to the merged statistics of
+ * the batch. The coordinator reads the merged statistics and the returns of the jobs directly from the segment, without
+ * any file I/O, once all jobs of the batch have been completed.
+ *
+ * Only the critics with additive statistics are supported: A and b (LSTDLambda, EpisodicNAC), and also B
+ * (LSPELambda). The statistics are stored in Matlab layout, so that they can be joined with addData(). If the batch is
+ * keyed, job j runs on the counter-based streams of episode firstEpisode + j (see PhiloxRandStream.hpp), so the
+ * episodes do not depend on which worker runs them, but the floating point sums of the merged statistics still
+ * depend on the order in which the jobs are completed.
+ *
+ * The jobs are claimed with a compare-and-swap on a single counter that holds both the batch number and the index of
+ * the next job, so that a worker can never claim a job of a batch whose settings it did not read. While a batch is
+ * being submitted, the counter holds the next batch number and a closed job index that exceeds any job count. A new
+ * batch can be submitted only once all jobs of the previous one have been completed. The statistics are merged under a
+ * spinlock.
+ *
+ * A job whose worker raises an error after claiming it is marked failed: it counts as completed, but its return stays
+ * NaN and its statistics are not merged, so that the coordinator does not wait for it and can detect the failure.
+ *
+ * NOTE: There is no recovery from a worker process that dies while running a job (the batch never completes) or while
+ * merging (the lock is never released); destroy and recreate the segment in that case. Only POSIX shared memory is
+ * supported.
+ */
+#ifndef SHAREDFARM_HPP
+#define SHAREDFARM_HPP
+
+
+#include "Tetris.hpp"
+#include "Critic.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <atomic>
+#include <cstddef>
+
+
+
+
+// the settings of a batch of jobs
+struct FarmBatch {
+  int jobs;
+  int criticClass, petersTrickMode;
+  double gamma, lambda;
+  double theta[STATEACTIONDIM];
+  double tau;
+  bool rejectTerminalActions;
+  int holeDefinition;
+  double terminalBiasValueS, terminalBiasValueA;
+  bool keyed;
+  unsigned long long seed, firstEpisode;
+};
+
+
+
+
+class SharedFarm {
+  
+  // the layout of the beginning of the segment. the atomics must be lock-free to work across processes.
+  struct Header {
+    unsigned long long magic;
+    int version, VDim, capacity;
+    
+    // (batch number << 32) | index of the next job to claim
+    std::atomic<unsigned long long> claim;
+    
+    // jobs of the current batch, the number of them completed, and the number of the completed ones that failed
+    std::atomic<int> jobs;
+    std::atomic<int> completed;
+    std::atomic<int> failed;
+    
+    // the statistics lock
+    std::atomic<int> lock;
+    
+    // the settings of the current batch (valid while any of its jobs are open), and whether B is merged (LSPE)
+    FarmBatch batch;
+    bool mergeB;
+  };
+  
+  Header * header;
+  size_t size;
+  
+  // the returns of the jobs (capacity elements), and the statistics A (VDim x VDim), b (VDim) and B (VDim x VDim)
+  double * returns;
+  double * A;
+  double * b;
+  double * B;
+  
+  void lock();
+  void unlock();
+  
+  // the segment size for the given capacity
+  static size_t segmentSize( int capacity );
+  
+  // the shared memory object name of a farm name (with a leading slash)
+  static void objectName( const char * name, char (& object)[256] );
+  
+  
+public:
+  
+  // create the segment, replacing any existing one of the same name, with room for batches of at most capacity jobs
+  static void create( const char * name, int capacity );
+  
+  // remove the segment. the processes that have it mapped keep their mapping.
+  static void destroy( const char * name );
+  
+  // map an existing segment
+  SharedFarm( const char * name );
+  ~SharedFarm();
+  
+  // coordinator: start a new batch. fails if the jobs of the previous batch have not all been completed.
+  void submit( const FarmBatch & batch );
+  
+  // worker: claim the next job of the current batch and copy the batch settings. returns false if no jobs are open.
+  bool claim( int & job, FarmBatch & batch );
+  
+  // worker: merge the critic statistics of a claimed job (a critic return struct) and record its return
+  void complete( int job, double jobReturn, const mxArray * critic );
+  
+  // worker: mark a claimed job failed, completing it without statistics. does not call Matlab, so it is safe while an
+  // error propagates.
+  void fail();
+  
+  // creates the status struct: jobs, claimed, completed, failed, returns (jobs x 1, NaN for the jobs not yet completed
+  // and the failed ones) and critic (the merged statistics)
+  mxArray * createReturnStruct();
+  
+};
+
+
+
+
+#endif
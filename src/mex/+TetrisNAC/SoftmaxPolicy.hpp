@@ -0,0 +1,108 @@
+/* SoftmaxPolicy.hpp
+ *
+ * The Gibbs policy over the actions listed in the step data, pi(a|s) ~ exp( phi(s,a)' theta / tau ), and the gradient
+ * of its logarithm, as decideAction() and learn() in AgentNaturalActorCritic.m. Shared by NaturalActorCritic (Tetris)
+ * and GenericActorCritic (the environments of NativeEnvironment.hpp).
+ *
+ * The functions are templates on the step data type, which provides actionCount, isActionTerminal[a], getActionDim()
+ * and getAction(a) (the features of action a). For Tetris::StepData the action dimension is a compile-time constant,
+ * so the Tetris instantiations keep their constant trip counts; the dynamic step data gives the dimension at runtime.
+ */
+#ifndef SOFTMAXPOLICY_HPP
+#define SOFTMAXPOLICY_HPP
+
+
+#include "../RandStream.hpp"
+
+#include <cstring>
+
+#include <limits>
+#include <cmath>
+
+
+
+
+class SoftmaxPolicy {
+  
+public:
+  
+  /* Normalized action probabilities pr (actionCount elements). If RejectTerminalActions, then actions flagged as
+   * terminal get zero probability, unless all actions are flagged, in which case the distribution is uniform. */
+  template<bool RejectTerminalActions, class StepData>
+  static void computeActionProbabilities( const StepData & s, const double * theta, double tau, double * pr )
+  {
+    const double Inf = std::numeric_limits<double>::infinity();
+    const int actionDim = s.getActionDim();
+    
+    // (col)actionProbabilities = ((matrix)actions * (col)theta) / tau   (find maximum value for later use)
+    double maxPr = -Inf;
+    for( int action = 0 ; action < s.actionCount ; action++ ) {
+      pr[action] = 0.0;
+      if( RejectTerminalActions && s.isActionTerminal[action] ) {
+        // disable
+        pr[action] = -Inf;
+      } else {
+        // add
+        const double * features = s.getAction( action );
+        for( int i = 0 ; i < actionDim ; i++ )
+          pr[action] += (features[i] * theta[i]) / tau;
+      }
+      // maintain max value
+      if( pr[action] > maxPr ) maxPr = pr[action];
+    }
+    
+    // (col)actionProbabilities = exp( (col)actionProbabilities - maxPr ) (avoid overflow, get sum for later use)
+    double sumPr = 0.0;
+    for( int action = 0 ; action < s.actionCount ; action++ ) {
+      pr[action] = std::exp( pr[action] - maxPr );
+      sumPr += pr[action];
+    }
+    
+    // (col)actionProbabilities = (col)actionProbabilities / sum( (col)actionProbabilities )
+    for( int action = 0 ; action < s.actionCount ; action++ ) {
+      pr[action] /= sumPr;
+    }
+    
+    // set to the uniform distribution if all actions had -Inf unnormalized probability
+    if( maxPr == -Inf ) {
+      for( int action = 0 ; action < s.actionCount ; action++ )
+        pr[action] = 1.0 / (double)s.actionCount;
+    }
+  }
+  
+  /* The gradient vector part of phi for action a (getActionDim() elements):
+   *   grad( log( pi(a|s) ) ) = phi(s,a) - sum_b( pi(b|s) phi(s,b) ) */
+  template<class StepData>
+  static void computeGradient( const StepData & s, const double * pr, int a, double * grad )
+  {
+    const int actionDim = s.getActionDim();
+    std::memcpy( grad, s.getAction( a ), actionDim * sizeof(double) );
+    for( int action = 0 ; action < s.actionCount ; action++ ) {
+      const double * features = s.getAction( action );
+      for( int i = 0 ; i < actionDim ; i++ )
+        grad[i] -= pr[action] * features[i];
+    }
+  }
+  
+  // draw an action from the probabilities pr with a single random number (-1 if there are no actions)
+  static int drawAction( const double * pr, int actionCount, RandStream & rng )
+  {
+    double r = rng.rand();
+    double sum = 0.0;
+    int action;
+    
+    for( action = 0 ; action < actionCount ; action++ ) {
+      sum += pr[action];
+      if( r < sum ) break;
+    }
+    if( action == actionCount ) action--;   // in case of numerical errors
+    
+    return action;
+  }
+  
+};
+
+
+
+
+#endif
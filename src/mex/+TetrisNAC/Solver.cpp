@@ -0,0 +1,333 @@
+/* Solver.cpp */
+
+
+#include "Solver.hpp"
+
+#include "mex.h"
+
+#include <cstring>
+using std::memcpy;
+using std::memset;
+using std::strcmp;
+
+#include <cmath>
+using std::sqrt;
+using std::fabs;
+
+#include <vector>
+
+#include <limits>
+#define Inf (std::numeric_limits<double>::infinity())
+#define EPS (std::numeric_limits<double>::epsilon())
+
+
+// maximum number of Jacobi sweeps in svd()
+#define MAXSWEEPS 60
+
+
+
+
+bool Solver::parseMethod( const char * name, Method & method )
+{
+  if( !strcmp( name, "\\" ) ) method = SM_LU;
+  else if( !strcmp( name, "chol" ) ) method = SM_CHOL;
+  else if( !strcmp( name, "qr" ) ) method = SM_QR;
+  else if( !strcmp( name, "pinv" ) ) method = SM_PINV;
+  else if( !strcmp( name, "regularized" ) ) method = SM_REGULARIZED;
+  else return false;
+  return true;
+}
+
+
+void Solver::solve( Method method, int n, const double * M, const double * b, double * x, double regularization )
+{
+  mxAssert( n <= SOLVER_MAXDIM, "Matrix too large!" );
+  
+  switch( method ) {
+    
+    case SM_LU:
+      if( !solveLU( n, M, b, x ) )
+        mexErrMsgIdAndTxt( "Solver:singularMatrix", "Solver: the matrix is singular to working precision!" );
+      break;
+    
+    case SM_QR:
+      if( !solveQR( n, M, b, x ) )
+        mexErrMsgIdAndTxt( "Solver:singularMatrix", "Solver: the matrix is singular to working precision!" );
+      break;
+    
+    case SM_PINV:
+      solvePinv( n, M, b, x );
+      break;
+    
+    case SM_CHOL:
+    case SM_REGULARIZED: {
+      
+      // symmetric? (exactly, as the critics accumulate symmetric matrices exactly symmetrically)
+      bool symmetric = method == SM_CHOL;
+      for( int i = 0 ; i < n && symmetric ; i++ )
+        for( int j = i + 1 ; j < n && symmetric ; j++ )
+          if( M[i * n + j] != M[j * n + i] ) symmetric = false;
+      
+      bool ok;
+      if( symmetric ) {
+        ok = solveChol( n, M, b, x );
+      } else {
+        // normal equations: (M'M + rho I) x = M'b
+        std::vector<double> MtM( n * n ), Mtb( n );
+        double rho = method == SM_REGULARIZED ? regularization : 0.0;
+        for( int i = 0 ; i < n ; i++ ) {
+          for( int j = i ; j < n ; j++ ) {
+            double sum = 0.0;
+            for( int k = 0 ; k < n ; k++ ) sum += M[k * n + i] * M[k * n + j];
+            MtM[i * n + j] = MtM[j * n + i] = sum;
+          }
+          MtM[i * n + i] += rho;
+          double sum = 0.0;
+          for( int k = 0 ; k < n ; k++ ) sum += M[k * n + i] * b[k];
+          Mtb[i] = sum;
+        }
+        ok = solveChol( n, &MtM[0], &Mtb[0], x );
+      }
+      if( !ok ) mexErrMsgIdAndTxt( "Solver:notPositiveDefinite", "Solver: the matrix is not positive definite!" );
+      break;
+    }
+    
+    default:
+      mxAssert( false, "Invalid solver method!" );
+  }
+}
+
+
+double Solver::cond( int n, const double * M )
+{
+  if( n == 0 ) return 0.0;
+  
+  std::vector<double> U( n * n ), s( n ), V( n * n );
+  svd( n, M, &U[0], &s[0], &V[0] );
+  
+  double smin = s[0], smax = s[0];
+  for( int i = 1 ; i < n ; i++ ) {
+    if( s[i] < smin ) smin = s[i];
+    if( s[i] > smax ) smax = s[i];
+  }
+  return smin > 0.0 ? smax / smin : Inf;
+}
+
+
+int Solver::extract( int VDim, const double * M, const bool * mask, double Ifactor, double * Mm )
+{
+  int nm = 0;
+  for( int i = 0 ; i < VDim ; i++ ) nm += mask[i];
+  
+  int row = 0;
+  for( int i = 0 ; i < VDim ; i++ ) {
+    if( !mask[i] ) continue;
+    int col = 0;
+    for( int j = 0 ; j < VDim ; j++ ) {
+      if( !mask[j] ) continue;
+      Mm[row * nm + col] = M[i * VDim + j] + (i == j ? Ifactor : 0.0);
+      col++;
+    }
+    row++;
+  }
+  return nm;
+}
+
+
+
+
+/* private methods */
+
+
+bool Solver::solveLU( int n, const double * M, const double * b, double * x )
+{
+  if( n == 0 ) return true;
+  std::vector<double> LU( M, M + n * n );
+  memcpy( x, b, n * sizeof(double) );
+  double tol = pivotTolerance( n, M );
+  
+  // factorize with partial pivoting, applying the row swaps and the elimination to x on the way
+  for( int k = 0 ; k < n ; k++ ) {
+    
+    int p = k;
+    for( int i = k + 1 ; i < n ; i++ )
+      if( fabs( LU[i * n + k] ) > fabs( LU[p * n + k] ) ) p = i;
+    if( p != k ) {
+      for( int j = 0 ; j < n ; j++ ) { double t = LU[k * n + j]; LU[k * n + j] = LU[p * n + j]; LU[p * n + j] = t; }
+      double t = x[k]; x[k] = x[p]; x[p] = t;
+    }
+    
+    // a zero or tiny pivot would yield Inf/NaN values (Matlab's backslash only warns about them)
+    if( !(fabs( LU[k * n + k] ) > tol) ) return false;
+    for( int i = k + 1 ; i < n ; i++ ) {
+      double l = LU[i * n + k] / LU[k * n + k];
+      for( int j = k + 1 ; j < n ; j++ ) LU[i * n + j] -= l * LU[k * n + j];
+      x[i] -= l * x[k];
+    }
+  }
+  
+  // back substitution
+  for( int i = n - 1 ; i >= 0 ; i-- ) {
+    for( int j = i + 1 ; j < n ; j++ ) x[i] -= LU[i * n + j] * x[j];
+    x[i] /= LU[i * n + i];
+  }
+  return true;
+}
+
+
+bool Solver::solveChol( int n, const double * M, const double * b, double * x )
+{
+  // M = L L', L stored in the lower triangle
+  std::vector<double> L( n * n );
+  for( int j = 0 ; j < n ; j++ ) {
+    double d = M[j * n + j];
+    for( int k = 0 ; k < j ; k++ ) d -= L[j * n + k] * L[j * n + k];
+    if( !(d > 0.0) ) return false;
+    L[j * n + j] = sqrt( d );
+    for( int i = j + 1 ; i < n ; i++ ) {
+      double sum = M[i * n + j];
+      for( int k = 0 ; k < j ; k++ ) sum -= L[i * n + k] * L[j * n + k];
+      L[i * n + j] = sum / L[j * n + j];
+    }
+  }
+  
+  // forward substitution L y = b, then back substitution L' x = y
+  for( int i = 0 ; i < n ; i++ ) {
+    double sum = b[i];
+    for( int k = 0 ; k < i ; k++ ) sum -= L[i * n + k] * x[k];
+    x[i] = sum / L[i * n + i];
+  }
+  for( int i = n - 1 ; i >= 0 ; i-- ) {
+    double sum = x[i];
+    for( int k = i + 1 ; k < n ; k++ ) sum -= L[k * n + i] * x[k];
+    x[i] = sum / L[i * n + i];
+  }
+  return true;
+}
+
+
+bool Solver::solveQR( int n, const double * M, const double * b, double * x )
+{
+  if( n == 0 ) return true;
+  std::vector<double> R( M, M + n * n ), v( n );
+  memcpy( x, b, n * sizeof(double) );
+  double tol = pivotTolerance( n, M );
+  
+  // apply Householder reflections to M and b: R = Q'M, x = Q'b
+  for( int k = 0 ; k < n ; k++ ) {
+    
+    double norm = 0.0;
+    for( int i = k ; i < n ; i++ ) norm += R[i * n + k] * R[i * n + k];
+    norm = sqrt( norm );
+    if( norm == 0.0 ) continue;
+    
+    double alpha = R[k * n + k] > 0.0 ? -norm : norm;
+    for( int i = k ; i < n ; i++ ) v[i] = R[i * n + k];
+    v[k] -= alpha;
+    double vv = 0.0;
+    for( int i = k ; i < n ; i++ ) vv += v[i] * v[i];
+    if( vv == 0.0 ) continue;
+    
+    for( int j = k ; j < n ; j++ ) {
+      double dot = 0.0;
+      for( int i = k ; i < n ; i++ ) dot += v[i] * R[i * n + j];
+      double f = 2.0 * dot / vv;
+      for( int i = k ; i < n ; i++ ) R[i * n + j] -= f * v[i];
+    }
+    double dot = 0.0;
+    for( int i = k ; i < n ; i++ ) dot += v[i] * x[i];
+    double f = 2.0 * dot / vv;
+    for( int i = k ; i < n ; i++ ) x[i] -= f * v[i];
+  }
+  
+  // back substitution R x = Q'b, rejecting a zero or tiny diagonal as solveLU() does
+  for( int i = n - 1 ; i >= 0 ; i-- ) {
+    if( !(fabs( R[i * n + i] ) > tol) ) return false;
+    for( int j = i + 1 ; j < n ; j++ ) x[i] -= R[i * n + j] * x[j];
+    x[i] /= R[i * n + i];
+  }
+  return true;
+}
+
+
+void Solver::solvePinv( int n, const double * M, const double * b, double * x )
+{
+  if( n == 0 ) return;
+  std::vector<double> U( n * n ), s( n ), V( n * n );
+  svd( n, M, &U[0], &s[0], &V[0] );
+  
+  // tolerance as in Matlab's pinv()
+  double smax = 0.0;
+  for( int i = 0 ; i < n ; i++ ) if( s[i] > smax ) smax = s[i];
+  double tol = n * smax * EPS;
+  
+  // x = V diag(1/s) U' b
+  std::vector<double> c( n );
+  for( int k = 0 ; k < n ; k++ ) {
+    c[k] = 0.0;
+    if( s[k] <= tol ) continue;
+    for( int i = 0 ; i < n ; i++ ) c[k] += U[k * n + i] * b[i];
+    c[k] /= s[k];
+  }
+  for( int i = 0 ; i < n ; i++ ) {
+    double sum = 0.0;
+    for( int k = 0 ; k < n ; k++ ) sum += V[k * n + i] * c[k];
+    x[i] = sum;
+  }
+}
+
+
+double Solver::pivotTolerance( int n, const double * M )
+{
+  double mmax = 0.0;
+  for( int i = 0 ; i < n * n ; i++ ) if( fabs( M[i] ) > mmax ) mmax = fabs( M[i] );
+  return n * mmax * EPS;
+}
+
+
+void Solver::svd( int n, const double * M, double * U, double * s, double * V )
+{
+  // one-sided Jacobi: orthogonalize the columns of U = M V by plane rotations
+  for( int col = 0 ; col < n ; col++ )
+    for( int row = 0 ; row < n ; row++ ) {
+      U[col * n + row] = M[row * n + col];
+      V[col * n + row] = (row == col) ? 1.0 : 0.0;
+    }
+  
+  for( int sweep = 0 ; sweep < MAXSWEEPS ; sweep++ ) {
+    bool rotated = false;
+    
+    for( int p = 0 ; p < n - 1 ; p++ )
+      for( int q = p + 1 ; q < n ; q++ ) {
+        double * up = &U[p * n], * uq = &U[q * n];
+        double alpha = 0.0, beta = 0.0, gamma = 0.0;
+        for( int i = 0 ; i < n ; i++ ) {
+          alpha += up[i] * up[i]; beta += uq[i] * uq[i]; gamma += up[i] * uq[i];
+        }
+        if( gamma == 0.0 || fabs( gamma ) <= EPS * sqrt( alpha * beta ) ) continue;
+        rotated = true;
+        
+        double zeta = (beta - alpha) / (2.0 * gamma);
+        double t = (zeta >= 0.0 ? 1.0 : -1.0) / (fabs( zeta ) + sqrt( 1.0 + zeta * zeta ));
+        double c = 1.0 / sqrt( 1.0 + t * t ), sn = c * t;
+        
+        double * vp = &V[p * n], * vq = &V[q * n];
+        for( int i = 0 ; i < n ; i++ ) {
+          double a = up[i], b = uq[i];
+          up[i] = c * a - sn * b; uq[i] = sn * a + c * b;
+          a = vp[i]; b = vq[i];
+          vp[i] = c * a - sn * b; vq[i] = sn * a + c * b;
+        }
+      }
+    
+    if( !rotated ) break;
+  }
+  
+  // singular values are the column norms; normalize the columns of U
+  for( int k = 0 ; k < n ; k++ ) {
+    double norm = 0.0;
+    for( int i = 0 ; i < n ; i++ ) norm += U[k * n + i] * U[k * n + i];
+    s[k] = sqrt( norm );
+    if( s[k] > 0.0 ) for( int i = 0 ; i < n ; i++ ) U[k * n + i] /= s[k];
+  }
+}
@@ -0,0 +1,85 @@
+/* Solver.hpp
+ *
+ * Dense linear solvers for the critics, so that the natural gradient can be computed natively instead of returning
+ * the critic statistics to Matlab (see the 'solve' session command in MexTetrisNAC). The method names match the
+ * batchMethod options of the Matlab critics:
+ *
+ *   '\'           LU decomposition with partial pivoting
+ *   'chol'        Cholesky decomposition. Non-symmetric matrices are solved in the least squares sense via the normal
+ *                 equations.
+ *   'qr'          Householder QR decomposition
+ *   'pinv'        Moore-Penrose pseudoinverse via a one-sided Jacobi SVD, with the same tolerance as Matlab's pinv()
+ *   'regularized' Tikhonov regularized least squares: x = (M'M + rho I) \ M'b, solved with Cholesky
+ *
+ * Matrices are row-major and at most SOLVER_MAXDIM x SOLVER_MAXDIM; the work arrays are allocated per call. The
+ * condition number is the 2-norm condition number, as in Matlab's cond().
+ */
+#ifndef SOLVER_HPP
+#define SOLVER_HPP
+
+
+// maximum matrix size, which is also the maximum critic dimension (must be at least VDIM, checked in Critic.hpp)
+#define SOLVER_MAXDIM 1024
+
+
+
+
+class Solver {
+  
+public:
+  
+  enum Method { SM_LU, SM_CHOL, SM_QR, SM_PINV, SM_REGULARIZED };
+  
+  // parse a batchMethod name, returns false if unknown
+  static bool parseMethod( const char * name, Method & method );
+  
+  /* Solve M x = b for the n x n matrix M. Raises a Matlab error if the method fails: 'Solver:singularMatrix' if LU or
+   * QR meets a pivot of at most pivotTolerance() in magnitude, 'Solver:notPositiveDefinite' if Cholesky fails. Only
+   * 'pinv' accepts singular matrices. */
+  static void solve( Method method, int n, const double * M, const double * b, double * x, double regularization );
+  
+  // 2-norm condition number of the n x n matrix M
+  static double cond( int n, const double * M );
+  
+  /* Extract the masked rows and columns of the VDim x VDim matrix M into Mm, which is then nm x nm, where nm is the
+   * number of set elements in mask. Ifactor is added to the diagonal. Returns nm. */
+  static int extract( int VDim, const double * M, const bool * mask, double Ifactor, double * Mm );
+  
+  
+private:
+  
+  // the solvers return false if they fail
+  static bool solveLU( int n, const double * M, const double * b, double * x );
+  static bool solveChol( int n, const double * M, const double * b, double * x );
+  static bool solveQR( int n, const double * M, const double * b, double * x );
+  static void solvePinv( int n, const double * M, const double * b, double * x );
+  
+  // pivot tolerance of solveLU() and solveQR(): n * max(abs(M(:))) * eps
+  static double pivotTolerance( int n, const double * M );
+  
+  // thin SVD M = U diag(s) V' (U and V stored column-major: U[col * n + row])
+  static void svd( int n, const double * M, double * U, double * s, double * V );
+  
+};
+
+
+
+
+/* Options for Critic::solve(). featureMask selects the features that take part in solving; the solution is zero for the
+ * others. Ifactor * I is added to the main matrix before solving. The LSPE fields are ignored by other critics. */
+struct SolverOptions {
+  Solver::Method method;
+  double Ifactor;
+  double regularization;
+  bool featureMask[SOLVER_MAXDIM];
+  
+  // LSPE: initial solution, number of iterations and stepsize
+  double w[SOLVER_MAXDIM];
+  int iterations;
+  double stepsize;
+};
+
+
+
+
+#endif
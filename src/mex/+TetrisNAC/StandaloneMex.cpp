@@ -0,0 +1,45 @@
+/* StandaloneMex.cpp
+ *
+ * The mex functions used by the engine sources, for building them into the C library (see TetrisNACApi.h) instead of
+ * a mex file. The Matrix API (mx functions) comes from libmx, which works outside of Matlab, but the mex functions
+ * exist only inside Matlab. Errors are raised as C++ exceptions, which the C interface catches at its boundary, and
+ * Matlab random streams are not available (the C interface keys all streams).
+ */
+
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <cstdarg>
+#include <cstdio>
+using std::vsnprintf;
+
+#include <stdexcept>
+#include <string>
+
+
+
+
+void mexErrMsgIdAndTxt( const char * id, const char * format, ... )
+{
+  char message[4096];
+  va_list args;
+  va_start( args, format );
+  vsnprintf( message, sizeof(message), format, args );
+  va_end( args );
+  throw std::runtime_error( std::string( message ) + " (" + id + ")" );
+}
+
+
+int mexCallMATLAB( int nlhs, mxArray * plhs[], int nrhs, mxArray * prhs[], const char * functionName )
+{
+  mexErrMsgIdAndTxt( "TetrisNACApi:matlabNotAvailable",
+                     "TetrisNACApi: Matlab is not available for calling '%s'!", functionName );
+  return 1;
+}
+
+
+void mexMakeArrayPersistent( mxArray * array )
+{
+  // arrays are never freed automatically outside of Matlab
+}
@@ -4,18 +4,28 @@
  * -----------------------
  *
  * The state observation vector of a terminal state is always a zero vector, except for the bias feature, which is set
- * to TERMINAL_BIAS_VALUE_S.
+ * to terminalBiasValueS (TERMINAL_BIAS_VALUE_S by default, see configure()).
  *
  * The action observation vector of an action that leads to termination is always a zero vector, except:
- *   - The bias feature is set to TERMINAL_BIAS_VALUE_A.
+ *   - The bias feature is set to terminalBiasValueA (TERMINAL_BIAS_VALUE_A by default).
  *   - The immediate reward feature is set to the actual immediate reward. For example, if the action clears one line
  *     and then leads to termination, then this feature will be set to 1.
+ *
+ * Hole definition
+ * ---------------
+ *
+ * The hole definition is selected at runtime (see configure()). The observation and action computations are templates
+ * on the hole definition, and generateStepData() dispatches once per step to the instantiation in use, so the inner
+ * loops are compiled for each definition.
  */
 
 
 #include "Tetris.hpp"
+#include "ActionCache.hpp"
+#include "ObservationLogger.hpp"
 #include "Configuration.hpp"
 #include "../MatlabRandStream.hpp"
+#include "../Profiler.hpp"
 #include "../../../external/SeedFill.hpp"
 
 #include "mex.h"
@@ -29,12 +39,6 @@ using std::memset;
 #define ABS(x) ((x)<0?-(x):(x))
 
 
-#define HD_COVEREDBY 0
-#define HD_UNDERTOPLINE 1
-#define HD_FLOODFILL 2
-#define HOLEDEFINITION HD_UNDERTOPLINE
-
-
 
 
 /* private methods */
@@ -53,7 +57,7 @@ void Tetris::resetState()
   this->boardHeightmapMin = ROWS;
   
   // set falling piece
-  this->fallingPiece = (int)(this->rstream.rand() * 7.0);
+  this->fallingPiece = (int)(rand() * 7.0);
   
   // clear scores and the terminal state flag
   this->clearedRows = 0; this->totalClearedRows = 0;
@@ -68,7 +72,7 @@ void Tetris::advanceState( int action )
   this->totalClearedRows += this->clearedRows;
   
   // randomize a new falling piece
-  this->fallingPiece = (int)(this->rstream.rand() * 7.0);
+  this->fallingPiece = (int)(rand() * 7.0);
 }
 
 
@@ -181,19 +185,34 @@ void Tetris::shiftRows( int firstRow, int lastRow, int shift )
 void Tetris::generateStepData()
 {
   this->stepData.transitionReward = this->clearedRows;
-  computeObservation( this->stepData.observation );
-  computeActions();
+  switch( this->holeDefinition ) {
+    case HD_COVEREDBY:
+      computeObservation<HD_COVEREDBY>( this->stepData.observation );
+      computeActions<HD_COVEREDBY>();
+      break;
+    case HD_UNDERTOPLINE:
+      computeObservation<HD_UNDERTOPLINE>( this->stepData.observation );
+      computeActions<HD_UNDERTOPLINE>();
+      break;
+    case HD_FLOODFILL:
+      computeObservation<HD_FLOODFILL>( this->stepData.observation );
+      computeActions<HD_FLOODFILL>();
+      break;
+  }
 }
 
 
+template<int HoleDefinition>
 void Tetris::computeObservation( double (& observation)[STATEDIM] )
 {
+  PROFILE_SCOPE( PP_COMPUTEOBSERVATION );
+  
   mxAssert( STATEDIM == 2 * this->columns - 1 + 3, "Unexpected STATEDIM!" );
   
   // terminal state? value == 0 -> observation == zero vector (bias value depends on configuration)
   if( this->terminalState ) {
     memset( observation, 0, sizeof(observation) );
-    observation[2 * this->columns - 1 + 2] = TERMINAL_BIAS_VALUE_S;
+    observation[2 * this->columns - 1 + 2] = this->terminalBiasValueS;
     return;
   }
   
@@ -208,7 +227,7 @@ void Tetris::computeObservation( double (& observation)[STATEDIM] )
   
   // set number of holes
   int holes = 0;
-  switch( HOLEDEFINITION ) {
+  switch( HoleDefinition ) {
     
     case HD_COVEREDBY:
       for( int row = this->boardHeightmapMin + 1 ; row < this->rows ; row++ )   // scan rows in the active region
@@ -240,8 +259,11 @@ void Tetris::computeObservation( double (& observation)[STATEDIM] )
 }
 
 
+template<int HoleDefinition>
 void Tetris::computeActions()
 {
+  PROFILE_SCOPE( PP_COMPUTEACTIONS );
+  
   mxAssert( STATEACTIONDIM == 2 * this->columns - 1 + 4, "Unexpected STATEACTIONDIM!" );
   mxAssert( STATEDIM <= STATEACTIONDIM, "STATEDIM must be <= STATEACTIONDIM!" );
   
@@ -252,6 +274,14 @@ void Tetris::computeActions()
   }
   
   
+  // try the action cache first (the action data depends only on the board and the falling piece)
+  ActionCache::Key cacheKey;
+  if( this->actionCache ) {
+    this->actionCache->makeKey( this->board, this->boardHeightmapMin, this->fallingPiece, cacheKey );
+    if( this->actionCache->lookup( cacheKey, this->terminalBiasValueA, this->stepData ) ) return;
+  }
+  
+  
   // state backup variables
   bool origBoard[ROWS][COLUMNS];
   int origBoardHeightmap[COLUMNS];
@@ -276,10 +306,10 @@ void Tetris::computeActions()
     clearedRows = dropPiece( action );
     
     // write the state observation vector to the action row
-    computeObservation( (double (&)[STATEDIM])this->stepData.actions[action] );
+    computeObservation<HoleDefinition>( (double (&)[STATEDIM])this->stepData.actions[action] );
     
     // if in terminal state, set the bias feature to the value specified in configuration
-    if( this->terminalState ) this->stepData.actions[action][2 * this->columns - 1 + 2] = TERMINAL_BIAS_VALUE_A;
+    if( this->terminalState ) this->stepData.actions[action][2 * this->columns - 1 + 2] = this->terminalBiasValueA;
     
     // add the immediate reward feature
     this->stepData.actions[action][2 * this->columns - 1 + 3] = clearedRows;
@@ -294,17 +324,16 @@ void Tetris::computeActions()
     this->terminalState = false;
     
   }
+  
+  // store the result into the cache
+  if( this->actionCache ) this->actionCache->store( cacheKey, this->stepData );
 }
 
 
 void Tetris::logState()
 {
-  if( !LOGOBSERVATIONS ) return;
-  
   // log the observation (other logging is not yet implemented)
-  if( this->observationLogInd < OBSERVATIONLOGLENGTH )
-    memcpy( (*this->observationLog)[this->observationLogInd++], this->stepData.observation,
-            sizeof(this->stepData.observation) );
+  if( this->observationLogger ) this->observationLogger->log( this->stepData.observation );
 }
 
 
@@ -317,23 +346,76 @@ void Tetris::logReward()
 /* public methods */
 
 
-Tetris::Tetris( int rows, int columns, mxArray * rstream ) :
-  observationLog( (ObservationLog *)mxMalloc( sizeof(ObservationLog) ) ),
-  observationLogInd( 0 ),
+Tetris::Tetris( int rows, int columns, mxArray * rstream, int actionCacheSize ) :
+  episode( 0 ),
   rows( rows ), columns( columns ),
   rstream( rstream ),
-  episode( 0 )
+  keyed( false ),
+  actionCache( 0 ),
+  observationLogger( 0 ),
+  holeDefinition( HOLEDEFINITION ),
+  terminalBiasValueS( TERMINAL_BIAS_VALUE_S ),
+  terminalBiasValueA( TERMINAL_BIAS_VALUE_A )
 {
-  // check memory allocation
-  mxAssert( this->observationLog, "Failed to allocate memory!" );
-  
   // check board size
   mxAssert( this->rows == ROWS && this->columns == COLUMNS, "The board size must match the hard-coded size!" );
+  
+  // create the action cache if requested
+  if( actionCacheSize > 0 ) {
+    this->actionCache = new ActionCache( actionCacheSize );
+    PROFILE_ALLOCATION( sizeof(ActionCache) );
+  }
 }
 
 Tetris::~Tetris()
 {
-  // causes occasional double-frees if ctrl-c. why? mxFree( this->observationLog ); this->observationLog = 0;
+  delete this->actionCache; this->actionCache = 0;
+  delete this->observationLogger; this->observationLogger = 0;
+}
+
+
+void Tetris::setLogging( bool enabled, const char * path )
+{
+  // keep the current log if the settings are unchanged
+  if( !enabled || !this->observationLogger || this->observationLogger->getPath() != (path ? path : "") ) {
+    delete this->observationLogger; this->observationLogger = 0;
+  }
+  if( enabled && !this->observationLogger ) {
+    this->observationLogger = new ObservationLogger( path );
+    PROFILE_ALLOCATION( sizeof(ObservationLogger) );
+  }
+}
+
+
+void Tetris::configure( int holeDefinition, double terminalBiasValueS, double terminalBiasValueA )
+{
+  if( holeDefinition != HD_COVEREDBY && holeDefinition != HD_UNDERTOPLINE && holeDefinition != HD_FLOODFILL )
+    mexErrMsgIdAndTxt( "Tetris:invalidHoleDefinition", "Tetris: Unknown hole definition!" );
+  
+  // the cached action data depends on the hole definition (the bias values are applied on lookup)
+  if( holeDefinition != this->holeDefinition && this->actionCache ) this->actionCache->clear();
+  
+  this->holeDefinition = holeDefinition;
+  this->terminalBiasValueS = terminalBiasValueS;
+  this->terminalBiasValueA = terminalBiasValueA;
+}
+
+
+void Tetris::attach( mxArray * rstream )
+{
+  this->rstream.setStream( rstream );
+  this->keyed = false;
+  if( this->observationLogger ) this->observationLogger->clear();
+  if( this->actionCache ) {
+    this->actionCache->hits = 0; this->actionCache->misses = 0; this->actionCache->evictions = 0;
+  }
+}
+
+
+void Tetris::keyStream( unsigned long long seed, unsigned long long episode, PhiloxRandStream::Purpose purpose )
+{
+  this->keyedStream.setKey( seed, episode, purpose );
+  this->keyed = true;
 }
 
 
@@ -355,6 +437,72 @@ double Tetris::step( int action )
 }
 
 
+void Tetris::getVectorialState( double * state ) const
+{
+  for( int row=0 ; row<this->rows ; row++ )
+    for( int col=0 ; col<this->columns ; col++ )
+      state[row * this->columns + col] = this->board[row][col] ? 1.0 : 0.0;
+  state[this->rows * this->columns] = this->fallingPiece + 1;
+}
+
+
+void Tetris::takeSnapshot( Snapshot & snapshot ) const
+{
+  mxAssert( !this->terminalState, "Cannot take a snapshot of a terminal state!" );
+  memcpy( snapshot.board, this->board, sizeof(this->board) );
+  memcpy( snapshot.boardHeightmap, this->boardHeightmap, sizeof(this->boardHeightmap) );
+  snapshot.boardHeightmapMin = this->boardHeightmapMin;
+  snapshot.fallingPiece = this->fallingPiece;
+}
+
+void Tetris::restoreSnapshot( const Snapshot & snapshot )
+{
+  memcpy( this->board, snapshot.board, sizeof(this->board) );
+  memcpy( this->boardHeightmap, snapshot.boardHeightmap, sizeof(this->boardHeightmap) );
+  this->boardHeightmapMin = snapshot.boardHeightmapMin;
+  this->fallingPiece = snapshot.fallingPiece;
+  
+  // as in resetState()
+  this->clearedRows = 0; this->totalClearedRows = 0;
+  this->terminalState = false;
+  generateStepData();
+}
+
+
+void Tetris::saveState( StateWriter & w ) const
+{
+  w.write( this->board );
+  w.write( this->boardHeightmap );
+  w.write( this->boardHeightmapMin );
+  w.write( this->fallingPiece );
+  w.write( this->clearedRows );
+  w.write( this->totalClearedRows );
+  w.write( this->terminalState );
+  w.write( this->episode );
+  w.write( this->keyed );
+  if( this->keyed ) this->keyedStream.saveState( w );
+  else this->rstream.saveState( w );
+}
+
+void Tetris::loadState( StateReader & r )
+{
+  r.read( this->board );
+  r.read( this->boardHeightmap );
+  r.read( this->boardHeightmapMin );
+  r.read( this->fallingPiece );
+  r.read( this->clearedRows );
+  r.read( this->totalClearedRows );
+  r.read( this->terminalState );
+  r.read( this->episode );
+  r.read( this->keyed );
+  if( this->keyed ) this->keyedStream.loadState( r );
+  else this->rstream.loadState( r );
+  
+  // the step data is a deterministic function of the above
+  generateStepData();
+}
+
+
 mxArray * Tetris::createReturnStruct()
 {
   mxArray * s = mxCreateStructMatrix( 1, 1, 0, 0 );
@@ -363,15 +511,26 @@ mxArray * Tetris::createReturnStruct()
   mxAddField( s, "return" );
   mxSetField( s, 0, "return", mxCreateDoubleScalar( this->totalClearedRows ) );
   
-  // add observation log
-  mxArray * olog = mxCreateDoubleMatrix( this->observationLogInd, STATEDIM, mxREAL );
-  double * ologData = mxGetPr(olog);
-  for( int row = 0 ; row < this->observationLogInd ; row++ )
-    for( int col = 0 ; col < STATEDIM ; col++ )
-      ologData[col * this->observationLogInd + row] = (*this->observationLog)[row][col]; // shuffle row-maj. to col-maj.
+  // add observation log (empty if disabled or streamed into a file)
+  mxArray * olog = this->observationLogger ? this->observationLogger->createArray() :
+                                             mxCreateDoubleMatrix( 0, STATEDIM, mxREAL );
   mxAddField( s, "observationLog" );
   mxSetField( s, 0, "observationLog", olog );
   
+  // add action cache statistics
+  if( this->actionCache ) {
+    mxAddField( s, "actionCache" );
+    mxSetField( s, 0, "actionCache", this->actionCache->createReturnStruct() );
+  }
+  
+  // add profiling counters
+#if PROFILING
+  mxArray * profile = mxCreateStructMatrix( 1, 1, 0, 0 );
+  Profiler::instance().fillReturnStruct( profile );
+  mxAddField( s, "profile" );
+  mxSetField( s, 0, "profile", profile );
+#endif
+  
   return s;
 }
 
@@ -1,11 +1,12 @@
 /* Tetris.hpp */
 // TODO: StepData -> StateData
-// TODO: clean up observation logging
 #ifndef TETRIS_HPP
 #define TETRIS_HPP
 
 
 #include "../MatlabRandStream.hpp"
+#include "../PhiloxRandStream.hpp"
+#include "../StateBuffer.hpp"
 
 
 #define ROWS 20
@@ -16,16 +17,17 @@
 #define STATEACTIONDIM (2 * COLUMNS - 1 + 3 + 1)   // add the immediate reward feature, keep bias for completeness
 #define MAXACTIONS (4 * COLUMNS)
 
-#define OBSERVATIONLOGLENGTH 50000   // enough for gaining about 20,000 points
-#define LOGOBSERVATIONS 0
-
-
-typedef double ObservationLog[OBSERVATIONLOGLENGTH][STATEDIM];
 
+class ActionCache;
+class ObservationLogger;
+class TetrisBatch;
 
 
 class Tetris {
   
+  // the batch environment shares the piece tables
+  friend class TetrisBatch;
+  
 public:
   
   /* Data structure for passing information from the environment to the agent. Terminal states are not explicitly
@@ -36,14 +38,12 @@ public:
     double actions[MAXACTIONS][STATEACTIONDIM];
     bool isActionTerminal[MAXACTIONS];
     int actionCount;
+    
+    // the action features, as accessed by SoftmaxPolicy (the dimension is a compile-time constant)
+    int getActionDim() const { return STATEACTIONDIM; }
+    const double * getAction( int a ) const { return this->actions[a]; }
   };
   
-  // observation log
-  ObservationLog * observationLog;
-  
-  // observation log index (points to the next free index)
-  int observationLogInd;
-  
   // outbound data for the current state
   StepData stepData;
   
@@ -56,6 +56,14 @@ public:
   // rows cleared during the episode
   int totalClearedRows;
   
+  // the board and the falling piece of a state, for restarting simulations from it (see RolloutEngine.hpp)
+  struct Snapshot {
+    bool board[ROWS][COLUMNS];
+    int boardHeightmap[COLUMNS];
+    int boardHeightmapMin;
+    int fallingPiece;
+  };
+  
   
 private:
   
@@ -85,8 +93,10 @@ private:
   int rows, columns;
   
   
-  // random number generator
+  // random number generators: the Matlab stream, or the counter-based piece stream if keyed (see keyStream())
   MatlabRandStream rstream;
+  PhiloxRandStream keyedStream;
+  bool keyed;
   
   // board state (hardwired size)
   bool board[ROWS][COLUMNS];
@@ -100,9 +110,19 @@ private:
   // currently falling piece index (0-6)
   int fallingPiece;
   
+  // cache for computeActions(), or null if disabled
+  ActionCache * actionCache;
+  
   // rows cleared during previous step
   int clearedRows;
   
+  // observation log, or null if logging is disabled (see setLogging())
+  ObservationLogger * observationLogger;
+  
+  // feature settings (see configure())
+  int holeDefinition;
+  double terminalBiasValueS, terminalBiasValueA;
+  
   
   // state handling
   void resetState();
@@ -110,10 +130,13 @@ private:
   int dropPiece( int action );
   void shiftRows( int firstRow, int lastRow, int shift );
   
+  // draw a random number from the current stream
+  double rand() { return this->keyed ? this->keyedStream.rand() : this->rstream.rand(); }
+  
   // generate data for the agent
   void generateStepData();
-  void computeObservation( double (& observation)[STATEDIM] );
-  void computeActions();
+  template<int HoleDefinition> void computeObservation( double (& observation)[STATEDIM] );
+  template<int HoleDefinition> void computeActions();
   
   // logging
   void logState();
@@ -122,15 +145,50 @@ private:
   
 public:
   
-  Tetris( int rows, int columns, mxArray * rstream );
+  // actionCacheSize is the number of entries in the action cache, or 0 to disable caching
+  Tetris( int rows, int columns, mxArray * rstream, int actionCacheSize );
   ~Tetris();
   
+  /* Enable or disable observation logging. If path is null or empty, then the observations are logged into memory and
+   * returned by createReturnStruct(), otherwise they are streamed into the file (see ObservationLogger.hpp). The log
+   * is kept if the settings do not change. */
+  void setLogging( bool enabled, const char * path );
+  
+  /* Set the hole definition (HD_*) and the values of the bias feature in terminal states and for terminal actions (see
+   * Tetris.cpp). The defaults are given in Configuration.hpp. Changing the settings clears the action cache. */
+  void configure( int holeDefinition, double terminalBiasValueS, double terminalBiasValueA );
+  
+  // prepare for a new mex call when the object outlives a call: attach to the call's random stream and clear the
+  // observation log and the action cache statistics
+  void attach( mxArray * rstream );
+  
+  // draw the pieces from the counter-based stream of the given experiment seed and episode index, instead of the Matlab
+  // stream, until the next attach(). call before newEpisode() or restoreSnapshot().
+  void keyStream( unsigned long long seed, unsigned long long episode,
+                  PhiloxRandStream::Purpose purpose = PhiloxRandStream::RS_PIECES );
+  
   // start a new episode
   void newEpisode();
   
   // take a step. action is orientation-major. returns the immediate reward.
   double step( int action );
   
+  // index of the currently falling piece (0-6)
+  int getFallingPiece() const { return this->fallingPiece; }
+  
+  // the state as in Tetris.generateVectorialState(): the board in row-major order (1 for a filled cell, top row first),
+  // followed by the falling piece index (1-7). state must have rows * columns + 1 elements.
+  void getVectorialState( double * state ) const;
+  
+  // copy the current (non-terminal) state, or start a new episode from a copied state with the scores cleared. the
+  // episode counter is not incremented.
+  void takeSnapshot( Snapshot & snapshot ) const;
+  void restoreSnapshot( const Snapshot & snapshot );
+  
+  // save and restore the episode state (board, falling piece, scores and the random stream position)
+  void saveState( StateWriter & w ) const;
+  void loadState( StateReader & r );
+  
   // creates the return struct
   mxArray * createReturnStruct();
   
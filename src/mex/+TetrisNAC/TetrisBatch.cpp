@@ -0,0 +1,390 @@
+/* TetrisBatch.cpp */
+
+
+#include "TetrisBatch.hpp"
+#include "Configuration.hpp"
+#include "../MatlabRandStream.hpp"
+#include "../PhiloxRandStream.hpp"
+#include "../Profiler.hpp"
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <cstring>
+using std::memcpy;
+using std::memset;
+
+
+#define ABS(x) ((x)<0?-(x):(x))
+
+// a full row
+#define FULLROW ((BoardRow)((1 << COLUMNS) - 1))
+
+
+
+
+// number of set bits in a row (branch-free, so that the loops over lanes vectorize)
+static inline int bitCount( BoardRow x )
+{
+  unsigned int v = x;
+  v = v - ((v >> 1) & 0x5555u);
+  v = (v & 0x3333u) + ((v >> 2) & 0x3333u);
+  v = (v + (v >> 4)) & 0x0f0fu;
+  return (int)((v + (v >> 8)) & 0x1fu);
+}
+
+
+
+
+/* private methods */
+
+
+void TetrisBatch::loadBoard( int lane, Board & b ) const
+{
+  for( int row = 0 ; row < ROWS ; row++ ) b.rows[row] = this->board[row][lane];
+  for( int col = 0 ; col < COLUMNS ; col++ ) b.heightmap[col] = this->heightmap[col][lane];
+  b.heightmapMin = this->heightmapMin[lane];
+}
+
+void TetrisBatch::storeBoard( int lane, const Board & b )
+{
+  for( int row = 0 ; row < ROWS ; row++ ) this->board[row][lane] = b.rows[row];
+  for( int col = 0 ; col < COLUMNS ; col++ ) this->heightmap[col][lane] = b.heightmap[col];
+  this->heightmapMin[lane] = b.heightmapMin;
+}
+
+
+/* Will update the board, its heightmap, min(heightmap), and the terminal flag. */
+int TetrisBatch::dropPiece( Board & b, int piece, int action, bool & terminal ) const
+{
+  // expand the action
+  int orientation;
+  for( orientation = 0 ; orientation < Tetris::pieceOrientationCounts[piece] ; orientation++ ) {
+    if( action < COLUMNS - Tetris::pieceWidths[piece][orientation] + 1 ) break;
+    action -= COLUMNS - Tetris::pieceWidths[piece][orientation] + 1;
+  }
+  int column = action;
+  
+  // explicate piece shape information
+  const int (& pieceTopHeightmap)[4]( Tetris::pieceTopHeightmaps[piece][orientation] );
+  const int (& pieceHeightmap)[4]( Tetris::pieceHeightmaps[piece][orientation] );
+  int pieceHeight = Tetris::pieceHeights[piece][orientation];
+  int pieceWidth = Tetris::pieceWidths[piece][orientation];
+  
+  // find row (topmost row of the piece)
+  int rowc, row = ROWS;
+  for( int pieceColumn = 0 ; pieceColumn < pieceWidth ; pieceColumn++ ) {
+    rowc = b.heightmap[column+pieceColumn] - pieceHeightmap[pieceColumn];
+    if( rowc < row ) row = rowc;
+  }
+  
+  // flag terminal state and return if the board would overflow
+  if( row < 0 ) {
+    terminal = true;
+    return 0;
+  }
+  
+  // place the piece to the board
+  for( int pieceRow = 0 ; pieceRow < pieceHeight ; pieceRow++ )
+    b.rows[row+pieceRow] |= (BoardRow)(this->pieceRows[piece][orientation][pieceRow] << column);
+  
+  // update the heightmap and maintain min(heightmap)
+  for( int pieceColumn = 0 ; pieceColumn < pieceWidth ; pieceColumn++ ) {
+    b.heightmap[column+pieceColumn] = row + pieceTopHeightmap[pieceColumn];
+    if( b.heightmap[column+pieceColumn] < b.heightmapMin ) b.heightmapMin = b.heightmap[column+pieceColumn];
+  }
+  
+  // count filled rows (only the rows of the piece can be full)
+  int filledRows = 0;
+  for( int pieceRow = 0 ; pieceRow < pieceHeight ; pieceRow++ )
+    if( b.rows[row+pieceRow] == FULLROW ) filledRows++;
+  
+  // if full rows were found, then remove them, shift down the rows above them and update the heightmap and
+  // min(heightmap)
+  if( filledRows > 0 ) {
+    
+    int target = row + pieceHeight - 1;
+    for( int source = row + pieceHeight - 1 ; source >= b.heightmapMin ; source-- )
+      if( b.rows[source] != FULLROW ) b.rows[target--] = b.rows[source];
+    for( ; target >= b.heightmapMin ; target-- ) b.rows[target] = 0;
+    
+    // (there can't be empty rows below the cleared rows)
+    b.heightmapMin += filledRows;
+    
+    for( int row, col = 0 ; col < COLUMNS ; col++ ) {
+      for( row = b.heightmapMin ; row < ROWS && !(b.rows[row] & (1 << col)) ; row++ );
+      b.heightmap[col] = row;
+    }
+    
+  }
+  
+  return filledRows;
+}
+
+
+template<int HoleDefinition>
+int TetrisBatch::countHoles( const Board & b )
+{
+  int holes = 0;
+  
+  if( HoleDefinition == HD_COVEREDBY ) {
+    for( int row = b.heightmapMin + 1 ; row < ROWS ; row++ )
+      holes += bitCount( (BoardRow)(~b.rows[row] & b.rows[row-1] & FULLROW) );
+  } else {
+    // HD_UNDERTOPLINE: the cells from the topline down, minus the filled cells (which are all below the topline)
+    for( int col = 0 ; col < COLUMNS ; col++ ) holes += ROWS - b.heightmap[col];
+    for( int row = b.heightmapMin ; row < ROWS ; row++ ) holes -= bitCount( b.rows[row] );
+  }
+  
+  return holes;
+}
+
+
+template<int HoleDefinition>
+void TetrisBatch::computeObservation( const Board & b, bool terminal, double (& observation)[STATEDIM] ) const
+{
+  PROFILE_SCOPE( PP_COMPUTEOBSERVATION );
+  
+  // terminal state? value == 0 -> observation == zero vector (bias value depends on configuration)
+  if( terminal ) {
+    memset( observation, 0, sizeof(observation) );
+    observation[2 * COLUMNS - 1 + 2] = this->terminalBiasValueS;
+    return;
+  }
+  
+  // fill in columns heights and height differences
+  for( int col = 0 ; col < COLUMNS ; col++ ) {
+    observation[col] = ROWS - b.heightmap[col];   // heights
+    if( col >= 1 ) observation[COLUMNS + col - 1] = ABS( observation[col] - observation[col-1] );   // hdiffs
+  }
+  
+  // set maximum column height, number of holes and bias
+  observation[2 * COLUMNS - 1 + 0] = ROWS - b.heightmapMin;
+  observation[2 * COLUMNS - 1 + 1] = countHoles<HoleDefinition>( b );
+  observation[2 * COLUMNS - 1 + 2] = 1.0;
+}
+
+
+template<int HoleDefinition>
+void TetrisBatch::computeObservations( const bool * active )
+{
+  PROFILE_SCOPE( PP_COMPUTEOBSERVATION );
+  
+  // compute the observations of all lanes in structure-of-arrays form (all lanes, for contiguous loops)
+  double observations[STATEDIM][BATCHMAXLANES];
+  int holes[BATCHMAXLANES];
+  
+  for( int col = 0 ; col < COLUMNS ; col++ )
+    for( int lane = 0 ; lane < this->lanes ; lane++ )
+      observations[col][lane] = ROWS - this->heightmap[col][lane];
+  
+  for( int col = 1 ; col < COLUMNS ; col++ )
+    for( int lane = 0 ; lane < this->lanes ; lane++ )
+      observations[COLUMNS + col - 1][lane] = ABS( observations[col][lane] - observations[col-1][lane] );
+  
+  for( int lane = 0 ; lane < this->lanes ; lane++ ) {
+    observations[2 * COLUMNS - 1 + 0][lane] = ROWS - this->heightmapMin[lane];
+    holes[lane] = 0;
+  }
+  
+  // holes (rows above min(heightmap) are empty and do not contribute)
+  if( HoleDefinition == HD_COVEREDBY ) {
+    for( int row = 1 ; row < ROWS ; row++ )
+      for( int lane = 0 ; lane < this->lanes ; lane++ )
+        holes[lane] += bitCount( (BoardRow)(~this->board[row][lane] & this->board[row-1][lane] & FULLROW) );
+  } else {
+    for( int col = 0 ; col < COLUMNS ; col++ )
+      for( int lane = 0 ; lane < this->lanes ; lane++ )
+        holes[lane] += ROWS - this->heightmap[col][lane];
+    for( int row = 0 ; row < ROWS ; row++ )
+      for( int lane = 0 ; lane < this->lanes ; lane++ )
+        holes[lane] -= bitCount( this->board[row][lane] );
+  }
+  
+  for( int lane = 0 ; lane < this->lanes ; lane++ ) {
+    observations[2 * COLUMNS - 1 + 1][lane] = holes[lane];
+    observations[2 * COLUMNS - 1 + 2][lane] = 1.0;
+  }
+  
+  // scatter into the step data of the active lanes
+  for( int lane = 0 ; lane < this->lanes ; lane++ ) {
+    if( !active[lane] ) continue;
+    double (& observation)[STATEDIM]( this->stepData[lane].observation );
+    if( this->terminalState[lane] ) {
+      memset( observation, 0, sizeof(observation) );
+      observation[2 * COLUMNS - 1 + 2] = this->terminalBiasValueS;
+    } else {
+      for( int i = 0 ; i < STATEDIM ; i++ ) observation[i] = observations[i][lane];
+    }
+  }
+}
+
+
+template<int HoleDefinition>
+void TetrisBatch::computeActions( int lane )
+{
+  PROFILE_SCOPE( PP_COMPUTEACTIONS );
+  
+  Tetris::StepData & s = this->stepData[lane];
+  
+  // if terminal state, then set actionCount to zero and return
+  if( this->terminalState[lane] ) {
+    s.actionCount = 0;
+    return;
+  }
+  
+  Board origBoard;
+  loadBoard( lane, origBoard );
+  int piece = this->fallingPiece[lane];
+  
+  // loop through available actions, dropping the piece on a copy of the board
+  s.actionCount = Tetris::pieceActionCounts[piece];
+  for( int action = 0 ; action < s.actionCount ; action++ ) {
+    
+    Board b = origBoard;
+    bool terminal = false;
+    int clearedRows = dropPiece( b, piece, action, terminal );
+    
+    // write the state observation vector to the action row
+    computeObservation<HoleDefinition>( b, terminal, (double (&)[STATEDIM])s.actions[action] );
+    
+    // if in terminal state, set the bias feature to the value specified in configuration
+    if( terminal ) s.actions[action][2 * COLUMNS - 1 + 2] = this->terminalBiasValueA;
+    
+    // add the immediate reward feature
+    s.actions[action][2 * COLUMNS - 1 + 3] = clearedRows;
+    
+    // set the terminal flag for the action
+    s.isActionTerminal[action] = terminal;
+    
+  }
+}
+
+
+template<int HoleDefinition>
+void TetrisBatch::generateStepData( int lane )
+{
+  Board b;
+  loadBoard( lane, b );
+  this->stepData[lane].transitionReward = 0;
+  computeObservation<HoleDefinition>( b, false, this->stepData[lane].observation );
+  computeActions<HoleDefinition>( lane );
+}
+
+
+template<int HoleDefinition>
+void TetrisBatch::generateStepData( const bool * active )
+{
+  computeObservations<HoleDefinition>( active );
+  for( int lane = 0 ; lane < this->lanes ; lane++ ) {
+    if( !active[lane] ) continue;
+    this->stepData[lane].transitionReward = this->clearedRows[lane];
+    computeActions<HoleDefinition>( lane );
+  }
+}
+
+
+
+
+/* public methods */
+
+
+TetrisBatch::TetrisBatch( int lanes, mxArray * rstream ) :
+  lanes( lanes ),
+  stepData( 0 ),
+  rstream( rstream ),
+  keyed( false ),
+  holeDefinition( HOLEDEFINITION ),
+  terminalBiasValueS( TERMINAL_BIAS_VALUE_S ),
+  terminalBiasValueA( TERMINAL_BIAS_VALUE_A )
+{
+  mxAssert( lanes > 0 && lanes <= BATCHMAXLANES, "Invalid number of lanes!" );
+  mxAssert( STATEDIM == 2 * COLUMNS - 1 + 3, "Unexpected STATEDIM!" );
+  mxAssert( HOLEDEFINITION != HD_FLOODFILL, "TetrisBatch does not support HD_FLOODFILL!" );
+  
+  this->stepData = new Tetris::StepData[lanes];
+  PROFILE_ALLOCATION( lanes * sizeof(Tetris::StepData) );
+  
+  // convert the piece shapes into row masks
+  for( int piece = 0 ; piece < 7 ; piece++ )
+    for( int orientation = 0 ; orientation < 4 ; orientation++ )
+      for( int row = 0 ; row < 4 ; row++ ) {
+        this->pieceRows[piece][orientation][row] = 0;
+        for( int col = 0 ; col < 4 ; col++ )
+          if( Tetris::pieces[piece][orientation][row][col] ) this->pieceRows[piece][orientation][row] |= 1 << col;
+      }
+  
+  // all lanes start empty and terminal
+  memset( this->board, 0, sizeof(this->board) );
+  for( int lane = 0 ; lane < BATCHMAXLANES ; lane++ ) {
+    for( int col = 0 ; col < COLUMNS ; col++ ) this->heightmap[col][lane] = ROWS;
+    this->heightmapMin[lane] = ROWS;
+    this->fallingPiece[lane] = 0;
+    this->clearedRows[lane] = 0; this->totalClearedRows[lane] = 0;
+    this->terminalState[lane] = true;
+  }
+}
+
+TetrisBatch::~TetrisBatch()
+{
+  delete[] this->stepData; this->stepData = 0;
+}
+
+
+void TetrisBatch::configure( int holeDefinition, double terminalBiasValueS, double terminalBiasValueA )
+{
+  if( holeDefinition != HD_COVEREDBY && holeDefinition != HD_UNDERTOPLINE )
+    mexErrMsgIdAndTxt( "TetrisBatch:invalidHoleDefinition", "TetrisBatch: Unsupported hole definition!" );
+  
+  this->holeDefinition = holeDefinition;
+  this->terminalBiasValueS = terminalBiasValueS;
+  this->terminalBiasValueA = terminalBiasValueA;
+}
+
+
+void TetrisBatch::keyStream( int lane, unsigned long long seed, unsigned long long episode )
+{
+  this->laneStreams[lane].setKey( seed, episode, PhiloxRandStream::RS_PIECES );
+  this->keyed = true;
+}
+
+
+void TetrisBatch::newEpisode( int lane )
+{
+  // clear board and heightmap
+  for( int row = 0 ; row < ROWS ; row++ ) this->board[row][lane] = 0;
+  for( int col = 0 ; col < COLUMNS ; col++ ) this->heightmap[col][lane] = ROWS;
+  this->heightmapMin[lane] = ROWS;
+  
+  // set falling piece
+  this->fallingPiece[lane] = (int)(rand( lane ) * 7.0);
+  
+  // clear scores and the terminal state flag
+  this->clearedRows[lane] = 0; this->totalClearedRows[lane] = 0;
+  this->terminalState[lane] = false;
+  
+  // generate the step data of the lane
+  if( this->holeDefinition == HD_COVEREDBY ) generateStepData<HD_COVEREDBY>( lane );
+  else generateStepData<HD_UNDERTOPLINE>( lane );
+}
+
+
+void TetrisBatch::step( const int * actions, const bool * active )
+{
+  // drop the pieces and randomize new falling pieces, in lane order
+  for( int lane = 0 ; lane < this->lanes ; lane++ ) {
+    if( !active[lane] ) continue;
+    
+    Board b;
+    loadBoard( lane, b );
+    this->clearedRows[lane] = dropPiece( b, this->fallingPiece[lane], actions[lane], this->terminalState[lane] );
+    storeBoard( lane, b );
+    this->totalClearedRows[lane] += this->clearedRows[lane];
+    
+    this->fallingPiece[lane] = (int)(rand( lane ) * 7.0);
+  }
+  
+  // generate the step data
+  if( this->holeDefinition == HD_COVEREDBY ) generateStepData<HD_COVEREDBY>( active );
+  else generateStepData<HD_UNDERTOPLINE>( active );
+}
@@ -0,0 +1,147 @@
+/* TetrisBatch.hpp
+ *
+ * A batch of Tetris boards that are stepped in lockstep, for high-throughput policy evaluation (see the 'evaluate'
+ * command in MexTetrisNAC). The boards follow exactly the same rules and produce exactly the same step data as Tetris.
+ *
+ * The state is stored in structure-of-arrays form with the lane (board) index innermost, and the boards are bitboards
+ * with one BoardRow per row (bit c is set if column c is filled). The per-lane loops over the whole batch (the state
+ * observations, the piece draws) are thus contiguous and vectorizable, and the hole count is computed with bit counts
+ * instead of scanning cells. Placements and the candidate observations of computeActions() are computed per lane on a
+ * gathered copy of the board.
+ *
+ * By default, the falling pieces of all lanes are drawn from a single random stream, in lane order, so results depend
+ * on the number of lanes. With a single lane, the random numbers are consumed exactly as by Tetris. Alternatively, each
+ * episode can draw its pieces from its own counter-based stream (see keyStream()), which makes the results independent
+ * of the number of lanes.
+ *
+ * As in Tetris, the hole definition is selected at runtime (see configure()) and dispatched once per step onto template
+ * instantiations of the observation and action computations. HD_FLOODFILL is not supported.
+ */
+#ifndef TETRISBATCH_HPP
+#define TETRISBATCH_HPP
+
+
+#include "Tetris.hpp"
+#include "../MatlabRandStream.hpp"
+#include "../PhiloxRandStream.hpp"
+
+
+// maximum number of lanes
+#define BATCHMAXLANES 64
+
+// one board row, bit c is set if column c is filled
+typedef unsigned short BoardRow;
+
+// compile-time check: a row must fit into BoardRow
+typedef char BoardRowSizeCheck[(COLUMNS <= 8 * sizeof(BoardRow)) ? 1 : -1];
+
+
+
+
+class TetrisBatch {
+  
+public:
+  
+  // number of lanes
+  int lanes;
+  
+  // outbound data for the current state of each lane
+  Tetris::StepData * stepData;
+  
+  // whether each lane is in a terminal state
+  bool terminalState[BATCHMAXLANES];
+  
+  // rows cleared during the episode in each lane
+  int totalClearedRows[BATCHMAXLANES];
+  
+  
+private:
+  
+  // a single board, gathered from a lane
+  struct Board {
+    BoardRow rows[ROWS];
+    int heightmap[COLUMNS];
+    int heightmapMin;
+  };
+  
+  // piece shapes as row masks: piece x orientation x row
+  BoardRow pieceRows[7][4][4];
+  
+  // random number generators: the shared Matlab stream, or the counter-based stream of each lane if keyed
+  MatlabRandStream rstream;
+  PhiloxRandStream laneStreams[BATCHMAXLANES];
+  bool keyed;
+  
+  // board state: row x lane
+  BoardRow board[ROWS][BATCHMAXLANES];
+  
+  // board heightmaps: column x lane (as in Tetris)
+  int heightmap[COLUMNS][BATCHMAXLANES];
+  int heightmapMin[BATCHMAXLANES];
+  
+  // currently falling piece of each lane
+  int fallingPiece[BATCHMAXLANES];
+  
+  // rows cleared during the previous step in each lane
+  int clearedRows[BATCHMAXLANES];
+  
+  // feature settings (see configure())
+  int holeDefinition;
+  double terminalBiasValueS, terminalBiasValueA;
+  
+  
+  // draw a random number for a lane
+  double rand( int lane ) { return this->keyed ? this->laneStreams[lane].rand() : this->rstream.rand(); }
+  
+  // gather and scatter a lane
+  void loadBoard( int lane, Board & b ) const;
+  void storeBoard( int lane, const Board & b );
+  
+  // drop a piece on a single board, as Tetris::dropPiece(). returns the number of cleared rows.
+  int dropPiece( Board & b, int piece, int action, bool & terminal ) const;
+  
+  // number of holes on a single board
+  template<int HoleDefinition> static int countHoles( const Board & b );
+  
+  // observation of a single board, as Tetris::computeObservation()
+  template<int HoleDefinition>
+  void computeObservation( const Board & b, bool terminal, double (& observation)[STATEDIM] ) const;
+  
+  // state observations of the given lanes
+  template<int HoleDefinition> void computeObservations( const bool * active );
+  
+  // action data of a lane, as Tetris::computeActions()
+  template<int HoleDefinition> void computeActions( int lane );
+  
+  // step data of a lane at the start of an episode, and of the given lanes after a step
+  template<int HoleDefinition> void generateStepData( int lane );
+  template<int HoleDefinition> void generateStepData( const bool * active );
+  
+  
+public:
+  
+  TetrisBatch( int lanes, mxArray * rstream );
+  ~TetrisBatch();
+  
+  // set the hole definition and the terminal bias feature values, as Tetris::configure()
+  void configure( int holeDefinition, double terminalBiasValueS, double terminalBiasValueA );
+  
+  // draw the pieces of a lane from the counter-based stream of the given experiment seed and episode index. call before
+  // newEpisode(). once called, all lanes must be keyed.
+  void keyStream( int lane, unsigned long long seed, unsigned long long episode );
+  
+  // start a new episode in a lane
+  void newEpisode( int lane );
+  
+  // take a step in each lane for which active is set. actions are orientation-major, as in Tetris::step().
+  void step( const int * actions, const bool * active );
+  
+  // index of the currently falling piece of a lane (0-6)
+  int getFallingPiece( int lane ) const { return this->fallingPiece[lane]; }
+  
+};
+
+
+
+
+#endif
@@ -0,0 +1,288 @@
+/* TetrisNACApi.cpp */
+
+
+#include "TetrisNACApi.h"
+#include "Tetris.hpp"
+#include "TetrisBatch.hpp"
+#include "NaturalActorCritic.hpp"
+#include "BatchEvaluation.hpp"
+#include "Configuration.hpp"
+#include "Solver.hpp"
+
+#include <cstring>
+using std::memcpy;
+
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <limits>
+#define Inf (std::numeric_limits<double>::infinity())
+
+
+
+
+struct tnacSession {
+  tnacSettings settings;
+  std::vector<double> theta;
+  double tau;
+  bool learning;
+  Tetris * environment;
+  NaturalActorCritic * agent;
+};
+
+
+// the most recent error of each thread
+static thread_local std::string lastError;
+
+
+// run f, storing the description of any error. returns 0 on success and -1 on failure.
+template<class F>
+static int guard( F f )
+{
+  try {
+    f();
+    lastError.clear();
+    return 0;
+  } catch( const std::exception & e ) {
+    lastError = e.what();
+  } catch( ... ) {
+    lastError = "TetrisNACApi: unknown error!";
+  }
+  return -1;
+}
+
+static void check( bool condition, const char * message )
+{
+  if( !condition ) throw std::invalid_argument( message );
+}
+
+
+
+
+extern "C" {
+
+
+int tnacApiVersion( void )
+{
+  return TNAC_API_VERSION;
+}
+
+
+const char * tnacLastError( void )
+{
+  return lastError.c_str();
+}
+
+
+void tnacDefaultSettings( tnacSettings * settings )
+{
+  settings->criticClass = Critic::CC_LSTD;
+  settings->petersTrickMode = PETERS_TRICK_MODE;
+  settings->gamma = 1.0;
+  settings->lambda = 0.0;
+  settings->actionCacheSize = 0;
+  settings->holeDefinition = HOLEDEFINITION;
+  settings->terminalBiasValueS = TERMINAL_BIAS_VALUE_S;
+  settings->terminalBiasValueA = TERMINAL_BIAS_VALUE_A;
+  settings->rejectTerminalActions = REJECT_TERMINAL_ACTIONS;
+  settings->pipelined = 0;
+}
+
+
+void tnacDefaultSolverOptions( tnacSolverOptions * options )
+{
+  options->method = "\\";
+  options->Ifactor = 0.0;
+  options->regularization = 0.0;
+  options->featureMask = 0;
+  options->w = 0;
+  options->iterations = 1;
+  options->stepsize = 1.0;
+}
+
+
+tnacSession * tnacCreateSession( const tnacSettings * settings, int thetaDim, const double * theta, double tau )
+{
+  tnacSession * session = 0;
+  int ret = guard( [&]() {
+    session = new tnacSession();
+    session->environment = 0;
+    session->agent = 0;
+    check( settings && theta, "TetrisNACApi: settings and theta must be given!" );
+    check( thetaDim == STATEACTIONDIM, "TetrisNACApi: theta must have one element per state-action feature!" );
+    session->settings = *settings;
+    session->theta.assign( theta, theta + thetaDim );
+    session->tau = tau;
+    session->learning = true;
+    
+    // the Matlab streams are never used, as every episode is keyed
+    session->environment = new Tetris( 20, 10, 0, settings->actionCacheSize );
+    session->environment->configure( settings->holeDefinition, settings->terminalBiasValueS,
+                                     settings->terminalBiasValueA );
+    session->agent = new NaturalActorCritic( 0, settings->criticClass, settings->petersTrickMode, true,
+                                             thetaDim, &session->theta[0], settings->gamma, settings->lambda, tau );
+    session->agent->setRejectTerminalActions( settings->rejectTerminalActions != 0 );
+    session->agent->setPipelined( settings->pipelined != 0 );
+    session->agent->makePersistent();
+  } );
+  if( ret ) {
+    tnacDestroySession( session );
+    return 0;
+  }
+  return session;
+}
+
+
+void tnacDestroySession( tnacSession * session )
+{
+  if( !session ) return;
+  delete session->agent;
+  delete session->environment;
+  delete session;
+}
+
+
+int tnacSetPolicy( tnacSession * session, const double * theta, double tau, int learning )
+{
+  return guard( [&]() {
+    check( session && theta, "TetrisNACApi: session and theta must be given!" );
+    session->agent->sync();
+    memcpy( &session->theta[0], theta, session->theta.size() * sizeof(double) );
+    session->tau = tau;
+    session->learning = learning != 0;
+    session->agent->attach( 0, session->learning, (int)session->theta.size(), &session->theta[0], tau );
+  } );
+}
+
+
+int tnacRunEpisodes( tnacSession * session, int episodes, unsigned long long seed,
+                     unsigned long long firstEpisode, double maxSteps, double * returns, double * steps )
+{
+  return guard( [&]() {
+    check( session && episodes >= 0, "TetrisNACApi: invalid session or number of episodes!" );
+    Tetris & environment = *session->environment;
+    NaturalActorCritic & agent = *session->agent;
+    
+    for( int episode = 0 ; episode < episodes ; episode++ ) {
+      
+      // as a plain MexTetrisNAC call with rngSeed = seed and rngEpisode = firstEpisode + episode
+      environment.keyStream( seed, firstEpisode + episode );
+      agent.keyStream( seed, firstEpisode + episode );
+      environment.newEpisode();
+      agent.newEpisode();
+      
+      double totalReward = 0.0, stepCounter = 0;
+      while( !environment.terminalState && stepCounter < maxSteps ) {
+        totalReward += environment.step( agent.step( environment.stepData ) );
+        stepCounter++;
+      }
+      agent.step( environment.stepData );   // step in terminal state for learning purposes
+      
+      if( returns ) returns[episode] = totalReward;
+      if( steps ) steps[episode] = stepCounter;
+    }
+    
+    agent.sync();
+  } );
+}
+
+
+int tnacEvaluate( tnacSession * session, int episodes, int lanes, unsigned long long seed,
+                  unsigned long long firstEpisode, double maxSteps, double * returns )
+{
+  return guard( [&]() {
+    check( session && episodes >= 0 && returns, "TetrisNACApi: invalid session, number of episodes or returns!" );
+    check( lanes >= 1 && lanes <= BATCHMAXLANES, "TetrisNACApi: the number of lanes must be in [1, 64]!" );
+    if( lanes > episodes ) lanes = episodes > 0 ? episodes : 1;
+    
+    // as the 'evaluate' command of MexTetrisNAC, with a separate non-learning agent
+    const tnacSettings & settings = session->settings;
+    TetrisBatch batch( lanes, 0 );
+    batch.configure( settings.holeDefinition, settings.terminalBiasValueS, settings.terminalBiasValueA );
+    NaturalActorCritic agent( 0, Critic::CC_LSTD, PTM_ON, false, (int)session->theta.size(), &session->theta[0],
+                              0.0, 0.0, session->tau );
+    agent.setRejectTerminalActions( settings.rejectTerminalActions != 0 );
+    evaluateBatch( batch, agent, episodes, true, seed, firstEpisode, maxSteps, -Inf, Inf, returns );
+  } );
+}
+
+
+int tnacResetCritic( tnacSession * session )
+{
+  return guard( [&]() {
+    check( session != 0, "TetrisNACApi: no session!" );
+    session->agent->sync();
+    session->agent->critic->reset();
+  } );
+}
+
+
+int tnacForget( tnacSession * session, double beta )
+{
+  return guard( [&]() {
+    check( session != 0, "TetrisNACApi: no session!" );
+    session->agent->sync();
+    session->agent->critic->forget( beta );
+    session->agent->policyUpdated();
+  } );
+}
+
+
+int tnacSolve( tnacSession * session, const tnacSolverOptions * options, double * V, double * cond )
+{
+  return guard( [&]() {
+    check( session && options && V && cond, "TetrisNACApi: session, options, V and cond must be given!" );
+    Critic & critic = *session->agent->critic;
+    const int VDim = critic.getVDim();
+    
+    SolverOptions o;
+    check( options->method && Solver::parseMethod( options->method, o.method ),
+           "TetrisNACApi: invalid or unsupported solver method!" );
+    o.Ifactor = options->Ifactor;
+    o.regularization = options->regularization;
+    for( int i = 0 ; i < VDim ; i++ ) {
+      o.featureMask[i] = options->featureMask ? options->featureMask[i] != 0 : true;
+      o.w[i] = options->w ? options->w[i] : 0.0;
+    }
+    o.iterations = options->iterations;
+    o.stepsize = options->stepsize;
+    
+    session->agent->sync();
+    critic.solve( o, V, *cond );
+  } );
+}
+
+
+int tnacCriticDim( const tnacSession * session )
+{
+  return session ? session->agent->critic->getVDim() : -1;
+}
+
+
+int tnacGetCriticBuffers( tnacSession * session, tnacBuffer * buffers, int maxBuffers )
+{
+  int count = 0;
+  int ret = guard( [&]() {
+    check( session && buffers, "TetrisNACApi: session and buffers must be given!" );
+    session->agent->sync();
+    CriticBuffer criticBuffers[CRITIC_MAXBUFFERS];
+    count = session->agent->critic->getBuffers( criticBuffers );
+    check( count <= maxBuffers, "TetrisNACApi: too few buffer descriptors!" );
+    for( int i = 0 ; i < count ; i++ ) {
+      const CriticBuffer & b = criticBuffers[i];
+      buffers[i].name = b.name;
+      buffers[i].data = b.data;
+      buffers[i].type = b.type == CriticBuffer::BT_INT64 ? TNAC_INT64 : TNAC_DOUBLE;
+      buffers[i].layout = b.layout == CriticBuffer::BL_PACKEDUPPER ? TNAC_PACKEDUPPER : TNAC_DENSE;
+      buffers[i].rows = b.rows;
+      buffers[i].cols = b.cols;
+      buffers[i].stride = b.stride;
+    }
+  } );
+  return ret ? -1 : count;
+}
+  
+  
+}
@@ -0,0 +1,162 @@
+/* TetrisNACApi.h
+ *
+ * C interface to the native Tetris environment and natural actor-critic agent, for driving the engine from outside of
+ * Matlab. The library is built with make('capi') and consists of the engine sources, TetrisNACApi.cpp and
+ * StandaloneMex.cpp; it links against the Matrix API (libmx) of a Matlab installation or the Matlab Runtime, but does
+ * not run Matlab.
+ *
+ * Dependencies: The library is not free of Matlab. Building it needs the headers of a Matlab installation (mex.h and
+ * matrix.h, as for the mex file), and loading it needs libmx and the libraries that libmx depends on, from that
+ * installation or from a Matlab Runtime of the same release. make('capi') sets the run-time search path to the
+ * installation it was built with; elsewhere, the directory of libmx must be added to the library search path (e.g.,
+ * LD_LIBRARY_PATH). The engine uses libmx only to allocate and fill the arrays that hold its statistics and results
+ * (creating numeric, struct and cell arrays and accessing their data and fields), never the Matlab interpreter.
+ *
+ * A session holds an environment and an agent whose critic statistics accumulate over the episodes run in it, as a
+ * MexTetrisNAC session does. All episodes draw their pieces and actions from the counter-based streams of an experiment
+ * seed and an episode index (see PhiloxRandStream.hpp), so the results match those of MexTetrisNAC with the same
+ * rngSeed and rngEpisode.
+ *
+ * Results are written into caller-provided arrays, and the critic statistics are exposed in place with
+ * tnacGetCriticBuffers(), without copying or transposing them. The buffers stay valid until the session is destroyed,
+ * but their contents change with every learning episode.
+ *
+ * Functions that can fail return 0 on success and -1 on failure (null for tnacCreateSession()), with a description of
+ * the error in tnacLastError(). A session must not be used from several threads at once; separate sessions are
+ * independent.
+ *
+ * Compatibility: TNAC_API_VERSION is incremented whenever the declarations below change incompatibly. Callers should
+ * check tnacApiVersion() against the version they were compiled with.
+ */
+#ifndef TETRISNACAPI_H
+#define TETRISNACAPI_H
+
+
+#if defined(_WIN32)
+#  if defined(TNAC_BUILD)
+#    define TNAC_API __declspec(dllexport)
+#  else
+#    define TNAC_API __declspec(dllimport)
+#  endif
+#elif defined(__GNUC__)
+#  define TNAC_API __attribute__((visibility("default")))
+#else
+#  define TNAC_API
+#endif
+
+#define TNAC_API_VERSION 1
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+
+/* an engine session */
+typedef struct tnacSession tnacSession;
+
+
+/* Settings fixed when a session is created. Initialize with tnacDefaultSettings(), which sets the defaults of
+ * Configuration.hpp, and then override fields as needed. */
+typedef struct {
+  int criticClass;             /* 0 = LSTD, 1 = LSPE, 2 = full TD (sample buffers), 3 = eNAC, 4 = GTD2, 5 = TDC */
+  int petersTrickMode;         /* 0 = off, 1 = on, 2 = corrected (LSTD only) */
+  double gamma;
+  double lambda;
+  int actionCacheSize;         /* number of cached placements, or 0 to disable the action cache */
+  int holeDefinition;          /* 0 = covered by, 1 = under the topline, 2 = flood fill (not with tnacEvaluate()) */
+  double terminalBiasValueS;
+  double terminalBiasValueA;
+  int rejectTerminalActions;
+  int pipelined;               /* run the critic updates in a learner thread */
+} tnacSettings;
+
+
+/* Options for tnacSolve(). Initialize with tnacDefaultSolverOptions(), as for tnacSettings. */
+typedef struct {
+  const char * method;         /* '\', 'chol', 'qr', 'pinv' or 'regularized' (see Solver.hpp) */
+  double Ifactor;              /* added to the diagonal of the main matrix */
+  double regularization;
+  const unsigned char * featureMask;   /* features taking part in solving (VDim elements), or null for all */
+  const double * w;            /* LSPE: initial solution (VDim elements), or null for zero */
+  int iterations;              /* LSPE */
+  double stepsize;             /* LSPE */
+} tnacSolverOptions;
+
+
+/* A critic statistics buffer, exposed in place (see CriticBuffer in Critic.hpp). A dense buffer has rows x cols
+ * elements, with element (row, col) at data[row * stride + col]. A packed buffer holds the upper triangle of a
+ * symmetric rows x rows matrix row by row. */
+enum { TNAC_DOUBLE = 0, TNAC_INT64 = 1 };
+enum { TNAC_DENSE = 0, TNAC_PACKEDUPPER = 1 };
+
+typedef struct {
+  const char * name;           /* LSTD: A, b. LSPE: A, b, Bss, Bsa, Baa, Bcarry (if any). Full TD: s0, s1, r. */
+  const void * data;
+  int type;                    /* TNAC_DOUBLE or TNAC_INT64 */
+  int layout;                  /* TNAC_DENSE or TNAC_PACKEDUPPER */
+  int rows, cols, stride;
+} tnacBuffer;
+
+
+
+
+/* version of the interface, TNAC_API_VERSION of the library */
+TNAC_API int tnacApiVersion( void );
+
+/* description of the most recent error in the calling thread, or an empty string */
+TNAC_API const char * tnacLastError( void );
+
+TNAC_API void tnacDefaultSettings( tnacSettings * settings );
+TNAC_API void tnacDefaultSolverOptions( tnacSolverOptions * options );
+
+/* Create a session with the policy (theta, tau), where theta has thetaDim elements and is copied. Learning is enabled.
+ * Returns null on failure. */
+TNAC_API tnacSession * tnacCreateSession( const tnacSettings * settings, int thetaDim, const double * theta,
+                                          double tau );
+
+/* destroy a session (null is ignored) */
+TNAC_API void tnacDestroySession( tnacSession * session );
+
+/* set the policy (theta is copied and must have thetaDim elements) and whether the episodes update the critic */
+TNAC_API int tnacSetPolicy( tnacSession * session, const double * theta, double tau, int learning );
+
+/* Run episodes episodes, where episode k uses the streams of (seed, firstEpisode + k) and ends in a terminal state or
+ * after maxSteps steps. The returns and the numbers of steps are stored in returns and steps (episodes elements each,
+ * either may be null). */
+TNAC_API int tnacRunEpisodes( tnacSession * session, int episodes, unsigned long long seed,
+                              unsigned long long firstEpisode, double maxSteps, double * returns, double * steps );
+
+/* Evaluate the policy of the session without learning in a batch of lanes (at most 64) boards stepped in lockstep, as
+ * the 'evaluate' command of MexTetrisNAC does, and store the returns in returns (episodes elements). Episode k uses the
+ * streams of (seed, firstEpisode + k), so the results do not depend on lanes. The critic is not touched. */
+TNAC_API int tnacEvaluate( tnacSession * session, int episodes, int lanes, unsigned long long seed,
+                           unsigned long long firstEpisode, double maxSteps, double * returns );
+
+/* clear the critic statistics */
+TNAC_API int tnacResetCritic( tnacSession * session );
+
+/* scale the critic statistics by beta after an actor update */
+TNAC_API int tnacForget( tnacSession * session, double beta );
+
+/* solve the critic parameters into V (tnacCriticDim() elements) and estimate the condition number into cond */
+TNAC_API int tnacSolve( tnacSession * session, const tnacSolverOptions * options, double * V, double * cond );
+
+/* number of critic features, or -1 on failure */
+TNAC_API int tnacCriticDim( const tnacSession * session );
+
+/* Describe the critic statistics buffers in buffers (at most maxBuffers; 8 is always enough). Returns the number of
+ * buffers, or -1 on failure. */
+TNAC_API int tnacGetCriticBuffers( tnacSession * session, tnacBuffer * buffers, int maxBuffers );
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
@@ -0,0 +1,69 @@
+/* TransitionStore.cpp */
+
+
+#include "TransitionStore.hpp"
+
+#include <cstring>
+using std::memcpy;
+
+
+
+
+TransitionStore::TransitionStore( int capacity ) :
+  capacity( capacity ),
+  size( 0 )
+{
+}
+
+
+void TransitionStore::newEpisode( int generation )
+{
+  this->episodes.push_back( Episode() );
+  this->episodes.back().generation = generation;
+}
+
+
+void TransitionStore::record( const Tetris::StepData & s, int action, double behaviorProbability )
+{
+  mxAssert( !this->episodes.empty(), "No episode is being recorded!" );
+  Episode & e = this->episodes.back();
+  
+  Step step;
+  step.reward = s.transitionReward;
+  memcpy( step.observation, s.observation, sizeof(step.observation) );
+  step.actionCount = s.actionCount;
+  step.offset = (int)(e.actions.size() / STATEACTIONDIM);
+  step.action = action;
+  step.behaviorProbability = behaviorProbability;
+  e.steps.push_back( step );
+  
+  e.actions.insert( e.actions.end(), &s.actions[0][0], &s.actions[0][0] + s.actionCount * STATEACTIONDIM );
+  e.isActionTerminal.insert( e.isActionTerminal.end(), s.isActionTerminal, s.isActionTerminal + s.actionCount );
+  this->size++;
+  
+  // drop the oldest episodes if over capacity
+  while( this->size > this->capacity && this->episodes.size() > 1 ) {
+    this->size -= (int)this->episodes.front().steps.size();
+    this->episodes.pop_front();
+  }
+}
+
+
+void TransitionStore::clear()
+{
+  this->episodes.clear();
+  this->size = 0;
+}
+
+
+void TransitionStore::load( const Episode & e, int t, Tetris::StepData & s )
+{
+  const Step & step = e.steps[t];
+  s.transitionReward = step.reward;
+  memcpy( s.observation, step.observation, sizeof(s.observation) );
+  s.actionCount = step.actionCount;
+  if( step.actionCount > 0 )
+    memcpy( s.actions, &e.actions[step.offset * STATEACTIONDIM], step.actionCount * sizeof(s.actions[0]) );
+  for( int action = 0 ; action < step.actionCount ; action++ )
+    s.isActionTerminal[action] = e.isActionTerminal[step.offset + action];
+}
@@ -0,0 +1,81 @@
+/* TransitionStore.hpp
+ *
+ * Transitions of recent episodes, kept for off-policy re-evaluation under later policies (see
+ * NaturalActorCritic::reevaluate()). For each step, the state observation, the features of the available actions, the
+ * selected action and the probability with which the behavior policy selected it are stored. Only the available actions
+ * are stored, so a step takes approx. actionCount * STATEACTIONDIM doubles instead of a full StepData.
+ *
+ * Each episode is tagged with the generation of the policy that produced it. When the number of stored steps exceeds
+ * the capacity, the oldest episodes are dropped (the episode being recorded is always kept).
+ */
+#ifndef TRANSITIONSTORE_HPP
+#define TRANSITIONSTORE_HPP
+
+
+#include "Tetris.hpp"
+
+#include <deque>
+#include <vector>
+
+
+
+
+class TransitionStore {
+  
+public:
+  
+  // a stored step. the features of its actions start at row offset of the episode's action array.
+  struct Step {
+    double reward;
+    double observation[STATEDIM];
+    int actionCount;
+    int offset;
+    int action;
+    double behaviorProbability;
+  };
+  
+  struct Episode {
+    int generation;
+    std::vector<Step> steps;
+    std::vector<double> actions;
+    std::vector<bool> isActionTerminal;
+  };
+  
+  
+private:
+  
+  std::deque<Episode> episodes;
+  
+  // maximum and current number of stored steps
+  int capacity;
+  int size;
+  
+  
+public:
+  
+  TransitionStore( int capacity );
+  
+  // change the capacity. excess episodes are dropped on the next record().
+  void setCapacity( int capacity ) { this->capacity = capacity; }
+  
+  // begin recording an episode produced by the given policy generation
+  void newEpisode( int generation );
+  
+  // record a step of the current episode. action is -1 in a terminal state.
+  void record( const Tetris::StepData & s, int action, double behaviorProbability );
+  
+  // drop all episodes
+  void clear();
+  
+  int episodeCount() const { return (int)this->episodes.size(); }
+  const Episode & episode( int i ) const { return this->episodes[i]; }
+  
+  // expand step t of an episode into step data
+  static void load( const Episode & e, int t, Tetris::StepData & s );
+  
+};
+
+
+
+
+#endif
@@ -0,0 +1,65 @@
+function report = CompareEnginesMex( environment, agent, episodes, engine, tolerance, stopConds )
+%COMPAREENGINESMEX Check an optimized mex engine against the reference engine
+%
+%   Run episodes episodes side by side in the reference mex engine (no
+%   action cache, sequential critic updates) and in the optimized engine
+%   engine, and compare the piece sequences, the step data, the selected
+%   actions and the critic statistics of each episode. engine is one of
+%
+%     'actionCache'  the Zobrist-keyed action cache (of size
+%                    environment.actionCacheSize, or 4096 if unset)
+%     'pipeline'     the pipelined critic updates in a learner thread
+%     'batch'        a single lane of the batch environment used by
+%                    EvaluateBatchMex (learning is disabled in both engines)
+%
+%   Values are compared bit-for-bit if tolerance is 0, and otherwise
+%   within the absolute tolerance. Both engines draw from the same
+%   counter-based random streams: those of the environment if enabled (see
+%   Environment.mexRngSeed), and those of seed 0 otherwise. stopConds.
+%   maxSteps applies to each episode. Neither the environment nor the agent
+%   is modified.
+%
+%   The returned struct has the fields episodes, steps, pieceMismatches,
+%   actionMismatches, stepDataMismatches, criticMismatches,
+%   maxStepDataDifference, maxCriticDifference, firstMismatch (a
+%   description of the first mismatch, or empty), and
+%   referenceStepsPerSecond and candidateStepsPerSecond (the throughput of
+%   each engine, excluding the comparisons). The engines are equivalent
+%   if all the mismatch counts are zero.
+%
+%   Only the mex engines are compared with each other; the results of the
+%   Matlab implementation are not.
+
+
+pairNames = { 'TetrisStandardFeatures-AgentNaturalActorCritic', 'TetrisNative-AgentNaturalActorCritic' };
+pairHandles = { @TetrisNAC.MexTetrisNAC, @TetrisNAC.MexTetrisNAC };
+
+
+
+
+% find handle
+pairName = [class(environment) '-' class(agent)];
+assert( any(strcmp( pairName, pairNames )), ['Unknown pair: ' pairName] );
+pairHandle = pairHandles{ strcmp( pairName, pairNames ) };
+
+
+% prepare
+if nargin < 6
+  stopConds = struct( 'maxSteps', Inf, 'totalRewardRange', [-Inf, Inf] );
+end
+[~, envData] = mexFork( environment, true );
+[~, agentData] = mexFork( agent, true );
+
+% call
+try
+  report = pairHandle( 'compare', envData, agentData, stopConds, episodes, engine, tolerance );
+catch err
+  if any(strcmp(err.identifier, {'MATLAB:UndefinedFunction','MATLAB:unassignedOutputs'}))
+    fprintf( '\n\nException ''%s'' caught during MEX execution. Did you remember to compile using ''make''?\n\n', ...
+      err.identifier );
+  end
+  rethrow(err);
+end
+
+
+end
@@ -0,0 +1,58 @@
+function returns = EvaluateBatchMex( environment, agent, episodes, lanes, stopConds )
+%EVALUATEBATCHMEX Evaluate a policy in a batch of boards using a mex implementation
+%
+%   Run episodes episodes with learning disabled, simulating lanes boards
+%   (at most 64) in lockstep, and return the episode returns as a column
+%   vector in the order in which the episodes were started. The pieces of
+%   all lanes come from the environment's random stream, so the results
+%   depend on the number of lanes. With a single lane, the results are
+%   identical to running the episodes one after another in a single mex
+%   call.
+%
+%   If the environment's counter-based random streams are enabled (see
+%   Environment.mexRngSeed), then each episode draws its pieces and actions
+%   from its own streams and the results do not depend on the number of
+%   lanes: episode k returns exactly what RunEpisodeMex would with
+%   mexRngEpisode advanced by k - 1. The episode counter is advanced by
+%   episodes.
+%
+%   stopConds apply to each episode, as in RunEpisodeMex. The agent is not
+%   modified; the environment is joined with the return of the last
+%   episode.
+
+
+pairNames = { 'TetrisStandardFeatures-AgentNaturalActorCritic', 'TetrisNative-AgentNaturalActorCritic' };
+pairHandles = { @TetrisNAC.MexTetrisNAC, @TetrisNAC.MexTetrisNAC };
+
+
+
+
+% find handle
+pairName = [class(environment) '-' class(agent)];
+assert( any(strcmp( pairName, pairNames )), ['Unknown pair: ' pairName] );
+pairHandle = pairHandles{ strcmp( pairName, pairNames ) };
+
+
+% prepare
+[~, envData] = mexFork( environment, true );
+[~, agentData] = mexFork( agent, true );
+
+% call
+try
+  returns = pairHandle( 'evaluate', envData, agentData, stopConds, episodes, lanes );
+catch err
+  if any(strcmp(err.identifier, {'MATLAB:UndefinedFunction','MATLAB:unassignedOutputs'}))
+    fprintf( '\n\nException ''%s'' caught during MEX execution. Did you remember to compile using ''make''?\n\n', ...
+      err.identifier );
+  end
+  rethrow(err);
+end
+
+% finalize
+if ~isempty(returns)
+  environment.mexJoin( struct( 'return', returns(end), 'observationLog', [] ) );
+end
+environment.mexRngEpisode = environment.mexRngEpisode + episodes;
+
+
+end
@@ -0,0 +1,77 @@
+function returns = FarmEvaluateMex( farm, environment, agent, episodes, stopConds )
+%FARMEVALUATEMEX Run learning episodes in a shared-memory farm of local Matlab processes
+%
+%   Submit episodes learning episodes of the agent's policy as jobs to the
+%   farm named farm, run jobs in this process as well, wait until the
+%   worker processes (see FarmWorkerMex) have completed the rest, and join
+%   the merged critic statistics into the agent, as if the episodes had
+%   been run with RunEpisodeMex. The episode returns are returned as a
+%   column vector in job order. The farm must have been created with
+%
+%     TetrisNAC.MexTetrisNAC( 'farmCreate', farm, capacity )
+%
+%   with capacity >= episodes, and is removed with 'farmDestroy' (see
+%   'farmCreate' in mex/+TetrisNAC/MexTetrisNAC.cpp). The statistics are
+%   read directly from shared memory, without any file I/O.
+%
+%   If the environment's counter-based random streams are enabled (see
+%   Environment.mexRngSeed), then job k draws from the streams of episode
+%   mexRngEpisode + k - 1 whichever process runs it, and the episodes are
+%   those of RunEpisodeMex; only the summation order of the statistics
+%   varies. The episode counter is advanced by episodes.
+%
+%   Mex sessions and sweep critics are not supported, and the critic must
+%   be LSTDLambda, LSPELambda or EpisodicNAC. If a job raises an error in
+%   a worker, then the worker stops with the error and, once the other
+%   jobs have been completed, the whole evaluation raises an error.
+
+
+pairNames = { 'TetrisStandardFeatures-AgentNaturalActorCritic', 'TetrisNative-AgentNaturalActorCritic' };
+pairHandles = { @TetrisNAC.MexTetrisNAC, @TetrisNAC.MexTetrisNAC };
+
+
+
+
+% find handle
+pairName = [class(environment) '-' class(agent)];
+assert( any(strcmp( pairName, pairNames )), ['Unknown pair: ' pairName] );
+pairHandle = pairHandles{ strcmp( pairName, pairNames ) };
+
+
+% prepare
+[~, envData] = mexFork( environment, true );
+[~, agentData] = mexFork( agent, true );
+assert( ~isfield( agentData, 'mexSession' ) && isempty(agentData.sweepCritics), ...
+        'Farms support neither mex sessions nor sweep critics.' );
+
+% call: submit, work along and wait for the workers
+try
+  pairHandle( 'farmSubmit', farm, envData, agentData, episodes );
+  pairHandle( 'farmWork', farm, envData, agentData, stopConds );
+  status = pairHandle( 'farmQuery', farm );
+  while status.completed < status.jobs
+    pause( 0.01 );
+    status = pairHandle( 'farmQuery', farm );
+  end
+  if status.failed > 0
+    error( 'FarmEvaluateMex:failedJobs', '%d of the %d jobs failed in the workers.', status.failed, status.jobs );
+  end
+catch err
+  if any(strcmp(err.identifier, {'MATLAB:UndefinedFunction','MATLAB:unassignedOutputs'}))
+    fprintf( '\n\nException ''%s'' caught during MEX execution. Did you remember to compile using ''make''?\n\n', ...
+      err.identifier );
+  end
+  rethrow(err);
+end
+
+% finalize
+returns = status.returns;
+for k=1:length(returns)
+  % join each job as RunEpisodeMex joins its episode (the last one is left in the logger proxy)
+  environment.mexJoin( struct( 'return', returns(k), 'observationLog', [] ) );
+end
+agent.mexJoin( struct( 'critic', status.critic ) );
+environment.mexRngEpisode = environment.mexRngEpisode + episodes;
+  
+  
+end
@@ -0,0 +1,50 @@
+function jobsRun = FarmWorkerMex( farm, environment, agent, stopConds, idleTimeout )
+%FARMWORKERMEX Run the jobs of a shared-memory farm in a worker process
+%
+%   Run the episode jobs submitted to the farm named farm (see
+%   FarmEvaluateMex) in this Matlab process, until no new jobs have been
+%   submitted for idleTimeout seconds (default Inf), and return the number
+%   of jobs run. Each job is a learning episode of the policy and the
+%   critic settings of the submitting agent, with the feature settings of
+%   the submitting environment, whose critic statistics are merged into
+%   the farm; the environment and the agent given here only provide the
+%   action cache size and the random streams used if the jobs are not
+%   keyed.
+%
+%   Start any number of workers on the same host, for example in Matlab
+%   processes started with -batch, once the farm has been created.
+
+
+if nargin < 5; idleTimeout = Inf; end
+
+pairNames = { 'TetrisStandardFeatures-AgentNaturalActorCritic', 'TetrisNative-AgentNaturalActorCritic' };
+pairHandles = { @TetrisNAC.MexTetrisNAC, @TetrisNAC.MexTetrisNAC };
+
+
+
+
+% find handle
+pairName = [class(environment) '-' class(agent)];
+assert( any(strcmp( pairName, pairNames )), ['Unknown pair: ' pairName] );
+pairHandle = pairHandles{ strcmp( pairName, pairNames ) };
+
+
+% prepare
+[~, envData] = mexFork( environment, true );
+[~, agentData] = mexFork( agent, true );
+
+% work, polling for new batches while idle
+jobsRun = 0;
+idleSince = tic;
+while toc( idleSince ) < idleTimeout
+  n = pairHandle( 'farmWork', farm, envData, agentData, stopConds );
+  if n > 0
+    jobsRun = jobsRun + n;
+    idleSince = tic;
+  else
+    pause( 0.01 );
+  end
+end
+  
+  
+end
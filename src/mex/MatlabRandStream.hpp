@@ -10,6 +10,10 @@
 #define MATLABRANDSTREAM
 
 
+#include "Profiler.hpp"
+#include "RandStream.hpp"
+#include "StateBuffer.hpp"
+
 #include "mex.h"
 #include "matrix.h"
 
@@ -20,7 +24,9 @@
 
 
 
-class MatlabRandStream {
+class MatlabRandStream :
+  public RandStream
+{
   
   mxArray * plhs[1];
   mxArray * prhs[3];
@@ -32,6 +38,9 @@ class MatlabRandStream {
    * the contained double data. */
   void loadBuffer()
   {
+    PROFILE_SCOPE( PP_LOADBUFFER );
+    PROFILE_ALLOCATION( BUFFERSIZE * sizeof(double) );
+    
     // free old data
     if( this->plhs[0] ) mxDestroyArray( this->plhs[0] );
     
@@ -48,14 +57,23 @@ class MatlabRandStream {
   
 public:
   
-  MatlabRandStream( mxArray * rstream ) :
-    idx(BUFFERSIZE)
+  MatlabRandStream( mxArray * rstream )
+  {
+    setStream( rstream );
+  }
+  
+  /* Attach to a Matlab stream for the current mex call. Must be called at the beginning of each mex call if the object
+   * outlives a call (see the session API in MexTetrisNAC), as Matlab frees the argument and buffer arrays when the
+   * call returns. Any buffered numbers are discarded, just as MexCompatibleRandStream.mexJoin() does. */
+  void setStream( mxArray * rstream )
   {
-    // set up args for the matlab call
+    // set up args for the matlab call. without a stream (the keyed and the standalone engines), nothing is ever pulled,
+    // so do not allocate the size args: outside of Matlab, they would never be freed.
     this->plhs[0] = 0;   // must be set for loadBuffer()
     this->prhs[0] = rstream;
-    this->prhs[1] = mxCreateDoubleScalar(BUFFERSIZE);
-    this->prhs[2] = mxCreateDoubleScalar(1.0);
+    this->prhs[1] = rstream ? mxCreateDoubleScalar(BUFFERSIZE) : 0;
+    this->prhs[2] = rstream ? mxCreateDoubleScalar(1.0) : 0;
+    this->idx = BUFFERSIZE;
   }
   
   // return a single random number
@@ -64,6 +82,25 @@ public:
     return this->buffer[this->idx++];
   }
   
+  /* Save and restore the stream position. Numbers that have already been pulled from Matlab but not yet used are
+   * stored in the state, so that a restored stream continues exactly where the saved one left off. */
+  void saveState( StateWriter & w ) const
+  {
+    w.write( this->idx );
+    if( this->idx < BUFFERSIZE ) w.write( this->buffer, BUFFERSIZE * sizeof(double) );
+  }
+  
+  void loadState( StateReader & r )
+  {
+    r.read( this->idx );
+    if( this->idx < BUFFERSIZE ) {
+      if( this->plhs[0] ) mxDestroyArray( this->plhs[0] );
+      this->plhs[0] = mxCreateDoubleMatrix( BUFFERSIZE, 1, mxREAL );
+      this->buffer = mxGetPr( this->plhs[0] );
+      r.read( this->buffer, BUFFERSIZE * sizeof(double) );
+    }
+  }
+  
 };
 
 
@@ -0,0 +1,139 @@
+/* PhiloxRandStream.hpp
+ *
+ * Counter-based random number streams: the n-th number of a stream is a pure function of the key (an experiment seed)
+ * and the counter (the episode index, the purpose of the stream and n), computed with the Philox4x32-10 bijection
+ * (Salmon, Moraes, Dror & Shaw, 2011). Any stream can thus be regenerated independently, and results do not depend
+ * on the order in which episodes are simulated, or on how many are simulated in parallel.
+ *
+ * Each block of the bijection yields two doubles with 53 random bits each. The counter words are the block index, the
+ * purpose, and the low and high words of the episode index, so streams of different purposes or episodes never share
+ * a counter. The block index has a word of its own, which limits a stream to 2^32 blocks (2^33 numbers) before it
+ * wraps around.
+ *
+ *   References
+ *
+ *     Salmon, Moraes, Dror & Shaw (2011). Parallel random numbers: as easy as 1, 2, 3.
+ */
+#ifndef PHILOXRANDSTREAM_HPP
+#define PHILOXRANDSTREAM_HPP
+
+
+#include "RandStream.hpp"
+#include "StateBuffer.hpp"
+
+
+// compile-time check: the bijection works on 32-bit words
+typedef char PhiloxWordSizeCheck[(sizeof(unsigned int) == 4) ? 1 : -1];
+
+
+
+
+class PhiloxRandStream :
+  public RandStream
+{
+  
+  // key, and the counter words: block index, purpose, episode (low and high)
+  unsigned int key[2];
+  unsigned int purpose;
+  unsigned long long episode;
+  unsigned int block;
+  
+  // the numbers of the current block, and the index of the next one to return
+  double buffer[2];
+  int idx;
+  
+  
+  static void mulhilo( unsigned int a, unsigned int b, unsigned int & hi, unsigned int & lo )
+  {
+    unsigned long long product = (unsigned long long)a * b;
+    hi = (unsigned int)(product >> 32); lo = (unsigned int)product;
+  }
+  
+  // compute the numbers of the current block
+  void generate()
+  {
+    unsigned int c[4] = { this->block, this->purpose,
+                          (unsigned int)this->episode, (unsigned int)(this->episode >> 32) };
+    unsigned int k[2] = { this->key[0], this->key[1] };
+    
+    for( int round = 0 ; round < 10 ; round++ ) {
+      unsigned int hi0, lo0, hi1, lo1;
+      mulhilo( 0xD2511F53u, c[0], hi0, lo0 );
+      mulhilo( 0xCD9E8D57u, c[2], hi1, lo1 );
+      c[0] = hi1 ^ c[1] ^ k[0]; c[1] = lo1;
+      c[2] = hi0 ^ c[3] ^ k[1]; c[3] = lo0;
+      k[0] += 0x9E3779B9u; k[1] += 0xBB67AE85u;
+    }
+    
+    // 53-bit doubles in [0, 1)
+    for( int i = 0 ; i < 2 ; i++ )
+      this->buffer[i] = ((c[2*i] >> 5) * 67108864.0 + (c[2*i+1] >> 6)) * (1.0 / 9007199254740992.0);
+    this->idx = 0;
+  }
+  
+  
+public:
+  
+  // stream purposes (a stream is identified by the key, the episode and the purpose). the rollout purposes are used by
+  // RolloutEngine, whose rollouts have their own episode index space.
+  enum Purpose { RS_PIECES = 1, RS_ACTIONS, RS_SAMPLES, RS_ROLLOUTPIECES, RS_ROLLOUTACTIONS };
+  
+  PhiloxRandStream() :
+    purpose( 0 ),
+    episode( 0 ),
+    block( 0 ),
+    idx( 2 )
+  {
+    this->key[0] = 0; this->key[1] = 0;
+  }
+  
+  // select a stream and rewind it to the beginning
+  void setKey( unsigned long long seed, unsigned long long episode, Purpose purpose )
+  {
+    this->key[0] = (unsigned int)seed; this->key[1] = (unsigned int)(seed >> 32);
+    this->episode = episode;
+    this->purpose = purpose;
+    this->block = 0;
+    this->idx = 2;
+  }
+  
+  // the episode index of the selected stream
+  unsigned long long getEpisode() const { return this->episode; }
+  
+  double rand()
+  {
+    if( this->idx == 2 ) { generate(); this->block++; }
+    return this->buffer[this->idx++];
+  }
+  
+  void saveState( StateWriter & w ) const
+  {
+    w.write( this->key );
+    w.write( this->purpose );
+    w.write( this->episode );
+    w.write( this->block );
+    w.write( this->idx );
+  }
+  
+  void loadState( StateReader & r )
+  {
+    r.read( this->key );
+    r.read( this->purpose );
+    r.read( this->episode );
+    r.read( this->block );
+    r.read( this->idx );
+    
+    // regenerate the current block
+    if( this->idx < 2 ) {
+      int idx = this->idx;
+      this->block--; generate(); this->block++;
+      this->idx = idx;
+    }
+  }
+  
+};
+
+
+
+
+#endif
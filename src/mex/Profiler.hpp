@@ -0,0 +1,220 @@
+/* Profiler.hpp
+ *
+ * Compile-time optional hot-path instrumentation for the mex implementations. When PROFILING is nonzero, call counts
+ * and time stamp counter (TSC) cycle totals are recorded for each phase, together with the number and total size of
+ * memory allocations. When PROFILING is zero, all macros expand to nothing.
+ *
+ * Cycle totals are inclusive: a phase that is entered from within another phase (computeObservation() within
+ * computeActions(), critic step() within learn()) is counted in both.
+ *
+ * The counters are process-global and persist while the mex file is loaded, so call PROFILE_RESET() at the beginning
+ * of each mex call. Enable by compiling with -DPROFILING=1 (see make('profile')).
+ *
+ * Each thread records into counters of its own (the learner thread of CriticPipeline and the workers of RolloutEngine
+ * profile as well), so recording needs no synchronization. The counters of a thread are registered with the instance
+ * on its first record and added to the totals of the exited threads when it exits. reset() and fillReturnStruct()
+ * cover all threads, and must be called only while no other thread is recording (between mex calls, or after the
+ * pipeline has been synced and the workers joined). Cycle totals are summed over the threads.
+ */
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+
+#ifndef PROFILING
+#define PROFILING 0
+#endif
+
+
+#include "matrix.h"
+
+#include <cstring>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <ctime>
+#endif
+
+
+
+
+class Profiler {
+  
+public:
+  
+  // profiled phases. remember to keep phaseName() in sync.
+  enum Phase { PP_COMPUTEACTIONS, PP_COMPUTEOBSERVATION, PP_ACT, PP_LEARN, PP_CRITICSTEP, PP_LOADBUFFER,
+               PP_COUNT };
+  
+  
+private:
+  
+  struct Counters {
+    unsigned long long calls[PP_COUNT];
+    unsigned long long cycles[PP_COUNT];
+    unsigned long long allocations;
+    unsigned long long allocatedBytes;
+    
+    Counters() { clear(); }
+    
+    void clear()
+    {
+      std::memset( this->calls, 0, sizeof(this->calls) );
+      std::memset( this->cycles, 0, sizeof(this->cycles) );
+      this->allocations = 0; this->allocatedBytes = 0;
+    }
+    
+    void add( const Counters & other )
+    {
+      for( int phase = 0 ; phase < PP_COUNT ; phase++ ) {
+        this->calls[phase] += other.calls[phase];
+        this->cycles[phase] += other.cycles[phase];
+      }
+      this->allocations += other.allocations; this->allocatedBytes += other.allocatedBytes;
+    }
+  };
+  
+  // the counters of a thread, registered with the instance for the lifetime of the thread
+  struct ThreadCounters {
+    Counters counters;
+    
+    ThreadCounters()
+    {
+      Profiler & profiler = instance();
+      std::lock_guard<std::mutex> lock( profiler.mutex );
+      profiler.threads.push_back( &this->counters );
+    }
+    
+    ~ThreadCounters()
+    {
+      Profiler & profiler = instance();
+      std::lock_guard<std::mutex> lock( profiler.mutex );
+      profiler.retired.add( this->counters );
+      profiler.threads.erase( std::find( profiler.threads.begin(), profiler.threads.end(), &this->counters ) );
+    }
+  };
+  
+  // the counters of the running threads, and the totals of the exited ones (guarded by mutex)
+  std::mutex mutex;
+  std::vector<Counters *> threads;
+  Counters retired;
+  
+  // the counters of the calling thread
+  static Counters & local() { thread_local ThreadCounters counters; return counters.counters; }
+  
+  // the totals over all threads
+  Counters totals()
+  {
+    std::lock_guard<std::mutex> lock( this->mutex );
+    Counters total = this->retired;
+    for( int i = 0 ; i < (int)this->threads.size() ; i++ ) total.add( *this->threads[i] );
+    return total;
+  }
+  
+  
+  static const char * phaseName( int phase )
+  {
+    static const char * const names[PP_COUNT] =
+      { "computeActions", "computeObservation", "act", "learn", "criticStep", "loadBuffer" };
+    return names[phase];
+  }
+  
+  
+public:
+  
+  // the process-global instance
+  static Profiler & instance() { static Profiler profiler; return profiler; }
+  
+  // read the time stamp counter (or a coarse clock on non-x86 platforms)
+  static unsigned long long ticks()
+  {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (unsigned long long)clock();
+#endif
+  }
+  
+  void reset()
+  {
+    std::lock_guard<std::mutex> lock( this->mutex );
+    this->retired.clear();
+    for( int i = 0 ; i < (int)this->threads.size() ; i++ ) this->threads[i]->clear();
+  }
+  
+  // record into the counters of the calling thread
+  void record( Phase phase, unsigned long long elapsed )
+  {
+    Counters & counters = local();
+    counters.calls[phase]++; counters.cycles[phase] += elapsed;
+  }
+  
+  void recordAllocation( unsigned long long bytes )
+  {
+    Counters & counters = local();
+    counters.allocations++; counters.allocatedBytes += bytes;
+  }
+  
+  // add the counters as fields of the provided struct: one struct with 'calls' and 'cycles' per phase, and an
+  // 'allocations' struct with 'count' and 'bytes'
+  void fillReturnStruct( mxArray * s )
+  {
+    Counters total = totals();
+    for( int phase = 0 ; phase < PP_COUNT ; phase++ ) {
+      mxArray * p = mxCreateStructMatrix( 1, 1, 0, 0 );
+      mxAddField( p, "calls" );
+      mxSetField( p, 0, "calls", mxCreateDoubleScalar( (double)total.calls[phase] ) );
+      mxAddField( p, "cycles" );
+      mxSetField( p, 0, "cycles", mxCreateDoubleScalar( (double)total.cycles[phase] ) );
+      mxAddField( s, phaseName( phase ) );
+      mxSetField( s, 0, phaseName( phase ), p );
+    }
+    
+    mxArray * a = mxCreateStructMatrix( 1, 1, 0, 0 );
+    mxAddField( a, "count" );
+    mxSetField( a, 0, "count", mxCreateDoubleScalar( (double)total.allocations ) );
+    mxAddField( a, "bytes" );
+    mxSetField( a, 0, "bytes", mxCreateDoubleScalar( (double)total.allocatedBytes ) );
+    mxAddField( s, "allocations" );
+    mxSetField( s, 0, "allocations", a );
+  }
+  
+};
+
+
+/* Records the time spent between construction and destruction. */
+class ProfileScope {
+  
+  Profiler::Phase phase;
+  unsigned long long start;
+  
+public:
+  
+  ProfileScope( Profiler::Phase phase ) : phase( phase ), start( Profiler::ticks() ) {}
+  ~ProfileScope() { Profiler::instance().record( this->phase, Profiler::ticks() - this->start ); }
+  
+};
+
+
+
+
+#if PROFILING
+#define PROFILE_RESET() Profiler::instance().reset()
+#define PROFILE_SCOPE(phase) ProfileScope profileScope_( Profiler::phase )
+#define PROFILE_ALLOCATION(bytes) Profiler::instance().recordAllocation( (unsigned long long)(bytes) )
+#else
+#define PROFILE_RESET() ((void)0)
+#define PROFILE_SCOPE(phase) ((void)0)
+#define PROFILE_ALLOCATION(bytes) ((void)0)
+#endif
+
+
+
+
+#endif
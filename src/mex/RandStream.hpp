@@ -0,0 +1,33 @@
+/* RandStream.hpp
+ *
+ * Interface of the random number streams used by the mex implementations: MatlabRandStream pulls numbers from a
+ * Matlab stream, and PhiloxRandStream generates counter-based streams natively.
+ */
+#ifndef RANDSTREAM_HPP
+#define RANDSTREAM_HPP
+
+
+#include "StateBuffer.hpp"
+
+
+
+
+class RandStream {
+  
+public:
+  
+  virtual ~RandStream() {}
+  
+  // return a single random number, uniformly distributed in [0, 1)
+  virtual double rand() = 0;
+  
+  // save and restore the stream position
+  virtual void saveState( StateWriter & w ) const = 0;
+  virtual void loadState( StateReader & r ) = 0;
+  
+};
+
+
+
+
+#endif
@@ -0,0 +1,59 @@
+function result = RolloutsMex( environment, agent, options, stopConds )
+%ROLLOUTSMEX Compute the targets of rollout-based policy iteration using a mex implementation
+%
+%   Sample options.states states from trajectories of the agent's policy
+%   (learning disabled), and estimate the value of each sampled state and
+%   of each action available in it by averaging options.rollouts truncated
+%   rollouts of options.rolloutLength steps that follow the policy, as
+%   needed by classification-based modified policy iteration (CBMPI). The
+%   rollouts are run in parallel threads. See 'rollouts' in MexTetrisNAC.cpp
+%   for the options and the fields of result; in short, result.V holds the
+%   regression targets of the value function and result.Q the action
+%   values, from which the classification targets of the policy follow
+%   (for example, the greedy actions [~, a] = max(result.Q, [], 2), as max
+%   ignores the NaNs of the unavailable actions). Fitting the value
+%   function and the classifier is left to the caller.
+%
+%   All random numbers come from counter-based streams, so the results do
+%   not depend on the number of threads. The streams are keyed by the
+%   environment's mexRngSeed and mexRngEpisode (see Environment), or by
+%   seed 0 from episode 0 if mexRngSeed is not set, in which case every
+%   call returns the same states. The episode counter is advanced by the
+%   number of sampling trajectories.
+%
+%   stopConds.maxSteps limits the length of the sampling trajectories. The
+%   environment and the agent are not otherwise modified.
+
+
+pairNames = { 'TetrisStandardFeatures-AgentNaturalActorCritic', 'TetrisNative-AgentNaturalActorCritic' };
+pairHandles = { @TetrisNAC.MexTetrisNAC, @TetrisNAC.MexTetrisNAC };
+
+
+
+
+% find handle
+pairName = [class(environment) '-' class(agent)];
+assert( any(strcmp( pairName, pairNames )), ['Unknown pair: ' pairName] );
+pairHandle = pairHandles{ strcmp( pairName, pairNames ) };
+
+
+% prepare
+[~, envData] = mexFork( environment, true );
+[~, agentData] = mexFork( agent, true );
+
+% call
+try
+  result = pairHandle( 'rollouts', envData, agentData, stopConds, options );
+catch err
+  if any(strcmp(err.identifier, {'MATLAB:UndefinedFunction','MATLAB:unassignedOutputs'}))
+    fprintf( '\n\nException ''%s'' caught during MEX execution. Did you remember to compile using ''make''?\n\n', ...
+      err.identifier );
+  end
+  rethrow(err);
+end
+
+% finalize
+environment.mexRngEpisode = environment.mexRngEpisode + result.episodes;
+
+
+end
@@ -6,14 +6,45 @@ function RunEpisodeMex( environment, agent, stopConds )
 %
 %   The episode ends when the environment enters a terminal state.
 %   Additional episode stopping conditions are not currently supported.
+%
+%   If stopConds contains the field 'chunkSteps', then the episode is run
+%   in chunks of at most that many steps, passing the episode state from
+%   one mex call to the next. The results are identical to an unchunked
+%   run. The environment is joined after each chunk, while the agent is
+%   joined only after the final chunk, as the mex implementation returns
+%   critic statistics that are cumulative over the whole episode.
+%
+%   If the agent requests a persistent mex session (by providing the field
+%   'mexSession' in its mexFork() data), then the session is created on
+%   first use and the episode is run within it. The agent then receives
+%   only the session handle; see AgentNaturalActorCritic.
+%
+%   The graph environments (GraphGeneric and its subclasses that do not
+%   override the dynamics) and GridEpisodicBasic are run by the generic
+%   native engine MexGenericNAC, which supports neither chunks nor
+%   sessions.
+%
+%   The episode counter of the environment's counter-based random streams
+%   (Environment.mexRngEpisode) is advanced by one.
 
 %   Information is passed from and to the agent and the environment in a
 %   customized manner using Environment.mexFork(), Agent.mexFork(),
 %   Environment.mexJoin() and Agent.mexJoin().
 
 
-pairNames = { 'TetrisStandardFeatures-AgentNaturalActorCritic' };
-pairHandles = { @TetrisNAC.MexTetrisNAC };
+pairNames = { 'TetrisStandardFeatures-AgentNaturalActorCritic', ...
+              'TetrisNative-AgentNaturalActorCritic', ...
+              'GraphGeneric-AgentNaturalActorCritic', ...
+              'GraphRotorblade-AgentNaturalActorCritic', ...
+              'GraphSynthetic-AgentNaturalActorCritic', ...
+              'GraphDoubleFork-AgentNaturalActorCritic', ...
+              'GraphDoubleForkSym-AgentNaturalActorCritic', ...
+              'GraphTDCross-AgentNaturalActorCritic', ...
+              'GridEpisodicBasic-AgentNaturalActorCritic' };
+pairHandles = { @TetrisNAC.MexTetrisNAC, @TetrisNAC.MexTetrisNAC, ...
+                @TetrisNAC.MexGenericNAC, @TetrisNAC.MexGenericNAC, @TetrisNAC.MexGenericNAC, ...
+                @TetrisNAC.MexGenericNAC, @TetrisNAC.MexGenericNAC, @TetrisNAC.MexGenericNAC, ...
+                @TetrisNAC.MexGenericNAC };
 
 
 
@@ -30,7 +61,28 @@ pairHandle = pairHandles{ strcmp( pairName, pairNames ) };
 
 % call
 try
-  [envDataOut, agentDataOut] = pairHandle( envData, agentData, stopConds );
+  if isfield( agentData, 'mexSession' )
+    if isempty(agentData.mexSession)
+      agentData.mexSession = pairHandle( 'create', envData, agentData );
+    end
+    episodeState = [];
+    while true
+      [envDataOut, episodeState] = pairHandle( 'run', agentData.mexSession, envData, agentData, stopConds, ...
+                                               episodeState );
+      if isempty(episodeState); break; end
+      environment.mexJoin( envDataOut );
+    end
+    agentDataOut = struct( 'mexSession', agentData.mexSession, 'mexSessionFunction', pairHandle );
+  elseif ~isfield( stopConds, 'chunkSteps' )
+    [envDataOut, agentDataOut] = pairHandle( envData, agentData, stopConds );
+  else
+    episodeState = [];
+    while true
+      [envDataOut, agentDataOut, episodeState] = pairHandle( envData, agentData, stopConds, episodeState );
+      if isempty(episodeState); break; end
+      environment.mexJoin( envDataOut );
+    end
+  end
 catch err
   if any(strcmp(err.identifier, {'MATLAB:UndefinedFunction','MATLAB:unassignedOutputs'}))
     fprintf( '\n\nException ''%s'' caught during MEX execution. Did you remember to compile using ''make''?\n\n', ...
@@ -42,6 +94,7 @@ end
 % finalize
 environment.mexJoin( envDataOut );
 agent.mexJoin( agentDataOut );
+environment.mexRngEpisode = environment.mexRngEpisode + 1;
 
 
 end
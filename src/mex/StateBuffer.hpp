@@ -0,0 +1,77 @@
+/* StateBuffer.hpp
+ *
+ * Minimal binary serialization helpers for exporting and importing the internal state of the mex objects as an
+ * opaque blob (a uint8 array on the Matlab side). The format is the raw in-memory representation and is therefore
+ * valid only for the same build of the mex file on the same platform.
+ */
+#ifndef STATEBUFFER_HPP
+#define STATEBUFFER_HPP
+
+
+#include "mex.h"
+#include "matrix.h"
+
+#include <vector>
+#include <cstring>
+
+
+
+
+class StateWriter {
+  
+  std::vector<char> data;
+  
+public:
+  
+  void write( const void * src, size_t size )
+  {
+    const char * p = (const char *)src;
+    this->data.insert( this->data.end(), p, p + size );
+  }
+  
+  // write a single plain-old-data value or array
+  template<class T> void write( const T & value ) { write( &value, sizeof(value) ); }
+  
+  // create a uint8 column array containing the written data
+  mxArray * createArray() const
+  {
+    mxArray * a = mxCreateNumericMatrix( this->data.size(), 1, mxUINT8_CLASS, mxREAL );
+    if( !this->data.empty() ) std::memcpy( mxGetData(a), &this->data[0], this->data.size() );
+    return a;
+  }
+  
+};
+
+
+class StateReader {
+  
+  const char * p;
+  const char * end;
+  
+public:
+  
+  StateReader( const mxArray * a ) :
+    p( (const char *)mxGetData(a) ),
+    end( (const char *)mxGetData(a) + mxGetNumberOfElements(a) * mxGetElementSize(a) )
+  {}
+  
+  void read( void * dst, size_t size )
+  {
+    if( this->p + size > this->end )
+      mexErrMsgIdAndTxt( "StateReader:truncated", "StateReader: the state blob is truncated or corrupt!" );
+    std::memcpy( dst, this->p, size );
+    this->p += size;
+  }
+  
+  // read a single plain-old-data value or array
+  template<class T> void read( T & value ) { read( &value, sizeof(value) ); }
+  
+  // whether all data has been read
+  bool atEnd() const { return this->p == this->end; }
+  
+};
+
+
+
+
+#endif
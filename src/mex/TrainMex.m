@@ -0,0 +1,71 @@
+function trainingLog = TrainMex( environment, agent, iterations, episodes, stopConds )
+%TRAINMEX Run policy improvement iterations using a mex implementation
+%
+%   Run iterations policy improvement iterations, each consisting of
+%   episodes evaluation episodes followed by an actor iteration, entirely
+%   within the mex implementation of an environment and an agent. This is
+%   equivalent to running ImprovePolicy with a mex-enabled EvaluatePolicy
+%   and an agent that solves its critic natively (the 'mexSolve' option of
+%   AgentNaturalActorCritic), but without returning to Matlab between
+%   episodes.
+%
+%   The returned log has the fields
+%     theta         policy parameters after each iteration (one column per
+%                   iteration)
+%     returns       episode returns (one column per iteration)
+%     gradientNorm  norm of the natural gradient estimate per iteration
+%     cond          condition number of the critic per iteration
+%     w             the last critic solution
+%     actorIteration  actor iteration counter after the last iteration
+%
+%   Afterwards, the agent is in the same state as after the corresponding
+%   iterateActor() calls, and the environment has been joined with the data
+%   of the last episode, and its random stream episode counter
+%   (Environment.mexRngEpisode) has been advanced by iterations * episodes.
+%   Chunked episodes are not supported.
+
+%   The training options are taken from the agent using
+%   AgentNaturalActorCritic.getMexTrainingOptions().
+
+
+pairNames = { 'TetrisStandardFeatures-AgentNaturalActorCritic', 'TetrisNative-AgentNaturalActorCritic' };
+pairHandles = { @TetrisNAC.MexTetrisNAC, @TetrisNAC.MexTetrisNAC };
+
+
+
+
+% find handle
+pairName = [class(environment) '-' class(agent)];
+assert( any(strcmp( pairName, pairNames )), ['Unknown pair: ' pairName] );
+pairHandle = pairHandles{ strcmp( pairName, pairNames ) };
+assert( ~isfield( stopConds, 'chunkSteps' ), 'Chunked episodes are not supported in native training.' );
+
+
+% prepare
+[~, envData] = mexFork( environment, true );
+[~, agentData] = mexFork( agent, true );
+assert( agentData.learning, 'Native training requires a learning agent.' );
+options = getMexTrainingOptions( agent, iterations, episodes );
+
+% call
+try
+  if isempty(agentData.mexSession)
+    agentData.mexSession = pairHandle( 'create', envData, agentData );
+  end
+  [trainingLog, envDataOut] = pairHandle( 'train', agentData.mexSession, envData, agentData, stopConds, options );
+catch err
+  if any(strcmp(err.identifier, {'MATLAB:UndefinedFunction','MATLAB:unassignedOutputs'}))
+    fprintf( '\n\nException ''%s'' caught during MEX execution. Did you remember to compile using ''make''?\n\n', ...
+      err.identifier );
+  end
+  rethrow(err);
+end
+
+% finalize
+environment.mexJoin( envDataOut );
+agent.mexJoin( struct( 'mexSession', agentData.mexSession, 'mexSessionFunction', pairHandle ) );
+agent.mexTrainingJoin( trainingLog );
+environment.mexRngEpisode = environment.mexRngEpisode + iterations * episodes;
+
+
+end
@@ -29,6 +29,13 @@ classdef ImprovePolicy < Iterative & Configurable & handle
     % policy evaluation process object
     evaluation;
     
+    % Whether to run each iteration (the evaluation episodes and the actor
+    % iteration) natively using TrainMex. Requires a mex-enabled evaluation
+    % and an agent that solves its critic natively. The evaluation process
+    % is then not stepped, so per-episode logging is not available.
+    % type: logical
+    useMexTraining = false;
+    
   end
   
   properties (Constant, Hidden, Access=private)
@@ -81,6 +88,14 @@ classdef ImprovePolicy < Iterative & Configurable & handle
     function output = stepHook( this )
       % Run a single training iteration
       
+      % run evaluation and policy improvement natively
+      if this.useMexTraining && this.agent.learning && this.evaluation.useMex
+        trainingLog = TrainMex( this.environment, this.agent, 1, this.evaluation.iterations, ...
+                                this.evaluation.episodeStoppingConditions );
+        output = num2cell( trainingLog.returns' );
+        return;
+      end
+      
       % run evaluation
       output = this.evaluation.run();
       
@@ -0,0 +1,37 @@
+function s = readEpisodeStatistics( filename )
+%READEPISODESTATISTICS Read a file of per-episode critic statistics.
+%
+%     s = readEpisodeStatistics( filename )
+%
+%   Read the records appended by the mex implementation (see the
+%   'mexEpisodeStatisticsFile' option of AgentNaturalActorCritic and
+%   mex/+TetrisNAC/EpisodeStatistics.hpp) into a struct of the same form
+%   as AgentNaturalActorCritic.getEpisodeStatistics() returns: episode,
+%   return, steps (n x 1), A (dim x dim x n), b (dim x n) and, for
+%   LSPELambda, B (dim x dim x n). A partially written last record is
+%   ignored, so the file can be read while it grows.
+
+fid = fopen( filename, 'r' );
+if fid < 0; error( 'Cannot open ''%s''!', filename ); end
+header = fread( fid, 4, 'double' );
+if numel(header) ~= 4 || header(4) ~= 1
+  fclose( fid );
+  error( '''%s'' is not an episode statistics file!', filename );
+end
+
+% the number of complete records
+fseek( fid, 0, 'eof' );
+n = floor( (ftell( fid ) - 32) / (8 * header(1)) );
+fseek( fid, 32, 'bof' );
+records = reshape( fread( fid, [header(1), n], 'double' ), header(1), n );
+fclose( fid );
+dim = header(2);
+
+s.episode = records(1,:)';
+s.return = records(2,:)';
+s.steps = records(3,:)';
+s.A = reshape( records(3+(1:dim*dim),:), [dim, dim, n] );
+s.b = records(3+dim*dim+(1:dim),:);
+if header(3); s.B = reshape( records(3+dim*dim+dim+(1:dim*dim),:), [dim, dim, n] ); end
+  
+end
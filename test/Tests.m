@@ -62,6 +62,17 @@ classdef Tests < PersistentSingleton
       struct( 'classname', 'TestGridNac', 'referenceRevision', 20171005, 'active', true ), ...
       struct( 'classname', 'TestGraphSynthetic', 'referenceRevision', 20171005, 'active', true ), ...
       struct( 'classname', 'TestFeaturizerSynthetic', 'referenceRevision', 20171005, 'active', true ), ...
+      struct( 'classname', 'TestMexLspeForget', 'referenceRevision', 20261018, 'active', true ), ...
+      struct( 'classname', 'TestMexLstdCorrected', 'referenceRevision', 20261018, 'active', true ), ...
+      struct( 'classname', 'TestMexChunkedEpisode', 'referenceRevision', 20261018, 'active', true ), ...
+      struct( 'classname', 'TestMexSession', 'referenceRevision', 20261018, 'active', true ), ...
+      struct( 'classname', 'TestMexCompareEngines', 'referenceRevision', 20261018, 'active', true ), ...
+      struct( 'classname', 'TestMexSolverMethods', 'referenceRevision', 20261018, 'active', true ), ...
+      struct( 'classname', 'TestMexKeyedStreams', 'referenceRevision', 20261018, 'active', true ), ...
+      struct( 'classname', 'TestMexGenericCritics', 'referenceRevision', 20261018, 'active', true ), ...
+      struct( 'classname', 'TestMexSweepCritics', 'referenceRevision', 20261018, 'active', true ), ...
+      struct( 'classname', 'TestMexFarm', 'referenceRevision', 20261018, 'active', true ), ...
+      struct( 'classname', 'TestMexGradientTD', 'referenceRevision', 20261018, 'active', true ), ...
       ];
     
   end
@@ -0,0 +1,100 @@
+classdef TestMexChunkedEpisode < Test
+  %TESTMEXCHUNKEDEPISODE Test the chunked episodes of the mex NAC
+  %
+  %   Runs the same keyed Tetris episodes once with a single plain mex call
+  %   and once in chunks of params.chunkSteps steps, passing the episode
+  %   state from each call to the next, with the LSTD and LSPE critics. The
+  %   returns and the critic statistics of the chunked episodes must be
+  %   identical to those of the unchunked ones.
+  %
+  %   The result is the largest difference relative to the magnitude of
+  %   the statistics, and the test fails if it exceeds params.tolerance on
+  %   any revision.
+  
+  
+  properties
+    
+    % parameters
+    params = struct( ...
+      'episodes', 3, ...
+      'chunkSteps', 7, ...
+      'gamma', 0.9, ...
+      'lambda', 0.5, ...
+      'seed', 1, ...
+      'tolerance', 0 );
+    
+  end
+  
+  methods
+    
+    function result = run( this )
+      
+      p = this.params;
+      theta = [zeros(10,1); -ones(9,1); 0; -3; 0; 1];
+      stopConds = struct( 'maxSteps', Inf, 'totalRewardRange', [-Inf Inf] );
+      chunkedStopConds = stopConds;
+      chunkedStopConds.chunkSteps = p.chunkSteps;
+      
+      result = 0;
+      for criticClass=[0 1]
+        for ep=1:p.episodes
+          
+          % the reference: a single call
+          [envOut, agentOut] = TetrisNAC.MexTetrisNAC( ...
+            this.environmentData( ep ), this.agentData( criticClass, theta ), stopConds );
+          
+          % the candidate: chunks, until the episode state is empty
+          [chunkedEnvOut, chunkedAgentOut, episodeState] = TetrisNAC.MexTetrisNAC( ...
+            this.environmentData( ep ), this.agentData( criticClass, theta ), chunkedStopConds, [] );
+          chunks = 1;
+          while ~isempty( episodeState )
+            [chunkedEnvOut, chunkedAgentOut, episodeState] = TetrisNAC.MexTetrisNAC( ...
+              this.environmentData( ep ), this.agentData( criticClass, theta ), chunkedStopConds, episodeState );
+            chunks = chunks + 1;
+          end
+          assert( chunks > 1, 'The episode should have been chunked.' );
+          
+          % the largest relative difference
+          result = max( result, abs( chunkedEnvOut.return - envOut.return ) );
+          for field=fieldnames( agentOut.critic )'
+            ref = agentOut.critic.(field{1}); res = chunkedAgentOut.critic.(field{1});
+            result = max( result, max(abs( res(:) - ref(:) )) / max( max(abs( ref(:) )), 1 ) );
+          end
+          
+        end
+      end
+      fprintf( 'TestMexChunkedEpisode: relative difference = %g\n', result );
+      
+    end
+    
+    function error = compareResults( this, lhs, rhs )
+      % Zero if both results are within the tolerance, Inf otherwise.
+      
+      if lhs <= this.params.tolerance && rhs <= this.params.tolerance
+        error = 0;
+      else
+        error = Inf;
+      end
+      
+    end
+    
+    function data = environmentData( this, episode )
+      % The keyed environment data of the given episode.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'rngSeed', this.params.seed, 'rngEpisode', episode );
+      
+    end
+    
+    function data = agentData( this, criticClass, theta )
+      % The agent data of a learning agent with the given critic class.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'criticClass', criticClass, 'learning', true, 'theta', theta, ...
+        'gamma', this.params.gamma, 'lambda', this.params.lambda, 'tau', 1 );
+      
+    end
+    
+  end
+  
+end
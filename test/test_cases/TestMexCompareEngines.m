@@ -0,0 +1,69 @@
+classdef TestMexCompareEngines < Test
+  %TESTMEXCOMPAREENGINES Test the optimized mex engines against the reference engine
+  %
+  %   Runs the 'compare' command of the mex NAC for each optimized engine
+  %   ('actionCache', 'pipeline' and 'batch') with the LSTD and LSPE
+  %   critics. The action cache is small, so that entries are also evicted
+  %   and refilled. Every comparison must report zero mismatches with a
+  %   zero tolerance, that is, bit-for-bit identical episodes.
+  %
+  %   The result is the total number of mismatches, and the test fails if
+  %   it is nonzero on any revision.
+  
+  
+  properties
+    
+    % parameters
+    params = struct( ...
+      'engines', {{ 'actionCache', 'pipeline', 'batch' }}, ...
+      'episodes', 5, ...
+      'actionCacheSize', 64, ...
+      'gamma', 0.9, ...
+      'lambda', 0.5, ...
+      'seed', 1 );
+    
+  end
+  
+  methods
+    
+    function result = run( this )
+      
+      p = this.params;
+      theta = [zeros(10,1); -ones(9,1); 0; -3; 0; 1];
+      stopConds = struct( 'maxSteps', Inf, 'totalRewardRange', [-Inf Inf] );
+      environmentData = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', p.seed ), ...
+        'rngSeed', p.seed, 'rngEpisode', 0, 'actionCacheSize', p.actionCacheSize );
+      
+      result = 0;
+      for criticClass=[0 1]
+        agentData = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', p.seed ), ...
+          'criticClass', criticClass, 'learning', true, 'theta', theta, ...
+          'gamma', p.gamma, 'lambda', p.lambda, 'tau', 1 );
+        for engine=p.engines
+          report = TetrisNAC.MexTetrisNAC( 'compare', environmentData, agentData, stopConds, p.episodes, engine{1}, 0 );
+          mismatches = report.pieceMismatches + report.actionMismatches + report.stepDataMismatches + ...
+            report.criticMismatches;
+          if mismatches > 0
+            fprintf( 'TestMexCompareEngines: %s, critic class %d: %s\n', engine{1}, criticClass, report.firstMismatch );
+          end
+          result = result + mismatches;
+        end
+      end
+      fprintf( 'TestMexCompareEngines: mismatches = %d\n', result );
+      
+    end
+    
+    function error = compareResults( this, lhs, rhs )
+      % Zero if neither result has mismatches, Inf otherwise.
+      
+      if lhs == 0 && rhs == 0
+        error = 0;
+      else
+        error = Inf;
+      end
+      
+    end
+    
+  end
+  
+end
@@ -0,0 +1,105 @@
+classdef TestMexFarm < Test
+  %TESTMEXFARM Test the shared-memory farms of the mex NAC
+  %
+  %   Runs keyed Tetris episodes once through plain mex calls, whose
+  %   statistics are added to an LSTDLambda critic, and once as the jobs of
+  %   a farm, which are all run in this process with 'farmWork' and read
+  %   with 'farmQuery'. The batch is submitted twice, to cover the reuse of
+  %   the farm. All jobs must be completed without failures, and the
+  %   returns of the jobs and the merged statistics A and b must match.
+  %
+  %   The result is the largest difference relative to the magnitude of
+  %   the statistics, and the test fails if it exceeds params.tolerance on
+  %   any revision.
+  
+  
+  properties
+    
+    % parameters
+    params = struct( ...
+      'farm', 'TestMexFarm', ...
+      'jobs', 4, ...
+      'gamma', 0.9, ...
+      'lambda', 0.5, ...
+      'seed', 1, ...
+      'tolerance', 1e-12 );
+    
+  end
+  
+  methods
+    
+    function result = run( this )
+      
+      p = this.params;
+      theta = [zeros(10,1); -ones(9,1); 0; -3; 0; 1];
+      stopConds = struct( 'maxSteps', Inf, 'totalRewardRange', [-Inf Inf] );
+      
+      % the reference: plain mex calls joined into LSTDLambda.m
+      critic = LSTDLambda( p.gamma, p.lambda );
+      critic.dim = 22 + 23;
+      critic = reset( critic );
+      returns = zeros( p.jobs, 1 );
+      for job=1:p.jobs
+        [envOut, agentDataOut] = TetrisNAC.MexTetrisNAC( ...
+          this.environmentData( job - 1 ), this.agentData( theta ), stopConds );
+        critic = addData( critic, agentDataOut.critic );
+        returns(job) = envOut.return;
+      end
+      
+      % the candidate: the same episodes as the jobs of a farm, submitted twice
+      TetrisNAC.MexTetrisNAC( 'farmCreate', p.farm, p.jobs );
+      result = 0;
+      for batch=1:2
+        TetrisNAC.MexTetrisNAC( 'farmSubmit', p.farm, this.environmentData( 0 ), this.agentData( theta ), p.jobs );
+        jobsRun = TetrisNAC.MexTetrisNAC( 'farmWork', p.farm, this.environmentData( 0 ), ...
+          this.agentData( zeros( size( theta ) ) ), stopConds );
+        status = TetrisNAC.MexTetrisNAC( 'farmQuery', p.farm );
+        if jobsRun ~= p.jobs || status.completed ~= p.jobs || status.failed ~= 0
+          fprintf( 'TestMexFarm: batch %d: ran %d jobs, %d completed, %d failed\n', ...
+            batch, jobsRun, status.completed, status.failed );
+          result = Inf;
+        end
+        
+        % the largest relative difference
+        result = max( result, max(abs( status.returns - returns )) );
+        for field={'A', 'b'}
+          ref = critic.(field{1}); res = status.critic.(field{1});
+          result = max( result, max(abs( res(:) - ref(:) )) / max(abs( ref(:) )) );
+        end
+      end
+      TetrisNAC.MexTetrisNAC( 'farmDestroy', p.farm );
+      fprintf( 'TestMexFarm: relative difference = %g\n', result );
+      
+    end
+    
+    function error = compareResults( this, lhs, rhs )
+      % Zero if both results are within the tolerance, Inf otherwise.
+      
+      if lhs <= this.params.tolerance && rhs <= this.params.tolerance
+        error = 0;
+      else
+        error = Inf;
+      end
+      
+    end
+    
+    function data = environmentData( this, episode )
+      % The keyed environment data of the given episode.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'rngSeed', this.params.seed, 'rngEpisode', episode );
+      
+    end
+    
+    function data = agentData( this, theta )
+      % The agent data of a learning LSTD agent.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'criticClass', 0, 'learning', true, 'theta', theta, ...
+        'gamma', this.params.gamma, 'lambda', this.params.lambda, 'tau', 1 );
+      
+    end
+    
+  end
+  
+end
@@ -0,0 +1,72 @@
+classdef TestMexGenericCritics < Test
+  %TESTMEXGENERICCRITICS Test the critic classes of the generic mex NAC
+  %
+  %   Runs a keyed episode of a synthetic graph environment in MexGenericNAC
+  %   with each critic class. The LSPE critic relies on the Tetris features
+  %   and must be rejected with GenericActorCritic:invalidCriticClass; the
+  %   other critics must run and return finite statistics.
+  %
+  %   The result is the number of critics that behave otherwise, and the
+  %   test fails if it is nonzero on any revision.
+  
+  
+  properties
+    
+    % parameters
+    params = struct( ...
+      'criticClasses', [0 1 2 3 4 5], ...
+      'gamma', 0.9, ...
+      'lambda', 0.5, ...
+      'seed', 1 );
+    
+  end
+  
+  methods
+    
+    function result = run( this )
+      
+      p = this.params;
+      environment = GraphSynthetic( 'synthSeed', p.seed, 'sCount', 9, 'aCount', 3, 'dimsMdp', 2, 'dimsPomdp', 2 );
+      environment.construct();
+      [~, environmentData] = mexFork( environment, true );
+      environmentData.rstream = RandStream( 'mt19937ar', 'Seed', p.seed );
+      environmentData.rngSeed = p.seed;
+      environmentData.rngEpisode = 0;
+      actionDim = size( environmentData.Q, 2 ) * size( environmentData.O, 2 );
+      stopConds = struct( 'maxSteps', 1000, 'totalRewardRange', [-Inf Inf] );
+      
+      result = 0;
+      for criticClass=p.criticClasses
+        agentData = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', p.seed ), ...
+          'criticClass', criticClass, 'learning', true, 'theta', zeros( actionDim, 1 ), ...
+          'gamma', p.gamma, 'lambda', p.lambda, 'tau', 1 );
+        try
+          [~, agentDataOut] = TetrisNAC.MexGenericNAC( environmentData, agentData, stopConds );
+          statistics = struct2cell( agentDataOut.critic );
+          ok = criticClass ~= 1 && all(cellfun( @(x) all(isfinite( double( x(:) ) )), statistics ));
+        catch err
+          ok = criticClass == 1 && strcmp( err.identifier, 'GenericActorCritic:invalidCriticClass' );
+        end
+        if ~ok
+          fprintf( 'TestMexGenericCritics: critic class %d failed\n', criticClass );
+          result = result + 1;
+        end
+      end
+      fprintf( 'TestMexGenericCritics: failed critics = %d\n', result );
+      
+    end
+    
+    function error = compareResults( this, lhs, rhs )
+      % Zero if neither result has failed critics, Inf otherwise.
+      
+      if lhs == 0 && rhs == 0
+        error = 0;
+      else
+        error = Inf;
+      end
+      
+    end
+    
+  end
+  
+end
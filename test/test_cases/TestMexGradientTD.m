@@ -0,0 +1,101 @@
+classdef TestMexGradientTD < Test
+  %TESTMEXGRADIENTTD Test the native gradient-TD critics against GradientTDLambda.m
+  %
+  %   Runs the same episodes of a synthetic graph environment with a
+  %   GTD2(lambda) and a TDC(lambda) critic, once with the Matlab
+  %   implementation, whose critic updates are those of GradientTDLambda.m,
+  %   and once with RunEpisodeMex, which runs them in MexGenericNAC and
+  %   carries w and h over from one episode to the next. The graph
+  %   episodes are identical in both implementations, so the critic
+  %   parameters w must match after the episodes. As the updates of w
+  %   depend on h, this also covers the auxiliary weights.
+  %
+  %   The result is the largest difference relative to the magnitude of
+  %   the parameters, and the test fails if it exceeds params.tolerance on
+  %   any revision.
+  
+  
+  properties
+    
+    % parameters
+    params = struct( ...
+      'variants', {{ 'GTD2', 'TDC' }}, ...
+      'episodes', 5, ...
+      'alpha', 0.05, ...
+      'alphaH', 0.1, ...
+      'gamma', 0.9, ...
+      'lambda', 0.5, ...
+      'seed', 1, ...
+      'tolerance', 1e-10 );
+    
+  end
+  
+  methods
+    
+    function result = run( this )
+      
+      p = this.params;
+      stopConds = struct( 'maxSteps', 1000, 'totalRewardRange', [-Inf Inf] );
+      
+      result = 0;
+      for variant=p.variants
+        w = cell( 1, 2 );
+        for useMex=[false true]
+          environment = GraphSynthetic( 'synthSeed', p.seed, 'sCount', 9, 'aCount', 3, 'dimsMdp', 2, 'dimsPomdp', 2 );
+          environment.construct();
+          environment.init( p.seed );
+          agent = AgentNaturalActorCritic( GradientTDLambda( p.gamma, p.lambda, 'variant', variant{1}, ...
+            'alpha', p.alpha, 'alphaH', p.alphaH ) );
+          agent.init( p.seed, environment.getProps() );
+          agent.learning = true;
+          for ep=1:p.episodes
+            if useMex
+              RunEpisodeMex( environment, agent, stopConds );
+            else
+              this.runEpisode( environment, agent, stopConds );
+            end
+          end
+          w{useMex+1} = [agent.getV(); agent.getQ()];
+        end
+        
+        % the largest relative difference
+        difference = max(abs( w{2} - w{1} )) / max(abs( w{1} ));
+        fprintf( 'TestMexGradientTD: %s: relative difference = %g\n', variant{1}, difference );
+        result = max( result, difference );
+      end
+      
+    end
+    
+    function error = compareResults( this, lhs, rhs )
+      % Zero if both results are within the tolerance, Inf otherwise.
+      
+      if lhs <= this.params.tolerance && rhs <= this.params.tolerance
+        error = 0;
+      else
+        error = Inf;
+      end
+      
+    end
+    
+    function runEpisode( this, environment, agent, stopConds ) %#ok<INUSL>
+      % Run an episode with the Matlab implementations (see EvaluatePolicy).
+      
+      environment.mexFork( false ); agent.mexFork( false );
+      [~, observation, actions] = environment.newEpisode();
+      agent.newEpisode();
+      reward = 0; totalReward = 0; stepCounter = 0;
+      while ~isempty(observation) && ...
+          totalReward >= stopConds.totalRewardRange(1) && totalReward <= stopConds.totalRewardRange(2) && ...
+          stepCounter < stopConds.maxSteps
+        [~, action] = agent.step( reward, observation, actions );
+        [~, reward, observation, actions] = environment.step( action );
+        totalReward = totalReward + reward; stepCounter = stepCounter + 1;
+      end
+      agent.step( reward, [], [] );
+      environment.mexJoin( [] ); agent.mexJoin( [] );
+      
+    end
+    
+  end
+  
+end
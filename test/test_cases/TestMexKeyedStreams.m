@@ -0,0 +1,101 @@
+classdef TestMexKeyedStreams < Test
+  %TESTMEXKEYEDSTREAMS Test the counter-based random streams of the mex NAC
+  %
+  %   Runs keyed Tetris episodes in several ways that must draw the same
+  %   numbers: 'evaluate' with different numbers of lanes, 'evaluate' from a
+  %   later first episode, plain calls of single episodes, a repeated call,
+  %   and 'rollouts' with different numbers of worker threads. The results
+  %   must be identical in each case.
+  %
+  %   The result is the number of comparisons that differ, and the test
+  %   fails if it is nonzero on any revision.
+  
+  
+  properties
+    
+    % parameters
+    params = struct( ...
+      'episodes', 24, ...
+      'lanes', [1 4 16], ...
+      'offset', 5, ...
+      'plainEpisodes', 3, ...
+      'threads', [1 4], ...
+      'rolloutOptions', struct( 'states', 6, 'rolloutLength', 10, 'rollouts', 3, 'gamma', 0.9 ), ...
+      'seed', 1 );
+    
+  end
+  
+  methods
+    
+    function result = run( this )
+      
+      p = this.params;
+      theta = [zeros(10,1); -ones(9,1); 0; -3; 0; 1];
+      stopConds = struct( 'maxSteps', Inf, 'totalRewardRange', [-Inf Inf] );
+      result = 0;
+      
+      % 'evaluate': independent of the number of lanes and reproducible
+      returns = TetrisNAC.MexTetrisNAC( 'evaluate', this.environmentData( 0 ), this.agentData( theta ), stopConds, ...
+        p.episodes, p.lanes(1) );
+      for lanes=p.lanes
+        res = TetrisNAC.MexTetrisNAC( 'evaluate', this.environmentData( 0 ), this.agentData( theta ), stopConds, ...
+          p.episodes, lanes );
+        result = result + ~isequal( res, returns );
+      end
+      
+      % 'evaluate' from a later episode: the tail of the same episodes
+      res = TetrisNAC.MexTetrisNAC( 'evaluate', this.environmentData( p.offset ), this.agentData( theta ), ...
+        stopConds, p.episodes - p.offset, p.lanes(end) );
+      result = result + ~isequal( res, returns(p.offset+1:end) );
+      
+      % plain calls of single episodes
+      for ep=1:p.plainEpisodes
+        envOut = TetrisNAC.MexTetrisNAC( this.environmentData( ep - 1 ), this.agentData( theta ), stopConds );
+        result = result + ~isequal( envOut.return, returns(ep) );
+      end
+      
+      % 'rollouts': independent of the number of threads
+      options = p.rolloutOptions;
+      options.threads = p.threads(1);
+      rollouts = TetrisNAC.MexTetrisNAC( 'rollouts', this.environmentData( 0 ), this.agentData( theta ), ...
+        stopConds, options );
+      for threads=p.threads(2:end)
+        options.threads = threads;
+        res = TetrisNAC.MexTetrisNAC( 'rollouts', this.environmentData( 0 ), this.agentData( theta ), ...
+          stopConds, options );
+        result = result + ~isequaln( res, rollouts );
+      end
+      fprintf( 'TestMexKeyedStreams: differing comparisons = %d\n', result );
+      
+    end
+    
+    function error = compareResults( this, lhs, rhs )
+      % Zero if neither result has differing comparisons, Inf otherwise.
+      
+      if lhs == 0 && rhs == 0
+        error = 0;
+      else
+        error = Inf;
+      end
+      
+    end
+    
+    function data = environmentData( this, episode )
+      % The keyed environment data from the given episode.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'rngSeed', this.params.seed, 'rngEpisode', episode );
+      
+    end
+    
+    function data = agentData( this, theta )
+      % The agent data of an evaluating agent.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'criticClass', 0, 'learning', false, 'theta', theta, 'gamma', 1, 'lambda', 0, 'tau', 1 );
+      
+    end
+    
+  end
+  
+end
@@ -0,0 +1,97 @@
+classdef TestMexLspeForget < Test
+  %TESTMEXLSPEFORGET Test the forgetting of the mex LSPE statistics
+  %
+  %   Runs the same keyed Tetris episodes once through plain mex calls,
+  %   whose statistics are added to an LSPELambda critic that forgets in
+  %   Matlab, and once through a mex session that forgets natively with
+  %   the 'forget' command, over several iterations. The statistics B, A
+  %   and b of the session must match those of LSPELambda.m (with I = 0,
+  %   so that the forgetting of B is a plain scaling).
+  %
+  %   The result is the largest difference relative to the magnitude of
+  %   the statistics, and the test fails if it exceeds params.tolerance on
+  %   any revision.
+  
+  
+  properties
+    
+    % parameters
+    params = struct( ...
+      'iterations', 4, ...
+      'beta', 0.5, ...
+      'gamma', 0.9, ...
+      'lambda', 0.5, ...
+      'seed', 1, ...
+      'tolerance', 1e-12 );
+    
+  end
+  
+  methods
+    
+    function result = run( this )
+      
+      p = this.params;
+      theta = [zeros(10,1); -ones(9,1); 0; -3; 0; 1];
+      stopConds = struct( 'maxSteps', Inf, 'totalRewardRange', [-Inf Inf] );
+      
+      % the reference: plain mex calls joined into LSPELambda.m
+      critic = LSPELambda( p.gamma, p.lambda, 'I', 0, 'beta', p.beta );
+      critic.dim = 22 + 23;
+      critic = reset( critic );
+      for it=1:p.iterations
+        if it > 1; critic = forget( critic ); end
+        [~, agentDataOut] = TetrisNAC.MexTetrisNAC( ...
+          this.environmentData( it ), this.agentData( theta ), stopConds );
+        critic = addData( critic, agentDataOut.critic );
+      end
+      
+      % the candidate: a mex session that forgets natively
+      session = TetrisNAC.MexTetrisNAC( 'create', this.environmentData( 0 ), this.agentData( theta ) );
+      for it=1:p.iterations
+        if it > 1; TetrisNAC.MexTetrisNAC( 'forget', session, p.beta ); end
+        TetrisNAC.MexTetrisNAC( 'run', session, this.environmentData( it ), this.agentData( theta ), stopConds );
+      end
+      agentDataOut = TetrisNAC.MexTetrisNAC( 'query', session );
+      TetrisNAC.MexTetrisNAC( 'destroy', session );
+      
+      % the largest relative difference
+      result = 0;
+      for field={'B', 'A', 'b'}
+        ref = critic.(field{1}); res = agentDataOut.critic.(field{1});
+        result = max( result, max(abs( res(:) - ref(:) )) / max(abs( ref(:) )) );
+      end
+      fprintf( 'TestMexLspeForget: relative difference = %g\n', result );
+      
+    end
+    
+    function error = compareResults( this, lhs, rhs )
+      % Zero if both results are within the tolerance, Inf otherwise.
+      
+      if lhs <= this.params.tolerance && rhs <= this.params.tolerance
+        error = 0;
+      else
+        error = Inf;
+      end
+      
+    end
+    
+    function data = environmentData( this, episode )
+      % The keyed environment data of the given episode.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'rngSeed', this.params.seed, 'rngEpisode', episode );
+      
+    end
+    
+    function data = agentData( this, theta )
+      % The agent data of a learning LSPE agent.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'criticClass', 1, 'learning', true, 'theta', theta, ...
+        'gamma', this.params.gamma, 'lambda', this.params.lambda, 'tau', 1 );
+      
+    end
+    
+  end
+  
+end
@@ -0,0 +1,81 @@
+classdef TestMexLstdCorrected < Test
+  %TESTMEXLSTDCORRECTED Test the corrected Peters' trick of the mex LSTD
+  %
+  %   Runs the same keyed GridEpisodicBasic episodes through MexGenericNAC
+  %   with the Peters' trick modes 'off', 'on' and 'corrected', and joins
+  %   the statistics of each mode into an LSTDLambda critic. The state
+  %   dimension differs from that of the Tetris features. On identical
+  %   episodes, the correction term of each step is lambda times the
+  %   difference of the 'on' and 'off' updates, so the A matrix of the
+  %   corrected mode must equal (1 - lambda) A_on + lambda A_off, and b
+  %   must not depend on the mode.
+  %
+  %   The result is the largest difference relative to the magnitude of
+  %   the statistics, and the test fails if it exceeds params.tolerance on
+  %   any revision.
+  
+  
+  properties
+    
+    % parameters
+    params = struct( ...
+      'environment', GridEpisodicBasic(5,5,'middlepuddle'), ...
+      'episodes', 10, ...
+      'gamma', 0.9, ...
+      'lambda', 0.5, ...
+      'seed', 1, ...
+      'tolerance', 1e-12 );
+    
+  end
+  
+  methods
+    
+    function result = run( this )
+      
+      p = this.params;
+      env = p.environment;
+      env = init( env, p.seed );
+      [env, observation, actions] = newEpisode( env );
+      sDim = numel(observation); aDim = size(actions, 2);
+      theta = randn( RandStream( 'mt19937ar', 'Seed', p.seed ), aDim, 1 );
+      stopConds = struct( 'maxSteps', Inf, 'totalRewardRange', [-Inf Inf] );
+      
+      % join the statistics of each mode (off, on, corrected) into LSTDLambda.m
+      critics = cell(1, 3);
+      for mode=1:3
+        critics{mode} = LSTDLambda( p.gamma, p.lambda );
+        critics{mode}.dim = sDim + aDim;
+        critics{mode} = reset( critics{mode} );
+        for ep=1:p.episodes
+          [~, envData] = env.mexFork( true );
+          envData.rngSeed = p.seed; envData.rngEpisode = ep;
+          agentData = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', p.seed ), ...
+            'criticClass', 0, 'learning', true, 'theta', theta, 'gamma', p.gamma, 'lambda', p.lambda, ...
+            'tau', 1, 'petersTrickMode', mode - 1 );
+          [~, agentDataOut] = TetrisNAC.MexGenericNAC( envData, agentData, stopConds );
+          critics{mode} = addData( critics{mode}, agentDataOut.critic );
+        end
+      end
+      
+      % the largest relative difference
+      ref = (1 - p.lambda) * critics{2}.A + p.lambda * critics{1}.A;
+      result = max(abs( critics{3}.A(:) - ref(:) )) / max(abs( ref(:) ));
+      result = max( result, max(abs( critics{3}.b - critics{1}.b )) / max(abs( critics{1}.b )) );
+      fprintf( 'TestMexLstdCorrected: relative difference = %g\n', result );
+      
+    end
+    
+    function error = compareResults( this, lhs, rhs )
+      % Zero if both results are within the tolerance, Inf otherwise.
+      
+      if lhs <= this.params.tolerance && rhs <= this.params.tolerance
+        error = 0;
+      else
+        error = Inf;
+      end
+      
+    end
+    
+  end
+  
+end
@@ -0,0 +1,100 @@
+classdef TestMexSession < Test
+  %TESTMEXSESSION Test the persistent sessions of the mex NAC
+  %
+  %   Runs the same keyed Tetris episodes once through plain mex calls,
+  %   whose statistics are added to an LSTDLambda critic, and once through
+  %   a mex session with 'run', whose statistics are read with 'query'.
+  %   The returns of the episodes and the statistics A and b must match,
+  %   also after a 'reset' that discards an earlier episode.
+  %
+  %   The result is the largest difference relative to the magnitude of
+  %   the statistics, and the test fails if it exceeds params.tolerance on
+  %   any revision.
+  
+  
+  properties
+    
+    % parameters
+    params = struct( ...
+      'episodes', 4, ...
+      'gamma', 0.9, ...
+      'lambda', 0.5, ...
+      'seed', 1, ...
+      'tolerance', 1e-12 );
+    
+  end
+  
+  methods
+    
+    function result = run( this )
+      
+      p = this.params;
+      theta = [zeros(10,1); -ones(9,1); 0; -3; 0; 1];
+      stopConds = struct( 'maxSteps', Inf, 'totalRewardRange', [-Inf Inf] );
+      
+      % the reference: plain mex calls joined into LSTDLambda.m
+      critic = LSTDLambda( p.gamma, p.lambda );
+      critic.dim = 22 + 23;
+      critic = reset( critic );
+      returns = zeros( 1, p.episodes );
+      for ep=1:p.episodes
+        [envOut, agentDataOut] = TetrisNAC.MexTetrisNAC( ...
+          this.environmentData( ep ), this.agentData( theta ), stopConds );
+        critic = addData( critic, agentDataOut.critic );
+        returns(ep) = envOut.return;
+      end
+      
+      % the candidate: a session, with a spurious first episode that is reset away
+      session = TetrisNAC.MexTetrisNAC( 'create', this.environmentData( 0 ), this.agentData( theta ) );
+      TetrisNAC.MexTetrisNAC( 'run', session, this.environmentData( 0 ), this.agentData( theta ), stopConds );
+      TetrisNAC.MexTetrisNAC( 'reset', session );
+      sessionReturns = zeros( 1, p.episodes );
+      for ep=1:p.episodes
+        envOut = TetrisNAC.MexTetrisNAC( ...
+          'run', session, this.environmentData( ep ), this.agentData( theta ), stopConds );
+        sessionReturns(ep) = envOut.return;
+      end
+      agentDataOut = TetrisNAC.MexTetrisNAC( 'query', session );
+      TetrisNAC.MexTetrisNAC( 'destroy', session );
+      
+      % the largest relative difference
+      result = max(abs( sessionReturns - returns ));
+      for field={'A', 'b'}
+        ref = critic.(field{1}); res = agentDataOut.critic.(field{1});
+        result = max( result, max(abs( res(:) - ref(:) )) / max(abs( ref(:) )) );
+      end
+      fprintf( 'TestMexSession: relative difference = %g\n', result );
+      
+    end
+    
+    function error = compareResults( this, lhs, rhs )
+      % Zero if both results are within the tolerance, Inf otherwise.
+      
+      if lhs <= this.params.tolerance && rhs <= this.params.tolerance
+        error = 0;
+      else
+        error = Inf;
+      end
+      
+    end
+    
+    function data = environmentData( this, episode )
+      % The keyed environment data of the given episode.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'rngSeed', this.params.seed, 'rngEpisode', episode );
+      
+    end
+    
+    function data = agentData( this, theta )
+      % The agent data of a learning LSTD agent.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'criticClass', 0, 'learning', true, 'theta', theta, ...
+        'gamma', this.params.gamma, 'lambda', this.params.lambda, 'tau', 1 );
+      
+    end
+    
+  end
+  
+end
@@ -0,0 +1,109 @@
+classdef TestMexSolverMethods < Test
+  %TESTMEXSOLVERMETHODS Test the native solver methods of the mex NAC
+  %
+  %   Runs keyed Tetris episodes in a mex session with the LSTD critic and
+  %   solves the critic with 'solve' for each native method ('\', 'qr',
+  %   'pinv', 'chol' and 'regularized'). The solutions must agree with the
+  %   solution of the statistics returned by 'query' with Matlab's
+  %   backslash. After a 'reset', the statistics are zero, and solving them
+  %   with '\' or 'qr' must raise Solver:singularMatrix instead of returning
+  %   NaN values.
+  %
+  %   The result is the largest difference relative to the norm of the
+  %   reference solution, and the test fails if it exceeds
+  %   params.tolerance on any revision.
+  
+  
+  properties
+    
+    % parameters
+    params = struct( ...
+      'methods', {{ '\', 'qr', 'pinv', 'chol', 'regularized' }}, ...
+      'episodes', 5, ...
+      'I', 1, ...
+      'regularization', 1e-9, ...
+      'gamma', 0.9, ...
+      'lambda', 0.5, ...
+      'seed', 1, ...
+      'tolerance', 1e-6 );
+    
+  end
+  
+  methods
+    
+    function result = run( this )
+      
+      p = this.params;
+      theta = [zeros(10,1); -ones(9,1); 0; -3; 0; 1];
+      stopConds = struct( 'maxSteps', Inf, 'totalRewardRange', [-Inf Inf] );
+      
+      session = TetrisNAC.MexTetrisNAC( 'create', this.environmentData( 0 ), this.agentData( theta ) );
+      for ep=1:p.episodes
+        TetrisNAC.MexTetrisNAC( 'run', session, this.environmentData( ep ), this.agentData( theta ), stopConds );
+      end
+      agentDataOut = TetrisNAC.MexTetrisNAC( 'query', session );
+      
+      % the reference: Matlab's backslash
+      A = agentDataOut.critic.A; b = agentDataOut.critic.b;
+      ref = (A + p.I * eye( size(A) )) \ b;
+      
+      % the candidates: each native method
+      result = 0;
+      for method=p.methods
+        solution = TetrisNAC.MexTetrisNAC( 'solve', session, this.solverOptions( method{1}, p.I ) );
+        result = max( result, norm( solution.V - ref ) / norm( ref ) );
+      end
+      
+      % singular statistics must raise an error
+      TetrisNAC.MexTetrisNAC( 'reset', session );
+      for method={'\', 'qr'}
+        try
+          TetrisNAC.MexTetrisNAC( 'solve', session, this.solverOptions( method{1}, 0 ) );
+          result = Inf;
+        catch err
+          if ~strcmp( err.identifier, 'Solver:singularMatrix' ); result = Inf; end
+        end
+      end
+      TetrisNAC.MexTetrisNAC( 'destroy', session );
+      fprintf( 'TestMexSolverMethods: relative difference = %g\n', result );
+      
+    end
+    
+    function error = compareResults( this, lhs, rhs )
+      % Zero if both results are within the tolerance, Inf otherwise.
+      
+      if lhs <= this.params.tolerance && rhs <= this.params.tolerance
+        error = 0;
+      else
+        error = Inf;
+      end
+      
+    end
+    
+    function data = environmentData( this, episode )
+      % The keyed environment data of the given episode.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'rngSeed', this.params.seed, 'rngEpisode', episode );
+      
+    end
+    
+    function data = agentData( this, theta )
+      % The agent data of a learning LSTD agent.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'criticClass', 0, 'learning', true, 'theta', theta, ...
+        'gamma', this.params.gamma, 'lambda', this.params.lambda, 'tau', 1 );
+      
+    end
+    
+    function opts = solverOptions( this, method, I )
+      % The solver options of the given method, without a feature mask.
+      
+      opts = struct( 'method', method, 'I', I, 'regularization', this.params.regularization, 'featureMask', [] );
+      
+    end
+    
+  end
+  
+end
@@ -0,0 +1,93 @@
+classdef TestMexSweepCritics < Test
+  %TESTMEXSWEEPCRITICS Test the parameter sweep critics of the mex NAC
+  %
+  %   Runs keyed Tetris episodes with a sweep of critics of several classes,
+  %   gammas and lambdas, sequentially and pipelined, and runs the same
+  %   episodes once for each setting with that critic as the main critic.
+  %   The statistics of each sweep critic must be identical to those of the
+  %   corresponding standalone run.
+  %
+  %   The result is the largest difference relative to the magnitude of
+  %   the statistics, and the test fails if it exceeds params.tolerance on
+  %   any revision.
+  
+  
+  properties
+    
+    % parameters: the rows of sweepCritics are [criticClass, gamma, lambda]
+    params = struct( ...
+      'sweepCritics', [0 1 0.5; 1 0.9 0.3; 3 0.95 0; 0 0.9 0.9], ...
+      'episodes', 2, ...
+      'seed', 1, ...
+      'tolerance', 0 );
+    
+  end
+  
+  methods
+    
+    function result = run( this )
+      
+      p = this.params;
+      theta = [zeros(10,1); -ones(9,1); 0; -3; 0; 1];
+      stopConds = struct( 'maxSteps', Inf, 'totalRewardRange', [-Inf Inf] );
+      
+      result = 0;
+      for ep=1:p.episodes
+        
+        % the references: each setting as the main critic
+        references = cell( 1, size( p.sweepCritics, 1 ) );
+        for i=1:size( p.sweepCritics, 1 )
+          [~, agentOut] = TetrisNAC.MexTetrisNAC( this.environmentData( ep ), ...
+            this.agentData( theta, p.sweepCritics(i,:), [], false ), stopConds );
+          references{i} = agentOut.critic;
+        end
+        
+        % the candidates: all settings as sweep critics, sequentially and pipelined
+        for pipelined=[false true]
+          [~, agentOut] = TetrisNAC.MexTetrisNAC( this.environmentData( ep ), ...
+            this.agentData( theta, [0 1 0], p.sweepCritics, pipelined ), stopConds );
+          for i=1:size( p.sweepCritics, 1 )
+            for field=fieldnames( references{i} )'
+              ref = references{i}.(field{1}); res = agentOut.sweepCritics{i}.(field{1});
+              result = max( result, max(abs( res(:) - ref(:) )) / max( max(abs( ref(:) )), 1 ) );
+            end
+          end
+        end
+        
+      end
+      fprintf( 'TestMexSweepCritics: relative difference = %g\n', result );
+      
+    end
+    
+    function error = compareResults( this, lhs, rhs )
+      % Zero if both results are within the tolerance, Inf otherwise.
+      
+      if lhs <= this.params.tolerance && rhs <= this.params.tolerance
+        error = 0;
+      else
+        error = Inf;
+      end
+      
+    end
+    
+    function data = environmentData( this, episode )
+      % The keyed environment data of the given episode.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'rngSeed', this.params.seed, 'rngEpisode', episode );
+      
+    end
+    
+    function data = agentData( this, theta, critic, sweepCritics, pipelined )
+      % The agent data of a learning agent with the main critic [criticClass, gamma, lambda] and the given sweep.
+      
+      data = struct( 'rstream', RandStream( 'mt19937ar', 'Seed', this.params.seed ), ...
+        'criticClass', critic(1), 'learning', true, 'theta', theta, ...
+        'gamma', critic(2), 'lambda', critic(3), 'tau', 1, ...
+        'sweepCritics', sweepCritics, 'pipelined', pipelined );
+      
+    end
+    
+  end
+  
+end